@@ -40,6 +40,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stddef.h>
 
 /*
  *	config.h needs to come first
@@ -55,6 +56,8 @@
 #include "fsl_power_manager.h"
 #include "fsl_mcglite_hal.h"
 #include "fsl_port_hal.h"
+#include "fsl_lptmr_hal.h"
+#include "fsl_rcm_hal.h"
 #include "fsl_lpuart_driver.h"
 #include "glaux.h"
 #include "warp.h"
@@ -124,7 +127,6 @@
 	volatile WarpI2CDeviceState			deviceMMA8451QState;
 #endif
 #if (WARP_BUILD_ENABLE_DEVBNO055)
-	#include "devBNO055.h"
 	volatile WarpI2CDeviceState			deviceBNO055State;	
 #endif
 #if (WARP_BUILD_ENABLE_DEVRF430CL331H)
@@ -209,12 +211,41 @@ typedef enum
 	kWarpFlashBNO055BitField		= 0b1000000000,
 	kWarpFlashBMX055BitField		= 0b10000000000,
 	kWarpFlashCCS811BitField		= 0b100000000000,
+	/*
+	 *	The SI7021 logs in the same layout as the HDC1000 and uses this
+	 *	bit on builds without the HDC1000; there are no spare bits, so
+	 *	kWarpFlashRecordFormatSI7021 says which of the two it was.
+	 */
 	kWarpFlashHDC1000BitField		= 0b1000000000000,
 	kWarpFlashRF430CL331HBitField	= 0b10000000000000,
 	kWarpFlashRV8803C7BitField		= 0b100000000000000,
 	kWarpFlashNumConfigErrors		= 0b1000000000000000,
 } WarpFlashSensorBitFieldEncoding;
 
+/*
+ *	Each record starts with the sensor bit field and then this byte: the
+ *	record layout version in the top two bits and, below them, which of the
+ *	layouts that share a sensor bit the build logged. It is in every record
+ *	rather than once at the start of the log, as the ring log erases that.
+ *
+ *	BME680Gas marks BME680 readings of 16 bytes, with gas resistance after
+ *	pressure, temperature and humidity, rather than the 12 of before.
+ *	BMX055Ahrs marks BMX055 readings that are the 8-byte AHRS quaternion
+ *	rather than the 22 bytes of raw channels. MMA8451QSpectrum marks
+ *	MMA8451Q readings that are the kWarpSpectrumBands band energies of a
+ *	spectrum window rather than one X/Y/Z sample, or with MMA8451QPeaks as
+ *	well, its kWarpSpectrumPeaks (bin, level) peaks.
+ */
+typedef enum
+{
+	kWarpFlashRecordFormatSI7021			= 0b1,
+	kWarpFlashRecordFormatBME680Gas			= 0b10,
+	kWarpFlashRecordFormatBMX055Ahrs		= 0b100,
+	kWarpFlashRecordFormatMMA8451QSpectrum	= 0b1000,
+	kWarpFlashRecordFormatMMA8451QPeaks		= 0b10000,
+	kWarpFlashRecordFormatVersion			= 0b01000000,
+} WarpFlashRecordFormatEncoding;
+
 volatile i2c_master_state_t		  i2cMasterState;
 volatile spi_master_state_t		  spiMasterState;
 volatile spi_master_user_config_t spiUserConfig;
@@ -223,6 +254,13 @@ volatile lpuart_state_t			  lpuartState;
 
 volatile bool		  gWarpBooted						   = false;
 volatile bool		  gWarpSleepMode					   = false;
+volatile bool		  gWarpWarmBoot						   = false;
+WarpPersistentState	  gWarpPersistentState;
+volatile uint32_t	  gWarpI2cTransactionCount			   = 0;
+volatile uint32_t	  gWarpI2cBusInitCount				   = 0;
+volatile uint32_t	  gWarpSpiTransactionCount			   = 0;
+volatile uint32_t	  gWarpSpiBusInitCount				   = 0;
+volatile bool		  gWarpFlashStreamOpen				   = false;
 volatile uint32_t	  gWarpI2cBaudRateKbps				   = kWarpDefaultI2cBaudRateKbps;
 volatile uint32_t	  gWarpUartBaudRateBps				   = kWarpDefaultUartBaudRateBps;
 volatile uint32_t	  gWarpSpiBaudRateKbps				   = kWarpDefaultSpiBaudRateKbps;
@@ -251,6 +289,126 @@ uint8_t							gWarpSpiCommonSinkBuffer[kWarpMemoryCommonSpiBufferBytes];
 
 static void						sleepUntilReset(void);
 static void						lowPowerPinStates(void);
+static void						enableSpiBus(void);
+static void						disableSpiBus(void);
+static void						enableI2cBus(void);
+static void						disableI2cBus(void);
+
+/*
+ *	Number of outstanding bus sessions. While a session is held, the per-transaction
+ *	warpEnable*pins()/warpDisable*pins() calls in the drivers leave the bus alone.
+ */
+static uint8_t					i2cBusSessionCount;
+static uint8_t					spiBusSessionCount;
+static uint32_t					i2cBusSavedBaudRateKbps;
+static uint32_t					spiBusSavedBaudRateKbps;
+static bool						i2cBusSessionStale;
+static bool						spiBusSessionStale;
+static bool						i2cBusSessionSuspended;
+static bool						spiBusSessionSuspended;
+
+#if (WARP_BUILD_ENABLE_DEVRV8803C7)
+/*
+ *	Errors from the device setup done in main() rather than in
+ *	writeAllSensorsToFlash(), which counts them in with its own.
+ */
+static uint8_t					bootConfigErrorCount = 0;
+#endif
+
+#if (WARP_BUILD_ENABLE_FLASH)
+/*
+ *	The time index is a ring of WarpFlashIndexEntry in its own part of the
+ *	flash. Where the next entry goes is not saved: flashLoadIndex() finds it
+ *	again by binary search on the entry numbers.
+ *
+ *	The RTC starts again from zero on a cold boot, so each entry also holds
+ *	the boot it was written in. The first record after a cold boot always
+ *	gets an entry, so the newest entry says which boot a warm boot is in.
+ *	Entries are written from flashHandleEndOfRecord() rather than when the
+ *	record starts, so index sector erases stay off the sample path.
+ */
+static bool						flashIndexLoaded = false;
+static uint16_t					flashIndexNextEntry;
+static uint16_t					flashIndexNextEntryNumber;
+static uint16_t					flashIndexLastGroup;
+static uint8_t					flashIndexBootEpoch;
+static bool						flashIndexBootEpochWritten;
+static bool						flashIndexPending = false;
+static WarpFlashIndexEntry		flashIndexPendingEntry;
+
+/*
+ *	Set while flashAggregateBetweenTimes() runs, so that the record decoder
+ *	accumulates readings instead of printing them.
+ */
+static WarpFlashAggregateQuery *	flashAggregateQuery = NULL;
+
+/*
+ *	The reader behind flashDumpRecords(), kept out of the stack. After 'q'
+ *	stops a read from the 'R' menu, flashLogReaderStopped is set and the next
+ *	'R' can carry on from where it was.
+ */
+static WarpFlashLogReader		flashLogReader;
+static bool						flashLogReaderStopped = false;
+#endif
+
+#if (WARP_BUILD_ENABLE_FLASH) && (WARP_BUILD_ENABLE_FLASH_TRIGGER)
+/*
+ *	Conditions that start a capture in writeAllSensorsToFlash(). Each is
+ *	only tested if its sensor is in the records being logged.
+ */
+static WarpTriggerCondition		triggerConditions[] =
+{
+#if (!WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM)
+	{
+		.predicate		= kWarpTriggerMagnitude,
+		.sensorBitField	= kWarpFlashMMA8451QBitField,
+		.readingIndex	= 0,
+		.threshold		= kWarpTriggerMMA8451QMagnitudeSquared,
+	},
+#endif
+	{
+		.predicate		= kWarpTriggerStep,
+		.sensorBitField	= kWarpFlashBME680BitField,
+		.readingIndex	= 0, /* Pressure */
+		.threshold		= kWarpTriggerBME680PressureStepPascals,
+	},
+	{
+		.predicate		= kWarpTriggerADXL362Activity,
+		.sensorBitField	= kWarpFlashADXL362BitField,
+	},
+};
+
+/*
+ *	Until a condition holds, records only go to a ring of the last few in
+ *	RAM. When one does, the ring goes to the flash, oldest record first,
+ *	followed by the next kWarpTriggerPostRecords records; each record that
+ *	meets a condition restarts that count. Records bound for the flash are
+ *	copied into the ring too, so that the conditions can be tested on them.
+ */
+static uint8_t					triggerRing[kWarpTriggerRingBytes];
+static uint16_t					triggerRecordBytes;
+static uint8_t					triggerRingSlots;
+static uint8_t					triggerRingNext;
+static uint8_t					triggerRingCount;
+static uint16_t					triggerRecordOffset;
+static uint16_t					triggerPostRecordsLeft;
+static bool						triggerArmed = false;
+
+static void						triggerStart(uint16_t sensorBitField);
+static WarpStatus				triggerBeginRecord(void);
+static WarpStatus				triggerEndRecord(void);
+#endif
+
+#if (WARP_BUILD_ENABLE_STACK_HIGH_WATER_MARK)
+/*
+ *	Bounds of the stack, from the linker script.
+ */
+extern uint32_t					__StackLimit[];
+extern uint32_t					__StackTop[];
+
+static void						paintStack(void);
+static uint32_t					stackHighWaterMarkBytes(void);
+#endif
 
 #if (!WARP_BUILD_ENABLE_GLAUX_VARIANT && !WARP_BUILD_ENABLE_FRDMKL03)
 	static void					disableTPS62740(void);
@@ -268,8 +426,12 @@ static void						activateAllLowPowerSensorModes(bool verbose);
 static void						powerupAllSensors(void);
 static uint8_t					readHexByte(void);
 static int						read4digits(void);
+#if (WARP_BUILD_ENABLE_FLASH)
+static uint32_t					read10digits(void);
+#endif
 static void 					writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever);
 static void						printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag, int menuDelayBetweenEachRun, bool loopForever);
+static void						updateEnvironmentDataCCS811(void);
 
 /*
  *	TODO: change the following to take byte arrays
@@ -279,6 +441,7 @@ WarpStatus						writeBytesToSpi(uint8_t *  payloadBytes, int payloadLength);
 
 
 void							warpLowPowerSecondsSleep(uint32_t sleepSeconds, bool forceAllPinsIntoLowPowerState);
+void							warpLowPowerMillisecondsSleep(uint32_t sleepMilliseconds, bool forceAllPinsIntoLowPowerState);
 
 /*
 * Flash related functions
@@ -286,11 +449,26 @@ void							warpLowPowerSecondsSleep(uint32_t sleepSeconds, bool forceAllPinsInto
 	WarpStatus					flashReadAllMemory();
 #if (WARP_BUILD_ENABLE_FLASH)
 	WarpStatus 					flashHandleEndOfWriteAllSensors();
+	WarpStatus 					flashHandleEndOfRecord();
 	WarpStatus					flashWriteFromEnd(size_t nbyte, uint8_t* buf);
 	WarpStatus					flashReadMemory(uint16_t startPageNumber, uint8_t startPageOffset, size_t nbyte, void *buf);
-	void 						flashHandleReadByte(uint8_t readByte, uint8_t *  bytesIndex, uint8_t *  readingIndex, uint8_t *  sensorIndex, uint8_t *  measurementIndex, uint8_t *  currentSensorNumberOfReadings, uint8_t *  currentSensorSizePerReading, uint16_t *  sensorBitField, uint8_t *  currentNumberOfSensors, int32_t *  currentReading);
+	WarpStatus					flashLoadPersistentState();
+	WarpStatus					flashStreamBegin();
+	WarpStatus					flashStreamEnd();
+	WarpStatus					flashGetLogHead(uint16_t* pageNumber, uint8_t* pageOffset);
+	void						flashGetLogTail(uint16_t* pageNumber, uint8_t* pageOffset);
+	WarpStatus					flashReadMemoryBetweenTimes(uint8_t bootEpoch, uint32_t startSeconds, uint32_t endSeconds);
+	WarpStatus					flashAggregateBetweenTimes(uint8_t bootEpoch, uint32_t startSeconds, uint32_t endSeconds, uint8_t sensorBitNumber, uint8_t firstReading);
+	WarpStatus					flashDumpRecords(uint16_t pageNumber, uint8_t pageOffset, uint16_t endPageNumber, uint8_t endPageOffset);
+	uint16_t					flashGetRecordSizeFromSensorBitField(uint16_t sensorBitField);
+	void						flashStartLogReader(WarpFlashLogReader *  reader, uint16_t pageNumber, uint8_t pageOffset, uint16_t endPageNumber, uint8_t endPageOffset);
+	WarpStatus					flashContinueLogReader(WarpFlashLogReader *  reader);
+	bool						flashLogReaderAtEnd(const WarpFlashLogReader *  reader);
+	void 						flashHandleReadByte(WarpFlashRecordDecoder *  decoder, uint8_t readByte);
+	uint8_t						flashGetRecordFormat(void);
 	uint8_t						flashGetNSensorsFromSensorBitField(uint16_t sensorBitField);
 	void						flashDecodeSensorBitField(uint16_t sensorBitField, uint8_t sensorIndex, uint8_t* sizePerReading, uint8_t* numberOfReadings);
+	static uint8_t				flashIndexCurrentBoot(void);
 #endif
 
 /*
@@ -355,6 +533,18 @@ RTC_Seconds_IRQHandler(void)
 	gWarpSleeptimeSeconds++;
 }
 
+/*
+ *	LPTMR compare match, used as the wakeup source for sub-second sleeps
+ *	(see armLptmrWakeup() in powermodes.c). The LPTMR is left running since
+ *	it is also the OSA time base.
+ */
+void
+LPTMR0_IRQHandler(void)
+{
+	LPTMR_HAL_SetIntCmd(LPTMR0_BASE, false);
+	LPTMR_HAL_ClearIntFlag(LPTMR0_BASE);
+}
+
 /*
  *	LLW_IRQHandler override. Since FRDM_KL03Z48M is not defined,
  *	according to power_manager_demo.c, what we need is LLW_IRQHandler.
@@ -441,6 +631,13 @@ sleepUntilReset(void)
 void
 enableLPUARTpins(void)
 {
+	/*
+	 *	The LPUART shares PTB3/4 with I2C0 and PTA6/7 with SPI0, so a bus session
+	 *	held across this gets set up again on its next transaction.
+	 */
+	i2cBusSessionStale = (i2cBusSessionCount > 0);
+	spiBusSessionStale = (spiBusSessionCount > 0);
+
 	/*
 	 *	Enable UART CLOCK
 	 */
@@ -531,9 +728,11 @@ sendBytesToUART(uint8_t *  bytes, size_t nbytes)
 	return kWarpStatusOK;
 }
 
-void
-warpEnableSPIpins(void)
+static void
+enableSpiBus(void)
 {
+	gWarpSpiBusInitCount++;
+
 	CLOCK_SYS_EnableSpiClock(0);
 
 	/*	kWarpPinSPI_MISO_UART_RTS_UART_RTS --> PTA6 (ALT3)	*/
@@ -562,8 +761,8 @@ warpEnableSPIpins(void)
 	SPI_DRV_MasterConfigureBus(0 /* SPI master instance */, (spi_master_user_config_t *)&spiUserConfig, &calculatedBaudRate);
 }
 
-void
-warpDisableSPIpins(void)
+static void
+disableSpiBus(void)
 {
 	SPI_DRV_MasterDeinit(0);
 
@@ -589,6 +788,67 @@ warpDisableSPIpins(void)
 	CLOCK_SYS_DisableSpiClock(0);
 }
 
+void
+warpEnableSPIpins(void)
+{
+	gWarpSpiTransactionCount++;
+
+	if ((spiBusSessionCount == 0) || spiBusSessionStale)
+	{
+		enableSpiBus();
+		spiBusSessionStale		= false;
+		spiBusSessionSuspended	= false;
+	}
+}
+
+void
+warpDisableSPIpins(void)
+{
+	if (spiBusSessionCount == 0)
+	{
+		disableSpiBus();
+	}
+}
+
+/*
+ *	Keep the SPI pins muxed and the SPI master configured at baudRateKbps until the
+ *	matching warpReleaseSpiBus(). Sessions nest; only the outermost acquire sets the
+ *	bus rate, and the previous rate is restored when the last session is released.
+ */
+void
+warpAcquireSpiBus(uint32_t baudRateKbps)
+{
+	if (spiBusSessionCount == 0)
+	{
+		spiBusSavedBaudRateKbps	= gWarpSpiBaudRateKbps;
+		gWarpSpiBaudRateKbps	= baudRateKbps;
+		enableSpiBus();
+	}
+
+	spiBusSessionCount++;
+}
+
+void
+warpReleaseSpiBus(void)
+{
+	if (spiBusSessionCount == 0)
+	{
+		return;
+	}
+
+	spiBusSessionCount--;
+	if (spiBusSessionCount == 0)
+	{
+		if (!spiBusSessionSuspended)
+		{
+			disableSpiBus();
+		}
+		gWarpSpiBaudRateKbps	= spiBusSavedBaudRateKbps;
+		spiBusSessionStale		= false;
+		spiBusSessionSuspended	= false;
+	}
+}
+
 void
 warpDeasserAllSPIchipSelects(void)
 {
@@ -606,9 +866,14 @@ warpDeasserAllSPIchipSelects(void)
 	 *
 	 *		On Glaux
 									PTB2/kGlauxPinFlash_SPI_nCS for GPIO
+	 *
+	 *	On Glaux, PTA9 is SPI SCK, not a chip select. It is left as it is:
+	 *	warpEnableSPIpins() does not mux it again inside a bus session.
 	 */
 	PORT_HAL_SetMuxMode(PORTA_BASE, 12, kPortMuxAsGpio);
+#if (!WARP_BUILD_ENABLE_GLAUX_VARIANT)
 	PORT_HAL_SetMuxMode(PORTA_BASE, 9, kPortMuxAsGpio);
+#endif
 	PORT_HAL_SetMuxMode(PORTA_BASE, 8, kPortMuxAsGpio);
 	PORT_HAL_SetMuxMode(PORTB_BASE, 1, kPortMuxAsGpio);
 #if (WARP_BUILD_ENABLE_GLAUX_VARIANT)
@@ -634,6 +899,12 @@ warpDeasserAllSPIchipSelects(void)
 #if (WARP_BUILD_ENABLE_GLAUX_VARIANT)
 	GPIO_DRV_SetPinOutput(kGlauxPinFlash_SPI_nCS);	
 #endif
+
+	/*
+	 *	Deasserting the flash chip select ends any record stream in progress;
+	 *	the flash driver reopens it at the right offset on the next byte.
+	 */
+	gWarpFlashStreamOpen = false;
 }
 
 void
@@ -646,9 +917,11 @@ debugPrintSPIsinkBuffer(void)
 	warpPrint("\n");
 }
 
-void
-warpEnableI2Cpins(void)
+static void
+enableI2cBus(void)
 {
+	gWarpI2cBusInitCount++;
+
 	/*
 	* Returning here if Glaux variant doesn't work. The program hangs. It seems to be okay if it is done only in the disable function.
 	*/
@@ -670,8 +943,8 @@ warpEnableI2Cpins(void)
 // #endif
 }
 
-void
-warpDisableI2Cpins(void)
+static void
+disableI2cBus(void)
 {
 #if (WARP_BUILD_ENABLE_GLAUX_VARIANT)
 	
@@ -693,6 +966,99 @@ warpDisableI2Cpins(void)
 #endif
 }
 
+void
+warpEnableI2Cpins(void)
+{
+	gWarpI2cTransactionCount++;
+
+	if ((i2cBusSessionCount == 0) || i2cBusSessionStale)
+	{
+		enableI2cBus();
+		i2cBusSessionStale		= false;
+		i2cBusSessionSuspended	= false;
+	}
+}
+
+void
+warpDisableI2Cpins(void)
+{
+	if (i2cBusSessionCount == 0)
+	{
+		disableI2cBus();
+	}
+}
+
+/*
+ *	I2C counterpart of warpAcquireSpiBus(). The rate takes effect through
+ *	gWarpI2cBaudRateKbps, which the drivers copy into each i2c_device_t.
+ */
+void
+warpAcquireI2cBus(uint32_t baudRateKbps)
+{
+	if (i2cBusSessionCount == 0)
+	{
+		i2cBusSavedBaudRateKbps	= gWarpI2cBaudRateKbps;
+		gWarpI2cBaudRateKbps	= baudRateKbps;
+		enableI2cBus();
+	}
+
+	i2cBusSessionCount++;
+}
+
+void
+warpReleaseI2cBus(void)
+{
+	if (i2cBusSessionCount == 0)
+	{
+		return;
+	}
+
+	i2cBusSessionCount--;
+	if (i2cBusSessionCount == 0)
+	{
+		if (!i2cBusSessionSuspended)
+		{
+			disableI2cBus();
+		}
+		gWarpI2cBaudRateKbps	= i2cBusSavedBaudRateKbps;
+		i2cBusSessionStale		= false;
+		i2cBusSessionSuspended	= false;
+	}
+}
+
+/*
+ *	Called before sleeping in VLPS, which stops the bus clocks under any
+ *	session still held. Shut the buses down, which also ends a flash record
+ *	stream, and mark the sessions stale, so that the next transaction sets
+ *	the bus up again as warpEnableSPIpins() / warpEnableI2Cpins() do after
+ *	the LPUART has had the pins.
+ */
+void
+warpSuspendBusSessions(void)
+{
+	if ((spiBusSessionCount > 0) && !spiBusSessionSuspended)
+	{
+		warpDeasserAllSPIchipSelects();
+		disableSpiBus();
+		spiBusSessionStale		= true;
+		spiBusSessionSuspended	= true;
+	}
+
+	if ((i2cBusSessionCount > 0) && !i2cBusSessionSuspended)
+	{
+		disableI2cBus();
+		i2cBusSessionStale		= true;
+		i2cBusSessionSuspended	= true;
+	}
+}
+
+void
+warpPrintBusTransactionCounts(void)
+{
+	warpPrint("\r\n\tI2C: %u transactions, %u bus initialisations", gWarpI2cTransactionCount, gWarpI2cBusInitCount);
+	warpPrint("\r\n\tSPI: %u transactions, %u bus initialisations\n", gWarpSpiTransactionCount, gWarpSpiBusInitCount);
+}
+
 #if (WARP_BUILD_ENABLE_GLAUX_VARIANT)
 void
 lowPowerPinStates(void)
@@ -1135,6 +1501,12 @@ warpDisableSupplyVoltage(void)
 
 void
 warpLowPowerSecondsSleep(uint32_t sleepSeconds, bool forceAllPinsIntoLowPowerState)
+{
+	warpLowPowerMillisecondsSleep(sleepSeconds*1000, forceAllPinsIntoLowPowerState);
+}
+
+void
+warpLowPowerMillisecondsSleep(uint32_t sleepMilliseconds, bool forceAllPinsIntoLowPowerState)
 {
 	WarpStatus	status = kWarpStatusOK;
 
@@ -1148,16 +1520,23 @@ warpLowPowerSecondsSleep(uint32_t sleepSeconds, bool forceAllPinsIntoLowPowerSta
 		lowPowerPinStates();
 	}
 
-	warpSetLowPowerMode(kWarpPowerModeVLPR, 0 /* Sleep Seconds */);
-	if ((status != kWarpStatusOK) && (status != kWarpStatusPowerTransitionErrorVlpr2Vlpr))
+	/*
+	 *	When duty-cycling, we are normally already in VLPR on the way back
+	 *	from the previous VLPS, so only pay for the transition if needed.
+	 */
+	if (POWER_SYS_GetCurrentMode() != kPowerManagerVlpr)
 	{
-		warpPrint("warpSetLowPowerMode(kWarpPowerModeVLPR, 0 /* sleep seconds : irrelevant here */)() failed...\n");
+		status = warpSetLowPowerMode(kWarpPowerModeVLPR, 0 /* Sleep Seconds */);
+		if ((status != kWarpStatusOK) && (status != kWarpStatusPowerTransitionErrorVlpr2Vlpr))
+		{
+			warpPrint("warpSetLowPowerMode(kWarpPowerModeVLPR, 0 /* sleep seconds : irrelevant here */)() failed...\n");
+		}
 	}
 
-	status = warpSetLowPowerMode(kWarpPowerModeVLPS, sleepSeconds);
+	status = warpSetLowPowerModeMilliseconds(kWarpPowerModeVLPS, sleepMilliseconds);
 	if (status != kWarpStatusOK)
 	{
-		warpPrint("warpSetLowPowerMode(kWarpPowerModeVLPS, 0 /* sleep seconds : irrelevant here */)() failed...\n");
+		warpPrint("warpSetLowPowerModeMilliseconds(kWarpPowerModeVLPS, %d)() failed...\n", sleepMilliseconds);
 	}
 }
 
@@ -1502,6 +1881,13 @@ main(void)
 								&callbackCfg0
 						};
 
+#if (WARP_BUILD_ENABLE_STACK_HIGH_WATER_MARK)
+	/*
+	 *	Before anything else uses the stack below main()'s frame.
+	 */
+	paintStack();
+#endif
+
 	/*
 	 *	Enable clock for I/O PORT A and PORT B
 	 */
@@ -1526,6 +1912,16 @@ main(void)
 	 */
 	SEGGER_RTT_ConfigUpBuffer(0, NULL, NULL, 0, SEGGER_RTT_MODE_NO_BLOCK_TRIM);
 
+	/*
+	 *	Waking from VLLSx goes through a reset with RCM_SRS0[WAKEUP] set,
+	 *	whereas a power-on or reset-button reset leaves it clear. On such a
+	 *	warm boot, we skip everything that is only there for someone at the
+	 *	console and go straight back to sampling.
+	 */
+#if (WARP_BUILD_ENABLE_GLAUX_VARIANT && WARP_BUILD_BOOT_TO_CSVSTREAM && WARP_BUILD_WARM_BOOT_FROM_VLLS)
+	gWarpWarmBoot = RCM_HAL_GetSrcStatusCmd(RCM_BASE, kRcmWakeup);
+#endif
+
 	/*
 	 *	When booting to CSV stream, we wait to be up and running as soon as possible after
 	 *	a reset (e.g., a reset due to waking from VLLS0)
@@ -1560,15 +1956,20 @@ main(void)
 	RTC_DRV_Init(0);
 
 	/*
-	 *	Set initial date to 1st January 2016 00:00, and set date via RTC driver
+	 *	Set initial date to 1st January 2016 00:00, and set date via RTC driver.
+	 *	On a warm boot the RTC (clocked from RTC_CLKIN on Glaux) has kept running
+	 *	through VLLS0, so leave it alone.
 	 */
-	warpBootDate.year	= 2016U;
-	warpBootDate.month	= 1U;
-	warpBootDate.day	= 1U;
-	warpBootDate.hour	= 0U;
-	warpBootDate.minute	= 0U;
-	warpBootDate.second	= 0U;
-	RTC_DRV_SetDatetime(0, &warpBootDate);
+	if (!gWarpWarmBoot)
+	{
+		warpBootDate.year	= 2016U;
+		warpBootDate.month	= 1U;
+		warpBootDate.day	= 1U;
+		warpBootDate.hour	= 0U;
+		warpBootDate.minute	= 0U;
+		warpBootDate.second	= 0U;
+		RTC_DRV_SetDatetime(0, &warpBootDate);
+	}
 
 	/*
 	 *	Setup Power Manager Driver
@@ -1645,11 +2046,21 @@ main(void)
 	lowPowerPinStates();
 	warpPrint("done.\n");
 
+	/*
+	 *	After a wakeup from VLLSx, the pins remain latched in their pre-sleep
+	 *	state until we acknowledge the isolation. Now that they have been
+	 *	configured again, release them.
+	 */
+	POWER_SYS_ClearAckIsolation();
+
 /*
  *	Toggle LED3 (kWarpPinSI4705_nRST on Warp revB, kGlauxPinLED on Glaux)
  */
 #if (WARP_BUILD_ENABLE_GLAUX_VARIANT)
-	blinkLED(kGlauxPinLED);
+	if (!gWarpWarmBoot)
+	{
+		blinkLED(kGlauxPinLED);
+	}
 #endif
 
 /*
@@ -1720,45 +2131,6 @@ main(void)
 
 #if (WARP_BUILD_ENABLE_DEVRV8803C7)
 		initRV8803C7(	0x32	/* i2cAddress */,					kWarpDefaultSupplyVoltageMillivoltsRV8803C7	);
-		status = setRTCCountdownRV8803C7(0 /* countdown */, kWarpRV8803ExtTD_1HZ /* frequency */, false /* interupt_enable */);
-	if (status != kWarpStatusOK)
-	{
-		warpPrint("setRTCCountdownRV8803C7() failed...\n");
-	}
-	else
-	{
-		warpPrint("setRTCCountdownRV8803C7() succeeded.\n");
-	}
-
-	/*
-	 *	Set the CLKOUT frequency to 1Hz, to reduce CV^2 power on the CLKOUT pin.
-	 *	See RV-8803-C7_App-Manual.pdf section 3.6 (register is 0Dh)
-	 */
-		uint8_t	extReg;
-	status = readRTCRegisterRV8803C7(kWarpRV8803RegExt, &extReg);
-	if (status != kWarpStatusOK)
-	{
-		warpPrint("readRTCRegisterRV8803C7() failed...\n");
-	}
-	else
-	{
-		warpPrint("readRTCRegisterRV8803C7() succeeded.\n");
-	}
-
-	/*
-	 *	Set bits 3:2 (FD) to 10 (1Hz CLKOUT)
-	 */
-	extReg &= 0b11110011;
-	extReg |= 0b00001000;
-	status = writeRTCRegisterRV8803C7(kWarpRV8803RegExt, extReg);
-	if (status != kWarpStatusOK)
-	{
-		warpPrint("writeRTCRegisterRV8803C7() failed...\n");
-	}
-	else
-	{
-		warpPrint("writeRTCRegisterRV8803C7() succeeded.\n");
-	}
 #endif
 
 	/*
@@ -1798,10 +2170,79 @@ main(void)
 	 */
 	initIS25xP(kGlauxPinFlash_SPI_nCS, kWarpDefaultSupplyVoltageMillivoltsIS25xP);
 
+#if (WARP_BUILD_ENABLE_FLASH)
+	/*
+	 *	On a warm boot, the persistent state says whether the sampling round
+	 *	before the sleep left every device configured. The flash was put in
+	 *	deep power-down before that sleep.
+	 */
+	if (gWarpWarmBoot)
+	{
+		releaseDeepPowerModeIS25xP();
+		status = flashLoadPersistentState();
+		if (status != kWarpStatusOK)
+		{
+			warpPrint("flashLoadPersistentState() failed...\n");
+		}
+	}
+#endif
 #elif (WARP_BUILD_ENABLE_DEVIS25xP)
 	initIS25xP(kWarpPinIS25xP_SPI_nCS, kWarpDefaultSupplyVoltageMillivoltsIS25xP);
 #endif
 
+#if (WARP_BUILD_ENABLE_DEVRV8803C7)
+	/*
+	 *	The RTC is not reset by VLLS0, so its countdown and CLKOUT settings are
+	 *	only set up again when the last sampling round did not finish
+	 *	configuring the devices.
+	 */
+	if (!(gWarpWarmBoot && (gWarpPersistentState.flags & kWarpPersistentStateFlagDevicesConfigured)))
+	{
+		status = setRTCCountdownRV8803C7(0 /* countdown */, kWarpRV8803ExtTD_1HZ /* frequency */, false /* interupt_enable */);
+		if (status != kWarpStatusOK)
+		{
+			warpPrint("setRTCCountdownRV8803C7() failed...\n");
+			bootConfigErrorCount++;
+		}
+		else
+		{
+			warpPrint("setRTCCountdownRV8803C7() succeeded.\n");
+		}
+
+		/*
+		 *	Set the CLKOUT frequency to 1Hz, to reduce CV^2 power on the CLKOUT pin.
+		 *	See RV-8803-C7_App-Manual.pdf section 3.6 (register is 0Dh)
+		 */
+		uint8_t	extReg;
+		status = readRTCRegisterRV8803C7(kWarpRV8803RegExt, &extReg);
+		if (status != kWarpStatusOK)
+		{
+			warpPrint("readRTCRegisterRV8803C7() failed...\n");
+			bootConfigErrorCount++;
+		}
+		else
+		{
+			warpPrint("readRTCRegisterRV8803C7() succeeded.\n");
+		}
+
+		/*
+		 *	Set bits 3:2 (FD) to 10 (1Hz CLKOUT)
+		 */
+		extReg &= 0b11110011;
+		extReg |= 0b00001000;
+		status = writeRTCRegisterRV8803C7(kWarpRV8803RegExt, extReg);
+		if (status != kWarpStatusOK)
+		{
+			warpPrint("writeRTCRegisterRV8803C7() failed...\n");
+			bootConfigErrorCount++;
+		}
+		else
+		{
+			warpPrint("writeRTCRegisterRV8803C7() succeeded.\n");
+		}
+	}
+#endif
+
 #if (WARP_BUILD_ENABLE_DEVISL23415)
 	/*
 	 *	Only supported in main Warp variant.
@@ -1959,21 +2400,33 @@ main(void)
 	int rttKey = -1;
 
 	bool _originalWarpExtraQuietMode = gWarpExtraQuietMode;
-	gWarpExtraQuietMode = false;
 	releaseDeepPowerModeIS25xP();
-	warpPrint("Press any key to show menu...\n");
-	gWarpExtraQuietMode = _originalWarpExtraQuietMode;
 
-	while (rttKey < 0 && timer < kWarpCsvstreamMenuWaitTimeMilliSeconds)
+	/*
+	 *	Only offer the menu on a cold boot. Waking from VLLS0 to take the
+	 *	next sample should not spend kWarpCsvstreamMenuWaitTimeMilliSeconds
+	 *	in RUN waiting for a key nobody is going to press.
+	 */
+	if (!gWarpWarmBoot)
 	{
-		rttKey = SEGGER_RTT_GetKey();
-		OSA_TimeDelay(1);
-		timer++;
+		gWarpExtraQuietMode = false;
+		warpPrint("Press any key to show menu...\n");
+		gWarpExtraQuietMode = _originalWarpExtraQuietMode;
+
+		while (rttKey < 0 && timer < kWarpCsvstreamMenuWaitTimeMilliSeconds)
+		{
+			rttKey = SEGGER_RTT_GetKey();
+			OSA_TimeDelay(1);
+			timer++;
+		}
 	}
 
 	if (rttKey < 0)
 	{
-		printBootSplash(gWarpCurrentSupplyVoltage, menuRegisterAddress, &powerManagerCallbackStructure);
+		if (!gWarpWarmBoot)
+		{
+			printBootSplash(gWarpCurrentSupplyVoltage, menuRegisterAddress, &powerManagerCallbackStructure);
+		}
 
 		warpPrint("About to loop with printSensorDataBME680()...\n");
 		while (1)
@@ -2001,8 +2454,13 @@ main(void)
 				warpPrint("About to configureSensorBME680() for sleep...\n");
 					status = configureSensorBME680(	0b00000000,	/*	payloadCtrl_Hum: Sleep							*/
 									0b00000000,	/*	payloadCtrl_Meas: No temperature samples, no pressure samples, sleep	*/
-									0b00001000	/*	payloadGas_0: Turn off heater						*/
-				);			
+									0b00000000	/*	payloadGas_0: heat_off set by setGasScheduleBME680() below		*/
+				);
+				/*
+				 *	No gas measurements, so that the heater is off and the
+				 *	driver's schedule agrees with ctrl_gas_0.
+				 */
+				status |= setGasScheduleBME680(0 /* numberOfProfiles */, 0 /* gasMeasurementInterval */);
 				if (status != kWarpStatusOK)
 				{
 					warpPrint("configureSensorBME680() failed...\n");
@@ -2021,6 +2479,30 @@ main(void)
 				StatusRF430CL331H();
 			#endif
 			#if (WARP_BUILD_ENABLE_DEVIS25xP)
+			/*
+			*	Use the idle time to erase ahead of the log. The flash ignores
+			*	deep power-down while erasing, so let the erase finish first.
+			*/
+				status = eraseAheadIS25xP();
+				if (status == kWarpStatusOK)
+				{
+					status = finishEraseAheadIS25xP();
+				}
+				if (status != kWarpStatusOK)
+				{
+					warpPrint("\r\n\tError: erase-ahead failed");
+				}
+
+			/*
+			*	RAM does not survive VLLS0, so save everything since the last
+			*	periodic save.
+			*/
+				status = savePersistentStateIS25xP();
+				if (status != kWarpStatusOK)
+				{
+					warpPrint("\r\n\tError: savePersistentStateIS25xP failed");
+				}
+
 			/*
 			*	Put the Flash in deep power-down
 			*/
@@ -2081,13 +2563,21 @@ main(void)
 
 #if (WARP_BUILD_ENABLE_DEVAT45DB)
 		warpPrint("\r- 'R': read bytes from Flash.\n");
+		warpPrint("\r- 'T': read Flash records between two times.\n");
+		warpPrint("\r- 'A': min/max/mean of Flash readings between two times.\n");
 		warpPrint("\r- 'Z': reset Flash.\n");
 #elif (WARP_BUILD_ENABLE_DEVIS25xP)
 		warpPrint("\r- 'R': read bytes from Flash.\n");
+		warpPrint("\r- 'T': read Flash records between two times.\n");
+		warpPrint("\r- 'A': min/max/mean of Flash readings between two times.\n");
 		warpPrint("\r- 'F': Open Flash menu.\n");
 		warpPrint("\r- 'Z': reset Flash.\n");
 #endif
 
+#if (WARP_BUILD_ENABLE_STACK_HIGH_WATER_MARK)
+		warpPrint("\r- 'S': print stack high-water mark.\n");
+#endif
+
 #if (WARP_BUILD_ENABLE_DEVICE40)
 		warpPrint("\r- 'P': write bytes to FPGA configuration.\n");
 #endif
@@ -2096,6 +2586,8 @@ main(void)
 		warpPrint("\r- 'v': Enter VLLS0 low-power mode for 3s, then reset\n");
 #endif
 
+		warpPrint("\r- 'w': print power mode transition costs.\n");
+		warpPrint("\r- 'y': print and reset bus transaction counts.\n");
 		warpPrint("\r- 'x': disable SWD and spin for 10 secs.\n");
 		warpPrint("\r- 'z': perpetually dump all sensor data.\n");
 
@@ -2152,9 +2644,9 @@ main(void)
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVSI7021)
-					warpPrint("\r\t- '9' SI7021			(0x00--0x0F): 1.9V -- 3.6V\n");
+					warpPrint("\r\t- '9' SI7021			(0xE0--0xF5): 1.9V -- 3.6V\n");
 #else
-					warpPrint("\r\t- '9' SI7021			(0x00--0x0F): 1.9V -- 3.6V (compiled out) \n");
+					warpPrint("\r\t- '9' SI7021			(0xE0--0xF5): 1.9V -- 3.6V (compiled out) \n");
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVL3GD20H)
@@ -2745,6 +3237,32 @@ main(void)
 				break;
 			}
 #endif
+			/*
+			 *	Print the measured power mode transition costs
+			 */
+			case 'w':
+			{
+				warpPrintPowerModeTransitionCosts();
+
+				break;
+			}
+
+			/*
+			 *	Print how many bus transactions each bus (re)initialisation served, then
+			 *	start counting afresh, e.g., before a run of 'z'.
+			 */
+			case 'y':
+			{
+				warpPrintBusTransactionCounts();
+
+				gWarpI2cTransactionCount	= 0;
+				gWarpI2cBusInitCount		= 0;
+				gWarpSpiTransactionCount	= 0;
+				gWarpSpiBusInitCount		= 0;
+
+				break;
+			}
+
 			/*
 			 *	Simply spin for 10 seconds. Since the SWD pins should only be enabled when we are waiting for key at top of loop (or toggling after printf), during this time there should be no interference from the SWD.
 			 */
@@ -2811,6 +3329,90 @@ main(void)
 				break;
 			}
 
+#if (WARP_BUILD_ENABLE_FLASH)
+			/*
+			 *	Read the records logged between two RTC times
+			 */
+			case 'T':
+			{
+				WarpStatus	status;
+				uint8_t		bootEpoch;
+				uint32_t	startSeconds;
+				uint32_t	endSeconds;
+
+				warpPrint("\r\n\tCurrent boot is %d, RTC time is %d seconds.", flashIndexCurrentBoot(), RTC->TSR);
+				warpPrint("\r\n\tEnter boot (e.g., '003')> ");
+				bootEpoch = (warpWaitKey() - '0') * 100;
+				bootEpoch += (warpWaitKey() - '0') * 10;
+				bootEpoch += warpWaitKey() - '0';
+				warpPrint("\r\n\tEnter start time in seconds (e.g., '0000003600')> ");
+				startSeconds = read10digits();
+				warpPrint("\r\n\tEnter end time in seconds (e.g., '0000007200')> ");
+				endSeconds = read10digits();
+
+				status = flashReadMemoryBetweenTimes(bootEpoch, startSeconds, endSeconds);
+				if (status != kWarpStatusOK)
+				{
+					warpPrint("\r\n\tflashReadMemoryBetweenTimes failed: %d", status);
+				}
+				break;
+			}
+
+			/*
+			 *	Aggregate the readings of one sensor logged between two RTC times
+			 */
+			case 'A':
+			{
+				WarpStatus	status;
+				uint8_t		sensorBitNumber;
+				uint8_t		firstReading;
+				uint8_t		bootEpoch;
+				uint32_t	startSeconds;
+				uint32_t	endSeconds;
+
+				warpPrint("\r\n\tEnter sensor bit number in the record bit field (e.g., '08' for BME680)> ");
+				sensorBitNumber = (warpWaitKey() - '0') * 10;
+				sensorBitNumber += warpWaitKey() - '0';
+				warpPrint("\r\n\tEnter first reading of that sensor to aggregate (e.g., '00')> ");
+				firstReading = (warpWaitKey() - '0') * 10;
+				firstReading += warpWaitKey() - '0';
+				warpPrint("\r\n\tCurrent boot is %d, RTC time is %d seconds.", flashIndexCurrentBoot(), RTC->TSR);
+				warpPrint("\r\n\tEnter boot (e.g., '003')> ");
+				bootEpoch = (warpWaitKey() - '0') * 100;
+				bootEpoch += (warpWaitKey() - '0') * 10;
+				bootEpoch += warpWaitKey() - '0';
+				warpPrint("\r\n\tEnter start time in seconds (e.g., '0000003600')> ");
+				startSeconds = read10digits();
+				warpPrint("\r\n\tEnter end time in seconds (e.g., '0000007200')> ");
+				endSeconds = read10digits();
+
+				if (sensorBitNumber >= 15)
+				{
+					warpPrint("\r\n\tInvalid sensor bit number");
+					break;
+				}
+
+				status = flashAggregateBetweenTimes(bootEpoch, startSeconds, endSeconds, sensorBitNumber, firstReading);
+				if (status != kWarpStatusOK)
+				{
+					warpPrint("\r\n\tflashAggregateBetweenTimes failed: %d", status);
+				}
+				break;
+			}
+#endif
+
+#if (WARP_BUILD_ENABLE_STACK_HIGH_WATER_MARK)
+			/*
+			 *	Print the deepest the stack has been since boot
+			 */
+			case 'S':
+			{
+				warpPrint("\r\n\tStack high-water mark: %u of %u bytes",
+					stackHighWaterMarkBytes(), (uint32_t)__StackTop - (uint32_t)__StackLimit);
+				break;
+			}
+#endif
+
 			case 'Z':
 			{
 #if (WARP_BUILD_ENABLE_DEVAT45DB)
@@ -2825,6 +3427,8 @@ main(void)
 					warpPrint("\r\n\tsetAT45DBStartOffset failed: %d", status);
 					break;
 				}
+				flashIndexLoaded = false;
+				flashLogReaderStopped = false;
 
 				warpPrint("\r\n\tFlash reset\n");
 
@@ -2843,6 +3447,8 @@ main(void)
 					warpPrint("\r\n\tresetIS25xP failed: %d", status);
 					break;
 				}
+				flashIndexLoaded = false;
+				flashLogReaderStopped = false;
 				warpPrint("\r\n\tFlash reset\n");
 				break;
 #else
@@ -3219,11 +3825,39 @@ main(void)
 	return 0;
 }
 
+/*
+ *	Pass the humidity and temperature from the last BME680 (or HDC1000,
+ *	or SI7021) measurement on to the CCS811 for its environmental
+ *	compensation.
+ */
+static void
+updateEnvironmentDataCCS811(void)
+{
+#if (WARP_BUILD_ENABLE_DEVCCS811) && (WARP_BUILD_ENABLE_DEVBME680 || WARP_BUILD_ENABLE_DEVHDC1000 || WARP_BUILD_ENABLE_DEVSI7021)
+	int16_t		temperatureCentidegrees;
+	uint16_t	humidityCentipercent;
+	WarpStatus	status;
+
+	#if (WARP_BUILD_ENABLE_DEVBME680)
+		status = environmentDataBME680(&temperatureCentidegrees, &humidityCentipercent);
+	#elif (WARP_BUILD_ENABLE_DEVHDC1000)
+		status = environmentDataHDC1000(&temperatureCentidegrees, &humidityCentipercent);
+	#else
+		status = environmentDataSI7021(&temperatureCentidegrees, &humidityCentipercent);
+	#endif
+
+	if (status == kWarpStatusOK)
+	{
+		setEnvironmentDataCCS811(temperatureCentidegrees, humidityCentipercent);
+	}
+#endif
+}
+
 void
 writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 {
 #if (WARP_BUILD_ENABLE_FLASH)
-	uint32_t timeAtStart = OSA_TimeGetMsec();
+	uint32_t timeAtStart = warpTimeGetMilliseconds();
 	/*
 	 *	A 32-bit counter gives us > 2 years of before it wraps, even if sampling
 	 *at 60fps
@@ -3242,12 +3876,41 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 	sensorBitField = sensorBitField | kWarpFlashRTCTPRBitField;
 #endif
 
-	uint8_t	 flashWriteBuf[128] = {0};
-
 	int rttKey = -1;
 	WarpStatus status;
 
-#if (WARP_BUILD_DEVADXL362)
+	/*
+	 *	Hold both buses for the whole sampling round rather than setting them up
+	 *	again for every register access.
+	 */
+	warpAcquireI2cBus(gWarpI2cBaudRateKbps);
+	warpAcquireSpiBus(gWarpSpiBaudRateKbps);
+
+	/*
+	 *	Carry the reading count and error tally on from the last wake cycle
+	 *	instead of restarting them after every reset.
+	 */
+	status = flashLoadPersistentState();
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tflashLoadPersistentState failed: %d", status);
+		warpReleaseSpiBus();
+		warpReleaseI2cBus();
+		return;
+	}
+
+#if (WARP_BUILD_ENABLE_DEVRF430CL331H)
+	/*
+	 *	Devices whose registers survive VLLS0 and are not touched before the
+	 *	sleep only need configuring again if the last round did not manage it.
+	 */
+	bool devicesConfigured = gWarpWarmBoot && (gWarpPersistentState.flags & kWarpPersistentStateFlagDevicesConfigured);
+#endif
+
+#if (WARP_BUILD_ENABLE_DEVADXL362)
+#if (WARP_BUILD_ENABLE_FLASH_TRIGGER)
+	numberOfConfigErrors += configureActivityADXL362(kWarpTriggerADXL362ActivityMilliG, kWarpTriggerADXL362ActivitySamples);
+#endif
 
 	sensorBitField = sensorBitField | kWarpFlashADXL362BitField;
 #endif
@@ -3262,7 +3925,11 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 
 #if (WARP_BUILD_ENABLE_DEVMMA8451Q)
 	numberOfConfigErrors += configureSensorMMA8451Q(
+#if (WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM)
+		0x40, /* Payload: Circular FIFO, for spectrum windows */
+#else
 		0x00, /* Payload: Disable FIFO */
+#endif
 		0x01  /* Normal read 8bit, 800Hz, normal, active mode */
 	);
 	sensorBitField = sensorBitField | kWarpFlashMMA8451QBitField;
@@ -3275,6 +3942,12 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 		0xA0, /*	Payload: AUTO_MRST_EN enable, RAW value without offset */
 		0x10);
 
+	/*
+	 *	Run no faster than the records asked for, or trigger one measurement
+	 *	per record once they are a second or more apart.
+	 */
+	numberOfConfigErrors += selectAcquisitionModeMAG3110(menuDelayBetweenEachRun, false /* fastRead */);
+
 	sensorBitField = sensorBitField | kWarpFlashMAG3110BitField;
 #endif
 
@@ -3286,6 +3959,12 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 		0b00000000 /* normal mode, disable FIFO, disable high pass filter */
 	);
 
+	/*
+	 *	At 800 Hz the gyroscope cannot be polled for every sample; each record
+	 *	averages what the FIFO collected since the last one instead.
+	 */
+	numberOfConfigErrors += configureFifoL3GD20H(kWarpL3GD20HFifoWatermarkSamples);
+
 	sensorBitField = sensorBitField | kWarpFlashL3GD20HBitField;
 #endif
 
@@ -3295,14 +3974,24 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 					 */
 		0b00100100, /*	payloadCtrl_Meas: Temperature oversample 1x, pressure
 										 overdsample 1x, mode 00	*/
-		0b00001000	/*	payloadGas_0: Turn off heater
+		0b00000000	/*	payloadGas_0: heat_off clear; setGasScheduleBME680()
+					 *	sets it if there are no gas measurements
 					 */
 	);
+	numberOfConfigErrors += configureHeaterProfileBME680(
+		0,											/*	profileIndex		*/
+		kWarpBME680HeaterTemperatureCelsius,		/*	temperatureCelsius	*/
+		kWarpBME680HeaterDurationMilliseconds		/*	durationMilliseconds	*/
+	);
+	numberOfConfigErrors += setGasScheduleBME680(1, kWarpBME680GasMeasurementInterval);
 
 	sensorBitField = sensorBitField | kWarpFlashBME680BitField;
 #endif
 #if (WARP_BUILD_ENABLE_DEVBNO055)
-	numberOfConfigErrors += configureSensorRegisterBNO055(0x00, 0x07);
+	numberOfConfigErrors += configureSensorRegisterBNO055(
+		kWarpSensorConfigConstBNO055registerNDOFMode,		/*	payloadOP_Mode: 9-axis fusion	*/
+		kWarpSensorConfigConstBNO055registerNormalPowerMode	/*	payloadPWR_Mode			*/
+	);
 
 	sensorBitField = sensorBitField | kWarpFlashBNO055BitField;	
 #endif
@@ -3317,11 +4006,21 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 	);
 	numberOfConfigErrors += configureSensorBMX055gyro(
 		0b00000100, /* +- 125degrees/s */
-		0b00000000, /* ODR 2000 Hz, unfiltered */
+		0b00000111, /* ODR 100 Hz, 32 Hz filter */
 		0b00000000, /* normal mode */
 		0b10000000	/* unfiltered data, shadowing enabled */
 	);
 
+	/*
+	 *	Each record takes the accelerometer and gyroscope frames collected in
+	 *	the FIFOs since the last one, rather than just the newest.
+	 */
+	numberOfConfigErrors += configureFifoBMX055accel(kWarpBMX055FifoWatermarkFrames);
+	numberOfConfigErrors += configureFifoBMX055gyro(kWarpBMX055FifoWatermarkFrames);
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+	initAhrsBMX055();
+#endif
+
 	sensorBitField = sensorBitField | kWarpFlashBMX055BitField;
 #endif
 #if (WARP_BUILD_ENABLE_DEVCCS811)
@@ -3337,10 +4036,17 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 		kWarpSensorConfigurationRegisterHDC1000Configuration, /* Configuration register	*/
 		(0b1010000 << 8));
 
+	sensorBitField = sensorBitField | kWarpFlashHDC1000BitField;
+#elif (WARP_BUILD_ENABLE_DEVSI7021)
+	numberOfConfigErrors += configureSensorSI7021(0x00 /* RH 12 bit, T 14 bit */);
+
 	sensorBitField = sensorBitField | kWarpFlashHDC1000BitField;
 #endif
 #if (WARP_BUILD_ENABLE_DEVRF430CL331H)
-	numberOfConfigErrors += configureSensorRegisterRF430CL331H(0x0040);
+	if (!devicesConfigured)
+	{
+		numberOfConfigErrors += configureSensorRegisterRF430CL331H(0x0040);
+	}
 
 	sensorBitField = sensorBitField | kWarpFlashRF430CL331HBitField;	
 #endif
@@ -3352,124 +4058,155 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 	sensorBitField = sensorBitField | kWarpFlashRV8803C7BitField;
 #endif
 
-	// Add readingCount, 1 x timing, numberofConfigErrors
-	uint8_t sensorBitFieldSize = 2;
-	uint8_t bytesWrittenIndex  = 0;
+#if (WARP_BUILD_ENABLE_DEVRV8803C7)
+	numberOfConfigErrors += bootConfigErrorCount;
+	bootConfigErrorCount = 0;
+#endif
 
-	/*
-	 * Write sensorBitField to flash first, outside of the loop.
-	*/
-	flashWriteBuf[bytesWrittenIndex] = (uint8_t)(sensorBitField >> 8);
-	bytesWrittenIndex++;
-	flashWriteBuf[bytesWrittenIndex] = (uint8_t)(sensorBitField);
-	bytesWrittenIndex++;
+	readingCount = gWarpPersistentState.sequenceNumber;
+	gWarpPersistentState.errorCount = MIN(gWarpPersistentState.errorCount + numberOfConfigErrors, 0xFF);
+	if (numberOfConfigErrors == 0)
+	{
+		gWarpPersistentState.flags |= kWarpPersistentStateFlagDevicesConfigured;
+	}
+	else
+	{
+		gWarpPersistentState.flags &= ~kWarpPersistentStateFlagDevicesConfigured;
+	}
+
+#if (WARP_BUILD_ENABLE_FLASH_TRIGGER)
+	triggerStart(sensorBitField);
+#endif
 
 	do
 	{
-		bytesWrittenIndex = sensorBitFieldSize;
+		/*
+		 *	Each record is clocked straight into the flash as it is read, so
+		 *	there is no RAM copy of it and no limit on its size (except for
+		 *	the pre-trigger ring of WARP_BUILD_ENABLE_FLASH_TRIGGER).
+		 */
+#if (WARP_BUILD_ENABLE_FLASH_TRIGGER)
+		status = triggerBeginRecord();
+#else
+		status = flashStreamBegin();
+#endif
+		if (status != kWarpStatusOK)
+		{
+			warpPrint("\r\n\tflashStreamBegin failed: %d", status);
+			warpReleaseSpiBus();
+			warpReleaseI2cBus();
+			return;
+		}
+
+		warpFlashStreamByte((uint8_t)(sensorBitField >> 8));
+		warpFlashStreamByte((uint8_t)(sensorBitField));
+		warpFlashStreamByte(flashGetRecordFormat());
 
 #if (WARP_CSVSTREAM_FLASH_PRINT_METADATA)
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(readingCount >> 24);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(readingCount >> 16);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(readingCount >> 8);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(readingCount);
-		bytesWrittenIndex++;
+		warpFlashStreamByte((uint8_t)(readingCount >> 24));
+		warpFlashStreamByte((uint8_t)(readingCount >> 16));
+		warpFlashStreamByte((uint8_t)(readingCount >> 8));
+		warpFlashStreamByte((uint8_t)(readingCount));
 
 		uint32_t currentRTC_TSR = RTC->TSR;
 		uint32_t currentRTC_TPR = RTC->TPR;
 
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TSR >> 24);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TSR >> 16);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TSR >> 8);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TSR);
-		bytesWrittenIndex++;
-
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TPR >> 24);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TPR >> 16);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TPR >> 8);
-		bytesWrittenIndex++;
-		flashWriteBuf[bytesWrittenIndex] = (uint8_t)(currentRTC_TPR);
-		bytesWrittenIndex++;
+		warpFlashStreamByte((uint8_t)(currentRTC_TSR >> 24));
+		warpFlashStreamByte((uint8_t)(currentRTC_TSR >> 16));
+		warpFlashStreamByte((uint8_t)(currentRTC_TSR >> 8));
+		warpFlashStreamByte((uint8_t)(currentRTC_TSR));
+
+		warpFlashStreamByte((uint8_t)(currentRTC_TPR >> 24));
+		warpFlashStreamByte((uint8_t)(currentRTC_TPR >> 16));
+		warpFlashStreamByte((uint8_t)(currentRTC_TPR >> 8));
+		warpFlashStreamByte((uint8_t)(currentRTC_TPR));
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVADXL362)
-		bytesWrittenIndex += appendSensorDataADXL362(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataADXL362();
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVAMG8834)
-		bytesWrittenIndex += appendSensorDataAMG8834(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataAMG8834();
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVMMA8451Q)
-		bytesWrittenIndex += appendSensorDataMMA8451Q(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataMMA8451Q();
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVMAG3110)
-		bytesWrittenIndex += appendSensorDataMAG3110(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataMAG3110();
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVL3GD20H)
-		bytesWrittenIndex += appendSensorDataL3GD20H(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataL3GD20H();
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVBME680)
-		bytesWrittenIndex += appendSensorDataBME680(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataBME680();
 #endif
 #if (WARP_BUILD_ENABLE_DEVBNO055)
-	bytesWrittenIndex += appendSensorDataBNO055(flashWriteBuf + bytesWrittenIndex);
+	appendSensorDataBNO055();
 #endif
 #if (WARP_BUILD_ENABLE_DEVRF430CL331H)
-	bytesWrittenIndex += appendSensorDataRF430CL331H(flashWriteBuf + bytesWrittenIndex);
+	appendSensorDataRF430CL331H();
 #endif
 #if (WARP_BUILD_ENABLE_DEVBMX055)
-		bytesWrittenIndex += appendSensorDataBMX055accel(flashWriteBuf + bytesWrittenIndex);
-		bytesWrittenIndex += appendSensorDataBMX055mag(flashWriteBuf + bytesWrittenIndex);
-		bytesWrittenIndex += appendSensorDataBMX055gyro(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataBMX055();
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVCCS811)
-		bytesWrittenIndex += appendSensorDataCCS811(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataCCS811();
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVHDC1000)
-		bytesWrittenIndex += appendSensorDataHDC1000(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataHDC1000();
+#elif (WARP_BUILD_ENABLE_DEVSI7021)
+		appendSensorDataSI7021();
 #endif
 
+		updateEnvironmentDataCCS811();
+
 #if (WARP_BUILD_ENABLE_DEVRV8803C7)
-		bytesWrittenIndex += appendSensorDataRV8803C7(flashWriteBuf + bytesWrittenIndex);
+		appendSensorDataRV8803C7();
 #endif
 
 		/*
 		*	Number of config errors.
 		*	Uncomment to write to flash. Don't forget to update the initial bitfield at the start of this function.
 		*/
-		// flashWriteBuf[bytesWrittenIndex] = (uint8_t)(numberOfConfigErrors >> 24);
-		// bytesWrittenIndex++;
-		// flashWriteBuf[bytesWrittenIndex] = (uint8_t)(numberOfConfigErrors >> 16);
-		// bytesWrittenIndex++;
-		// flashWriteBuf[bytesWrittenIndex] = (uint8_t)(numberOfConfigErrors >> 8);
-		// bytesWrittenIndex++;
-		// flashWriteBuf[bytesWrittenIndex] = (uint8_t)(numberOfConfigErrors);
-		// bytesWrittenIndex++;
+		// warpFlashStreamByte((uint8_t)(numberOfConfigErrors >> 24));
+		// warpFlashStreamByte((uint8_t)(numberOfConfigErrors >> 16));
+		// warpFlashStreamByte((uint8_t)(numberOfConfigErrors >> 8));
+		// warpFlashStreamByte((uint8_t)(numberOfConfigErrors));
 
 		/*
-		*	Dump to flash
+		*	Finish the record. The sequence number is advanced first so that the
+		*	state saved alongside this record already accounts for it.
 		*/
-		status = flashWriteFromEnd(bytesWrittenIndex, flashWriteBuf);
+		gWarpPersistentState.sequenceNumber = readingCount + 1;
+
+#if (WARP_BUILD_ENABLE_FLASH_TRIGGER)
+		status = triggerEndRecord();
+#else
+		status = flashStreamEnd();
+#endif
 		if (status != kWarpStatusOK)
 		{
-			warpPrint("\r\n\tflashWriteFromEnd failed: %d", status);
+			gWarpPersistentState.errorCount = MIN(gWarpPersistentState.errorCount + 1, 0xFF);
+			warpPrint("\r\n\tflashStreamEnd failed: %d", status);
+			warpReleaseSpiBus();
+			warpReleaseI2cBus();
 			return;
 		}
 
+		status = flashHandleEndOfRecord();
+		if (status != kWarpStatusOK)
+		{
+			gWarpPersistentState.errorCount = MIN(gWarpPersistentState.errorCount + 1, 0xFF);
+			warpPrint("\r\n\tflashHandleEndOfRecord failed: %d", status);
+		}
+
 		// if (menuDelayBetweenEachRun > 0)
 		// {
 		// 	// while (OSA_TimeGetMsec() - timeAtStart < menuDelayBetweenEachRun)
@@ -3500,6 +4237,9 @@ writeAllSensorsToFlash(int menuDelayBetweenEachRun, int loopForever)
 		}
 	}
 	while (loopForever);
+
+	warpReleaseSpiBus();
+	warpReleaseI2cBus();
 #endif
 }
 
@@ -3508,7 +4248,7 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 				int menuDelayBetweenEachRun, bool loopForever)
 {
 	WarpStatus status;
-	uint32_t timeAtStart = OSA_TimeGetMsec();
+	uint32_t timeAtStart = warpTimeGetMilliseconds();
 
 	/*
 	 *	A 32-bit counter gives us > 2 years of before it wraps, even if sampling
@@ -3520,6 +4260,8 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 
 	int rttKey = -1;
 
+	warpAcquireI2cBus(gWarpI2cBaudRateKbps);
+
 
 #if (WARP_BUILD_ENABLE_DEVAMG8834)
 	numberOfConfigErrors += configureSensorAMG8834(0x3F, /* Initial reset */
@@ -3540,6 +4282,7 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 							 to set up register*/
 		0xA0, /*	Payload: AUTO_MRST_EN enable, RAW value without offset */
 		0x10);
+	numberOfConfigErrors += selectAcquisitionModeMAG3110(menuDelayBetweenEachRun, false /* fastRead */);
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVL3GD20H)
@@ -3557,9 +4300,16 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 					 */
 		0b00100100, /*	payloadCtrl_Meas: Temperature oversample 1x, pressure
 										 overdsample 1x, mode 00	*/
-		0b00001000	/*	payloadGas_0: Turn off heater
+		0b00000000	/*	payloadGas_0: heat_off clear; setGasScheduleBME680()
+					 *	sets it if there are no gas measurements
 					 */
 	);
+	numberOfConfigErrors += configureHeaterProfileBME680(
+		0,											/*	profileIndex		*/
+		kWarpBME680HeaterTemperatureCelsius,		/*	temperatureCelsius	*/
+		kWarpBME680HeaterDurationMilliseconds		/*	durationMilliseconds	*/
+	);
+	numberOfConfigErrors += setGasScheduleBME680(1, kWarpBME680GasMeasurementInterval);
 
 	if (printHeadersAndCalibration)
 	{
@@ -3579,6 +4329,13 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 	}
 #endif
 
+#if (WARP_BUILD_ENABLE_DEVBNO055)
+	numberOfConfigErrors += configureSensorRegisterBNO055(
+		kWarpSensorConfigConstBNO055registerNDOFMode,		/*	payloadOP_Mode: 9-axis fusion	*/
+		kWarpSensorConfigConstBNO055registerNormalPowerMode	/*	payloadPWR_Mode			*/
+	);
+#endif
+
 #if (WARP_BUILD_ENABLE_DEVBMX055)
 	numberOfConfigErrors += configureSensorBMX055accel(
 		0b00000011, /* Payload:+-2g range */
@@ -3590,7 +4347,7 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 	);
 	numberOfConfigErrors += configureSensorBMX055gyro(
 		0b00000100, /* +- 125degrees/s */
-		0b00000000, /* ODR 2000 Hz, unfiltered */
+		0b00000111, /* ODR 100 Hz, 32 Hz filter */
 		0b00000000, /* normal mode */
 		0b10000000	/* unfiltered data, shadowing enabled */
 	);
@@ -3608,6 +4365,10 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 		(0b1010000 << 8));
 #endif
 
+#if (WARP_BUILD_ENABLE_DEVSI7021)
+	numberOfConfigErrors += configureSensorSI7021(0x00 /* RH 12 bit, T 14 bit */);
+#endif
+
 	if (printHeadersAndCalibration)
 	{
 
@@ -3640,10 +4401,13 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 #endif
 
 #if (WARP_BUILD_ENABLE_DEVBME680)
-		warpPrint(" BME680 Press, BME680 Temp, BME680 Hum,");
+		warpPrint(" BME680 Press, BME680 Temp, BME680 Hum, BME680 Gas,");
 #endif
 #if (WARP_BUILD_ENABLE_DEVBNO055)
-			warpPrint("Accel x,Accel y, Accel z, Mag x, Mag y, Mag z,Gyro x, Gyro y, Gyro z");
+		warpPrint(" BNO055acc x, BNO055acc y, BNO055acc z,");
+		warpPrint(" BNO055mag x, BNO055mag y, BNO055mag z,");
+		warpPrint(" BNO055gyro x, BNO055gyro y, BNO055gyro z,");
+		warpPrint(" BNO055quat w, BNO055quat x, BNO055quat y, BNO055quat z,");
 #endif
 #if (WARP_BUILD_ENABLE_DEVRF430CL331H)
 			warpPrint("NFC/RFID");
@@ -3662,6 +4426,10 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 		warpPrint(" HDC1000 Temp, HDC1000 Hum,");
 #endif
 
+#if (WARP_BUILD_ENABLE_DEVSI7021)
+		warpPrint(" SI7021 Temp, SI7021 Hum,");
+#endif
+
 #if (WARP_CSVSTREAM_FLASH_PRINT_METADATA)
 		warpPrint(" RTC->TSR, RTC->TPR,");
 #endif
@@ -3715,6 +4483,12 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 		printSensorDataHDC1000(hexModeFlag);
 #endif
 
+#if (WARP_BUILD_ENABLE_DEVSI7021)
+		printSensorDataSI7021(hexModeFlag);
+#endif
+
+		updateEnvironmentDataCCS811();
+
 #if (WARP_CSVSTREAM_FLASH_PRINT_METADATA)
 		warpPrint(" %12d, %6d,", RTC->TSR, RTC->TPR);
 #endif
@@ -3745,6 +4519,8 @@ printAllSensors(bool printHeadersAndCalibration, bool hexModeFlag,
 	}
 
 	while (loopForever);
+
+	warpReleaseI2cBus();
 }
 
 void
@@ -4304,8 +5080,8 @@ repeatRegisterReadForDeviceAndAddress(WarpSensorDevice warpSensorDevice, uint8_t
 						&deviceSI7021State,		/*	i2cDeviceState			*/
 						NULL,				/*	spiDeviceState			*/
 						baseAddress,			/*	baseAddress			*/
-						0x00,				/*	minAddress			*/
-						0x09,				/*	maxAddress			*/
+						0xE0,				/*	minAddress			*/
+						0xF5,				/*	maxAddress			*/
 						repetitionsPerAddress,		/*	repetitionsPerAddress		*/
 						chunkReadsPerAddress,		/*	chunkReadsPerAddress		*/
 						spinDelay,			/*	spinDelay			*/
@@ -4501,6 +5277,21 @@ read4digits(void)
 	return (digit1 - '0')*1000 + (digit2 - '0')*100 + (digit3 - '0')*10 + (digit4 - '0');
 }
 
+#if (WARP_BUILD_ENABLE_FLASH)
+static uint32_t
+read10digits(void)
+{
+	uint32_t	value = 0;
+
+	for (int i = 0; i < 10; i++)
+	{
+		value = value*10 + (warpWaitKey() - '0');
+	}
+
+	return value;
+}
+#endif
+
 
 
 WarpStatus
@@ -4532,6 +5323,78 @@ writeByteToI2cDeviceRegister(uint8_t i2cAddress, bool sendCommandByte, uint8_t c
 
 
 
+/*
+ *	Wait for a flash part to finish a program or erase. From VLPR, the MCU first
+ *	sleeps for the operation's typical duration through warpSleepMilliseconds(),
+ *	which picks VLPS or VLPW and suspends any bus session held across it. It
+ *	then holds /CS low and clocks status bytes until (status & readyMask) ==
+ *	readyValue, giving up maximumMilliseconds after the start of the wait.
+ */
+WarpStatus
+warpWaitForFlashReady(WarpSPIDeviceState volatile *  deviceStatePointer, uint8_t statusOpcode, uint8_t readyMask, uint8_t readyValue, uint32_t typicalMilliseconds, uint32_t maximumMilliseconds)
+{
+	spi_status_t	status;
+	uint8_t			txByte;
+	uint8_t			rxByte;
+	uint16_t		lastMilliseconds;
+	uint16_t		nowMilliseconds;
+	uint32_t		elapsedMilliseconds = 0;
+
+	if ((typicalMilliseconds > 0) && (POWER_SYS_GetCurrentMode() == kPowerManagerVlpr))
+	{
+		/*
+		 *	warpSleepMilliseconds() busy-waits if the sleep fails, so the
+		 *	typical duration has passed either way.
+		 */
+		warpSleepMilliseconds(typicalMilliseconds);
+		elapsedMilliseconds = typicalMilliseconds;
+	}
+
+	warpScaleSupplyVoltage(deviceStatePointer->operatingVoltageMillivolts);
+	warpDeasserAllSPIchipSelects();
+	warpEnableSPIpins();
+	GPIO_DRV_ClearPinOutput(deviceStatePointer->chipSelectIoPinID);
+
+	/*
+	 *	Both the AT45DB and the IS25xP keep shifting out the current status
+	 *	register for as long as /CS stays asserted after the status opcode.
+	 */
+	txByte = statusOpcode;
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */, NULL, &txByte, &rxByte, 1, gWarpSpiTimeoutMicroseconds);
+
+	txByte = 0x00;
+	lastMilliseconds = warpTimeGetMilliseconds();
+	while (status == kStatus_SPI_Success)
+	{
+		status = SPI_DRV_MasterTransferBlocking(0 /* master instance */, NULL, &txByte, &rxByte, 1, gWarpSpiTimeoutMicroseconds);
+		if ((status != kStatus_SPI_Success) || ((rxByte & readyMask) == readyValue))
+		{
+			break;
+		}
+
+		/*
+		 *	warpTimeGetMilliseconds() is a 16-bit counter, so accumulate the
+		 *	differences rather than comparing against a start time.
+		 */
+		nowMilliseconds = warpTimeGetMilliseconds();
+		elapsedMilliseconds += (uint16_t)(nowMilliseconds - lastMilliseconds);
+		lastMilliseconds = nowMilliseconds;
+
+		if (elapsedMilliseconds > maximumMilliseconds)
+		{
+			GPIO_DRV_SetPinOutput(deviceStatePointer->chipSelectIoPinID);
+			warpDisableSPIpins();
+
+			return kWarpStatusFlashReadyTimeout;
+		}
+	}
+
+	GPIO_DRV_SetPinOutput(deviceStatePointer->chipSelectIoPinID);
+	warpDisableSPIpins();
+
+	return (status == kStatus_SPI_Success ? kWarpStatusOK : kWarpStatusDeviceCommunicationFailed);
+}
+
 WarpStatus
 writeBytesToSpi(uint8_t *  payloadBytes, int payloadLength)
 {
@@ -4673,7 +5536,10 @@ activateAllLowPowerSensorModes(bool verbose)
 
 
 /*
- *	SI7021: Can't talk to it correctly yet.
+ *	SI7021: No registers, only command codes (Table 11). The menu reads walk
+ *	0xE0--0xF5; readSensorRegisterSI7021() sends only the read commands in
+ *	it ("Measure RH/T, no hold master", "Read T from previous RH" and "Read
+ *	user register 1") and counts the rest as bad commands.
  */
 
 
@@ -4734,6 +5600,78 @@ activateAllLowPowerSensorModes(bool verbose)
 #endif
 }
 
+#if (WARP_BUILD_ENABLE_STACK_HIGH_WATER_MARK)
+/*
+ *	Fill the unused part of the stack with kWarpStackPaintPattern, so that
+ *	stackHighWaterMarkBytes() can later tell how much of it has been used.
+ *	Everything below the current stack pointer is free.
+ */
+static void
+paintStack(void)
+{
+	uint32_t *	word			= __StackLimit;
+	uint32_t *	stackPointer	= (uint32_t *)__get_MSP();
+
+	while (word < stackPointer)
+	{
+		*word++ = kWarpStackPaintPattern;
+	}
+}
+
+/*
+ *	The most stack used since paintStack(): the bytes from the top of the
+ *	stack down to the lowest word no longer holding the pattern.
+ */
+static uint32_t
+stackHighWaterMarkBytes(void)
+{
+	uint32_t *	word = __StackLimit;
+
+	while ((word < __StackTop) && (*word == kWarpStackPaintPattern))
+	{
+		word++;
+	}
+
+	return (uint32_t)__StackTop - (uint32_t)word;
+}
+#endif
+
+/*
+ *	CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), computed
+ *	bitwise since there is no room for a lookup table.
+ */
+uint16_t
+warpCrc16(const uint8_t *  data, size_t nbyte)
+{
+	return warpCrc16Update(0xFFFF, data, nbyte);
+}
+
+/*
+ *	Continue a warpCrc16() over more bytes, for data that arrives a piece at
+ *	a time.
+ */
+uint16_t
+warpCrc16Update(uint16_t crc, const uint8_t *  data, size_t nbyte)
+{
+	for (size_t i = 0; i < nbyte; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+		for (int bit = 0; bit < 8; bit++)
+		{
+			if (crc & 0x8000)
+			{
+				crc = (crc << 1) ^ 0x1021;
+			}
+			else
+			{
+				crc = crc << 1;
+			}
+		}
+	}
+
+	return crc;
+}
+
 #if (WARP_BUILD_ENABLE_FLASH)
 WarpStatus
 flashWriteFromEnd(size_t nbyte, uint8_t* buf)
@@ -4748,18 +5686,1238 @@ flashWriteFromEnd(size_t nbyte, uint8_t* buf)
 
 #if (WARP_BUILD_ENABLE_FLASH)
 WarpStatus
-flashHandleEndOfWriteAllSensors()
+flashStreamBegin()
 {
-#if (WARP_BUILD_ENABLE_DEVAT45DB)
-	/*
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		return beginStreamToAT45DB();
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		return beginStreamToIS25xP();
+	#endif
+}
+
+WarpStatus
+flashStreamEnd()
+{
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		return endStreamToAT45DB();
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		return endStreamToIS25xP();
+	#endif
+}
+#endif
+
+static void
+flashStreamByteToDevice(uint8_t byte)
+{
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		streamByteToAT45DB(byte);
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		streamByteToIS25xP(byte);
+	#endif
+}
+
+/*
+ *	Called by the appendSensorData*() routines for each byte of a record, between
+ *	flashStreamBegin() and flashStreamEnd(). Errors are reported by flashStreamEnd().
+ */
+void
+warpFlashStreamByte(uint8_t byte)
+{
+#if (WARP_BUILD_ENABLE_FLASH) && (WARP_BUILD_ENABLE_FLASH_TRIGGER)
+	if (triggerRecordOffset < triggerRecordBytes)
+	{
+		triggerRing[triggerRingNext * triggerRecordBytes + triggerRecordOffset] = byte;
+	}
+	triggerRecordOffset++;
+
+	if (triggerArmed)
+	{
+		return;
+	}
+#endif
+
+	flashStreamByteToDevice(byte);
+}
+
+#if (WARP_BUILD_ENABLE_FLASH) && (WARP_BUILD_ENABLE_FLASH_TRIGGER)
+/*
+ *	Size the ring for records with the given bit field and find where the
+ *	readings of each condition are in them. Records that do not fit in the
+ *	ring, or whose size is unknown, are logged continuously as before.
+ */
+static void
+triggerStart(uint16_t sensorBitField)
+{
+	triggerRecordBytes		= flashGetRecordSizeFromSensorBitField(sensorBitField);
+	triggerRingSlots		= (triggerRecordBytes == 0) ? 0 : MIN(kWarpTriggerRingBytes / triggerRecordBytes, 0xFF);
+	triggerRingNext			= 0;
+	triggerRingCount		= 0;
+	triggerPostRecordsLeft	= 0;
+	triggerArmed			= (triggerRingSlots > 0);
+
+	if (!triggerArmed)
+	{
+		warpPrint("\r\n\tRecords of %d bytes do not fit the trigger ring, logging all of them", triggerRecordBytes);
+		triggerRecordBytes = 0;
+	}
+
+	for (uint8_t i = 0; i < sizeof(triggerConditions) / sizeof(triggerConditions[0]); i++)
+	{
+		WarpTriggerCondition *	condition = &triggerConditions[i];
+		uint16_t				offset = 3;
+		uint8_t					sensorIndex = 0;
+		uint8_t					sizePerReading;
+		uint8_t					numberOfReadings;
+
+		condition->enabled		= false;
+		condition->havePrevious	= false;
+
+		/*
+		 *	flashDecodeSensorBitField() lays sensors out in order of
+		 *	increasing bit.
+		 */
+		for (uint16_t sensorBit = 1; triggerArmed && (sensorBit != 0); sensorBit <<= 1)
+		{
+			if (!(sensorBitField & sensorBit))
+			{
+				continue;
+			}
+
+			sizePerReading		= 0;
+			numberOfReadings	= 0;
+			flashDecodeSensorBitField(sensorBitField, sensorIndex, &sizePerReading, &numberOfReadings);
+
+			if (sensorBit == condition->sensorBitField)
+			{
+				uint8_t		readingsNeeded = (condition->predicate == kWarpTriggerMagnitude) ? 3 : 1;
+
+				condition->recordOffset		= offset + condition->readingIndex * sizePerReading;
+				condition->sizePerReading	= sizePerReading;
+				condition->enabled			= (condition->predicate == kWarpTriggerADXL362Activity) ||
+											  ((condition->readingIndex + readingsNeeded <= numberOfReadings) &&
+											   ((condition->predicate != kWarpTriggerMagnitude) || (sizePerReading == 2)));
+				break;
+			}
+
+			offset += sizePerReading * numberOfReadings;
+			sensorIndex++;
+		}
+	}
+}
+
+/*
+ *	A reading from a record in the ring, MSB first as the decoder reads it.
+ */
+static int32_t
+triggerReading(const uint8_t *  record, uint16_t offset, uint8_t sizePerReading)
+{
+	uint32_t	reading = 0;
+
+	for (uint8_t i = 0; i < sizePerReading; i++)
+	{
+		reading = (reading << 8) | record[offset + i];
+	}
+
+	if (sizePerReading == 2)
+	{
+		return (int16_t)reading;
+	}
+	else if (sizePerReading == 1)
+	{
+		return (int8_t)reading;
+	}
+
+	return (int32_t)reading;
+}
+
+/*
+ *	Whether any condition holds for a record in the ring. All conditions are
+ *	tested every time, so that the step conditions always have the reading
+ *	from the record before.
+ */
+static bool
+triggerTest(const uint8_t *  record)
+{
+	bool	fired = false;
+
+	for (uint8_t i = 0; i < sizeof(triggerConditions) / sizeof(triggerConditions[0]); i++)
+	{
+		WarpTriggerCondition *	condition = &triggerConditions[i];
+		int32_t					reading;
+
+		if (!condition->enabled)
+		{
+			continue;
+		}
+
+		switch (condition->predicate)
+		{
+			case kWarpTriggerAbove:
+			{
+				reading = triggerReading(record, condition->recordOffset, condition->sizePerReading);
+				if (reading > (int32_t)condition->threshold)
+				{
+					fired = true;
+				}
+				break;
+			}
+
+			case kWarpTriggerStep:
+			{
+				reading = triggerReading(record, condition->recordOffset, condition->sizePerReading);
+				if (condition->havePrevious && ((uint32_t)abs(reading - condition->previous) > condition->threshold))
+				{
+					fired = true;
+				}
+				condition->previous		= reading;
+				condition->havePrevious	= true;
+				break;
+			}
+
+			case kWarpTriggerMagnitude:
+			{
+				uint32_t	sumOfSquares = 0;
+
+				for (uint8_t axis = 0; axis < 3; axis++)
+				{
+					reading = triggerReading(record, condition->recordOffset + 2 * axis, 2);
+					sumOfSquares += (uint32_t)(reading * reading);
+				}
+				if (sumOfSquares > condition->threshold)
+				{
+					fired = true;
+				}
+				break;
+			}
+
+			case kWarpTriggerADXL362Activity:
+			{
+#if (WARP_BUILD_ENABLE_DEVADXL362)
+				if (activityDetectedADXL362())
+				{
+					fired = true;
+				}
+#endif
+				break;
+			}
+		}
+	}
+
+	return fired;
+}
+
+/*
+ *	Write the records in the ring to the flash, oldest first. The newest is
+ *	the one in slot triggerRingNext.
+ */
+static WarpStatus
+triggerFlushRing(void)
+{
+	WarpStatus	status;
+	uint8_t		slot = triggerRingNext + 1 + triggerRingSlots - triggerRingCount;
+
+	if (slot >= triggerRingSlots)
+	{
+		slot -= triggerRingSlots;
+	}
+
+	for (; triggerRingCount > 0; triggerRingCount--)
+	{
+		status = flashStreamBegin();
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		for (uint16_t i = 0; i < triggerRecordBytes; i++)
+		{
+			flashStreamByteToDevice(triggerRing[slot * triggerRecordBytes + i]);
+		}
+
+		status = flashStreamEnd();
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		slot = (slot + 1 >= triggerRingSlots) ? 0 : slot + 1;
+	}
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	In place of flashStreamBegin() in writeAllSensorsToFlash(): while armed
+ *	the record only goes to the ring.
+ */
+static WarpStatus
+triggerBeginRecord(void)
+{
+	triggerRecordOffset = 0;
+
+	if (triggerArmed)
+	{
+		return kWarpStatusOK;
+	}
+
+	return flashStreamBegin();
+}
+
+/*
+ *	In place of flashStreamEnd() in writeAllSensorsToFlash().
+ */
+static WarpStatus
+triggerEndRecord(void)
+{
+	WarpStatus	status = kWarpStatusOK;
+	bool		fired = false;
+
+	if (triggerRingSlots == 0)
+	{
+		return flashStreamEnd();
+	}
+
+	fired = triggerTest(&triggerRing[triggerRingNext * triggerRecordBytes]);
+
+	if (triggerArmed)
+	{
+		triggerRingCount = MIN(triggerRingCount + 1, triggerRingSlots);
+		if (fired)
+		{
+			status = triggerFlushRing();
+		}
+	}
+	else
+	{
+		status = flashStreamEnd();
+		if (triggerPostRecordsLeft > 0)
+		{
+			triggerPostRecordsLeft--;
+		}
+	}
+
+	if (fired)
+	{
+		triggerPostRecordsLeft = kWarpTriggerPostRecords;
+	}
+
+	triggerRingNext	= (triggerRingNext + 1 >= triggerRingSlots) ? 0 : triggerRingNext + 1;
+	triggerArmed	= (triggerPostRecordsLeft == 0);
+
+	return status;
+}
+#endif
+
+#if (WARP_BUILD_ENABLE_FLASH)
+/*
+ *	With the ring log, the page after the last one is the first. Without it
+ *	the log ends where the spare pages and time index start.
+ */
+static uint16_t
+flashNextLogPage(uint16_t pageNumber)
+{
+#if (WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		return (pageNumber + 1 >= kWarpAT45DBLogEndPage) ? kWarpInitialPageNumberAT45DB : pageNumber + 1;
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		return (pageNumber + 1 >= kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector) ? kWarpInitialPageNumberIS25xP : pageNumber + 1;
+	#endif
+#else
+	return pageNumber + 1;
+#endif
+}
+
+/*
+ *	Position of the oldest record. Until the ring log first wraps, this is the
+ *	start of the log. Expects the persistent state to have been loaded, e.g.,
+ *	by flashGetLogHead().
+ */
+void
+flashGetLogTail(uint16_t* pageNumber, uint8_t* pageOffset)
+{
+	if (gWarpPersistentState.logTailPageNumber == 0)
+	{
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		*pageNumber = kWarpInitialPageNumberAT45DB;
+		*pageOffset = kWarpInitialPageOffsetAT45DB;
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		*pageNumber = kWarpInitialPageNumberIS25xP;
+		*pageOffset = kWarpInitialPageOffsetIS25xP;
+	#endif
+
+		return;
+	}
+
+	*pageNumber = gWarpPersistentState.logTailPageNumber;
+	*pageOffset = gWarpPersistentState.logTailPageOffset;
+}
+
+/*
+ *	Length of a record in bytes, including its two sensor bit field bytes, or
+ *	0 if the bit field has a sensor we do not know the size of (e.g., erased
+ *	flash).
+ */
+uint16_t
+flashGetRecordSizeFromSensorBitField(uint16_t sensorBitField)
+{
+	uint8_t		numberOfSensors;
+	uint8_t		sizePerReading;
+	uint8_t		numberOfReadings;
+	uint16_t	recordSize = 3;
+
+	if ((sensorBitField == 0) || (sensorBitField == 0xFFFF))
+	{
+		return 0;
+	}
+
+	numberOfSensors = flashGetNSensorsFromSensorBitField(sensorBitField);
+	for (uint8_t sensorIndex = 0; sensorIndex < numberOfSensors; sensorIndex++)
+	{
+		sizePerReading		= 0;
+		numberOfReadings	= 0;
+		flashDecodeSensorBitField(sensorBitField, sensorIndex, &sizePerReading, &numberOfReadings);
+		if ((sizePerReading == 0) || (numberOfReadings == 0))
+		{
+			return 0;
+		}
+
+		recordSize += sizePerReading * numberOfReadings;
+	}
+
+	return recordSize;
+}
+#endif
+
+/*
+ *	Called by the flash drivers before they erase or reprogram the pageCount
+ *	pages from firstPageNumber once the ring log has wrapped. If the oldest
+ *	record is in those pages, step the tail forward a record at a time (the
+ *	records are still intact, so this is two short reads per record) until it
+ *	is past them. A tail left at the very start of the next page is stepped
+ *	on one more record, as the head can be there too (the AT45DB programs the
+ *	page the head has just filled), and a tail equal to the head reads as an
+ *	empty log.
+ */
+WarpStatus
+warpFlashAdvanceLogTail(uint16_t firstPageNumber, uint16_t pageCount)
+{
+#if (WARP_BUILD_ENABLE_FLASH) && (WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	WarpStatus	status;
+	uint16_t	pageSizeBytes;
+	uint16_t	tailPageNumber;
+	uint8_t		tailPageOffset;
+	uint16_t	nextPageNumber;
+	uint8_t		nextPageOffset;
+	uint8_t		bitFieldBytes[2];
+	uint16_t	recordSize;
+	uint16_t	recordEnd;
+	uint16_t	endPageNumber;
+
+#if (WARP_BUILD_ENABLE_DEVAT45DB)
+	pageSizeBytes	= kWarpSizeAT45DBPageSizeBytes;
+#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+	pageSizeBytes	= kWarpSizeIS25xPPageSizeBytes;
+#endif
+
+	if (gWarpPersistentState.logTailPageNumber == 0)
+	{
+		return kWarpStatusOK;
+	}
+
+	tailPageNumber = gWarpPersistentState.logTailPageNumber;
+	tailPageOffset = gWarpPersistentState.logTailPageOffset;
+	endPageNumber = flashNextLogPage(firstPageNumber + pageCount - 1);
+
+	while (((uint16_t)(tailPageNumber - firstPageNumber) < pageCount) || ((tailPageNumber == endPageNumber) && (tailPageOffset == 0)))
+	{
+		/*
+		 *	The bit field can straddle a page boundary.
+		 */
+		nextPageNumber	= tailPageNumber;
+		nextPageOffset	= tailPageOffset + 1;
+		if (tailPageOffset == pageSizeBytes - 1)
+		{
+			nextPageNumber	= flashNextLogPage(tailPageNumber);
+			nextPageOffset	= 0;
+		}
+
+		status = flashReadMemory(tailPageNumber, tailPageOffset, 1, &bitFieldBytes[0]);
+		if (status == kWarpStatusOK)
+		{
+			status = flashReadMemory(nextPageNumber, nextPageOffset, 1, &bitFieldBytes[1]);
+		}
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		recordSize = flashGetRecordSizeFromSensorBitField((bitFieldBytes[0] << 8) | bitFieldBytes[1]);
+		if (recordSize == 0)
+		{
+			/*
+			 *	We have lost track of the record boundaries, so give up the
+			 *	rest of these pages and resume at the page after them.
+			 */
+			gWarpPersistentState.logTailPageNumber = endPageNumber;
+			gWarpPersistentState.logTailPageOffset = 0;
+
+			break;
+		}
+		else
+		{
+			recordEnd = tailPageOffset + recordSize;
+			while (recordEnd >= pageSizeBytes)
+			{
+				recordEnd -= pageSizeBytes;
+				tailPageNumber = flashNextLogPage(tailPageNumber);
+			}
+			tailPageOffset = recordEnd;
+		}
+
+		gWarpPersistentState.logTailPageNumber = tailPageNumber;
+		gWarpPersistentState.logTailPageOffset = tailPageOffset;
+	}
+#endif
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Called by the flash drivers after loading a persistent state that may
+ *	have been saved up to maxRecords records ago. Steps the log head forward
+ *	a record at a time, counting each into the sequence number, until it
+ *	reaches erased flash, so that new records are not programmed over ones
+ *	written since the save.
+ */
+WarpStatus
+warpFlashRecoverLogHead(uint16_t maxRecords)
+{
+#if (WARP_BUILD_ENABLE_FLASH)
+	WarpStatus	status;
+	uint16_t	pageSizeBytes;
+	uint16_t	logEndPage;
+	uint16_t	headPageNumber	= gWarpPersistentState.logPageNumber;
+	uint8_t		headPageOffset	= gWarpPersistentState.logPageOffset;
+	uint16_t	nextPageNumber;
+	uint8_t		nextPageOffset;
+	uint8_t		bitFieldBytes[2];
+	uint16_t	bitField;
+	uint16_t	recordSize;
+	uint16_t	recordEnd;
+
+#if (WARP_BUILD_ENABLE_DEVAT45DB)
+	pageSizeBytes	= kWarpSizeAT45DBPageSizeBytes;
+	logEndPage		= kWarpAT45DBLogEndPage;
+#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+	pageSizeBytes	= kWarpSizeIS25xPPageSizeBytes;
+	logEndPage		= kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector;
+#endif
+
+	for (uint16_t i = 0; (i < maxRecords) && (headPageNumber != 0); i++)
+	{
+		nextPageNumber	= headPageNumber;
+		nextPageOffset	= headPageOffset + 1;
+		if (headPageOffset == pageSizeBytes - 1)
+		{
+			nextPageNumber	= flashNextLogPage(headPageNumber);
+			nextPageOffset	= 0;
+		}
+
+		status = flashReadMemory(headPageNumber, headPageOffset, 1, &bitFieldBytes[0]);
+		if ((status == kWarpStatusOK) && (nextPageNumber < logEndPage))
+		{
+			status = flashReadMemory(nextPageNumber, nextPageOffset, 1, &bitFieldBytes[1]);
+		}
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		bitField = (bitFieldBytes[0] << 8) | bitFieldBytes[1];
+		if (bitField == 0xFFFF)
+		{
+			break;
+		}
+
+		recordSize = flashGetRecordSizeFromSensorBitField(bitField);
+		if (recordSize == 0)
+		{
+			/*
+			 *	Not a record we know, so resume at the next page, as
+			 *	warpFlashAdvanceLogTail() does.
+			 */
+			headPageNumber = flashNextLogPage(headPageNumber);
+			headPageOffset = 0;
+		}
+		else
+		{
+			recordEnd = headPageOffset + recordSize;
+			while (recordEnd >= pageSizeBytes)
+			{
+				recordEnd -= pageSizeBytes;
+				headPageNumber = flashNextLogPage(headPageNumber);
+			}
+			headPageOffset = recordEnd;
+			gWarpPersistentState.sequenceNumber++;
+		}
+
+		/*
+		 *	Without the ring log, page 0 marks a full log.
+		 */
+		if (headPageNumber >= logEndPage)
+		{
+			headPageNumber = 0;
+			headPageOffset = 0;
+		}
+	}
+
+	gWarpPersistentState.logPageNumber = headPageNumber;
+	gWarpPersistentState.logPageOffset = headPageOffset;
+#endif
+
+	return kWarpStatusOK;
+}
+
+#if (WARP_BUILD_ENABLE_FLASH)
+static uint16_t
+flashIndexEntryCount(void)
+{
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		return kWarpAT45DBIndexEntries;
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		return kWarpIS25xPIndexEntries;
+	#endif
+}
+
+/*
+ *	Returns false if the entry could not be read or fails its CRC, e.g.,
+ *	because it is erased.
+ */
+static bool
+flashReadIndexEntry(uint16_t entryIndex, WarpFlashIndexEntry *  entry)
+{
+	uint16_t	firstPageNumber;
+	uint16_t	entriesPerPage;
+
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		firstPageNumber	= kWarpAT45DBIndexFirstPage;
+		entriesPerPage	= kWarpSizeAT45DBPageSizeBytes / sizeof(WarpFlashIndexEntry);
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		firstPageNumber	= kWarpIS25xPIndexFirstSector * kWarpIS25xPPagesPerSector;
+		entriesPerPage	= kWarpSizeIS25xPPageSizeBytes / sizeof(WarpFlashIndexEntry);
+	#endif
+
+	if (flashReadMemory(firstPageNumber + entryIndex / entriesPerPage,
+						(entryIndex % entriesPerPage) * sizeof(WarpFlashIndexEntry),
+						sizeof(WarpFlashIndexEntry),
+						entry) != kWarpStatusOK)
+	{
+		return false;
+	}
+
+	return entry->crc == warpCrc16((const uint8_t *)entry, offsetof(WarpFlashIndexEntry, crc));
+}
+
+static void
+flashLoadIndex(void)
+{
+	WarpFlashIndexEntry	entry;
+	uint16_t			firstEntryNumber;
+	uint16_t			low		= 0;
+	uint16_t			high	= flashIndexEntryCount();
+	uint16_t			middle;
+
+	flashIndexLoaded	= true;
+	flashIndexPending	= false;
+
+	if (!flashReadIndexEntry(0, &entry))
+	{
+		flashIndexNextEntry			= 0;
+		flashIndexNextEntryNumber	= 0;
+		flashIndexLastGroup			= 0xFFFF;
+		flashIndexBootEpoch			= 0;
+		flashIndexBootEpochWritten	= false;
+
+		return;
+	}
+
+	/*
+	 *	Entries from the start of the ring up to the newest are valid and
+	 *	numbered upwards from entry 0. Those after it are erased or from the
+	 *	previous time round, with lower numbers.
+	 */
+	firstEntryNumber = entry.entryNumber;
+	while (high - low > 1)
+	{
+		middle = low + (high - low) / 2;
+		if (flashReadIndexEntry(middle, &entry) && ((int16_t)(entry.entryNumber - firstEntryNumber) >= 0))
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	flashReadIndexEntry(low, &entry);
+	flashIndexNextEntry			= (low + 1) % flashIndexEntryCount();
+	flashIndexNextEntryNumber	= entry.entryNumber + 1;
+	flashIndexLastGroup			= entry.pageNumber / kWarpFlashIndexPagesPerEntry;
+
+	/*
+	 *	The RTC runs on through VLLS0, so a warm boot is still in the boot of
+	 *	the newest entry.
+	 */
+	flashIndexBootEpoch			= gWarpWarmBoot ? entry.bootEpoch : entry.bootEpoch + 1;
+	flashIndexBootEpochWritten	= gWarpWarmBoot;
+}
+
+/*
+ *	Write the entry warpFlashIndexRecordStart() left, if there is one.
+ */
+static WarpStatus
+flashIndexWritePending(void)
+{
+	WarpStatus	status;
+
+	if (!flashIndexPending)
+	{
+		return kWarpStatusOK;
+	}
+
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		status = writeIndexEntryAT45DB(flashIndexNextEntry, sizeof(flashIndexPendingEntry), (uint8_t *)&flashIndexPendingEntry);
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		status = writeIndexEntryIS25xP(flashIndexNextEntry, sizeof(flashIndexPendingEntry), (uint8_t *)&flashIndexPendingEntry);
+	#endif
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	flashIndexPending			= false;
+	flashIndexBootEpochWritten	= true;
+	flashIndexNextEntry			= (flashIndexNextEntry + 1) % flashIndexEntryCount();
+	flashIndexNextEntryNumber++;
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	The boot that records are now being logged in, for the time queries.
+ */
+static uint8_t
+flashIndexCurrentBoot(void)
+{
+	if (!flashIndexLoaded)
+	{
+		flashLoadIndex();
+	}
+
+	return flashIndexBootEpoch;
+}
+#endif
+
+/*
+ *	Called by the flash drivers when a record is about to be written at the
+ *	given position. Makes an index entry if this is the first record to start
+ *	in its group of kWarpFlashIndexPagesPerEntry pages, or the first since a
+ *	cold boot. The entry is only written by flashIndexWritePending(), after
+ *	the record; an earlier one still waiting is written now.
+ */
+WarpStatus
+warpFlashIndexRecordStart(uint16_t pageNumber, uint8_t pageOffset)
+{
+#if (WARP_BUILD_ENABLE_FLASH)
+	WarpStatus			status;
+	WarpFlashIndexEntry	*entry = &flashIndexPendingEntry;
+
+	if (!flashIndexLoaded)
+	{
+		flashLoadIndex();
+	}
+
+	if ((pageNumber / kWarpFlashIndexPagesPerEntry == flashIndexLastGroup) && (flashIndexBootEpochWritten || flashIndexPending))
+	{
+		return kWarpStatusOK;
+	}
+
+	status = flashIndexWritePending();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	entry->timestamp		= RTC->TSR;
+	entry->sequenceNumber	= gWarpPersistentState.sequenceNumber;
+	entry->entryNumber		= flashIndexNextEntryNumber;
+	entry->pageNumber		= pageNumber;
+	entry->pageOffset		= pageOffset;
+	entry->bootEpoch		= flashIndexBootEpoch;
+	entry->crc				= warpCrc16((const uint8_t *)entry, offsetof(WarpFlashIndexEntry, crc));
+
+	flashIndexPending			= true;
+	flashIndexLastGroup			= pageNumber / kWarpFlashIndexPagesPerEntry;
+#endif
+
+	return kWarpStatusOK;
+}
+
+#if (WARP_BUILD_ENABLE_FLASH)
+static uint16_t
+flashSparePage(uint8_t remapEntry)
+{
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		return kWarpAT45DBSpareFirstPage + remapEntry;
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		return (kWarpIS25xPSpareFirstSector + remapEntry) * kWarpIS25xPPagesPerSector;
+	#endif
+}
+#endif
+
+/*
+ *	Page the flash drivers should actually read or program for a log page:
+ *	the spare of the last active remap table entry for it, so that a spare
+ *	which itself fails is replaced by a later entry, or else the page itself.
+ */
+uint16_t
+warpFlashRemapPage(uint16_t pageNumber)
+{
+	uint16_t	physicalPageNumber = pageNumber;
+
+#if (WARP_BUILD_ENABLE_FLASH)
+	if (pageNumber == 0)
+	{
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < kWarpFlashRemapTableEntries; i++)
+	{
+		if ((gWarpPersistentState.remapPageNumbers[i] == pageNumber) &&
+			!(gWarpPersistentState.remapPendingMask & (1 << i)))
+		{
+			physicalPageNumber = flashSparePage(i);
+		}
+	}
+#endif
+
+	return physicalPageNumber;
+}
+
+/*
+ *	Called by the flash drivers when a log page fails write verification.
+ *	Adds a remap table entry for it and returns the spare page it uses, or 0
+ *	if the table is full. A pending entry only takes effect once the driver
+ *	clears its bit in remapPendingMask. The caller saves the table.
+ *
+ *	Entries are never reclaimed: a page that has failed once is not trusted
+ *	again, and only resetting the flash ('Z') empties the table. Once
+ *	all kWarpFlashRemapTableEntries are used, a page that fails stays where
+ *	it is with whatever it holds, and the driver returns
+ *	kWarpStatusFlashVerifyFailed for it each time, which the logger counts in
+ *	errorCount and prints.
+ */
+uint16_t
+warpFlashAddRemap(uint16_t pageNumber, bool pending)
+{
+#if (WARP_BUILD_ENABLE_FLASH)
+	for (uint8_t i = 0; i < kWarpFlashRemapTableEntries; i++)
+	{
+		if (gWarpPersistentState.remapPageNumbers[i] == 0)
+		{
+			gWarpPersistentState.remapPageNumbers[i] = pageNumber;
+			if (pending)
+			{
+				gWarpPersistentState.remapPendingMask |= (1 << i);
+			}
+
+			return flashSparePage(i);
+		}
+	}
+
+	warpPrint("\r\n\tFlash remap table full: page %d failed verification and was not remapped", pageNumber);
+#endif
+
+	return 0;
+}
+
+#if (WARP_BUILD_ENABLE_FLASH)
+/*
+ *	Number of log bytes from one position to another, going round the ring.
+ */
+static uint32_t
+flashLogDistance(uint16_t fromPageNumber, uint8_t fromPageOffset, uint16_t toPageNumber, uint8_t toPageOffset)
+{
+	int32_t		pageSizeBytes;
+	int32_t		ringPages;
+	int32_t		distance;
+
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		pageSizeBytes	= kWarpSizeAT45DBPageSizeBytes;
+		ringPages		= kWarpAT45DBLogEndPage - kWarpInitialPageNumberAT45DB;
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		pageSizeBytes	= kWarpSizeIS25xPPageSizeBytes;
+		ringPages		= kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector - kWarpInitialPageNumberIS25xP;
+	#endif
+
+	distance = (((int32_t)toPageNumber - fromPageNumber + ringPages) % ringPages) * pageSizeBytes + toPageOffset - fromPageOffset;
+	if (distance < 0)
+	{
+		distance += ringPages * pageSizeBytes;
+	}
+
+	return distance;
+}
+
+/*
+ *	The first of the index entries firstEntry + [low, high) written after the
+ *	given RTC time in the given boot, or high if there is none. Entries are
+ *	ordered by boot and then by time; boots are compared modulo 256, which
+ *	holds as long as the log spans fewer than 128 of them. Unreadable entries
+ *	count as after it.
+ */
+static uint16_t
+flashIndexFirstEntryAfter(uint16_t firstEntry, uint16_t low, uint16_t high, uint8_t bootEpoch, uint32_t seconds)
+{
+	WarpFlashIndexEntry	entry;
+	uint16_t			middle;
+
+	while (low < high)
+	{
+		middle = low + (high - low) / 2;
+		if (flashReadIndexEntry((firstEntry + middle) % flashIndexEntryCount(), &entry) &&
+			(((int8_t)(entry.bootEpoch - bootEpoch) < 0) ||
+			 ((entry.bootEpoch == bootEpoch) && (entry.timestamp <= seconds))))
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/*
+ *	Find the part of the log holding the records written between two RTC
+ *	times (seconds) in one boot, to within a group of
+ *	kWarpFlashIndexPagesPerEntry pages at either end. Binary search on the
+ *	time index picks the pages, so only those pages need to be read.
+ */
+static WarpStatus
+flashFindTimeRange(uint8_t bootEpoch, uint32_t startSeconds, uint32_t endSeconds, uint16_t *  startPageNumber, uint8_t *  startPageOffset, uint16_t *  endPageNumber, uint8_t *  endPageOffset)
+{
+	WarpStatus			status;
+	WarpFlashIndexEntry	entry;
+	uint16_t			headPageNumber;
+	uint8_t				headPageOffset;
+	uint32_t			logBytes;
+	uint16_t			windowEntries;
+	uint16_t			firstEntry;
+	uint16_t			low;
+	uint16_t			found;
+	uint32_t			entryBytes;
+
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		entryBytes	= kWarpFlashIndexPagesPerEntry * kWarpSizeAT45DBPageSizeBytes;
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		entryBytes	= kWarpFlashIndexPagesPerEntry * kWarpSizeIS25xPPageSizeBytes;
+	#endif
+
+	status = flashGetLogHead(&headPageNumber, &headPageOffset);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	flashGetLogTail(startPageNumber, startPageOffset);
+	*endPageNumber	= headPageNumber;
+	*endPageOffset	= headPageOffset;
+
+	if (!flashIndexLoaded)
+	{
+		flashLoadIndex();
+	}
+
+	status = flashIndexWritePending();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	/*
+	 *	Only the newest entries can point into the log: one for each group of
+	 *	pages from the tail to the head, and one for the group the tail is in.
+	 */
+	logBytes		= flashLogDistance(*startPageNumber, *startPageOffset, headPageNumber, headPageOffset);
+	windowEntries	= MIN(logBytes / entryBytes + 2, flashIndexEntryCount());
+	firstEntry		= (flashIndexNextEntry + flashIndexEntryCount() - windowEntries) % flashIndexEntryCount();
+
+	/*
+	 *	Skip the oldest of those if they are erased or their records have
+	 *	since been overwritten.
+	 */
+	low = 0;
+	while ((low < windowEntries) &&
+		   (!flashReadIndexEntry((firstEntry + low) % flashIndexEntryCount(), &entry) ||
+			(flashLogDistance(*startPageNumber, *startPageOffset, entry.pageNumber, entry.pageOffset) >= logBytes)))
+	{
+		low++;
+	}
+
+	found = flashIndexFirstEntryAfter(firstEntry, low, windowEntries, bootEpoch, startSeconds);
+	if ((found > low) && flashReadIndexEntry((firstEntry + found - 1) % flashIndexEntryCount(), &entry))
+	{
+		*startPageNumber	= entry.pageNumber;
+		*startPageOffset	= entry.pageOffset;
+	}
+
+	found = flashIndexFirstEntryAfter(firstEntry, low, windowEntries, bootEpoch, endSeconds);
+	if ((found < windowEntries) && flashReadIndexEntry((firstEntry + found) % flashIndexEntryCount(), &entry))
+	{
+		*endPageNumber	= entry.pageNumber;
+		*endPageOffset	= entry.pageOffset;
+	}
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Print the records logged between two RTC times (seconds) in one boot.
+ */
+WarpStatus
+flashReadMemoryBetweenTimes(uint8_t bootEpoch, uint32_t startSeconds, uint32_t endSeconds)
+{
+	WarpStatus	status;
+	uint16_t	startPageNumber;
+	uint8_t		startPageOffset;
+	uint16_t	endPageNumber;
+	uint8_t		endPageOffset;
+
+	status = flashFindTimeRange(bootEpoch, startSeconds, endSeconds, &startPageNumber, &startPageOffset, &endPageNumber, &endPageOffset);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	warpPrint("\r\n\tReading from page %d, offset %d to page %d, offset %d. Press 'q' to stop.\n\n",
+				startPageNumber, startPageOffset, endPageNumber, endPageOffset);
+
+	return flashDumpRecords(startPageNumber, startPageOffset, endPageNumber, endPageOffset);
+}
+
+/*
+ *	Count, minimum, maximum and mean of up to kWarpFlashAggregateMaxChannels
+ *	readings of one sensor, over the records logged between two RTC times in
+ *	one boot.
+ *	The records go through the same decoder as flashDumpRecords(), but only
+ *	the results are printed, so RAM use does not depend on the range.
+ */
+WarpStatus
+flashAggregateBetweenTimes(uint8_t bootEpoch, uint32_t startSeconds, uint32_t endSeconds, uint8_t sensorBitNumber, uint8_t firstReading)
+{
+	WarpStatus					status;
+	WarpFlashAggregateQuery		query;
+	uint16_t					startPageNumber;
+	uint8_t						startPageOffset;
+	uint16_t					endPageNumber;
+	uint8_t						endPageOffset;
+
+	status = flashFindTimeRange(bootEpoch, startSeconds, endSeconds, &startPageNumber, &startPageOffset, &endPageNumber, &endPageOffset);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	memset(&query, 0, sizeof(query));
+	query.sensorBitField	= 1 << sensorBitNumber;
+	query.firstReading		= firstReading;
+
+	warpPrint("\r\n\tAggregating from page %d, offset %d to page %d, offset %d. Press 'q' to stop.\n",
+				startPageNumber, startPageOffset, endPageNumber, endPageOffset);
+
+	flashAggregateQuery = &query;
+	status = flashDumpRecords(startPageNumber, startPageOffset, endPageNumber, endPageOffset);
+	flashAggregateQuery = NULL;
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	for (int i = 0; i < kWarpFlashAggregateMaxChannels; i++)
+	{
+		if (query.channels[i].count == 0)
+		{
+			continue;
+		}
+
+		warpPrint("\r\n\treading %d: count %u, min %d, max %d, mean %d",
+					firstReading + i,
+					query.channels[i].count,
+					query.channels[i].min,
+					query.channels[i].max,
+					(int32_t)(query.channels[i].sum / (int64_t)query.channels[i].count));
+	}
+	warpPrint("\n");
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Add one decoded reading to the aggregate query in progress, if it is one
+ *	of the readings being aggregated.
+ */
+static void
+flashAggregateReading(uint16_t sensorBitField, uint8_t sensorIndex, uint8_t readingIndex, int32_t reading)
+{
+	WarpFlashChannelAggregate *		channel;
+	uint16_t						sensorBit;
+
+	if ((readingIndex < flashAggregateQuery->firstReading) ||
+		(readingIndex >= flashAggregateQuery->firstReading + kWarpFlashAggregateMaxChannels))
+	{
+		return;
+	}
+
+	/*
+	 *	flashDecodeSensorBitField() lays sensors out in order of increasing
+	 *	bit, so the sensorIndex'th set bit is the sensor being read.
+	 */
+	for (sensorBit = 1; sensorBit != 0; sensorBit <<= 1)
+	{
+		if (sensorBitField & sensorBit)
+		{
+			if (sensorIndex == 0)
+			{
+				break;
+			}
+			sensorIndex--;
+		}
+	}
+
+	if (sensorBit != flashAggregateQuery->sensorBitField)
+	{
+		return;
+	}
+
+	channel = &flashAggregateQuery->channels[readingIndex - flashAggregateQuery->firstReading];
+	if ((channel->count == 0) || (reading < channel->min))
+	{
+		channel->min = reading;
+	}
+	if ((channel->count == 0) || (reading > channel->max))
+	{
+		channel->max = reading;
+	}
+	channel->sum += reading;
+	channel->count++;
+}
+#endif
+
+#if (WARP_BUILD_ENABLE_FLASH)
+WarpStatus
+flashLoadPersistentState()
+{
+	#if (WARP_BUILD_ENABLE_DEVAT45DB)
+		/*
+		 *	initAT45DB() has already loaded the state saved in page 0 along
+		 *	with the page pointer.
+		 */
+		return kWarpStatusOK;
+	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+		return loadPersistentStateIS25xP();
+	#endif
+}
+#endif
+
+#if (WARP_BUILD_ENABLE_FLASH)
+WarpStatus
+flashGetLogHead(uint16_t* pageNumber, uint8_t* pageOffset)
+{
+#if (WARP_BUILD_ENABLE_DEVAT45DB)
+	/*
+	 *	Read back what was last saved rather than the RAM copy, which may be
+	 *	ahead of what is in main memory. This also loads the ring-log tail.
+	 */
+	return loadPagePositionAT45DB(pageNumber, pageOffset);
+#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+	WarpStatus status;
+
+	status = loadPersistentStateIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	*pageOffset = gWarpPersistentState.logPageOffset;
+	*pageNumber = gWarpPersistentState.logPageNumber;
+
+	return kWarpStatusOK;
+#endif
+}
+#endif
+
+#if (WARP_BUILD_ENABLE_FLASH)
+/*
+ *	Called between records. Writes the index entry for the record, if it has
+ *	one, checks the pages programmed since the last call, and starts erasing
+ *	at most one sector ahead of the log, so that the sample path does not
+ *	meet an unerased sector.
+ */
+WarpStatus
+flashHandleEndOfRecord()
+{
+	WarpStatus	status;
+
+	status = flashIndexWritePending();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+#if (WARP_BUILD_ENABLE_DEVAT45DB)
+	/*
+	 *	The AT45DB erases each page as it programs it.
+	 */
+	return verifyLastPageAT45DB();
+#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+	return eraseAheadIS25xP();
+#endif
+}
+#endif
+
+#if (WARP_BUILD_ENABLE_FLASH)
+WarpStatus
+flashHandleEndOfWriteAllSensors()
+{
+	WarpStatus	status;
+
+	status = flashIndexWritePending();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+#if (WARP_BUILD_ENABLE_DEVAT45DB)
+	/*
 	 *	Write the remainder of buffer to main memory
 	 */
 	writeBufferAndSavePagePositionAT45DB();
 #elif (WARP_BUILD_ENABLE_DEVIS25xP)
 	/*
-	 *	Do nothing
+	 *	Records are already in flash; use the pause to start erasing ahead
+	 *	of the log, and save the state the records since the last save left.
 	 */
-	return kWarpStatusOK;
+	status = eraseAheadIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	return savePersistentStateIS25xP();
 #endif
 }
 #endif
@@ -4769,7 +6927,7 @@ WarpStatus
 flashReadMemory(uint16_t startPageNumber, uint8_t startPageOffset, size_t nbyte, void *buf)
 {
 	#if (WARP_BUILD_ENABLE_DEVAT45DB)
-		return readMemoryAT45DB(startPageNumber, nbyte, buf);
+		return readMemoryAT45DB(startPageNumber, startPageOffset, nbyte, buf);
 	#elif (WARP_BUILD_ENABLE_DEVIS25xP)
 		return readMemoryIS25xP(startPageNumber, startPageOffset, nbyte, buf);
 	#endif
@@ -4777,77 +6935,124 @@ flashReadMemory(uint16_t startPageNumber, uint8_t startPageOffset, size_t nbyte,
 #endif
 
 #if (WARP_BUILD_ENABLE_FLASH)
+/*
+ *	Feed one byte of the log to the record decoder, printing (or
+ *	aggregating) each reading as it completes. All the decoder's state is in
+ *	*decoder, so decoding can stop and carry on at any byte.
+ */
 void
-flashHandleReadByte(uint8_t readByte, uint8_t *  bytesIndex, uint8_t *  readingIndex, uint8_t *  sensorIndex, uint8_t *  measurementIndex, uint8_t *  currentSensorNumberOfReadings, uint8_t *  currentSensorSizePerReading, uint16_t *  sensorBitField, uint8_t *  currentNumberOfSensors, int32_t *  currentReading)
+flashHandleReadByte(WarpFlashRecordDecoder *  decoder, uint8_t readByte)
 {
-	if (*measurementIndex == 0)
+	if (decoder->measurementIndex == 0)
 	{
 		// reading sensorBitField
 		// warpPrint("\n%d ", readByte);
-		*sensorBitField = readByte << 8;
-		*measurementIndex = *measurementIndex + 1;
+		decoder->sensorBitField = readByte << 8;
+		decoder->measurementIndex++;
 
 		return;
 	}
-	else if (*measurementIndex == 1)
+	else if (decoder->measurementIndex == 1)
 	{
 		// warpPrint("%d\n", readByte);
-		*sensorBitField |= readByte;
-		*measurementIndex = *measurementIndex + 1;
+		decoder->sensorBitField |= readByte;
+		decoder->measurementIndex++;
+
+		return;
+	}
+	else if (decoder->measurementIndex == 2)
+	{
+		decoder->recordFormat = readByte;
+		decoder->measurementIndex++;
 
-		*currentNumberOfSensors = flashGetNSensorsFromSensorBitField(*sensorBitField);
+		/*
+		 *	Records logged by a build with another layout are dumped
+		 *	all the same, tagged so they are not read as this build's.
+		 */
+		if ((flashAggregateQuery == NULL) && (decoder->recordFormat != flashGetRecordFormat()))
+		{
+			warpPrint("[format 0x%02x] ", decoder->recordFormat);
+		}
 
-		*sensorIndex	= 0;
-		*readingIndex	= 0;
-		*bytesIndex		= 0;
+		decoder->numberOfSensors = flashGetNSensorsFromSensorBitField(decoder->sensorBitField);
+
+		decoder->sensorIndex	= 0;
+		decoder->readingIndex	= 0;
+		decoder->bytesIndex		= 0;
+		decoder->reading		= 0;
 
 		return;
 	}
 
-	if (*readingIndex == 0 && *bytesIndex == 0)
+	if (decoder->readingIndex == 0 && decoder->bytesIndex == 0)
 	{
-		flashDecodeSensorBitField(*sensorBitField, *sensorIndex, currentSensorSizePerReading, currentSensorNumberOfReadings);
-		// warpPrint("\r\n\tsensorBit: %d, number of Sensors: %d, sensor index: %d, size: %d, readings: %d", sensorBitField, currentNumberOfSensors, sensorIndex, currentSensorSizePerReading, currentSensorNumberOfReadings);
+		flashDecodeSensorBitField(decoder->sensorBitField, decoder->sensorIndex, &decoder->sizePerReading, &decoder->numberOfReadings);
+		// warpPrint("\r\n\tsensorBit: %d, number of Sensors: %d, sensor index: %d, size: %d, readings: %d", decoder->sensorBitField, decoder->numberOfSensors, decoder->sensorIndex, decoder->sizePerReading, decoder->numberOfReadings);
 	}
 
-	if (*readingIndex < *currentSensorNumberOfReadings)
+	if (decoder->readingIndex < decoder->numberOfReadings)
 	{
-		if (*bytesIndex < *currentSensorSizePerReading)
+		if (decoder->bytesIndex < decoder->sizePerReading)
 		{
-			*currentReading |= readByte << (8 * (*currentSensorSizePerReading - *bytesIndex - 1));
-			*bytesIndex = *bytesIndex + 1;
-			*measurementIndex = *measurementIndex + 1;
+			decoder->reading |= readByte << (8 * (decoder->sizePerReading - decoder->bytesIndex - 1));
+			decoder->bytesIndex++;
+			decoder->measurementIndex++;
 
-			if (*bytesIndex == *currentSensorSizePerReading)
+			if (decoder->bytesIndex == decoder->sizePerReading)
 			{
-				if (*currentSensorSizePerReading == 4)
+				if (flashAggregateQuery != NULL)
+				{
+					/*
+					 *	Readings logged in another layout would be
+					 *	misread, so leave them out of the aggregate.
+					 */
+					if (decoder->recordFormat == flashGetRecordFormat())
+					{
+						if (decoder->sizePerReading == 4)
+						{
+							flashAggregateReading(decoder->sensorBitField, decoder->sensorIndex, decoder->readingIndex, (int32_t)(decoder->reading));
+						}
+						else if (decoder->sizePerReading == 2)
+						{
+							flashAggregateReading(decoder->sensorBitField, decoder->sensorIndex, decoder->readingIndex, (int16_t)(decoder->reading));
+						}
+						else if (decoder->sizePerReading == 1)
+						{
+							flashAggregateReading(decoder->sensorBitField, decoder->sensorIndex, decoder->readingIndex, (int8_t)(decoder->reading));
+						}
+					}
+				}
+				else if (decoder->sizePerReading == 4)
 				{
-					warpPrint("%d, ", (int32_t)(*currentReading));
+					warpPrint("%d, ", (int32_t)(decoder->reading));
 				}
-				else if (*currentSensorSizePerReading == 2)
+				else if (decoder->sizePerReading == 2)
 				{
-					warpPrint("%d, ", (int16_t)(*currentReading));
+					warpPrint("%d, ", (int16_t)(decoder->reading));
 				}
-				else if (*currentSensorSizePerReading == 1)
+				else if (decoder->sizePerReading == 1)
 				{
-					warpPrint("%d, ", (int8_t)(*currentReading));
+					warpPrint("%d, ", (int8_t)(decoder->reading));
 				}
 
-				*currentReading	= 0;
-				*bytesIndex		= 0;
+				decoder->reading	= 0;
+				decoder->bytesIndex	= 0;
 
-				*readingIndex = *readingIndex + 1;
-				*measurementIndex = *measurementIndex + 1;
+				decoder->readingIndex++;
+				decoder->measurementIndex++;
 
-				if (*readingIndex == *currentSensorNumberOfReadings)
+				if (decoder->readingIndex == decoder->numberOfReadings)
 				{
-					*readingIndex = 0;
-					*sensorIndex = *sensorIndex + 1;
+					decoder->readingIndex = 0;
+					decoder->sensorIndex++;
 
-					if (*sensorIndex == *currentNumberOfSensors)
+					if (decoder->sensorIndex == decoder->numberOfSensors)
 					{
-						*measurementIndex = 0;
-						warpPrint("\b\b \n");
+						decoder->measurementIndex = 0;
+						if (flashAggregateQuery == NULL)
+						{
+							warpPrint("\b\b \n");
+						}
 					}
 				}
 			}
@@ -4862,99 +7067,167 @@ flashReadAllMemory()
 	WarpStatus status;
 
 #if (WARP_BUILD_ENABLE_FLASH)
-	int pageSizeBytes;
-	uint16_t pageOffsetStoragePage;
-	size_t pageOffsetStorageSize;
-	int initialPageNumber;
-	int initialPageOffset;
-
-#if (WARP_BUILD_ENABLE_DEVAT45DB)
-	pageSizeBytes				= kWarpSizeAT45DBPageSizeBytes;
-	pageOffsetStoragePage		= kWarpAT45DBPageOffsetStoragePage;
-	pageOffsetStorageSize		= kWarpAT45DBPageOffsetStorageSize;
-	initialPageNumber			= kWarpInitialPageNumberAT45DB;
-	initialPageOffset			= kWarpInitialPageOffsetAT45DB;
-#elif (WARP_BUILD_ENABLE_DEVIS25xP)
-	pageSizeBytes				= kWarpSizeIS25xPPageSizeBytes;
-	pageOffsetStoragePage		= kWarpIS25xPPageOffsetStoragePage;
-	pageOffsetStorageSize		= kWarpIS25xPPageOffsetStorageSize;
-	initialPageNumber			= kWarpInitialPageNumberIS25xP;
-	initialPageOffset			= kWarpInitialPageOffsetIS25xP;
-#endif
-
-	uint8_t dataBuffer[pageSizeBytes];
+	uint8_t headPageOffset;
+	uint16_t headPageNumber;
+	uint8_t pageOffset;
+	uint16_t pageNumber;
 
-	uint8_t pagePositionBuf[3];
-
-	status = flashReadMemory(pageOffsetStoragePage, 0, pageOffsetStorageSize, pagePositionBuf);
+	status = flashGetLogHead(&headPageNumber, &headPageOffset);
 	if (status != kWarpStatusOK)
 	{
 		return status;
 	}
 
-	uint8_t pageOffset			= pagePositionBuf[2];
-	uint16_t pageNumberTotal 	= pagePositionBuf[1] | pagePositionBuf[0] << 8;
+	flashGetLogTail(&pageNumber, &pageOffset);
+
+	warpPrint("\r\n\tPage number: %d", headPageNumber);
+	warpPrint("\r\n\tPage offset: %d", headPageOffset);
+	warpPrint("\r\n\tOldest record: page %d, offset %d\n", pageNumber, pageOffset);
+
+	if (flashLogReaderStopped)
+	{
+		warpPrint("\r\n\tCarry on from page %d, offset %d? ['y' | 'n']> ", flashLogReader.pageNumber, flashLogReader.pageOffset);
+		if (warpWaitKey() != 'y')
+		{
+			flashStartLogReader(&flashLogReader, pageNumber, pageOffset, headPageNumber, headPageOffset);
+		}
+	}
+	else
+	{
+		flashStartLogReader(&flashLogReader, pageNumber, pageOffset, headPageNumber, headPageOffset);
+	}
 
-	warpPrint("\r\n\tPage number: %d", pageNumberTotal);
-	warpPrint("\r\n\tPage offset: %d\n", pageOffset);
 	warpPrint("\r\n\tReading memory. Press 'q' to stop.\n\n");
 
-	uint8_t bytesIndex			= 0;
-	uint8_t readingIndex		= 0;
-	uint8_t sensorIndex			= 0;
-	uint8_t measurementIndex	= 0;
+	status = flashContinueLogReader(&flashLogReader);
+	flashLogReaderStopped = (status == kWarpStatusOK) && !flashLogReaderAtEnd(&flashLogReader);
+#endif
+
+	return status;
+}
+
+#if (WARP_BUILD_ENABLE_FLASH)
+/*
+ *	Set a reader up to decode the records from one position in the log to
+ *	another. The start has to be the start of a record.
+ */
+void
+flashStartLogReader(WarpFlashLogReader *  reader, uint16_t pageNumber, uint8_t pageOffset, uint16_t endPageNumber, uint8_t endPageOffset)
+{
+	memset(reader, 0, sizeof(*reader));
 
-	uint8_t currentSensorNumberOfReadings	= 0;
-	uint8_t currentSensorSizePerReading		= 0;
+	reader->pageNumber		= pageNumber;
+	reader->pageOffset		= pageOffset;
+	reader->endPageNumber	= endPageNumber;
+	reader->endPageOffset	= endPageOffset;
+}
 
-	uint16_t sensorBitField			= 0;
-	uint8_t currentNumberOfSensors	= 0;
+bool
+flashLogReaderAtEnd(const WarpFlashLogReader *  reader)
+{
+	return (reader->pageNumber == reader->endPageNumber) && (reader->pageOffset == reader->endPageOffset);
+}
 
-	int32_t currentReading = 0;
+/*
+ *	Decode and print records until the reader gets to its end or 'q' is
+ *	pressed, going round the end of the log if the ring log has wrapped, so
+ *	records come out in the order they were written. The log is read through
+ *	a kWarpFlashReadWindowBytes window rather than a page at a time, to keep
+ *	the stack used small whatever the page size. Calling again after 'q'
+ *	carries on from where the read stopped.
+ */
+WarpStatus
+flashContinueLogReader(WarpFlashLogReader *  reader)
+{
+	WarpStatus	status;
+	uint8_t		window[kWarpFlashReadWindowBytes];
+	size_t		pageSizeBytes;
+	size_t		pageEnd;
+	size_t		nbyte;
 
-	int rttKey = -1;
+#if (WARP_BUILD_ENABLE_DEVAT45DB)
+	pageSizeBytes	= kWarpSizeAT45DBPageSizeBytes;
+#elif (WARP_BUILD_ENABLE_DEVIS25xP)
+	pageSizeBytes	= kWarpSizeIS25xPPageSizeBytes;
+#endif
 
-	for (uint32_t pageNumber = initialPageNumber; pageNumber < pageNumberTotal;
-			 pageNumber++)
+	while (!flashLogReaderAtEnd(reader))
 	{
-		rttKey = SEGGER_RTT_GetKey();
-		if (rttKey == 'q')
+		if (SEGGER_RTT_GetKey() == 'q')
 		{
 			return kWarpStatusOK;
 		}
 
-		status = flashReadMemory(pageNumber, 0, pageSizeBytes, dataBuffer);
+		pageEnd	= ((reader->pageNumber == reader->endPageNumber) && (reader->pageOffset < reader->endPageOffset)) ? reader->endPageOffset : pageSizeBytes;
+		nbyte	= MIN(sizeof(window), pageEnd - reader->pageOffset);
+
+		status = flashReadMemory(reader->pageNumber, reader->pageOffset, nbyte, window);
 		if (status != kWarpStatusOK)
 		{
 			return status;
 		}
 
-		for (size_t i = 0; i < kWarpSizeAT45DBPageSizeBytes; i++)
+		for (size_t i = 0; i < nbyte; i++)
 		{
-			flashHandleReadByte(dataBuffer[i], &bytesIndex, &readingIndex, &sensorIndex, &measurementIndex, &currentSensorNumberOfReadings, &currentSensorSizePerReading, &sensorBitField, &currentNumberOfSensors, &currentReading);
+			flashHandleReadByte(&reader->decoder, window[i]);
 		}
-	}
 
-	if (pageOffset <= 0)
-	{
-		return status;
+		if (reader->pageOffset + nbyte == pageSizeBytes)
+		{
+			reader->pageNumber = flashNextLogPage(reader->pageNumber);
+			reader->pageOffset = 0;
+		}
+		else
+		{
+			reader->pageOffset += nbyte;
+		}
 	}
 
-	status = flashReadMemory(pageNumberTotal, 0, pageOffset, dataBuffer);
+	return kWarpStatusOK;
+}
 
-	if (status != kWarpStatusOK)
-	{
-		return status;
-	}
+/*
+ *	Decode and print the records from one position in the log to another.
+ *	The start has to be the start of a record.
+ */
+WarpStatus
+flashDumpRecords(uint16_t pageNumber, uint8_t pageOffset, uint16_t endPageNumber, uint8_t endPageOffset)
+{
+	flashLogReaderStopped = false;
+	flashStartLogReader(&flashLogReader, pageNumber, pageOffset, endPageNumber, endPageOffset);
 
-	for (size_t i = 0; i < pageOffset; i++)
-	{
-		flashHandleReadByte(dataBuffer[i], &bytesIndex, &readingIndex, &sensorIndex, &measurementIndex, &currentSensorNumberOfReadings, &currentSensorSizePerReading, &sensorBitField, &currentNumberOfSensors, &currentReading);
-	}
+	return flashContinueLogReader(&flashLogReader);
+}
 #endif
 
-	return status;
+#if (WARP_BUILD_ENABLE_FLASH)
+/*
+ *	The WarpFlashRecordFormatEncoding byte for records this build logs.
+ */
+uint8_t
+flashGetRecordFormat(void)
+{
+	uint8_t recordFormat = kWarpFlashRecordFormatVersion;
+
+#if (!WARP_BUILD_ENABLE_DEVHDC1000) && (WARP_BUILD_ENABLE_DEVSI7021)
+	recordFormat |= kWarpFlashRecordFormatSI7021;
+#endif
+#if (WARP_BUILD_ENABLE_DEVBME680)
+	recordFormat |= kWarpFlashRecordFormatBME680Gas;
+#endif
+#if (WARP_BUILD_ENABLE_DEVBMX055) && (WARP_BUILD_ENABLE_BMX055_AHRS)
+	recordFormat |= kWarpFlashRecordFormatBMX055Ahrs;
+#endif
+#if (WARP_BUILD_ENABLE_DEVMMA8451Q) && (WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM)
+	recordFormat |= kWarpFlashRecordFormatMMA8451QSpectrum;
+#if (WARP_BUILD_SPECTRUM_LOG_PEAKS)
+	recordFormat |= kWarpFlashRecordFormatMMA8451QPeaks;
+#endif
+#endif
+
+	return recordFormat;
 }
+#endif
 
 #if (WARP_BUILD_ENABLE_FLASH)
 uint8_t
@@ -5104,6 +7377,20 @@ flashDecodeSensorBitField(uint16_t sensorBitField, uint8_t sensorIndex, uint8_t*
 		}
 	}
 
+	/*
+	 * BNO055
+	*/
+	if (sensorBitField & kWarpFlashBNO055BitField)
+	{
+		numberOfSensorsFound++;
+		if (numberOfSensorsFound - 1 == sensorIndex)
+		{
+			*sizePerReading		= bytesPerReadingBNO055;
+			*numberOfReadings = numberOfReadingsPerMeasurementBNO055;
+			return;
+		}
+	}
+
 	/*
 	 * BMX055
 	*/
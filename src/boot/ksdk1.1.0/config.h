@@ -39,9 +39,17 @@
 #define WARP_BUILD_BOOT_TO_CSVSTREAM				1
 #define WARP_CSVSTREAM_TO_FLASH						1
 #define WARP_CSVSTREAM_FLASH_PRINT_METADATA			0
+#define WARP_BUILD_ENABLE_FLASH_RING_LOG			1
+#define WARP_BUILD_ENABLE_FLASH_VERIFY				1
+#define WARP_BUILD_ENABLE_STACK_HIGH_WATER_MARK		0
+#define WARP_BUILD_ENABLE_BMX055_AHRS				0
+#define WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM		0
+#define WARP_BUILD_SPECTRUM_LOG_PEAKS				0
+#define WARP_BUILD_ENABLE_FLASH_TRIGGER			0
 #define WARP_BUILD_EXTRA_QUIET_MODE					0
 #define WARP_BUILD_BOOT_TO_VLPR						0
 #define WARP_BUILD_DISABLE_SUPPLIES_BY_DEFAULT		0
+#define WARP_BUILD_WARM_BOOT_FROM_VLLS				1
 
 /*
  *	NOTE: The choice of WARP_BUILD_ENABLE_GLAUX_VARIANT is defined via the Makefile build rules
@@ -157,6 +165,44 @@ typedef enum
 	kWarpDefaultMenuPrintDelayMilliseconds      = 10,
 	kWarpDefaultSupplySettlingDelayMilliseconds = 1,
 	kWarpCsvstreamMenuWaitTimeMilliSeconds		= 3000,
+	kWarpMAG3110TriggeredModeMinPeriodMilliseconds = 1000,
+	kWarpMAG3110TemperatureReadInterval         = 16,
+	kWarpCCS811StartupMilliseconds              = 20,
+	kWarpCCS811AppStartMilliseconds             = 500,
+	kWarpBME680HeaterTemperatureCelsius         = 320,
+	kWarpBME680HeaterDurationMilliseconds       = 150,
+	kWarpBME680GasMeasurementInterval           = 10,
+	kWarpBNO055ToConfigModeMilliseconds         = 19,
+	kWarpBNO055FromConfigModeMilliseconds       = 7,
+	kWarpBMX055AhrsMaxStepTicks                 = 3276,
+	kWarpBMX055FifoWatermarkFrames              = 16,
+	kWarpL3GD20HFifoWatermarkSamples            = 16,
+	kWarpMMA8451QSpectrumMaxEmptyPolls          = 4,
+
+	/*
+	 *	Filter gains
+	 */
+	kWarpBMX055AhrsTwoKpQ8                      = 256,
+	kWarpBMX055AhrsTwoKiQ8                      = 0,
+
+	/*
+	 *	Spectra: 2^kWarpSpectrumLog2Points samples (64--256) of axis
+	 *	kWarpMMA8451QSpectrumAxis (0 = x, 1 = y, 2 = z) per window
+	 */
+	kWarpSpectrumLog2Points                     = 6,
+	kWarpSpectrumBands                          = 8,
+	kWarpSpectrumPeaks                          = 4,
+	kWarpSpectrumMaxPeaks                       = 8,
+	kWarpMMA8451QSpectrumAxis                   = 2,
+
+	/*
+	 *	Triggers: 1.5 g on the MMA8451Q (4096 counts/g at +/-2 g), 30 Pa on
+	 *	the BME680, 250 mg on the ADXL362 (1 mg/LSB at +/-2 g)
+	 */
+	kWarpTriggerMMA8451QMagnitudeSquared        = 6144 * 6144,
+	kWarpTriggerBME680PressureStepPascals       = 30,
+	kWarpTriggerADXL362ActivityMilliG           = 250,
+	kWarpTriggerADXL362ActivitySamples          = 1,
 
 
 	/*
@@ -168,9 +214,37 @@ typedef enum
 	kWarpSizesSpiBufferBytes               = 7,
 	kWarpSizesUartBufferBytes              = 8,
 	kWarpSizesBME680CalibrationValuesCount = 41,
+	kWarpSizesBME680CalibrationRegion1Bytes = 25,
+	kWarpSizesBME680OutputBytes            = 15,
+	kWarpSizesBME680HeaterProfiles         = 10,
+	kWarpSizesBNO055DataBurstBytes         = 18,
+	kWarpSizesBNO055QuaternionBytes        = 8,
+	kWarpSizesBMX055accelBurstBytes        = 7,
+	kWarpSizesBMX055gyroBurstBytes         = 6,
+	kWarpSizesBMX055magBurstBytes          = 8,
+	kWarpSizesBMX055FifoFrameBytes         = 6,
+	kWarpSizesBMX055FifoBurstFrames        = 8,
+	kWarpSizesBMX055accelFifoFrames        = 32,
+	kWarpSizesBMX055gyroFifoFrames         = 100,
+	kWarpSizesL3GD20HBurstBytes            = 8,
+	kWarpSizesL3GD20HFifoSampleBytes       = 6,
+	kWarpSizesL3GD20HFifoBurstSamples      = 8,
+	kWarpSizesL3GD20HFifoSamples           = 32,
+	kWarpSizesMAG3110BurstBytes            = 6,
+	kWarpSizesMMA8451QFifoFrameBytes       = 6,
+	kWarpSizesMMA8451QFifoBurstFrames      = 8,
+	kWarpSizesHDC1000MeasurementBytes      = 4,
+	kWarpSizesCCS811AlgResultBytes         = 8,
 	kWarpSizeAT45DBPageSizeBytes           = 256,
 	kWarpSizeAT45DBNPages                  = 32768,
 	kWarpSizeIS25xPPageSizeBytes           = 256,
+	kWarpFlashIndexPagesPerEntry           = 16,
+	kWarpFlashAggregateMaxChannels         = 4,
+	kWarpFlashRemapTableEntries            = 7,
+	kWarpFlashReadWindowBytes              = 16,
+	kWarpTriggerRingBytes                  = 256,
+	kWarpTriggerPostRecords                = 32,
+	kWarpStackPaintPattern                 = 0x5A5A5A5A,
 	kWarpWriteToFlash                      = 0,
 
 	/*
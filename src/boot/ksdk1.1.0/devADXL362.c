@@ -536,7 +536,7 @@ printSensorDataADXL362(bool hexModeFlag)
 }
 
 uint8_t
-appendSensorDataADXL362(uint8_t* buf)
+appendSensorDataADXL362(void)
 {
 	uint8_t index = 0;
 	uint8_t readSensorRegisterValueLSB;
@@ -555,10 +555,10 @@ appendSensorDataADXL362(uint8_t* buf)
 	 */
 	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -575,10 +575,10 @@ appendSensorDataADXL362(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 
@@ -587,10 +587,10 @@ appendSensorDataADXL362(uint8_t* buf)
 	 */
 	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -607,10 +607,10 @@ appendSensorDataADXL362(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 
@@ -619,10 +619,10 @@ appendSensorDataADXL362(uint8_t* buf)
 	 */
 	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -639,10 +639,10 @@ appendSensorDataADXL362(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 
@@ -651,10 +651,10 @@ appendSensorDataADXL362(uint8_t* buf)
 	 */
 	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -671,12 +671,55 @@ appendSensorDataADXL362(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 
 	return index;
-}
\ No newline at end of file
+}
+
+/*
+ *	Set the activity threshold used by the referenced activity detection
+ *	that initADXL362() enables: activity is flagged once the acceleration
+ *	has changed by more than thresholdMilliG for timeSamples samples.
+ */
+WarpStatus
+configureActivityADXL362(uint16_t thresholdMilliG, uint8_t timeSamples)
+{
+	WarpStatus	status1, status2, status3;
+
+	status1 = writeSensorRegisterADXL362(	kWarpSensorConfigConstADXL362registerWriteCommand	/*	command == write register		*/,
+						kWarpSensorOutputRegisterADXL362THRESH_ACT_L		/*	The register to write			*/,
+						thresholdMilliG & 0xFF					/*	writeValue				*/,
+						0							/*	number of additional dummy bytes	*/
+	);
+	status2 = writeSensorRegisterADXL362(	kWarpSensorConfigConstADXL362registerWriteCommand	/*	command == write register		*/,
+						kWarpSensorOutputRegisterADXL362THRESH_ACT_H		/*	The register to write			*/,
+						(thresholdMilliG >> 8) & 0x07				/*	writeValue				*/,
+						0							/*	number of additional dummy bytes	*/
+	);
+	status3 = writeSensorRegisterADXL362(	kWarpSensorConfigConstADXL362registerWriteCommand	/*	command == write register		*/,
+						kWarpSensorOutputRegisterADXL362TIME_ACT		/*	The register to write			*/,
+						timeSamples						/*	writeValue				*/,
+						0							/*	number of additional dummy bytes	*/
+	);
+
+	return (status1 | status2 | status3);
+}
+
+/*
+ *	Whether the ACT bit of STATUS is set. Reading STATUS clears it.
+ */
+bool
+activityDetectedADXL362(void)
+{
+	if (readSensorRegisterADXL362(kWarpSensorOutputRegisterADXL362STATUS, 1 /* numberOfBytes */) != kWarpStatusOK)
+	{
+		return false;
+	}
+
+	return (deviceADXL362State.spiSinkBuffer[2] & 0x10) != 0;
+}
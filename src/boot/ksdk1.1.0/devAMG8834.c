@@ -261,7 +261,7 @@ printSensorDataAMG8834(bool hexModeFlag)
 }
 
 uint8_t
-appendSensorDataAMG8834(uint8_t* buf)
+appendSensorDataAMG8834(void)
 {
 	uint8_t index = 0;
 
@@ -291,10 +291,10 @@ appendSensorDataAMG8834(uint8_t* buf)
 
 		if (i2cReadStatus != kWarpStatusOK)
 		{
-			buf[index] = 0;
+			warpFlashStreamByte(0);
 			index += 1;
 
-			buf[index] = 0;
+			warpFlashStreamByte(0);
 			index += 1;
 		}
 		else
@@ -302,10 +302,10 @@ appendSensorDataAMG8834(uint8_t* buf)
 			/*
 			 * MSB first
 			 */
-			buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+			warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 			index += 1;
 
-			buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+			warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 			index += 1;
 		}
 	}
@@ -327,10 +327,10 @@ appendSensorDataAMG8834(uint8_t* buf)
 
 	if (i2cReadStatus != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -338,10 +338,10 @@ appendSensorDataAMG8834(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 
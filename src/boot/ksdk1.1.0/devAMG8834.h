@@ -40,7 +40,7 @@ WarpStatus	readSensorRegisterAMG8834(uint8_t deviceRegister, int numberOfBytes);
 WarpStatus	writeSensorRegisterAMG8834(uint8_t deviceRegister, uint8_t payload);
 WarpStatus	configureSensorAMG8834(uint8_t payloadConfigReg, uint8_t payloadFrameRateReg);
 void		printSensorDataAMG8834(bool hexModeFlag);
-uint8_t		appendSensorDataAMG8834(uint8_t* buf);
+uint8_t		appendSensorDataAMG8834(void);
 
 const uint8_t	bytesPerMeasurementAMG8834			= 4;
 const uint8_t	bytesPerReadingAMG8834				= 2;
@@ -35,6 +35,7 @@
 	POSSIBILITY OF SUCH DAMAGE.
 */
 #include <stdlib.h>
+#include <string.h>
 
 /*
  *	config.h needs to come first
@@ -71,6 +72,8 @@ extern volatile WarpSPIDeviceState deviceAT45DBState;
 extern volatile uint32_t gWarpSpiTimeoutMicroseconds;
 extern uint8_t gWarpSpiCommonSourceBuffer[];
 extern uint8_t gWarpSpiCommonSinkBuffer[];
+extern volatile bool gWarpFlashStreamOpen;
+extern WarpPersistentState gWarpPersistentState;
 
 /* Read commands */
 #define AT45DB_RDMN							0xd2 /* Main Memory Page Read */
@@ -170,6 +173,24 @@ volatile uint8_t currentPageOffsetAT45DB;
 
 bool AT45DBFull = false;
 
+/*
+ *	First error seen since beginStreamToAT45DB(); once set, further bytes are dropped.
+ */
+static WarpStatus streamStatusAT45DB = kWarpStatusOK;
+
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+/*
+ *	The last log page programmed from a buffer, not yet compared against that
+ *	buffer. It has to be compared before the buffer is changed or another page
+ *	is programmed.
+ */
+static bool					verifyPendingAT45DB		= false;
+static BufferNumberAT45DB	verifyBufferAT45DB;
+static uint16_t				verifyPageNumberAT45DB;
+#endif
+
+static WarpStatus	finishVerifyAT45DB(void);
+
 WarpStatus
 initAT45DB(int chipSelectIoPinID, uint16_t operatingVoltageMillivolts)
 {
@@ -183,8 +204,9 @@ initAT45DB(int chipSelectIoPinID, uint16_t operatingVoltageMillivolts)
 
 	enableAT45DBWrite();
 
-	uint8_t pagePositionBuf[3];
-	status = readMemoryAT45DB(kWarpAT45DBPageOffsetStoragePage, kWarpAT45DBPageOffsetStorageSize, pagePositionBuf);
+	uint16_t	pageNumber;
+	uint8_t		pageOffset;
+	status = loadPagePositionAT45DB(&pageNumber, &pageOffset);
 	if (status != kWarpStatusOK)
 	{
 		return status;
@@ -192,18 +214,33 @@ initAT45DB(int chipSelectIoPinID, uint16_t operatingVoltageMillivolts)
 
 	currentBufferAT45DB = bufferNumber1AT45DB;
 
-	currentPageOffsetAT45DB = pagePositionBuf[2];
-	currentPageNumberAT45DB = pagePositionBuf[1] | pagePositionBuf[0] << 8;
+	currentPageOffsetAT45DB = pageOffset;
+	currentPageNumberAT45DB = pageNumber;
+
+#if (WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	if (currentPageNumberAT45DB == kWarpSizeAT45DBNPages && currentPageOffsetAT45DB == kWarpSizeAT45DBPageSizeBytes - 1)
+	{
+		/*
+		 * Left full by firmware without the ring log: carry on from the first page, overwriting the oldest records.
+		 */
+		currentPageNumberAT45DB = kWarpInitialPageNumberAT45DB;
+		currentPageOffsetAT45DB = kWarpInitialPageOffsetAT45DB;
+
+		gWarpPersistentState.logTailPageNumber = kWarpInitialPageNumberAT45DB;
+		gWarpPersistentState.logTailPageOffset = kWarpInitialPageOffsetAT45DB;
+	}
+#endif
 
 	currentBufferOffsetAT45DB = currentPageOffsetAT45DB;
 
 	/*
 	 * Load the current page from main memory into the current buffer. This is done so that if the previous session ended with a partial write to a page, we need to load that page again into the buffer, and continue writing from there, since we can only do page writes from the start of a page.
 	 */
-	status = loadMainMemoryPageToBuffer(currentPageNumberAT45DB, currentBufferAT45DB);
+	status = loadMainMemoryPageToBuffer(currentBufferAT45DB, currentPageNumberAT45DB);
 	warpPrint("\nAT45DB global variables set to page %d, offset %d, buffer offset %d\n", currentPageNumberAT45DB, currentPageOffsetAT45DB, currentBufferOffsetAT45DB);
 
 
+#if (!WARP_BUILD_ENABLE_FLASH_RING_LOG)
 	/*
 	* Check if the flash is full. If so, set AT45DBFull to true.
 	*/
@@ -212,6 +249,7 @@ initAT45DB(int chipSelectIoPinID, uint16_t operatingVoltageMillivolts)
 		AT45DBFull = true;
 		warpPrint("\nAT45DB is full\n");
 	}
+#endif
 	return status;
 }
 
@@ -306,13 +344,45 @@ WarpStatus
 setAT45DBStartPosition(uint16_t pageNumber, uint8_t pageOffset)
 {
 	WarpStatus status;
+	uint16_t crc;
 
-	uint8_t initialNANDStartPosition[3];
+	/*
+	 *	Page 0 is programmed through the free buffer, and a failed
+	 *	verification changes the remap table saved below, so check the last
+	 *	page programmed first.
+	 */
+	status = finishVerifyAT45DB();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	uint8_t initialNANDStartPosition[kWarpAT45DBPageOffsetStorageSize];
 	initialNANDStartPosition[1] = (uint8_t)pageNumber;
 	initialNANDStartPosition[0] = (uint8_t)(pageNumber >>= 8);
 	initialNANDStartPosition[2] = pageOffset;
+	initialNANDStartPosition[4] = (uint8_t)gWarpPersistentState.logTailPageNumber;
+	initialNANDStartPosition[3] = (uint8_t)(gWarpPersistentState.logTailPageNumber >> 8);
+	initialNANDStartPosition[5] = gWarpPersistentState.logTailPageOffset;
 
-	status = pageProgramAT45DB(0, 3, initialNANDStartPosition);
+	for (int i = 0; i < kWarpFlashRemapTableEntries; i++)
+	{
+		initialNANDStartPosition[6 + 2*i]	= (uint8_t)(gWarpPersistentState.remapPageNumbers[i] >> 8);
+		initialNANDStartPosition[7 + 2*i]	= (uint8_t)gWarpPersistentState.remapPageNumbers[i];
+	}
+	initialNANDStartPosition[6 + 2*kWarpFlashRemapTableEntries] = gWarpPersistentState.remapPendingMask;
+	initialNANDStartPosition[7 + 2*kWarpFlashRemapTableEntries] = gWarpPersistentState.flags;
+	initialNANDStartPosition[8 + 2*kWarpFlashRemapTableEntries] = gWarpPersistentState.errorCount;
+	for (int i = 0; i < 4; i++)
+	{
+		initialNANDStartPosition[9 + 2*kWarpFlashRemapTableEntries + i] = (uint8_t)(gWarpPersistentState.sequenceNumber >> (24 - 8*i));
+	}
+
+	crc = warpCrc16(initialNANDStartPosition, kWarpAT45DBPageOffsetStorageSize - 2);
+	initialNANDStartPosition[kWarpAT45DBPageOffsetStorageSize - 2] = (uint8_t)(crc >> 8);
+	initialNANDStartPosition[kWarpAT45DBPageOffsetStorageSize - 1] = (uint8_t)crc;
+
+	status = pageProgramAT45DB(0, kWarpAT45DBPageOffsetStorageSize, initialNANDStartPosition);
 
 	if (status != kWarpStatusOK)
 	{
@@ -332,6 +402,59 @@ savePagePositionAT45DB()
 	return status;
 }
 
+WarpStatus
+loadPagePositionAT45DB(uint16_t* pageNumber, uint8_t* pageOffset)
+{
+	WarpStatus status;
+
+	uint8_t pagePositionBuf[kWarpAT45DBPageOffsetStorageSize];
+	status = readMemoryAT45DB(kWarpAT45DBPageOffsetStoragePage, 0, kWarpAT45DBPageOffsetStorageSize, pagePositionBuf);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	*pageOffset = pagePositionBuf[2];
+	*pageNumber = pagePositionBuf[1] | pagePositionBuf[0] << 8;
+
+	bool	crcOK		= warpCrc16(pagePositionBuf, kWarpAT45DBPageOffsetStorageSize - 2) ==
+						  (uint16_t)(pagePositionBuf[kWarpAT45DBPageOffsetStorageSize - 2] << 8 | pagePositionBuf[kWarpAT45DBPageOffsetStorageSize - 1]);
+	bool	legacyCrcOK	= warpCrc16(pagePositionBuf, kWarpAT45DBPageOffsetStorageLegacySize - 2) ==
+						  (uint16_t)(pagePositionBuf[kWarpAT45DBPageOffsetStorageLegacySize - 2] << 8 | pagePositionBuf[kWarpAT45DBPageOffsetStorageLegacySize - 1]);
+
+	if (crcOK)
+	{
+		gWarpPersistentState.flags		= pagePositionBuf[7 + 2*kWarpFlashRemapTableEntries];
+		gWarpPersistentState.errorCount	= pagePositionBuf[8 + 2*kWarpFlashRemapTableEntries];
+		gWarpPersistentState.sequenceNumber = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			gWarpPersistentState.sequenceNumber = (gWarpPersistentState.sequenceNumber << 8) | pagePositionBuf[9 + 2*kWarpFlashRemapTableEntries + i];
+		}
+	}
+
+	if (crcOK || legacyCrcOK)
+	{
+		gWarpPersistentState.logTailPageNumber = pagePositionBuf[4] | pagePositionBuf[3] << 8;
+		gWarpPersistentState.logTailPageOffset = pagePositionBuf[5];
+
+		for (int i = 0; i < kWarpFlashRemapTableEntries; i++)
+		{
+			gWarpPersistentState.remapPageNumbers[i] = pagePositionBuf[7 + 2*i] | pagePositionBuf[6 + 2*i] << 8;
+		}
+		gWarpPersistentState.remapPendingMask = pagePositionBuf[6 + 2*kWarpFlashRemapTableEntries];
+	}
+	else
+	{
+		gWarpPersistentState.logTailPageNumber = 0;
+		gWarpPersistentState.logTailPageOffset = 0;
+		memset(gWarpPersistentState.remapPageNumbers, 0, sizeof(gWarpPersistentState.remapPageNumbers));
+		gWarpPersistentState.remapPendingMask = 0;
+	}
+
+	return kWarpStatusOK;
+}
+
 WarpStatus
 writeToAT45DBFromEndBuffered(size_t nbyte, uint8_t* buf)
 {
@@ -344,8 +467,10 @@ writeToAT45DBFromEndBuffered(size_t nbyte, uint8_t* buf)
 	{
 		/*
 		 * If the current buffer is exactly full (most likely after the next condition was called), wait for a previous write to main memory to finish, and then write the current buffer to main memory. Then, switch to the other buffer, and call this function again. The control should then go to the final else condition, at which point the other buffer will be filled with the data as needed.
+		 *
+		 * The previous write was started a whole buffer of records ago, so there is no point sleeping for tEP here: just poll.
 		 */
-		status = waitForDeviceReady();
+		status = waitForDeviceReady(0, kWarpAT45DBPageEraseProgramMaxMilliseconds);
 		if (status != kWarpStatusOK)
 		{
 			return status;
@@ -400,11 +525,205 @@ writeToAT45DBFromEndBuffered(size_t nbyte, uint8_t* buf)
 	return status;
 }
 
+/*
+ *	Open a Buffer Write at the current buffer offset and leave /CS asserted, so
+ *	that the bytes of a record can be clocked straight into the SRAM buffer as
+ *	they are read from the sensors.
+ */
+static WarpStatus
+openStreamAT45DB(void)
+{
+	spi_status_t status;
+	WarpStatus	 verifyStatus;
+	uint8_t ops[4];
+
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	if (verifyPendingAT45DB && (verifyBufferAT45DB == currentBufferAT45DB))
+	{
+		verifyStatus = finishVerifyAT45DB();
+		if (verifyStatus != kWarpStatusOK)
+		{
+			return verifyStatus;
+		}
+	}
+#endif
+
+	ops[0] = (currentBufferAT45DB == bufferNumber1AT45DB) ? AT45DB_WRBF1 : AT45DB_WRBF2;
+	ops[1] = 0x00;
+	ops[2] = 0x00;
+	ops[3] = (uint8_t)currentBufferOffsetAT45DB;
+
+	warpScaleSupplyVoltage(deviceAT45DBState.operatingVoltageMillivolts);
+	warpDeasserAllSPIchipSelects();
+	warpEnableSPIpins();
+	GPIO_DRV_ClearPinOutput(deviceAT45DBState.chipSelectIoPinID);
+
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */, NULL, ops, NULL, 4, gWarpSpiTimeoutMicroseconds);
+	if (status != kStatus_SPI_Success)
+	{
+		GPIO_DRV_SetPinOutput(deviceAT45DBState.chipSelectIoPinID);
+		warpDisableSPIpins();
+
+		return kWarpStatusDeviceCommunicationFailed;
+	}
+
+	gWarpFlashStreamOpen = true;
+
+	return kWarpStatusOK;
+}
+
+static void
+closeStreamAT45DB(void)
+{
+	/*
+	 *	If another SPI transaction has happened since the stream was opened,
+	 *	warpDeasserAllSPIchipSelects() has already ended it.
+	 */
+	if (gWarpFlashStreamOpen)
+	{
+		GPIO_DRV_SetPinOutput(deviceAT45DBState.chipSelectIoPinID);
+		warpDisableSPIpins();
+		gWarpFlashStreamOpen = false;
+	}
+}
+
+WarpStatus
+beginStreamToAT45DB(void)
+{
+	WarpStatus status;
+
+	if (AT45DBFull)
+	{
+		return kWarpStatusFlashFull;
+	}
+
+	status = warpFlashIndexRecordStart(currentPageNumberAT45DB, currentBufferOffsetAT45DB);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	streamStatusAT45DB = kWarpStatusOK;
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Read-modify-write a time-index entry on its page, through the buffer that
+ *	is not collecting log data. That buffer's last page program has to finish
+ *	first.
+ */
+WarpStatus
+writeIndexEntryAT45DB(uint16_t entryIndex, size_t nbyte, uint8_t *  entry)
+{
+	WarpStatus			status;
+	BufferNumberAT45DB	freeBuffer;
+	uint16_t			pageNumber	= kWarpAT45DBIndexFirstPage + (entryIndex * nbyte) / kWarpSizeAT45DBPageSizeBytes;
+	uint8_t				pageOffset	= (entryIndex * nbyte) % kWarpSizeAT45DBPageSizeBytes;
+
+	freeBuffer = currentBufferAT45DB == bufferNumber1AT45DB ? bufferNumber2AT45DB : bufferNumber1AT45DB;
+
+	status = waitForDeviceReady(0, kWarpAT45DBPageEraseProgramMaxMilliseconds);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	status = loadMainMemoryPageToBuffer(freeBuffer, pageNumber);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	status = writeToBufferAT45DB(freeBuffer, pageOffset, nbyte, entry);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	return bufferToMainMemoryWriteAT45DB(freeBuffer, pageNumber);
+}
+
+void
+streamByteToAT45DB(uint8_t byte)
+{
+	spi_status_t status;
+
+	if (streamStatusAT45DB != kWarpStatusOK)
+	{
+		return;
+	}
+
+	if (!gWarpFlashStreamOpen)
+	{
+		streamStatusAT45DB = openStreamAT45DB();
+		if (streamStatusAT45DB != kWarpStatusOK)
+		{
+			return;
+		}
+	}
+
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */, NULL, &byte, NULL, 1, gWarpSpiTimeoutMicroseconds);
+	if (status != kStatus_SPI_Success)
+	{
+		closeStreamAT45DB();
+		streamStatusAT45DB = kWarpStatusDeviceCommunicationFailed;
+
+		return;
+	}
+
+	currentBufferOffsetAT45DB++;
+	if (currentBufferOffsetAT45DB == kWarpSizeAT45DBBufferSize)
+	{
+		/*
+		 *	As in writeToAT45DBFromEndBuffered(): program the full buffer into
+		 *	its page and carry on in the other buffer while that happens.
+		 */
+		closeStreamAT45DB();
+
+		streamStatusAT45DB = waitForDeviceReady(0, kWarpAT45DBPageEraseProgramMaxMilliseconds);
+		if (streamStatusAT45DB != kWarpStatusOK)
+		{
+			return;
+		}
+
+		streamStatusAT45DB = bufferToMainMemoryWritePageAT45DB(currentBufferAT45DB);
+		if (streamStatusAT45DB != kWarpStatusOK)
+		{
+			return;
+		}
+
+		currentBufferAT45DB			= currentBufferAT45DB == bufferNumber1AT45DB ? bufferNumber2AT45DB : bufferNumber1AT45DB;
+		currentBufferOffsetAT45DB	= 0;
+	}
+}
+
+WarpStatus
+endStreamToAT45DB(void)
+{
+	closeStreamAT45DB();
+
+	return streamStatusAT45DB;
+}
+
 WarpStatus
 loadMainMemoryPageToBuffer(BufferNumberAT45DB buffer, uint16_t address)
 {
 	WarpStatus status;
 
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	if (verifyPendingAT45DB && (verifyBufferAT45DB == buffer))
+	{
+		status = finishVerifyAT45DB();
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+	}
+#endif
+
+	address = warpFlashRemapPage(address);
+
 	uint8_t opCode;
 	if (buffer == bufferNumber1AT45DB)
 	{
@@ -423,8 +742,12 @@ loadMainMemoryPageToBuffer(BufferNumberAT45DB buffer, uint16_t address)
 	ops[3] = 0x00;
 
 	status = spiTransactionAT45DB(&deviceAT45DBState, ops, 4);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
 
-	waitForDeviceReady();
+	status = waitForDeviceReady(kWarpAT45DBBufferTransferTypicalMilliseconds, kWarpAT45DBBufferTransferMaxMilliseconds);
 
 	return status;
 }
@@ -434,7 +757,13 @@ writeBufferAndSavePagePositionAT45DB()
 {
 	WarpStatus status;
 
-	status = waitForDeviceReady();
+	status = waitForDeviceReady(0, kWarpAT45DBPageEraseProgramMaxMilliseconds);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	status = finishVerifyAT45DB();
 	if (status != kWarpStatusOK)
 	{
 		return status;
@@ -450,6 +779,22 @@ writeBufferAndSavePagePositionAT45DB()
 		return status;
 	}
 
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	verifyPendingAT45DB		= true;
+	verifyBufferAT45DB		= currentBufferAT45DB;
+	verifyPageNumberAT45DB	= currentPageNumberAT45DB;
+#endif
+
+	/*
+	 *	The page position is itself programmed through a buffer, so the page
+	 *	program above has to finish first.
+	 */
+	status = waitForDeviceReady(kWarpAT45DBPageEraseProgramTypicalMilliseconds, kWarpAT45DBPageEraseProgramMaxMilliseconds);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
 	currentPageOffsetAT45DB = currentBufferOffsetAT45DB;
 	savePagePositionAT45DB();
 
@@ -466,6 +811,17 @@ writeToBufferAT45DB(BufferNumberAT45DB buffer, uint8_t address, size_t nbyte, ui
 		return kWarpStatusBadDeviceCommand;
 	}
 
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	if (verifyPendingAT45DB && (verifyBufferAT45DB == buffer))
+	{
+		status = finishVerifyAT45DB();
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+	}
+#endif
+
 	uint8_t opCode;
 	if (buffer == bufferNumber1AT45DB)
 	{
@@ -515,11 +871,49 @@ initiateChipEraseAndWaitAT45DB()
 	WarpStatus status;
 
 	status = initiateChipEraseAT45DB();
-	status = waitForDeviceReady();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	status = waitForDeviceReady(kWarpAT45DBChipEraseTypicalMilliseconds, kWarpAT45DBChipEraseMaxMilliseconds);
 
 	return status;
 }
 
+/*
+ *	Erase the time-index pages, so that entries from before a reset are not
+ *	taken for entries of the new log.
+ */
+static WarpStatus
+eraseIndexAT45DB(void)
+{
+	WarpStatus status;
+	uint8_t ops[4] = {0};
+
+	for (uint16_t pageNumber = kWarpAT45DBIndexFirstPage; pageNumber < kWarpSizeAT45DBNPages; pageNumber++)
+	{
+		ops[0] = AT45DB_PGERASE;
+		ops[2] = (uint8_t)(pageNumber << 1);
+		ops[1] = (uint8_t)(pageNumber >> 7);
+		ops[3] = 0x00;
+
+		status = spiTransactionAT45DB(&deviceAT45DBState, ops, 4);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		status = waitForDeviceReady(kWarpAT45DBPageEraseProgramTypicalMilliseconds, kWarpAT45DBPageEraseProgramMaxMilliseconds);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+	}
+
+	return kWarpStatusOK;
+}
+
 WarpStatus
 resetAT45DB()
 {
@@ -539,7 +933,18 @@ resetAT45DB()
 	// 	return status;
 	// }
 
+	warpPrint("Erasing time index...\n");
+	status = eraseIndexAT45DB();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
 	warpPrint("Setting start offset...\n");
+	memset(&gWarpPersistentState, 0, sizeof(gWarpPersistentState));
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	verifyPendingAT45DB = false;
+#endif
 	status = setAT45DBStartPosition(kWarpInitialPageNumberAT45DB, kWarpInitialPageOffsetAT45DB);
 	if (status != kWarpStatusOK)
 	{
@@ -569,28 +974,138 @@ configurePageSize()
 	ops[3] = 0xA6;
 
 	status = spiTransactionAT45DB(&deviceAT45DBState, ops, 4);
-	waitForDeviceReady();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	/*
+	 *	Programming the configuration register takes as long as a page program.
+	 */
+	status = waitForDeviceReady(kWarpAT45DBPageEraseProgramTypicalMilliseconds, kWarpAT45DBPageEraseProgramMaxMilliseconds);
 	return status;
 }
 
 WarpStatus
-waitForDeviceReady()
+waitForDeviceReady(uint32_t typicalMilliseconds, uint32_t maximumMilliseconds)
 {
-	WarpStatus status = kWarpStatusOK;
-	uint8_t ops[3]		= {0};
+	/*
+	 *	Status Register Read (0xD7); bit 7 is RDY/BUSY, set when ready.
+	 */
+	return warpWaitForFlashReady(&deviceAT45DBState, 0xD7, 0x80, 0x80, typicalMilliseconds, maximumMilliseconds);
+}
 
-	ops[0] = 0xD7; /* RDSR (SPI Mode) */
-	ops[1] = 0x0;
-	ops[2] = 0x0;
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+/*
+ *	Compare a main memory page with a buffer on-chip (Main Memory Page to
+ *	Buffer Compare) and read the result from the COMP bit of the status
+ *	register, which is 0 when they match.
+ */
+static WarpStatus
+compareBufferAT45DB(BufferNumberAT45DB buffer, uint16_t pageNumber, bool *  match)
+{
+	WarpStatus status;
+	uint8_t ops[4] = {0};
 
-	uint8_t statusByte = 0x00;
-	while ((statusByte & 0x80) == 0)
+	status = waitForDeviceReady(0, kWarpAT45DBPageEraseProgramMaxMilliseconds);
+	if (status != kWarpStatusOK)
 	{
-		status		 = spiTransactionAT45DB(&deviceAT45DBState, ops, 3);
-		statusByte = deviceAT45DBState.spiSinkBuffer[1];
+		return status;
 	}
 
-	return status;
+	ops[0] = (buffer == bufferNumber1AT45DB) ? AT45DB_MNBF1CMP : AT45DB_MNBF2CMP;
+	ops[1] = (uint8_t)(pageNumber >> 7);
+	ops[2] = (uint8_t)(pageNumber << 1);
+	ops[3] = 0x00;
+
+	status = spiTransactionAT45DB(&deviceAT45DBState, ops, 4);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	status = waitForDeviceReady(kWarpAT45DBBufferTransferTypicalMilliseconds, kWarpAT45DBBufferTransferMaxMilliseconds);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	ops[0] = 0xD7; /* Status Register Read */
+	ops[1] = 0x00;
+
+	status = spiTransactionAT45DB(&deviceAT45DBState, ops, 2);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	*match = !(deviceAT45DBState.spiSinkBuffer[1] & AT45DB_SR_COMP);
+
+	return kWarpStatusOK;
+}
+#endif
+
+/*
+ *	Call between records, when there is idle time: check the last log page
+ *	programmed now, so that the stream does not have to when it next needs
+ *	that buffer. Records shorter than a page then only ever check a page on
+ *	the sample path if they span two page programs.
+ */
+WarpStatus
+verifyLastPageAT45DB(void)
+{
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	if (verifyPendingAT45DB && !gWarpFlashStreamOpen)
+	{
+		return finishVerifyAT45DB();
+	}
+#endif
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Check the last log page programmed against the buffer it came from. The
+ *	buffer still holds the page, so if they differ, program it into a spare
+ *	page, which reads and later writes of that page go to from then on, and
+ *	check that in turn. The new remap table is saved with the page position.
+ */
+static WarpStatus
+finishVerifyAT45DB(void)
+{
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	WarpStatus	status;
+	bool		match;
+
+	while (verifyPendingAT45DB)
+	{
+		status = compareBufferAT45DB(verifyBufferAT45DB, warpFlashRemapPage(verifyPageNumberAT45DB), &match);
+		if ((status != kWarpStatusOK) || match)
+		{
+			verifyPendingAT45DB = false;
+
+			return status;
+		}
+
+		gWarpPersistentState.errorCount = MIN(gWarpPersistentState.errorCount + 1, 0xFF);
+		if (warpFlashAddRemap(verifyPageNumberAT45DB, false) == 0)
+		{
+			verifyPendingAT45DB = false;
+
+			return kWarpStatusFlashVerifyFailed;
+		}
+
+		status = bufferToMainMemoryWriteAT45DB(verifyBufferAT45DB, verifyPageNumberAT45DB);
+		if (status != kWarpStatusOK)
+		{
+			verifyPendingAT45DB = false;
+
+			return status;
+		}
+	}
+#endif
+
+	return kWarpStatusOK;
 }
 
 WarpStatus
@@ -606,6 +1121,17 @@ bufferToMainMemoryWriteAT45DB(BufferNumberAT45DB buffer, uint16_t pageNumber)
 		return kWarpStatusFlashFull;
 	}
 
+#if (WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	/*
+	 * The built-in erase clears the whole page, so once the log has wrapped, move the tail past the oldest records first.
+	 */
+	status = warpFlashAdvanceLogTail(pageNumber, 1);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+#endif
+
 	/*
 	* We are using buffer to main memory WITH built-in erase because it makes dealing with partial buffers easier.  Furthermore, using WITHOUT built-in erase doesn't provide much of an increase in the write-rate.
 	*/
@@ -619,6 +1145,8 @@ bufferToMainMemoryWriteAT45DB(BufferNumberAT45DB buffer, uint16_t pageNumber)
 		writeOpcode = 0x86;
 	}
 
+	pageNumber = warpFlashRemapPage(pageNumber);
+
 	uint8_t ops[4] = {0};
 
 	ops[0] = writeOpcode; /* PP */
@@ -636,6 +1164,12 @@ bufferToMainMemoryWritePageAT45DB(BufferNumberAT45DB buffer)
 {
 	WarpStatus status;
 
+	status = finishVerifyAT45DB();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
 	status = bufferToMainMemoryWriteAT45DB(buffer, currentPageNumberAT45DB);
 	if (status == kWarpStatusFlashFull)
 	{
@@ -649,18 +1183,44 @@ bufferToMainMemoryWritePageAT45DB(BufferNumberAT45DB buffer)
 		return status;
 	}
 
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	verifyPendingAT45DB		= true;
+	verifyBufferAT45DB		= buffer;
+	verifyPageNumberAT45DB	= currentPageNumberAT45DB;
+#endif
+
 	currentPageNumberAT45DB += 1;
 	currentPageOffsetAT45DB = 0;
 
+#if (WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	if (currentPageNumberAT45DB == (uint16_t)(kWarpAT45DBLogEndPage))
+	{
+		/*
+		 * Wrap round to the first page. The tail starts there, and bufferToMainMemoryWriteAT45DB() moves it on ahead of the head from now on.
+		 */
+		currentPageNumberAT45DB = kWarpInitialPageNumberAT45DB;
 
-	if (currentPageNumberAT45DB == (uint16_t)(kWarpSizeAT45DBNPages)) 
+		if (gWarpPersistentState.logTailPageNumber == 0)
+		{
+			gWarpPersistentState.logTailPageNumber = kWarpInitialPageNumberAT45DB;
+			gWarpPersistentState.logTailPageOffset = kWarpInitialPageOffsetAT45DB;
+		}
+	}
+#else
+	if (currentPageNumberAT45DB == (uint16_t)(kWarpAT45DBLogEndPage)) 
 	{
 		AT45DBFull = true;
 
 		currentPageNumberAT45DB = kWarpSizeAT45DBNPages;
 		currentPageOffsetAT45DB = kWarpSizeAT45DBPageSizeBytes-1;
+
+		/*
+		 * The last page is still being programmed, and the device ignores commands until it is done.
+		 */
+		waitForDeviceReady(kWarpAT45DBPageEraseProgramTypicalMilliseconds, kWarpAT45DBPageEraseProgramMaxMilliseconds);
 		setAT45DBStartPosition(currentPageNumberAT45DB, currentPageOffsetAT45DB);
 	}
+#endif
 
 	return status;
 }
@@ -675,14 +1235,23 @@ pageProgramAT45DB(uint16_t pageNumber, size_t nbyte, uint8_t* buf)
 		return kWarpStatusBadDeviceCommand;
 	}
 
-	uint8_t opCode = 0x82;
+	status = finishVerifyAT45DB();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	/*
+	 * Go through the buffer that is not collecting log data, so as not to overwrite the start of it.
+	 */
+	uint8_t opCode = 0x85;
 	if (currentBufferAT45DB == bufferNumber1AT45DB)
 	{
-		opCode = 0x82;
+		opCode = 0x85;
 	}
 	else if (currentBufferAT45DB == bufferNumber2AT45DB)
 	{
-		opCode = 0x85;
+		opCode = 0x82;
 	}
 
 	uint8_t ops[kWarpMemoryCommonSpiBufferBytes] = {0};
@@ -703,11 +1272,11 @@ pageProgramAT45DB(uint16_t pageNumber, size_t nbyte, uint8_t* buf)
 }
 
 WarpStatus
-readMemoryAT45DB(uint16_t pageNumber, size_t nbyte, void* buf)
+readMemoryAT45DB(uint16_t pageNumber, uint8_t pageOffset, size_t nbyte, void* buf)
 {
 	WarpStatus status;
 
-	if (nbyte > kWarpSizeAT45DBPageSizeBytes)
+	if (pageOffset + nbyte > kWarpSizeAT45DBPageSizeBytes)
 	{
 		return kWarpStatusBadDeviceCommand;
 	}
@@ -715,6 +1284,8 @@ readMemoryAT45DB(uint16_t pageNumber, size_t nbyte, void* buf)
 	size_t nIterations = nbyte / (kWarpMemoryCommonSpiBufferBytes - 8);
 	size_t excessBytes = nbyte % (kWarpMemoryCommonSpiBufferBytes - 8);
 
+	pageNumber = warpFlashRemapPage(pageNumber);
+
 	uint8_t ops[kWarpMemoryCommonSpiBufferBytes] = {0};
 
 	ops[0] = 0xD2; /* NORD */
@@ -726,7 +1297,7 @@ readMemoryAT45DB(uint16_t pageNumber, size_t nbyte, void* buf)
 	{
 		// warpPrint("Reading page %d, offset: %d\n", pageNumber, i * (kWarpMemoryCommonSpiBufferBytes - 8));
 
-		ops[3] = (uint8_t)(i * (kWarpMemoryCommonSpiBufferBytes - 8));
+		ops[3] = (uint8_t)(pageOffset + i * (kWarpMemoryCommonSpiBufferBytes - 8));
 
 		status = spiTransactionAT45DB(&deviceAT45DBState, ops, kWarpMemoryCommonSpiBufferBytes);
 
@@ -742,7 +1313,7 @@ readMemoryAT45DB(uint16_t pageNumber, size_t nbyte, void* buf)
 		}
 	}
 
-	ops[3] = (uint8_t)(nIterations * (kWarpMemoryCommonSpiBufferBytes - 8));
+	ops[3] = (uint8_t)(pageOffset + nIterations * (kWarpMemoryCommonSpiBufferBytes - 8));
 
 	status = spiTransactionAT45DB(&deviceAT45DBState, ops, excessBytes + 8);
 
@@ -40,8 +40,41 @@
 #define kWarpInitialPageOffsetAT45DB	0
 #define kWarpInitialBufferOffsetAT45DB	0
 
-const uint16_t	kWarpAT45DBPageOffsetStoragePage	= 0;
-const size_t	kWarpAT45DBPageOffsetStorageSize	= 3;
+/*
+ *	The last 128 pages hold the time index, 2048 16-byte entries (see
+ *	warpFlashIndexRecordStart()). Before them are the spare pages that log
+ *	pages failing write verification are remapped to, one per remap table
+ *	entry. The log wraps before the spares.
+ */
+#define kWarpAT45DBIndexFirstPage		(kWarpSizeAT45DBNPages - 128)
+#define kWarpAT45DBIndexEntries			2048
+#define kWarpAT45DBSpareFirstPage		(kWarpAT45DBIndexFirstPage - kWarpFlashRemapTableEntries)
+#define kWarpAT45DBLogEndPage			kWarpAT45DBSpareFirstPage
+
+/*
+ *	Typical and maximum busy times in milliseconds, from the AC characteristics
+ *	in the AT45DB641E datasheet. A typical time of 0 means the operation is too
+ *	short to be worth sleeping through.
+ */
+#define kWarpAT45DBPageEraseProgramTypicalMilliseconds	17	/* tEP	*/
+#define kWarpAT45DBPageEraseProgramMaxMilliseconds		35
+#define kWarpAT45DBBufferTransferTypicalMilliseconds	0	/* tXFR	*/
+#define kWarpAT45DBBufferTransferMaxMilliseconds		1
+#define kWarpAT45DBChipEraseTypicalMilliseconds			208000	/* tCE	*/
+#define kWarpAT45DBChipEraseMaxMilliseconds				280000
+
+/*
+ *	Page 0 holds the log head (page number high and low bytes, then offset),
+ *	the ring-log tail in the same form, the remap table (page numbers high
+ *	byte first, then the pending mask and the persistent-state flags), the
+ *	error count, the sequence number (high byte first), and a CRC-16 over all
+ *	of that in the last two bytes. Older firmware only wrote the head, or
+ *	stopped with a CRC after the flags, so a bad CRC at the end falls back to
+ *	the older CRC, and a bad CRC there means no tail and no remapped pages.
+ */
+const uint16_t	kWarpAT45DBPageOffsetStoragePage			= 0;
+const size_t	kWarpAT45DBPageOffsetStorageSize			= 8 + 2*kWarpFlashRemapTableEntries + 5 + 2;
+const size_t	kWarpAT45DBPageOffsetStorageLegacySize		= 8 + 2*kWarpFlashRemapTableEntries + 2;
 
 typedef enum
 {
@@ -54,18 +87,24 @@ WarpStatus	initAT45DB(int chipSelectIoPinID, uint16_t operatingVoltageMillivolts
 WarpStatus	spiTransactionAT45DB(WarpSPIDeviceState volatile* deviceStatePointer, uint8_t ops[], size_t opCount);
 WarpStatus	saveToAT45DBFromEnd(size_t nbyte, uint8_t* buf);
 WarpStatus	setAT45DBStartPosition(uint16_t pageNumber, uint8_t pageOffset);
-WarpStatus	readMemoryAT45DB(uint16_t pageNumber, size_t nbyte, void* buf);
+WarpStatus	readMemoryAT45DB(uint16_t pageNumber, uint8_t pageOffset, size_t nbyte, void* buf);
 WarpStatus	pageProgramAT45DB(uint16_t startAddress, size_t nbyte, uint8_t* buf);
 WarpStatus	writeToAT45DBFromEndBuffered(size_t nbyte, uint8_t* buf);
+WarpStatus	beginStreamToAT45DB(void);
+void		streamByteToAT45DB(uint8_t byte);
+WarpStatus	writeIndexEntryAT45DB(uint16_t entryIndex, size_t nbyte, uint8_t *  entry);
+WarpStatus	endStreamToAT45DB(void);
 
 WarpStatus	resetAT45DB();
-WarpStatus	waitForDeviceReady();
+WarpStatus	waitForDeviceReady(uint32_t typicalMilliseconds, uint32_t maximumMilliseconds);
 WarpStatus	initiateChipEraseAndWaitAT45DB();
 WarpStatus	initiateChipEraseAT45DB();
 
 WarpStatus	configurePageSize();
 WarpStatus	savePagePositionAT45DB();
+WarpStatus	loadPagePositionAT45DB(uint16_t* pageNumber, uint8_t* pageOffset);
 WarpStatus	writeBufferAndSavePagePositionAT45DB();
+WarpStatus	verifyLastPageAT45DB(void);
 
 WarpStatus	writeToBufferAT45DB(BufferNumberAT45DB buffer, uint8_t address, size_t nbyte, uint8_t *  buf);
 WarpStatus	bufferToMainMemoryWriteAT45DB(BufferNumberAT45DB buffer, uint16_t pageNumber);
@@ -63,6 +63,78 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+/*
+ *	Calibration parameters, parsed from deviceBME680CalibrationValues[] and
+ *	the heater registers by configureSensorBME680(). Names follow Section 3
+ *	of the BME680 datasheet; members are ordered by size so the struct has
+ *	no padding.
+ */
+typedef struct
+{
+	uint16_t	parT1;
+	int16_t		parT2;
+	uint16_t	parP1;
+	int16_t		parP2;
+	int16_t		parP4;
+	int16_t		parP5;
+	int16_t		parP8;
+	int16_t		parP9;
+	uint16_t	parH1;
+	uint16_t	parH2;
+	int16_t		parGh2;
+	int8_t		parT3;
+	int8_t		parP3;
+	int8_t		parP6;
+	int8_t		parP7;
+	uint8_t		parP10;
+	int8_t		parH3;
+	int8_t		parH4;
+	int8_t		parH5;
+	uint8_t		parH6;
+	int8_t		parH7;
+	int8_t		parGh1;
+	int8_t		parGh3;
+	uint8_t		resHeatRange;
+	int8_t		resHeatVal;
+	int8_t		rangeSwitchingError;
+} WarpBME680Calibration;
+
+static WarpBME680Calibration		calibrationBME680;
+static bool							calibrationValidBME680 = false;
+
+/*
+ *	Fine temperature from the last compensateTemperatureBME680(), which
+ *	the pressure and humidity compensation depend on.
+ */
+static int32_t						temperatureFineBME680;
+
+/*
+ *	Last compensated temperature (0.01 degrees C) and humidity (0.001 %RH),
+ *	for other drivers that want the ambient conditions.
+ */
+static int16_t						lastTemperatureBME680;
+static uint32_t						lastHumidityBME680;
+static bool							lastMeasurementValidBME680 = false;
+
+/*
+ *	ctrl_hum and ctrl_meas as last configured (oversampling), and ctrl_gas_1
+ *	as last written, so it is only rewritten when the gas setting changes.
+ */
+static uint8_t						ctrlHumBME680;
+static uint8_t						ctrlMeasBME680;
+static uint8_t						ctrlGas1BME680;
+
+/*
+ *	Gas scheduling: every gasIntervalBME680 samples (0: never) one forced
+ *	measurement also runs the heater, cycling through profiles
+ *	0..heaterProfileCountBME680-1. gas_wait_x is kept to know how long the
+ *	heater runs.
+ */
+static uint8_t						gasWaitBME680[kWarpSizesBME680HeaterProfiles];
+static uint8_t						heaterProfileCountBME680	= 0;
+static uint8_t						nextHeaterProfileBME680		= 0;
+static uint8_t						gasIntervalBME680			= 0;
+static uint8_t						samplesUntilGasBME680		= 0;
 
 void
 initBME680(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts)
@@ -159,13 +231,86 @@ readSensorRegisterBME680(uint8_t deviceRegister, int numberOfBytes)
 }
 
 
+static WarpStatus
+burstReadBME680(uint8_t deviceRegister, uint8_t *  data, size_t nbyte)
+{
+	uint8_t		cmdBuf[1] = {deviceRegister};
+	i2c_status_t	status;
+
+	i2c_device_t slave =
+		{
+		.address = deviceBME680State.i2cAddress,
+		.baudRate_kbps = gWarpI2cBaudRateKbps
+	};
+
+	warpScaleSupplyVoltage(deviceBME680State.operatingVoltageMillivolts);
+	warpEnableI2Cpins();
+	status = I2C_DRV_MasterReceiveDataBlocking(
+		0 /* I2C peripheral instance */,
+		&slave,
+		cmdBuf,
+		1,
+		data,
+		nbyte,
+		gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
+	{
+		return kWarpStatusDeviceCommunicationFailed;
+	}
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Offsets into the 41 calibration bytes: 25 from 0x89 followed by 16 from
+ *	0xE1, the same layout as Bosch's reference driver.
+ */
+static void
+parseCalibrationBME680(const uint8_t *  c)
+{
+	calibrationBME680.parT1		= (uint16_t)((c[34] << 8) | c[33]);
+	calibrationBME680.parT2		= (int16_t)((c[2] << 8) | c[1]);
+	calibrationBME680.parT3		= (int8_t)c[3];
+
+	calibrationBME680.parP1		= (uint16_t)((c[6] << 8) | c[5]);
+	calibrationBME680.parP2		= (int16_t)((c[8] << 8) | c[7]);
+	calibrationBME680.parP3		= (int8_t)c[9];
+	calibrationBME680.parP4		= (int16_t)((c[12] << 8) | c[11]);
+	calibrationBME680.parP5		= (int16_t)((c[14] << 8) | c[13]);
+	calibrationBME680.parP6		= (int8_t)c[16];
+	calibrationBME680.parP7		= (int8_t)c[15];
+	calibrationBME680.parP8		= (int16_t)((c[20] << 8) | c[19]);
+	calibrationBME680.parP9		= (int16_t)((c[22] << 8) | c[21]);
+	calibrationBME680.parP10	= c[23];
+
+	/*
+	 *	par_h1 and par_h2 are 12 bits each, sharing the nibbles of 0xE2.
+	 */
+	calibrationBME680.parH1		= (uint16_t)((c[27] << 4) | (c[26] & 0x0F));
+	calibrationBME680.parH2		= (uint16_t)((c[25] << 4) | (c[26] >> 4));
+	calibrationBME680.parH3		= (int8_t)c[28];
+	calibrationBME680.parH4		= (int8_t)c[29];
+	calibrationBME680.parH5		= (int8_t)c[30];
+	calibrationBME680.parH6		= c[31];
+	calibrationBME680.parH7		= (int8_t)c[32];
+
+	calibrationBME680.parGh1	= (int8_t)c[37];
+	calibrationBME680.parGh2	= (int16_t)((c[36] << 8) | c[35]);
+	calibrationBME680.parGh3	= (int8_t)c[38];
+}
+
 WarpStatus
 configureSensorBME680(uint8_t payloadCtrl_Hum, uint8_t payloadCtrl_Meas, uint8_t payloadGas_0)
 {
-	uint8_t		reg, index = 0;
-	WarpStatus	status1, status2, status3, status4 = 0;
+	uint8_t		coefficients[kWarpSizesBME680CalibrationValuesCount];
+	uint8_t		heaterRegisters[5];
+	WarpStatus	status1, status2, status3, status4, status5;
 
 
+	ctrlHumBME680	= payloadCtrl_Hum;
+	ctrlMeasBME680	= payloadCtrl_Meas & 0xFC;
+	ctrlGas1BME680	= 0x00;
+
 	warpScaleSupplyVoltage(deviceBME680State.operatingVoltageMillivolts);
 	status1 = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Hum,
 										payloadCtrl_Hum);
@@ -175,262 +320,453 @@ configureSensorBME680(uint8_t payloadCtrl_Hum, uint8_t payloadCtrl_Meas, uint8_t
 
 	status3 = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Gas_0,
 										payloadGas_0);
+	status3 |= writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Gas_1,
+										 ctrlGas1BME680);
 
 	/*
-	 *	Read the calibration registers
+	 *	Read the calibration registers, two bursts rather than one read
+	 *	per byte, and the heater calibration from 0x00--0x04.
 	 */
-	for (reg = kWarpSensorConfigurationRegisterBME680CalibrationRegion1Start;
-		 reg < kWarpSensorConfigurationRegisterBME680CalibrationRegion1End;
-		 reg++)
+	status4 = burstReadBME680(kWarpSensorConfigurationRegisterBME680CalibrationRegion1Start,
+							  &coefficients[0],
+							  kWarpSizesBME680CalibrationRegion1Bytes);
+	status4 |= burstReadBME680(kWarpSensorConfigurationRegisterBME680CalibrationRegion2Start,
+							   &coefficients[kWarpSizesBME680CalibrationRegion1Bytes],
+							   kWarpSizesBME680CalibrationValuesCount - kWarpSizesBME680CalibrationRegion1Bytes);
+	status5 = burstReadBME680(kWarpSensorOutputRegisterBME680res_heat_val, heaterRegisters, sizeof(heaterRegisters));
+
+	for (uint8_t i = 0; i < kWarpSizesBME680CalibrationValuesCount; i++)
 	{
-		status4 |= readSensorRegisterBME680(reg, 1 /* numberOfBytes */);
-		deviceBME680CalibrationValues[index++] = deviceBME680State.i2cBuffer[0];
+		deviceBME680CalibrationValues[i] = coefficients[i];
 	}
 
-	for (reg = kWarpSensorConfigurationRegisterBME680CalibrationRegion2Start;
-		 reg < kWarpSensorConfigurationRegisterBME680CalibrationRegion2End;
-		 reg++)
+	if ((status4 == kWarpStatusOK) && (status5 == kWarpStatusOK))
 	{
-		status4 |= readSensorRegisterBME680(reg, 1 /* numberOfBytes */);
-		deviceBME680CalibrationValues[index++] = deviceBME680State.i2cBuffer[0];
+		parseCalibrationBME680(coefficients);
+		calibrationBME680.resHeatVal			= (int8_t)heaterRegisters[0];
+		calibrationBME680.resHeatRange			= (heaterRegisters[2] & 0x30) >> 4;
+		calibrationBME680.rangeSwitchingError	= ((int8_t)heaterRegisters[4]) >> 4;
+		calibrationValidBME680					= true;
 	}
 
-	return (status1 | status2 | status3 | status4);
+	return (status1 | status2 | status3 | status4 | status5);
 }
 
-
-void
-printSensorDataBME680(bool hexModeFlag)
+/*
+ *	Integer compensation, following the fixed-point formulas of Bosch's
+ *	reference driver. compensateTemperatureBME680() must run first for each
+ *	measurement, since the others use the fine temperature it leaves.
+ *	Returns 0.01 degrees C.
+ */
+int16_t
+compensateTemperatureBME680(uint32_t temperatureAdc)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	uint16_t	readSensorRegisterValueXLSB;
-	uint32_t	unsignedRawAdcValue;
-	WarpStatus	triggerStatus, i2cReadStatusMSB, i2cReadStatusLSB, i2cReadStatusXLSB;
+	int64_t		var1, var2, var3;
 
+	var1 = ((int32_t)temperatureAdc >> 3) - ((int32_t)calibrationBME680.parT1 << 1);
+	var2 = (var1 * (int32_t)calibrationBME680.parT2) >> 11;
+	var3 = ((var1 >> 1) * (var1 >> 1)) >> 12;
+	var3 = (var3 * ((int32_t)calibrationBME680.parT3 << 4)) >> 14;
+	temperatureFineBME680 = (int32_t)(var2 + var3);
 
-	warpScaleSupplyVoltage(deviceBME680State.operatingVoltageMillivolts);
+	return (int16_t)(((temperatureFineBME680 * 5) + 128) >> 8);
+}
+
+/*
+ *	Returns Pa.
+ */
+uint32_t
+compensatePressureBME680(uint32_t pressureAdc)
+{
+	int32_t		var1, var2, var3, pressure;
+	uint32_t	scaledPressure;
+
+	var1 = (temperatureFineBME680 >> 1) - 64000;
+	var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)calibrationBME680.parP6) >> 2;
+	var2 = var2 + ((var1 * (int32_t)calibrationBME680.parP5) << 1);
+	var2 = (var2 >> 2) + ((int32_t)calibrationBME680.parP4 << 16);
+	var1 = (((((var1 >> 2) * (var1 >> 2)) >> 13) * ((int32_t)calibrationBME680.parP3 << 5)) >> 3) +
+			(((int32_t)calibrationBME680.parP2 * var1) >> 1);
+	var1 = var1 >> 18;
+	var1 = ((32768 + var1) * (int32_t)calibrationBME680.parP1) >> 15;
+	if (var1 <= 0)
+	{
+		return 0;
+	}
 
 	/*
-	 *	First, trigger a measurement
+	 *	The reference driver does this step in int32_t, which overflows
+	 *	at high pressures; the difference is positive, so use uint32_t.
 	 */
-	triggerStatus = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Meas,
-															0b00100101);
-
-	i2cReadStatusMSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680press_msb, 1);
-	readSensorRegisterValueMSB = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusLSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680press_lsb, 1);
-	readSensorRegisterValueLSB = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusXLSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680press_xlsb, 1);
-	readSensorRegisterValueXLSB = deviceBME680State.i2cBuffer[0];
-	unsignedRawAdcValue =
-			((readSensorRegisterValueMSB & 0xFF)  << 12) |
-			((readSensorRegisterValueLSB & 0xFF)  << 4)  |
-		((readSensorRegisterValueXLSB & 0xF0) >> 4);
-
-	if ((triggerStatus != kWarpStatusOK) || (i2cReadStatusMSB != kWarpStatusOK) || (i2cReadStatusLSB != kWarpStatusOK) || (i2cReadStatusXLSB != kWarpStatusOK))
+	pressure = 1048576 - (int32_t)pressureAdc;
+	scaledPressure = (uint32_t)(pressure - (var2 >> 12)) * 3125;
+	if (scaledPressure >= 0x80000000)
 	{
-		warpPrint(" ----,");
+		pressure = (int32_t)((scaledPressure / (uint32_t)var1) << 1);
 	}
 	else
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB, readSensorRegisterValueXLSB);
-		}
-		else
-		{
-			warpPrint(" %u,", unsignedRawAdcValue);
-		}
+		pressure = (int32_t)((scaledPressure << 1) / (uint32_t)var1);
 	}
 
-	i2cReadStatusMSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680temp_msb, 1);
-	readSensorRegisterValueMSB = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusLSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680temp_lsb, 1);
-	readSensorRegisterValueLSB = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusXLSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680temp_xlsb, 1);
-	readSensorRegisterValueXLSB = deviceBME680State.i2cBuffer[0];
-	unsignedRawAdcValue =
-			((readSensorRegisterValueMSB & 0xFF)  << 12) |
-			((readSensorRegisterValueLSB & 0xFF)  << 4)  |
-		((readSensorRegisterValueXLSB & 0xF0) >> 4);
-	if ((triggerStatus != kWarpStatusOK) || (i2cReadStatusMSB != kWarpStatusOK) || (i2cReadStatusLSB != kWarpStatusOK) || (i2cReadStatusXLSB != kWarpStatusOK))
+	var1 = ((int32_t)calibrationBME680.parP9 * (int32_t)(((pressure >> 3) * (pressure >> 3)) >> 13)) >> 12;
+	var2 = ((int32_t)(pressure >> 2) * (int32_t)calibrationBME680.parP8) >> 13;
+
+	/*
+	 *	Also split the >> 17 of the reference driver, whose product
+	 *	overflows int32_t above ~105 kPa.
+	 */
+	var3 = ((((int32_t)(pressure >> 8) * (int32_t)(pressure >> 8) * (int32_t)(pressure >> 8)) >> 8) * (int32_t)calibrationBME680.parP10) >> 9;
+	pressure = pressure + ((var1 + var2 + var3 + ((int32_t)calibrationBME680.parP7 << 7)) >> 4);
+
+	return (uint32_t)pressure;
+}
+
+/*
+ *	Returns 0.001 %RH, clamped to 0--100 %. The reference driver's int32_t
+ *	products overflow for readings well past saturation, which then come
+ *	out as 0 %, so the terms from var3 on are 64-bit.
+ */
+uint32_t
+compensateHumidityBME680(uint16_t humidityAdc)
+{
+	int32_t		var1, var2, var4, temperatureScaled;
+	int64_t		var3, var5, var6, humidity;
+
+	temperatureScaled = ((temperatureFineBME680 * 5) + 128) >> 8;
+	var1 = (int32_t)(humidityAdc - ((int32_t)calibrationBME680.parH1 * 16)) -
+			(((temperatureScaled * (int32_t)calibrationBME680.parH3) / 100) >> 1);
+	var2 = ((int32_t)calibrationBME680.parH2 *
+			(((temperatureScaled * (int32_t)calibrationBME680.parH4) / 100) +
+			 (((temperatureScaled * ((temperatureScaled * (int32_t)calibrationBME680.parH5) / 100)) >> 6) / 100) +
+			 (1 << 14))) >> 10;
+	var3 = (int64_t)var1 * var2;
+	var4 = (int32_t)calibrationBME680.parH6 << 7;
+	var4 = (var4 + ((temperatureScaled * (int32_t)calibrationBME680.parH7) / 100)) >> 4;
+	var5 = ((var3 >> 14) * (var3 >> 14)) >> 10;
+	var6 = (var4 * var5) >> 1;
+	humidity = (((var3 + var6) >> 10) * 1000) >> 12;
+
+	if (humidity > 100000)
 	{
-		warpPrint(" ----,");
+		humidity = 100000;
 	}
-	else
+	else if (humidity < 0)
 	{
-		if (hexModeFlag)
+		humidity = 0;
+	}
+
+	return (uint32_t)humidity;
+}
+
+/*
+ *	Returns ohms, from the 10-bit gas ADC value and the 4-bit range in
+ *	gas_r_lsb.
+ */
+uint32_t
+compensateGasResistanceBME680(uint16_t gasAdc, uint8_t gasRange)
+{
+	static const uint32_t	lookupTable1[16] =
 		{
-			warpPrint(" 0x%02x 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB, readSensorRegisterValueXLSB);
-		}
-		else
+			2147483647UL, 2147483647UL, 2147483647UL, 2147483647UL,
+			2147483647UL, 2126008810UL, 2147483647UL, 2130303777UL,
+			2147483647UL, 2147483647UL, 2143188679UL, 2136746228UL,
+			2147483647UL, 2126008810UL, 2147483647UL, 2147483647UL,
+		};
+	static const uint32_t	lookupTable2[16] =
 		{
-			warpPrint(" %u,", unsignedRawAdcValue);
-		}
+			4096000000UL, 2048000000UL, 1024000000UL, 512000000UL,
+			255744255UL, 127110228UL, 64000000UL, 32258064UL,
+			16016016UL, 8000000UL, 4000000UL, 2000000UL,
+			1000000UL, 500000UL, 250000UL, 125000UL,
+		};
+	int64_t		var1, var2, var3;
+
+	gasRange &= 0x0F;
+	var1 = ((1340 + (5 * (int64_t)calibrationBME680.rangeSwitchingError)) * (int64_t)lookupTable1[gasRange]) >> 16;
+	var2 = (((int64_t)gasAdc << 15) - 16777216) + var1;
+	var3 = ((int64_t)lookupTable2[gasRange] * var1) >> 9;
+
+	return (uint32_t)((var3 + (var2 >> 1)) / var2);
+}
+
+WarpStatus
+environmentDataBME680(int16_t *  temperatureCentidegrees, uint16_t *  humidityCentipercent)
+{
+	if (!lastMeasurementValidBME680)
+	{
+		return kWarpStatusDeviceNotInitialized;
+	}
+
+	*temperatureCentidegrees	= lastTemperatureBME680;
+	*humidityCentipercent		= (uint16_t)(lastHumidityBME680 / 10);
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Set heater profile profileIndex (0--9) to heat the hot plate to
+ *	temperatureCelsius (at most 400) for durationMilliseconds (at most
+ *	4032). The heater resistance depends on the ambient temperature, taken
+ *	from the last measurement, or 25 degrees C before there is one. Uses
+ *	Bosch's integer formulas for res_heat_x and gas_wait_x.
+ */
+WarpStatus
+configureHeaterProfileBME680(uint8_t profileIndex, uint16_t temperatureCelsius, uint16_t durationMilliseconds)
+{
+	int32_t		ambientCelsius;
+	int32_t		var1, var2, var3, var4, var5;
+	uint8_t		resHeat;
+	uint8_t		gasWait;
+	uint8_t		factor = 0;
+	WarpStatus	status1, status2;
+
+	if ((profileIndex >= kWarpSizesBME680HeaterProfiles) || !calibrationValidBME680)
+	{
+		return kWarpStatusBadDeviceCommand;
 	}
 
-	i2cReadStatusMSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680hum_msb, 1);
-	readSensorRegisterValueMSB = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusLSB = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680hum_lsb, 1);
-	readSensorRegisterValueLSB = deviceBME680State.i2cBuffer[0];
-	unsignedRawAdcValue = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-	if ((triggerStatus != kWarpStatusOK) || (i2cReadStatusMSB != kWarpStatusOK) || (i2cReadStatusLSB != kWarpStatusOK))
+	if (temperatureCelsius > 400)
 	{
-		warpPrint(" ----,");
+		temperatureCelsius = 400;
+	}
+
+	ambientCelsius = lastMeasurementValidBME680 ? (lastTemperatureBME680 / 100) : 25;
+	var1 = ((ambientCelsius * calibrationBME680.parGh3) / 1000) * 256;
+	var2 = (calibrationBME680.parGh1 + 784) *
+			(((((calibrationBME680.parGh2 + 154009) * (int32_t)temperatureCelsius * 5) / 100) + 3276800) / 10);
+	var3 = var1 + (var2 / 2);
+	var4 = var3 / (calibrationBME680.resHeatRange + 4);
+	var5 = (131 * calibrationBME680.resHeatVal) + 65536;
+	resHeat = (uint8_t)(((((var4 / var5) - 250) * 34) + 50) / 100);
+
+	/*
+	 *	gas_wait_x is 6 bits of duration and a 2-bit multiplier (1, 4, 16
+	 *	or 64).
+	 */
+	if (durationMilliseconds >= 0xFC0)
+	{
+		gasWait = 0xFF;
 	}
 	else
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
+		while (durationMilliseconds > 0x3F)
 		{
-			warpPrint(" %u,", unsignedRawAdcValue);
+			durationMilliseconds /= 4;
+			factor++;
 		}
+		gasWait = (uint8_t)(durationMilliseconds + (factor * 64));
 	}
+
+	status1 = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Res_Heat_0 + profileIndex, resHeat);
+	status2 = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Gas_Wait_0 + profileIndex, gasWait);
+	if ((status1 | status2) == kWarpStatusOK)
+	{
+		gasWaitBME680[profileIndex] = gasWait;
+	}
+
+	return (status1 | status2);
 }
 
-uint8_t
-appendSensorDataBME680(uint8_t* buf)
+/*
+ *	Run a gas measurement on every gasMeasurementInterval'th sample (0 turns
+ *	gas measurements off), using heater profiles 0..numberOfProfiles-1 in
+ *	turn, which must have been set with configureHeaterProfileBME680().
+ *	The other samples measure only temperature, pressure and humidity and
+ *	leave the heater off.
+ */
+WarpStatus
+setGasScheduleBME680(uint8_t numberOfProfiles, uint8_t gasMeasurementInterval)
 {
-	uint8_t index = 0;
+	if (numberOfProfiles > kWarpSizesBME680HeaterProfiles)
+	{
+		return kWarpStatusBadDeviceCommand;
+	}
 
-	uint16_t readSensorRegisterValueLSB;
-	uint16_t readSensorRegisterValueMSB;
-	uint16_t readSensorRegisterValueXLSB;
-	uint32_t unsignedRawAdcValue;
-	WarpStatus triggerStatus, i2cReadStatusMSB, i2cReadStatusLSB, i2cReadStatusXLSB;
+	if (numberOfProfiles == 0)
+	{
+		gasMeasurementInterval = 0;
+	}
 
-	warpScaleSupplyVoltage(deviceBME680State.operatingVoltageMillivolts);
+	heaterProfileCountBME680	= numberOfProfiles;
+	nextHeaterProfileBME680		= 0;
+	gasIntervalBME680			= gasMeasurementInterval;
+	samplesUntilGasBME680		= 0;
 
 	/*
-	 *	First, trigger a measurement
+	 *	heat_off in ctrl_gas_0 would keep the heater off even when run_gas
+	 *	is set.
 	 */
-	triggerStatus               = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Meas,
-															0b00100101);
-
-	i2cReadStatusMSB            = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680press_msb, 1);
-	readSensorRegisterValueMSB  = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusLSB            = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680press_lsb, 1);
-	readSensorRegisterValueLSB  = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusXLSB           = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680press_xlsb, 1);
-	readSensorRegisterValueXLSB = deviceBME680State.i2cBuffer[0];
-	unsignedRawAdcValue =
-		((readSensorRegisterValueMSB & 0xFF) << 12) |
-		((readSensorRegisterValueLSB & 0xFF) << 4) |
-		((readSensorRegisterValueXLSB & 0xF0) >> 4);
-
-	if ((triggerStatus != kWarpStatusOK) || (i2cReadStatusMSB != kWarpStatusOK) || (i2cReadStatusLSB != kWarpStatusOK) || (i2cReadStatusXLSB != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
+	return writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Gas_0,
+									 (gasMeasurementInterval == 0) ? 0b00001000 : 0b00000000);
+}
 
-		buf[index] = 0;
-		index += 1;
+/*
+ *	Duration of a forced-mode T/P/H measurement at the configured
+ *	oversampling, from Bosch's reference driver: 1963us per oversampling
+ *	cycle, plus switching and gas conversion overhead, plus 1ms wake-up.
+ */
+static uint8_t
+measurementMillisecondsBME680(void)
+{
+	static const uint8_t	oversamplingCycles[8] = {0, 1, 2, 4, 8, 16, 16, 16};
+	uint32_t				cycles;
 
-		buf[index] = 0;
-		index += 1;
+	cycles =	oversamplingCycles[(ctrlMeasBME680 >> 5) & 0x07] +
+				oversamplingCycles[(ctrlMeasBME680 >> 2) & 0x07] +
+				oversamplingCycles[ctrlHumBME680 & 0x07];
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 24);
-		index += 1;
+	return (uint8_t)(((cycles * 1963) + (477 * 9) + 500) / 1000 + 1);
+}
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 16);
-		index += 1;
+/*
+ *	Trigger a forced-mode measurement, with a gas measurement if one is
+ *	due, sleep until it is done, read meas_status_0..gas_r_lsb in one burst
+ *	and compensate. data[] keeps the raw bytes for hex output. readings[]
+ *	are in the units logged by appendSensorDataBME680().
+ */
+static WarpStatus
+readOutputsBME680(uint8_t *  data, uint32_t *  readings)
+{
+	uint8_t		ctrlGas1 = 0x00;
+	uint8_t		profile = 0;
+	uint16_t	gasWaitMilliseconds = 0;
+	uint32_t	gasResistance;
+	WarpStatus	status;
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 8);
-		index += 1;
+	if (!calibrationValidBME680)
+	{
+		return kWarpStatusDeviceNotInitialized;
+	}
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue);
-		index += 1;
+	if (gasIntervalBME680 != 0)
+	{
+		if (samplesUntilGasBME680 == 0)
+		{
+			profile						= nextHeaterProfileBME680;
+			nextHeaterProfileBME680		= (nextHeaterProfileBME680 + 1) % heaterProfileCountBME680;
+			samplesUntilGasBME680		= gasIntervalBME680 - 1;
+			ctrlGas1					= 0x10 /* run_gas */ | profile;
+			gasWaitMilliseconds			= (gasWaitBME680[profile] & 0x3F) << (2 * (gasWaitBME680[profile] >> 6));
+		}
+		else
+		{
+			samplesUntilGasBME680--;
+		}
 	}
 
-	i2cReadStatusMSB            = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680temp_msb, 1);
-	readSensorRegisterValueMSB  = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusLSB            = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680temp_lsb, 1);
-	readSensorRegisterValueLSB  = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusXLSB           = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680temp_xlsb, 1);
-	readSensorRegisterValueXLSB = deviceBME680State.i2cBuffer[0];
-	unsignedRawAdcValue =
-		((readSensorRegisterValueMSB & 0xFF) << 12) |
-		((readSensorRegisterValueLSB & 0xFF) << 4) |
-		((readSensorRegisterValueXLSB & 0xF0) >> 4);
-	if ((triggerStatus != kWarpStatusOK) || (i2cReadStatusMSB != kWarpStatusOK) || (i2cReadStatusLSB != kWarpStatusOK) || (i2cReadStatusXLSB != kWarpStatusOK))
+	if (ctrlGas1 != ctrlGas1BME680)
 	{
-		buf[index] = 0;
-		index += 1;
+		status = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Gas_1, ctrlGas1);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+		ctrlGas1BME680 = ctrlGas1;
+	}
 
-		buf[index] = 0;
-		index += 1;
+	status = writeSensorRegisterBME680(kWarpSensorConfigurationRegisterBME680Ctrl_Meas,
+									   ctrlMeasBME680 | 0b01 /* forced mode */);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
 
-		buf[index] = 0;
-		index += 1;
+	/*
+	 *	The heater runs after the T/P/H conversions.
+	 */
+	warpSleepMilliseconds(measurementMillisecondsBME680() + gasWaitMilliseconds);
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
+	status = burstReadBME680(kWarpSensorOutputRegisterBME680meas_status_0, data, kWarpSizesBME680OutputBytes);
+	if (status != kWarpStatusOK)
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 24);
-		index += 1;
+		return status;
+	}
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 16);
-		index += 1;
+	if (!(data[0] & 0x80 /* new_data_0 */))
+	{
+		return kWarpStatusDeviceCommunicationFailed;
+	}
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 8);
-		index += 1;
+	readings[1]	= (uint32_t)(int32_t)compensateTemperatureBME680(((uint32_t)data[5] << 12) | ((uint32_t)data[6] << 4) | (data[7] >> 4));
+	readings[0]	= compensatePressureBME680(((uint32_t)data[2] << 12) | ((uint32_t)data[3] << 4) | (data[4] >> 4));
+	readings[2]	= compensateHumidityBME680(((uint16_t)data[8] << 8) | data[9]);
+	readings[3]	= 0;
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue);
-		index += 1;
+	/*
+	 *	gas_r_lsb: 2 ADC bits, gas_valid_r, heat_stab_r, then gas_range_r.
+	 */
+	if ((ctrlGas1 != 0) && ((data[14] & 0x30) == 0x30))
+	{
+		gasResistance = compensateGasResistanceBME680(((uint16_t)data[13] << 2) | (data[14] >> 6), data[14] & 0x0F);
+		if (gasResistance > 0x0FFFFFFF)
+		{
+			gasResistance = 0x0FFFFFFF;
+		}
+		readings[3] = ((uint32_t)profile << 28) | gasResistance;
 	}
 
-	i2cReadStatusMSB           = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680hum_msb, 1);
-	readSensorRegisterValueMSB = deviceBME680State.i2cBuffer[0];
-	i2cReadStatusLSB           = readSensorRegisterBME680(kWarpSensorOutputRegisterBME680hum_lsb, 1);
-	readSensorRegisterValueLSB = deviceBME680State.i2cBuffer[0];
-	unsignedRawAdcValue        = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-	if ((triggerStatus != kWarpStatusOK) || (i2cReadStatusMSB != kWarpStatusOK) || (i2cReadStatusLSB != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
+	lastTemperatureBME680		= (int16_t)readings[1];
+	lastHumidityBME680			= readings[2];
+	lastMeasurementValidBME680	= true;
+
+	return kWarpStatusOK;
+}
 
-		buf[index] = 0;
-		index += 1;
+void
+printSensorDataBME680(bool hexModeFlag)
+{
+	uint8_t		data[kWarpSizesBME680OutputBytes];
+	uint32_t	readings[4];
+	WarpStatus	i2cReadStatus;
 
-		buf[index] = 0;
-		index += 1;
+	i2cReadStatus = readOutputsBME680(data, readings);
 
-		buf[index] = 0;
-		index += 1;
+	if (i2cReadStatus != kWarpStatusOK)
+	{
+		warpPrint(" ----, ----, ----, ----,");
 	}
 	else
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 24);
-		index += 1;
+		if (hexModeFlag)
+		{
+			warpPrint(" 0x%02x 0x%02x 0x%02x,", data[2], data[3], data[4]);
+			warpPrint(" 0x%02x 0x%02x 0x%02x,", data[5], data[6], data[7]);
+			warpPrint(" 0x%02x 0x%02x,", data[8], data[9]);
+			warpPrint(" 0x%02x 0x%02x,", data[13], data[14]);
+		}
+		else
+		{
+			warpPrint(" %u, %d, %u, %u,", readings[0], (int32_t)readings[1], readings[2], readings[3]);
+		}
+	}
+}
+
+uint8_t
+appendSensorDataBME680(void)
+{
+	uint8_t		index = 0;
+	uint8_t		data[kWarpSizesBME680OutputBytes];
+	uint32_t	readings[4];
+	WarpStatus	i2cReadStatus;
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 16);
-		index += 1;
+	i2cReadStatus = readOutputsBME680(data, readings);
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue >> 8);
-		index += 1;
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		if (i2cReadStatus != kWarpStatusOK)
+		{
+			readings[i] = 0;
+		}
 
-		buf[index] = (uint8_t)(unsignedRawAdcValue);
-		index += 1;
+		/*
+		 * MSB first
+		 */
+		warpFlashStreamByte((uint8_t)(readings[i] >> 24));
+		warpFlashStreamByte((uint8_t)(readings[i] >> 16));
+		warpFlashStreamByte((uint8_t)(readings[i] >> 8));
+		warpFlashStreamByte((uint8_t)(readings[i]));
+		index += 4;
 	}
 
 	/*
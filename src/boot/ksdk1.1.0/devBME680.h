@@ -42,9 +42,22 @@ WarpStatus	configureSensorBME680(	uint8_t payloadCtrl_Hum,
 								 uint8_t payloadGas_0);
 WarpStatus	readSensorRegisterBME680(uint8_t deviceRegister, int numberOfBytes);
 void		printSensorDataBME680(bool hexModeFlag);
-uint8_t		appendSensorDataBME680(uint8_t* buf);
+uint8_t		appendSensorDataBME680(void);
 WarpStatus 	StateBME680();
+int16_t		compensateTemperatureBME680(uint32_t temperatureAdc);
+uint32_t	compensatePressureBME680(uint32_t pressureAdc);
+uint32_t	compensateHumidityBME680(uint16_t humidityAdc);
+uint32_t	compensateGasResistanceBME680(uint16_t gasAdc, uint8_t gasRange);
+WarpStatus	environmentDataBME680(int16_t *  temperatureCentidegrees, uint16_t *  humidityCentipercent);
+WarpStatus	configureHeaterProfileBME680(uint8_t profileIndex, uint16_t temperatureCelsius, uint16_t durationMilliseconds);
+WarpStatus	setGasScheduleBME680(uint8_t numberOfProfiles, uint8_t gasMeasurementInterval);
 
-const uint8_t	bytesPerMeasurementBME680				= 12;
+/*
+ *	Compensated readings: pressure in Pa, temperature in 0.01 degrees C,
+ *	relative humidity in 0.001 % and gas resistance in ohms, with the
+ *	heater profile index in the top 4 bits. Gas resistance is 0 for samples
+ *	without a (valid, heater-stable) gas measurement.
+ */
+const uint8_t	bytesPerMeasurementBME680				= 16;
 const uint8_t	bytesPerReadingBME680					= 4;
-const uint8_t	numberOfReadingsPerMeasurementBME680	= 3;
\ No newline at end of file
+const uint8_t	numberOfReadingsPerMeasurementBME680	= 4;
\ No newline at end of file
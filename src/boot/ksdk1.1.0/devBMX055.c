@@ -64,6 +64,34 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+/*
+ *	RANGE as configured: the gyroscope full scale is 2000 >> range dps.
+ *	gyroPeriodBMX055 is the gyroscope's sample period for the BW as
+ *	configured, in 1/256ths of an RTC prescaler tick (1/32768 s), and
+ *	gyroPeriodRemainderBMX055 the fraction of a tick not yet given to a
+ *	filter step, so that the steps add up to the time the frames span.
+ */
+static uint8_t						gyroRangeBMX055 = 0;
+static uint32_t						gyroPeriodBMX055 = 83886;
+static uint8_t						gyroPeriodRemainderBMX055 = 0;
+
+/*
+ *	BW values 0--7 are output data rates of 2000, 2000, 1000, 400, 200,
+ *	100, 200 and 100 Hz.
+ */
+static const uint32_t				gyroPeriodsBMX055[8] = {4194, 4194, 8389, 20972, 41943, 83886, 41943, 83886};
+#endif
+
+/*
+ *	Set once configureFifoBMX055accel() / configureFifoBMX055gyro() have put
+ *	the FIFO in stream mode, so that appendSensorDataBMX055() drains it.
+ */
+static bool							fifoAccelBMX055 = false;
+static bool							fifoGyroBMX055 = false;
+
+WarpStatus	readFifoBMX055accel(int16_t *  samples, uint8_t maxFrames, uint8_t *  framesRead);
+WarpStatus	readFifoBMX055gyro(int16_t *  samples, uint8_t maxFrames, uint8_t *  framesRead);
 
 
 /*
@@ -334,6 +362,10 @@ configureSensorBMX055gyro(uint8_t payloadRANGE, uint8_t payloadBW, uint8_t paylo
 	status1 = writeSensorRegisterBMX055gyro(kWarpSensorConfigurationRegisterBMX055gyroRANGE /* register address RANGE */,
 											payloadRANGE /* payload */
 	);
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+	gyroRangeBMX055		= payloadRANGE & 0x07;
+	gyroPeriodBMX055	= gyroPeriodsBMX055[payloadBW & 0x07];
+#endif
 
 	status2 = writeSensorRegisterBMX055gyro(kWarpSensorConfigurationRegisterBMX055gyroBW /* register address filter bandwidth */,
 											payloadBW /* payload */
@@ -389,52 +421,61 @@ readSensorRegisterBMX055gyro(uint8_t deviceRegister, int numberOfBytes)
 	return kWarpStatusOK;
 }
 
-void
-printSensorDataBMX055accel(bool hexModeFlag)
+/*
+ *	Read numberOfBytes consecutive registers in one transaction. The data
+ *	registers of all three sub-devices auto-increment, and with shadowing
+ *	enabled (ACCD_HBW, RATE_HBW) reading the LSB locks the MSB until it is
+ *	read, so a burst gives one consistent sample. The i2cBuffer of each
+ *	sub-device is too small for a burst, so the caller supplies the buffer.
+ */
+static WarpStatus
+burstReadBMX055(volatile WarpI2CDeviceState *  deviceState, uint8_t deviceRegister, uint8_t *  buffer, size_t numberOfBytes)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
-	WarpStatus	i2cReadStatus;
+	uint8_t			cmdBuf[1] = {0xFF};
+	i2c_status_t	status;
 
+	i2c_device_t slave =
+		{
+		.address = deviceState->i2cAddress,
+		.baudRate_kbps = gWarpI2cBaudRateKbps
+	};
 
-	warpScaleSupplyVoltage(deviceBMX055accelState.operatingVoltageMillivolts);
-	i2cReadStatus = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_X_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055accelState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055accelState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 4) | (readSensorRegisterValueLSB >> 4);
+	cmdBuf[0] = deviceRegister;
 
-	/*
-	 *	Sign extend the 12-bit value based on knowledge that upper 4 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 11)) - (1 << 11);
+	warpScaleSupplyVoltage(deviceState->operatingVoltageMillivolts);
+	warpEnableI2Cpins();
+	status = I2C_DRV_MasterReceiveDataBlocking(
+		0 /* I2C peripheral instance */,
+		&slave,
+		cmdBuf,
+		1,
+		buffer,
+		numberOfBytes,
+		gWarpI2cTimeoutMilliseconds);
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
+	if (status != kStatus_I2C_Success)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		return kWarpStatusDeviceCommunicationFailed;
 	}
 
-	i2cReadStatus = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_Y_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055accelState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055accelState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 4) | (readSensorRegisterValueLSB >> 4);
+	return kWarpStatusOK;
+}
 
-	/*
-	 *	Sign extend the 12-bit value based on knowledge that upper 4 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 11)) - (1 << 11);
+/*
+ *	The value of an LSB/MSB register pair whose top significantBits bits
+ *	hold a two's complement reading, sign extended.
+ */
+static int16_t
+combineBMX055(const uint8_t *  lsbMsb, uint8_t significantBits)
+{
+	int32_t	value = ((lsbMsb[1] << 8) | lsbMsb[0]) >> (16 - significantBits);
 
+	return (value ^ (1 << (significantBits - 1))) - (1 << (significantBits - 1));
+}
+
+static void
+printReadingBMX055(WarpStatus i2cReadStatus, bool hexModeFlag, const uint8_t *  lsbMsb, uint8_t significantBits)
+{
 	if (i2cReadStatus != kWarpStatusOK)
 	{
 		warpPrint(" ----,");
@@ -443,83 +484,92 @@ printSensorDataBMX055accel(bool hexModeFlag)
 	{
 		if (hexModeFlag)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
+			warpPrint(" 0x%02x 0x%02x,", lsbMsb[1], lsbMsb[0]);
 		}
 		else
 		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			warpPrint(" %d,", combineBMX055(lsbMsb, significantBits));
 		}
 	}
+}
 
-	i2cReadStatus = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_Z_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055accelState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055accelState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 4) | (readSensorRegisterValueLSB >> 4);
+static uint8_t
+streamReadingBMX055(WarpStatus i2cReadStatus, int16_t reading)
+{
+	if (i2cReadStatus != kWarpStatusOK)
+	{
+		reading = 0;
+	}
 
 	/*
-	 *	Sign extend the 12-bit value based on knowledge that upper 4 bit are 0:
+	 * MSB first
 	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 11)) - (1 << 11);
+	warpFlashStreamByte((uint8_t)(reading >> 8));
+	warpFlashStreamByte((uint8_t)(reading));
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
+	return 2;
+}
+
+/*
+ *	Significant bits of the X, Y, Z and RHALL registers of the magnetometer.
+ */
+static const uint8_t	magSignificantBitsBMX055[4] = {13, 13, 15, 14};
+
+/*
+ *	X, Y and Z are taken from fifoMean instead of data when it is not NULL;
+ *	the temperature always comes from data.
+ */
+static uint8_t
+streamAccelBMX055(WarpStatus i2cReadStatus, const uint8_t *  data, const int16_t *  fifoMean)
+{
+	uint8_t index = 0;
+
+	for (uint8_t i = 0; i < 3; i++)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		index += streamReadingBMX055(i2cReadStatus, (fifoMean != NULL) ? fifoMean[i] : combineBMX055(&data[2 * i], 12));
 	}
+	index += streamReadingBMX055(i2cReadStatus, (int8_t)data[6]);
 
-	i2cReadStatus = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_TEMP, 1 /* numberOfBytes */);
-	readSensorRegisterValueCombined = deviceBMX055accelState.i2cBuffer[0];
+	return index;
+}
 
-	/*
-	 *	Sign extend the 8-bit value based on knowledge that upper 8 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 7)) - (1 << 7);
+static uint8_t
+streamMagBMX055(WarpStatus i2cReadStatus, const uint8_t *  data)
+{
+	uint8_t index = 0;
 
-	if (i2cReadStatus != kWarpStatusOK)
+	for (uint8_t i = 0; i < 4; i++)
 	{
-		warpPrint(" ----,");
+		index += streamReadingBMX055(i2cReadStatus, combineBMX055(&data[2 * i], magSignificantBitsBMX055[i]));
 	}
-	else
+
+	return index;
+}
+
+static uint8_t
+streamGyroBMX055(WarpStatus i2cReadStatus, const uint8_t *  data, const int16_t *  fifoMean)
+{
+	uint8_t index = 0;
+
+	for (uint8_t i = 0; i < 3; i++)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x,", readSensorRegisterValueCombined);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		index += streamReadingBMX055(i2cReadStatus, (fifoMean != NULL) ? fifoMean[i] : combineBMX055(&data[2 * i], 16));
 	}
+
+	return index;
 }
 
 void
-printSensorDataBMX055gyro(bool hexModeFlag)
+printSensorDataBMX055accel(bool hexModeFlag)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
+	uint8_t		data[kWarpSizesBMX055accelBurstBytes];
 	WarpStatus	i2cReadStatus;
 
-
-	warpScaleSupplyVoltage(deviceBMX055gyroState.operatingVoltageMillivolts);
-	i2cReadStatus = readSensorRegisterBMX055gyro(kWarpSensorOutputRegisterBMX055gyroRATE_X_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055gyroState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055gyroState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+	i2cReadStatus = burstReadBMX055(&deviceBMX055accelState, kWarpSensorOutputRegisterBMX055accelACCD_X_LSB, data, sizeof(data));
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		printReadingBMX055(i2cReadStatus, hexModeFlag, &data[2 * i], 12);
+	}
 
 	if (i2cReadStatus != kWarpStatusOK)
 	{
@@ -529,543 +579,609 @@ printSensorDataBMX055gyro(bool hexModeFlag)
 	{
 		if (hexModeFlag)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
+			warpPrint(" 0x%02x,", data[6]);
 		}
 		else
 		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			warpPrint(" %d,", (int8_t)data[6]);
 		}
 	}
+}
 
-	i2cReadStatus = readSensorRegisterBMX055gyro(kWarpSensorOutputRegisterBMX055gyroRATE_Y_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055gyroState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055gyroState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+void
+printSensorDataBMX055gyro(bool hexModeFlag)
+{
+	uint8_t		data[kWarpSizesBMX055gyroBurstBytes];
+	WarpStatus	i2cReadStatus;
 
-	if (i2cReadStatus != kWarpStatusOK)
+	i2cReadStatus = burstReadBMX055(&deviceBMX055gyroState, kWarpSensorOutputRegisterBMX055gyroRATE_X_LSB, data, sizeof(data));
+	for (uint8_t i = 0; i < 3; i++)
 	{
-		warpPrint(" ----,");
+		printReadingBMX055(i2cReadStatus, hexModeFlag, &data[2 * i], 16);
 	}
-	else
+}
+
+void
+printSensorDataBMX055mag(bool hexModeFlag)
+{
+	uint8_t		data[kWarpSizesBMX055magBurstBytes];
+	WarpStatus	i2cReadStatus;
+
+	i2cReadStatus = burstReadBMX055(&deviceBMX055magState, kWarpSensorOutputRegisterBMX055magX_LSB, data, sizeof(data));
+	for (uint8_t i = 0; i < 4; i++)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		printReadingBMX055(i2cReadStatus, hexModeFlag, &data[2 * i], magSignificantBitsBMX055[i]);
 	}
+}
 
-	i2cReadStatus = readSensorRegisterBMX055gyro(kWarpSensorOutputRegisterBMX055gyroRATE_Z_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055gyroState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055gyroState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+uint8_t
+appendSensorDataBMX055accel(void)
+{
+	uint8_t		data[kWarpSizesBMX055accelBurstBytes];
+	WarpStatus	i2cReadStatus;
 
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+	i2cReadStatus = burstReadBMX055(&deviceBMX055accelState, kWarpSensorOutputRegisterBMX055accelACCD_X_LSB, data, sizeof(data));
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
-	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
-	}
+	return streamAccelBMX055(i2cReadStatus, data, NULL);
 }
 
-void
-printSensorDataBMX055mag(bool hexModeFlag)
+uint8_t
+appendSensorDataBMX055gyro(void)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
+	uint8_t		data[kWarpSizesBMX055gyroBurstBytes];
 	WarpStatus	i2cReadStatus;
 
+	i2cReadStatus = burstReadBMX055(&deviceBMX055gyroState, kWarpSensorOutputRegisterBMX055gyroRATE_X_LSB, data, sizeof(data));
 
-	warpScaleSupplyVoltage(deviceBMX055magState.operatingVoltageMillivolts);
-	i2cReadStatus = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magX_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 5) | (readSensorRegisterValueLSB >> 3);
+	return streamGyroBMX055(i2cReadStatus, data, NULL);
+}
 
-	/*
-	 *	Sign extend the 13-bit value based on knowledge that upper 3 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 12)) - (1 << 12);
+uint8_t
+appendSensorDataBMX055mag(void)
+{
+	uint8_t		data[kWarpSizesBMX055magBurstBytes];
+	WarpStatus	i2cReadStatus;
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
-	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
-	}
+	i2cReadStatus = burstReadBMX055(&deviceBMX055magState, kWarpSensorOutputRegisterBMX055magX_LSB, data, sizeof(data));
 
-	i2cReadStatus = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magY_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 5) | (readSensorRegisterValueLSB >> 3);
+	return streamMagBMX055(i2cReadStatus, data);
+}
 
-	/*
-	 *	Sign extend the 13-bit value based on knowledge that upper 4 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 12)) - (1 << 12);
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+/*
+ *	Fixed-point Mahony AHRS on the raw accelerometer, gyroscope and
+ *	magnetometer readings. The quaternion, vectors and errors are Q30; the
+ *	Cortex-M0+ has neither an FPU nor a divider, so products go through
+ *	64-bit multiplies and normalisation uses Newton's method for 1/sqrt.
+ */
+static int32_t		quaternionAhrsBMX055[4] = {1 << 30, 0, 0, 0};
+static int32_t		integralAhrsBMX055[3];
+static uint32_t		rtcTicksAhrsBMX055;
 
-	if (i2cReadStatus != kWarpStatusOK)
+static int32_t
+mulAhrsBMX055(int32_t a, int32_t b)
+{
+	return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+/*
+ *	Scale v[0..n-1] to a Q30 unit vector. Returns false for a zero vector.
+ */
+static bool
+normalizeAhrsBMX055(int32_t *  v, uint8_t n)
+{
+	uint64_t	x = 0;
+	int64_t		y;
+	int8_t		e = 0;
+
+	for (uint8_t i = 0; i < n; i++)
 	{
-		warpPrint(" ----,");
+		x += (int64_t)v[i] * v[i];
 	}
-	else
+
+	if (x == 0)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		return false;
 	}
 
-	i2cReadStatus = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magZ_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 7) | (readSensorRegisterValueLSB >> 1);
-
 	/*
-	 *	Sign extend the 15-bit value based on knowledge that upper 1 bit are 0:
+	 *	|v|^2 = x * 4^e with x, as Q30, in [0.25, 1), where a linear first
+	 *	guess is within 15% of 1/sqrt(x) and four iterations reach Q30.
 	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 14)) - (1 << 14);
-
-	if (i2cReadStatus != kWarpStatusOK)
+	while (x >= (1ULL << 30))
 	{
-		warpPrint(" ----,");
+		x >>= 2;
+		e++;
 	}
-	else
+	while (x < (1ULL << 28))
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		x <<= 2;
+		e--;
 	}
 
-	i2cReadStatus = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magRHALL_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 6) | (readSensorRegisterValueLSB >> 2);
-
-	/*
-	 *	Sign extend the 14-bit value based on knowledge that upper 2 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 13)) - (1 << 13);
-
-	if (i2cReadStatus != kWarpStatusOK)
+	y = 2362232013LL - (((int64_t)x * 1288490189LL) >> 30);
+	for (uint8_t i = 0; i < 4; i++)
 	{
-		warpPrint(" ----,");
+		int64_t	xy2 = ((int64_t)x * ((y * y) >> 30)) >> 30;
+
+		y = (y * ((3LL << 30) - xy2)) >> 31;
 	}
-	else
+
+	for (uint8_t i = 0; i < n; i++)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		v[i] = (int32_t)(((int64_t)v[i] * y) >> (15 + e));
 	}
+
+	return true;
 }
 
-uint8_t
-appendSensorDataBMX055accel(uint8_t* buf)
+/*
+ *	RTC time in prescaler ticks (1/32768 s). It wraps, but differences
+ *	between calls are still right.
+ */
+static uint32_t
+rtcTicksBMX055(void)
 {
-	uint8_t index = 0;
-
-	uint16_t 	readSensorRegisterValueLSB;
-	uint16_t 	readSensorRegisterValueMSB;
-	int16_t 	readSensorRegisterValueCombined;
-	WarpStatus 	i2cReadStatus;
-
-	warpScaleSupplyVoltage(deviceBMX055accelState.operatingVoltageMillivolts);
-	i2cReadStatus                   = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_X_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055accelState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055accelState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 4) | (readSensorRegisterValueLSB >> 4);
-
-	/*
-	 *	Sign extend the 12-bit value based on knowledge that upper 4 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 11)) - (1 << 11);
+	return (RTC->TSR << 15) | RTC->TPR;
+}
 
-	if (i2cReadStatus != kWarpStatusOK)
+void
+initAhrsBMX055(void)
+{
+	rtcTicksAhrsBMX055 = rtcTicksBMX055();
+	quaternionAhrsBMX055[0] = 1 << 30;
+	for (uint8_t i = 0; i < 3; i++)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		quaternionAhrsBMX055[i + 1]	= 0;
+		integralAhrsBMX055[i]		= 0;
 	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+}
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+/*
+ *	One filter step from readings taken elapsedTicks RTC prescaler ticks
+ *	(1/32768 s) after the previous ones. accel and gyro are X, Y, Z as
+ *	logged; mag may be NULL. Steps longer than
+ *	kWarpBMX055AhrsMaxStepTicks are clamped; appendSensorDataBMX055()
+ *	steps once per gyroscope FIFO frame, so this only matters when the
+ *	FIFO is not in use.
+ */
+void
+updateAhrsBMX055(const int16_t *  accel, const int16_t *  gyro, const int16_t *  mag, uint32_t elapsedTicks)
+{
+	int32_t		a[3], m[3], b[2], e[3] = {0, 0, 0}, g[3], t[4];
+	int32_t *	q = quaternionAhrsBMX055;
+	int32_t		q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
+	int32_t		hx, hy, bx, bz;
+	int32_t		halfvx, halfvy, halfvz, halfwx, halfwy, halfwz;
+	const int32_t	half = 1 << 29;
+
+	if (elapsedTicks > kWarpBMX055AhrsMaxStepTicks)
+	{
+		elapsedTicks = kWarpBMX055AhrsMaxStepTicks;
 	}
 
-	i2cReadStatus                   = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_Y_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055accelState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055accelState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 4) | (readSensorRegisterValueLSB >> 4);
-
-	/*
-	 *	Sign extend the 12-bit value based on knowledge that upper 4 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 11)) - (1 << 11);
-
-	if (i2cReadStatus != kWarpStatusOK)
+	for (uint8_t i = 0; i < 3; i++)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		a[i] = accel[i];
+		m[i] = (mag != NULL) ? mag[i] : 0;
 	}
-	else
+
+	if (normalizeAhrsBMX055(a, 3))
 	{
+		q0q0 = mulAhrsBMX055(q[0], q[0]);
+		q0q1 = mulAhrsBMX055(q[0], q[1]);
+		q0q2 = mulAhrsBMX055(q[0], q[2]);
+		q0q3 = mulAhrsBMX055(q[0], q[3]);
+		q1q1 = mulAhrsBMX055(q[1], q[1]);
+		q1q2 = mulAhrsBMX055(q[1], q[2]);
+		q1q3 = mulAhrsBMX055(q[1], q[3]);
+		q2q2 = mulAhrsBMX055(q[2], q[2]);
+		q2q3 = mulAhrsBMX055(q[2], q[3]);
+		q3q3 = mulAhrsBMX055(q[3], q[3]);
+
 		/*
-		 * MSB first
+		 *	Half the estimated direction of gravity; the error is its
+		 *	cross product with the measured direction.
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+		halfvx = q1q3 - q0q2;
+		halfvy = q0q1 + q2q3;
+		halfvz = q0q0 - half + q3q3;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
+		e[0] = mulAhrsBMX055(a[1], halfvz) - mulAhrsBMX055(a[2], halfvy);
+		e[1] = mulAhrsBMX055(a[2], halfvx) - mulAhrsBMX055(a[0], halfvz);
+		e[2] = mulAhrsBMX055(a[0], halfvy) - mulAhrsBMX055(a[1], halfvx);
 
-	i2cReadStatus                   = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_Z_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055accelState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055accelState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 4) | (readSensorRegisterValueLSB >> 4);
+		if (normalizeAhrsBMX055(m, 3))
+		{
+			/*
+			 *	The Earth's field in the Earth frame, rotated so it has no
+			 *	east component, then back into the sensor frame.
+			 */
+			hx = 2 * (mulAhrsBMX055(m[0], half - q2q2 - q3q3) + mulAhrsBMX055(m[1], q1q2 - q0q3) + mulAhrsBMX055(m[2], q1q3 + q0q2));
+			hy = 2 * (mulAhrsBMX055(m[0], q1q2 + q0q3) + mulAhrsBMX055(m[1], half - q1q1 - q3q3) + mulAhrsBMX055(m[2], q2q3 - q0q1));
+			bz = 2 * (mulAhrsBMX055(m[0], q1q3 - q0q2) + mulAhrsBMX055(m[1], q2q3 + q0q1) + mulAhrsBMX055(m[2], half - q1q1 - q2q2));
+
+			b[0] = hx;
+			b[1] = hy;
+			bx = normalizeAhrsBMX055(b, 2) ? (mulAhrsBMX055(hx, b[0]) + mulAhrsBMX055(hy, b[1])) : 0;
+
+			halfwx = mulAhrsBMX055(bx, half - q2q2 - q3q3) + mulAhrsBMX055(bz, q1q3 - q0q2);
+			halfwy = mulAhrsBMX055(bx, q1q2 - q0q3) + mulAhrsBMX055(bz, q0q1 + q2q3);
+			halfwz = mulAhrsBMX055(bx, q0q2 + q1q3) + mulAhrsBMX055(bz, half - q1q1 - q2q2);
+
+			e[0] += mulAhrsBMX055(m[1], halfwz) - mulAhrsBMX055(m[2], halfwy);
+			e[1] += mulAhrsBMX055(m[2], halfwx) - mulAhrsBMX055(m[0], halfwz);
+			e[2] += mulAhrsBMX055(m[0], halfwy) - mulAhrsBMX055(m[1], halfwx);
+		}
+	}
 
 	/*
-	 *	Sign extend the 12-bit value based on knowledge that upper 4 bit are 0:
+	 *	Angular rate in Q30 rad/s: full scale is 2000 >> range dps, and
+	 *	pi / 180 * 2^30 / 2^15 is 572. Half of it times the step, in Q30
+	 *	radians, rotates the quaternion.
 	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 11)) - (1 << 11);
-
-	if (i2cReadStatus != kWarpStatusOK)
+	for (uint8_t i = 0; i < 3; i++)
 	{
-		buf[index] = 0;
-		index += 1;
+		int64_t	omega;
 
-		buf[index] = 0;
-		index += 1;
+		integralAhrsBMX055[i] += (int32_t)(((int64_t)e[i] * kWarpBMX055AhrsTwoKiQ8 * elapsedTicks) >> (8 + 15));
+		omega = (int64_t)gyro[i] * (2000 >> gyroRangeBMX055) * 572
+				+ (((int64_t)e[i] * kWarpBMX055AhrsTwoKpQ8) >> 8)
+				+ integralAhrsBMX055[i];
+		g[i] = (int32_t)((omega * elapsedTicks) >> 16);
 	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
-
-	i2cReadStatus                   = readSensorRegisterBMX055accel(kWarpSensorOutputRegisterBMX055accelACCD_TEMP, 1 /* numberOfBytes */);
-	readSensorRegisterValueCombined = deviceBMX055accelState.i2cBuffer[0];
 
 	/*
-	 *	Sign extend the 8-bit value based on knowledge that upper 8 bit are 0:
+	 *	Scaled down by 4 so the sums fit; normalising restores Q30.
 	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 7)) - (1 << 7);
+	t[0] = (int32_t)(((int64_t)q[0] - mulAhrsBMX055(q[1], g[0]) - mulAhrsBMX055(q[2], g[1]) - mulAhrsBMX055(q[3], g[2])) >> 2);
+	t[1] = (int32_t)(((int64_t)q[1] + mulAhrsBMX055(q[0], g[0]) + mulAhrsBMX055(q[2], g[2]) - mulAhrsBMX055(q[3], g[1])) >> 2);
+	t[2] = (int32_t)(((int64_t)q[2] + mulAhrsBMX055(q[0], g[1]) - mulAhrsBMX055(q[1], g[2]) + mulAhrsBMX055(q[3], g[0])) >> 2);
+	t[3] = (int32_t)(((int64_t)q[3] + mulAhrsBMX055(q[0], g[2]) + mulAhrsBMX055(q[1], g[1]) - mulAhrsBMX055(q[2], g[0])) >> 2);
 
-	if (i2cReadStatus != kWarpStatusOK)
+	if (normalizeAhrsBMX055(t, 4))
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		for (uint8_t i = 0; i < 4; i++)
+		{
+			q[i] = t[i];
+		}
 	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+}
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+/*
+ *	The orientation quaternion W, X, Y, Z in Q14.
+ */
+void
+getQuaternionAhrsBMX055(int16_t *  quaternion)
+{
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		quaternion[i] = (int16_t)((quaternionAhrsBMX055[i] + (1 << 15)) >> 16);
 	}
-
-	return index;
 }
 
-uint8_t
-appendSensorDataBMX055gyro(uint8_t* buf)
+/*
+ *	Step the filter once for each frame in the gyroscope FIFO, read
+ *	kWarpSizesBMX055FifoBurstFrames frames at a time, by the gyroscope's
+ *	sample period, with the same accel and mag for every frame. Returns the
+ *	number of frames used. The FIFO holds kWarpSizesBMX055gyroFifoFrames
+ *	frames (one second at 100 Hz); records further apart than that lose the
+ *	rotation in the frames it dropped.
+ */
+static uint16_t
+updateAhrsFromFifoBMX055(const int16_t *  accel, const int16_t *  mag)
 {
-	uint8_t index = 0;
+	int16_t		samples[3 * kWarpSizesBMX055FifoBurstFrames];
+	uint16_t	frames = 0;
+	uint32_t	stepTicks;
+	uint8_t		framesRead;
 
-	uint16_t 	readSensorRegisterValueLSB;
-	uint16_t 	readSensorRegisterValueMSB;
-	int16_t 	readSensorRegisterValueCombined;
-	WarpStatus 	i2cReadStatus;
+	do
+	{
+		if (readFifoBMX055gyro(samples, MIN(kWarpSizesBMX055FifoBurstFrames, kWarpSizesBMX055gyroFifoFrames - frames), &framesRead) != kWarpStatusOK)
+		{
+			break;
+		}
 
-	warpScaleSupplyVoltage(deviceBMX055gyroState.operatingVoltageMillivolts);
-	i2cReadStatus                   = readSensorRegisterBMX055gyro(kWarpSensorOutputRegisterBMX055gyroRATE_X_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055gyroState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055gyroState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+		for (uint8_t i = 0; i < framesRead; i++)
+		{
+			stepTicks					= gyroPeriodBMX055 + gyroPeriodRemainderBMX055;
+			gyroPeriodRemainderBMX055	= (uint8_t)stepTicks;
+			updateAhrsBMX055(accel, &samples[3 * i], mag, stepTicks >> 8);
+		}
+		frames += framesRead;
+	}
+	while ((framesRead == kWarpSizesBMX055FifoBurstFrames) && (frames < kWarpSizesBMX055gyroFifoFrames));
 
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+	return frames;
+}
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
+/*
+ *	Feed the readings taken for one record to the filter. accelMean, if not
+ *	NULL, replaces the accelerometer data registers. With the gyroscope FIFO
+ *	configured, each frame collected since the last record is one step at
+ *	the gyroscope's output data rate; otherwise, or if no frame has arrived,
+ *	the data registers are one step over the RTC time since the last
+ *	update. The magnetometer is used when it could be read; its axes are
+ *	taken to be those of the accelerometer and gyroscope, uncompensated and
+ *	without hard-iron correction.
+ */
+static WarpStatus
+updateAhrsFromReadingsBMX055(WarpStatus accelStatus, WarpStatus magStatus, WarpStatus gyroStatus,
+							 const uint8_t *  accelData, const uint8_t *  magData, const uint8_t *  gyroData, const int16_t *  accelMean)
+{
+	int16_t			accel[3], mag[3], gyro[3];
+	const int16_t *	magUsed = (magStatus == kWarpStatusOK) ? mag : NULL;
+	uint32_t		ticks = rtcTicksBMX055();
+	uint16_t		frames = 0;
+	WarpStatus		status = (accelMean != NULL) ? kWarpStatusOK : accelStatus;
 
-		buf[index] = 0;
-		index += 1;
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		accel[i]	= (accelMean != NULL) ? accelMean[i] : combineBMX055(&accelData[2 * i], 12);
+		mag[i]		= combineBMX055(&magData[2 * i], magSignificantBitsBMX055[i]);
+		gyro[i]		= combineBMX055(&gyroData[2 * i], 16);
 	}
-	else
+
+	if ((status == kWarpStatusOK) && fifoGyroBMX055)
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+		frames = updateAhrsFromFifoBMX055(accel, magUsed);
+	}
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+	if (frames == 0)
+	{
+		status |= gyroStatus;
+		if (status == kWarpStatusOK)
+		{
+			updateAhrsBMX055(accel, gyro, magUsed, ticks - rtcTicksAhrsBMX055);
+		}
 	}
+	rtcTicksAhrsBMX055 = ticks;
 
-	i2cReadStatus                   = readSensorRegisterBMX055gyro(kWarpSensorOutputRegisterBMX055gyroRATE_Y_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055gyroState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055gyroState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+	return status;
+}
 
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+/*
+ *	Append the quaternion instead of the nine raw channels.
+ */
+static uint8_t
+streamAhrsBMX055(WarpStatus status)
+{
+	int16_t		quaternion[4] = {0, 0, 0, 0};
+	uint8_t		index = 0;
 
-	if (i2cReadStatus != kWarpStatusOK)
+	if (status == kWarpStatusOK)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		getQuaternionAhrsBMX055(quaternion);
 	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		index += streamReadingBMX055(status, quaternion[i]);
 	}
 
-	i2cReadStatus                   = readSensorRegisterBMX055gyro(kWarpSensorOutputRegisterBMX055gyroRATE_Z_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055gyroState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055gyroState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+	return index;
+}
+#endif
 
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+/*
+ *	Empty a FIFO kWarpSizesBMX055FifoBurstFrames frames at a time, taking at
+ *	most depthFrames so that a FIFO filling as fast as it is read cannot
+ *	keep us here, and average the X/Y/Z frames it held. Returns the number
+ *	of frames averaged, 0 if the FIFO was empty or could not be read.
+ */
+static uint16_t
+meanFifoBMX055(WarpStatus (*readFifo)(int16_t *, uint8_t, uint8_t *), uint8_t depthFrames, int16_t *  mean)
+{
+	int16_t		samples[3 * kWarpSizesBMX055FifoBurstFrames];
+	int32_t		sum[3] = {0, 0, 0};
+	uint16_t	frames = 0;
+	uint8_t		framesRead;
 
-	if (i2cReadStatus != kWarpStatusOK)
+	do
 	{
-		buf[index] = 0;
-		index += 1;
+		if (readFifo(samples, MIN(kWarpSizesBMX055FifoBurstFrames, depthFrames - frames), &framesRead) != kWarpStatusOK)
+		{
+			return 0;
+		}
 
-		buf[index] = 0;
-		index += 1;
+		for (uint8_t i = 0; i < framesRead; i++)
+		{
+			for (uint8_t j = 0; j < 3; j++)
+			{
+				sum[j] += samples[3 * i + j];
+			}
+		}
+		frames += framesRead;
 	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+	while ((framesRead == kWarpSizesBMX055FifoBurstFrames) && (frames < depthFrames));
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+	for (uint8_t j = 0; (frames != 0) && (j < 3); j++)
+	{
+		mean[j] = sum[j] / frames;
 	}
 
-	return index;
+	return frames;
 }
 
+/*
+ *	Append accelerometer, magnetometer and gyroscope readings in that order,
+ *	or with WARP_BUILD_ENABLE_BMX055_AHRS, the orientation quaternion they
+ *	update.
+ *	All three are read, back to back in one bus session, before any of them
+ *	goes to the flash, so that the nine axes are sampled as close together
+ *	as the bus allows and share the record's timestamp.
+ *	With the FIFOs configured, the accelerometer and gyroscope X, Y and Z
+ *	are instead the mean of the frames collected since the last record, so
+ *	that records further apart than the sample period still use every
+ *	sample. If no frame has arrived since, the data registers are used.
+ *	With WARP_BUILD_ENABLE_BMX055_AHRS the gyroscope frames are not
+ *	averaged but each integrated by the filter, in the same bus session.
+ */
 uint8_t
-appendSensorDataBMX055mag(uint8_t* buf)
+appendSensorDataBMX055(void)
 {
-	uint8_t index = 0;
-
-	uint16_t 	readSensorRegisterValueLSB;
-	uint16_t 	readSensorRegisterValueMSB;
-	int16_t 	readSensorRegisterValueCombined;
-	WarpStatus 	i2cReadStatus;
-
-	warpScaleSupplyVoltage(deviceBMX055magState.operatingVoltageMillivolts);
-	i2cReadStatus                   = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magX_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 5) | (readSensorRegisterValueLSB >> 3);
-
-	/*
-	 *	Sign extend the 13-bit value based on knowledge that upper 3 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 12)) - (1 << 12);
-
-	if (i2cReadStatus != kWarpStatusOK)
+	uint8_t		accelData[kWarpSizesBMX055accelBurstBytes];
+	uint8_t		magData[kWarpSizesBMX055magBurstBytes];
+	uint8_t		gyroData[kWarpSizesBMX055gyroBurstBytes];
+	WarpStatus	accelStatus, magStatus, gyroStatus;
+	uint8_t		index = 0;
+	int16_t		accelMean[3];
+	uint16_t	accelFrames = 0;
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+	WarpStatus	ahrsStatus;
+#else
+	int16_t		gyroMean[3];
+	uint16_t	gyroFrames = 0;
+#endif
+
+	warpAcquireI2cBus(gWarpI2cBaudRateKbps);
+	accelStatus	= burstReadBMX055(&deviceBMX055accelState, kWarpSensorOutputRegisterBMX055accelACCD_X_LSB, accelData, sizeof(accelData));
+	magStatus	= burstReadBMX055(&deviceBMX055magState, kWarpSensorOutputRegisterBMX055magX_LSB, magData, sizeof(magData));
+	gyroStatus	= burstReadBMX055(&deviceBMX055gyroState, kWarpSensorOutputRegisterBMX055gyroRATE_X_LSB, gyroData, sizeof(gyroData));
+	if (fifoAccelBMX055)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		accelFrames = meanFifoBMX055(&readFifoBMX055accel, kWarpSizesBMX055accelFifoFrames, accelMean);
 	}
-	else
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+	ahrsStatus = updateAhrsFromReadingsBMX055(accelStatus, magStatus, gyroStatus, accelData, magData, gyroData,
+											  (accelFrames != 0) ? accelMean : NULL);
+#else
+	if (fifoGyroBMX055)
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+		gyroFrames = meanFifoBMX055(&readFifoBMX055gyro, kWarpSizesBMX055gyroFifoFrames, gyroMean);
 	}
+#endif
+	warpReleaseI2cBus();
 
-	i2cReadStatus                   = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magY_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 5) | (readSensorRegisterValueLSB >> 3);
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+	index += streamAhrsBMX055(ahrsStatus);
+#else
+	index += streamAccelBMX055(accelStatus, accelData, (accelFrames != 0) ? accelMean : NULL);
+	index += streamMagBMX055(magStatus, magData);
+	index += streamGyroBMX055(gyroStatus, gyroData, (gyroFrames != 0) ? gyroMean : NULL);
+#endif
 
-	/*
-	 *	Sign extend the 13-bit value based on knowledge that upper 4 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 12)) - (1 << 12);
+	return index;
+}
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
+/*
+ *	Put the accelerometer FIFO (32 frames) in stream mode collecting X/Y/Z
+ *	frames, with the watermark interrupt on INT1 once watermarkFrames are
+ *	waiting. Writing FIFO_CONFIG_1 also empties the FIFO.
+ */
+WarpStatus
+configureFifoBMX055accel(uint8_t watermarkFrames)
+{
+	WarpStatus status1, status2, status3, status4;
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+	status1 = writeSensorRegisterBMX055accel(kWarpSensorConfigurationRegisterBMX055accelFIFO_CONFIG_0,
+											 watermarkFrames & 0x3F /* payload: watermark level */
+	);
+	status2 = writeSensorRegisterBMX055accel(kWarpSensorConfigurationRegisterBMX055accelINT_MAP_1,
+											 0b00000010 /* payload: int1_fwm */
+	);
+	status3 = writeSensorRegisterBMX055accel(kWarpSensorConfigurationRegisterBMX055accelINT_EN_1,
+											 0b01000000 /* payload: int_fwm_en */
+	);
+	status4 = writeSensorRegisterBMX055accel(kWarpSensorConfigurationRegisterBMX055accelFIFO_CONFIG_1,
+											 0b10000000 /* payload: stream mode, X/Y/Z */
+	);
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
+	fifoAccelBMX055 = ((status1 | status2 | status3 | status4) == kWarpStatusOK);
 
-	i2cReadStatus                   = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magZ_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 7) | (readSensorRegisterValueLSB >> 1);
+	return (status1 | status2 | status3 | status4);
+}
 
-	/*
-	 *	Sign extend the 15-bit value based on knowledge that upper 1 bit are 0:
-	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 14)) - (1 << 14);
+/*
+ *	Gyroscope counterpart of configureFifoBMX055accel(); its FIFO holds 100
+ *	frames.
+ */
+WarpStatus
+configureFifoBMX055gyro(uint8_t watermarkFrames)
+{
+	WarpStatus status1, status2, status3, status4, status5;
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
+	status1 = writeSensorRegisterBMX055gyro(kWarpSensorConfigurationRegisterBMX055gyroFIFO_CONFIG_0,
+											watermarkFrames & 0x7F /* payload: no tag, watermark level */
+	);
+	status2 = writeSensorRegisterBMX055gyro(kWarpSensorConfigurationRegisterBMX055gyroFIFO_WM_EN,
+											0b10000000 /* payload: fifo_wm_enable */
+	);
+	status3 = writeSensorRegisterBMX055gyro(kWarpSensorConfigurationRegisterBMX055gyroINT_MAP_1,
+											0b00000100 /* payload: int1_fifo */
+	);
+	status4 = writeSensorRegisterBMX055gyro(kWarpSensorConfigurationRegisterBMX055gyroINT_EN_0,
+											0b01000000 /* payload: fifo_en */
+	);
+	status5 = writeSensorRegisterBMX055gyro(kWarpSensorConfigurationRegisterBMX055gyroFIFO_CONFIG_1,
+											0b10000000 /* payload: stream mode, X/Y/Z */
+	);
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+	fifoGyroBMX055 = ((status1 | status2 | status3 | status4 | status5) == kWarpStatusOK);
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
+	return (status1 | status2 | status3 | status4 | status5);
+}
 
-	i2cReadStatus                   = readSensorRegisterBMX055mag(kWarpSensorOutputRegisterBMX055magRHALL_LSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceBMX055magState.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceBMX055magState.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 6) | (readSensorRegisterValueLSB >> 2);
+/*
+ *	Drain up to maxFrames X/Y/Z frames from a FIFO in one transaction.
+ *	FIFO_DATA does not auto-increment, so a long read keeps popping frames.
+ *	The frames are LSB first, the byte order of an int16_t on the KL03, so
+ *	they are read straight into samples and then shifted into place.
+ */
+static WarpStatus
+readFifoBMX055(volatile WarpI2CDeviceState *  deviceState, WarpStatus (*readSensorRegister)(uint8_t, int), uint8_t dataRegister,
+			   uint8_t significantBits, int16_t *  samples, uint8_t maxFrames, uint8_t *  framesRead)
+{
+	WarpStatus	status;
+	uint8_t *	bytes = (uint8_t *)samples;
+	uint8_t		frames;
+
+	*framesRead = 0;
 
 	/*
-	 *	Sign extend the 14-bit value based on knowledge that upper 2 bit are 0:
+	 *	FIFO_STATUS is at 0x0E on both the accelerometer and the gyroscope.
 	 */
-	readSensorRegisterValueCombined = (readSensorRegisterValueCombined ^ (1 << 13)) - (1 << 13);
-
-	if (i2cReadStatus != kWarpStatusOK)
+	status = readSensorRegister(kWarpSensorOutputRegisterBMX055accelFIFO_STATUS, 1 /* numberOfBytes */);
+	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
-		index += 1;
+		return status;
+	}
 
-		buf[index] = 0;
-		index += 1;
+	frames = MIN(deviceState->i2cBuffer[0] & 0x7F, maxFrames);
+	if (frames == 0)
+	{
+		return kWarpStatusOK;
 	}
-	else
+
+	status = burstReadBMX055(deviceState, dataRegister, bytes, frames * kWarpSizesBMX055FifoFrameBytes);
+	if (status != kWarpStatusOK)
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+		return status;
+	}
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+	for (uint16_t i = 0; i < frames * 3; i++)
+	{
+		samples[i] = combineBMX055(&bytes[2 * i], significantBits);
 	}
+	*framesRead = frames;
 
-	return index;
-}
\ No newline at end of file
+	return kWarpStatusOK;
+}
+
+/*
+ *	samples needs room for 3 * maxFrames readings.
+ */
+WarpStatus
+readFifoBMX055accel(int16_t *  samples, uint8_t maxFrames, uint8_t *  framesRead)
+{
+	return readFifoBMX055(&deviceBMX055accelState, &readSensorRegisterBMX055accel, kWarpSensorOutputRegisterBMX055accelFIFO_DATA,
+						  12, samples, maxFrames, framesRead);
+}
+
+WarpStatus
+readFifoBMX055gyro(int16_t *  samples, uint8_t maxFrames, uint8_t *  framesRead)
+{
+	return readFifoBMX055(&deviceBMX055gyroState, &readSensorRegisterBMX055gyro, kWarpSensorOutputRegisterBMX055gyroFIFO_DATA,
+						  16, samples, maxFrames, framesRead);
+}
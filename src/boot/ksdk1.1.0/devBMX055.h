@@ -60,10 +60,33 @@ void 		printSensorDataBMX055accel(bool hexModeFlag);
 void 		printSensorDataBMX055gyro(bool hexModeFlag);
 void 		printSensorDataBMX055mag(bool hexModeFlag);
 
-uint8_t 	appendSensorDataBMX055accel(uint8_t* buf);
-uint8_t 	appendSensorDataBMX055gyro(uint8_t* buf);
-uint8_t 	appendSensorDataBMX055mag(uint8_t* buf);
+uint8_t 	appendSensorDataBMX055accel(void);
+uint8_t 	appendSensorDataBMX055gyro(void);
+uint8_t 	appendSensorDataBMX055mag(void);
+uint8_t		appendSensorDataBMX055(void);
 
-const uint8_t bytesPerMeasurementBMX055            = 16;
+WarpStatus	configureFifoBMX055accel(uint8_t watermarkFrames);
+WarpStatus	configureFifoBMX055gyro(uint8_t watermarkFrames);
+WarpStatus	readFifoBMX055accel(int16_t *  samples, uint8_t maxFrames, uint8_t *  framesRead);
+WarpStatus	readFifoBMX055gyro(int16_t *  samples, uint8_t maxFrames, uint8_t *  framesRead);
+
+#if (WARP_BUILD_ENABLE_BMX055_AHRS)
+void		initAhrsBMX055(void);
+void		updateAhrsBMX055(const int16_t *  accel, const int16_t *  gyro, const int16_t *  mag, uint32_t elapsedTicks);
+void		getQuaternionAhrsBMX055(int16_t *  quaternion);
+
+/*
+ *	Orientation quaternion W, X, Y, Z in Q14.
+ */
+const uint8_t bytesPerMeasurementBMX055            = 8;
+const uint8_t bytesPerReadingBMX055                = 2;
+const uint8_t numberOfReadingsPerMeasurementBMX055 = 4;
+#else
+/*
+ *	Accelerometer X, Y, Z, temperature; magnetometer X, Y, Z, RHALL;
+ *	gyroscope X, Y, Z.
+ */
+const uint8_t bytesPerMeasurementBMX055            = 22;
 const uint8_t bytesPerReadingBMX055                = 2;
-const uint8_t numberOfReadingsPerMeasurementBMX055 = 8;
\ No newline at end of file
+const uint8_t numberOfReadingsPerMeasurementBMX055 = 11;
+#endif
\ No newline at end of file
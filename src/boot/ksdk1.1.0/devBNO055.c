@@ -28,6 +28,12 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+/*
+ *	OPR_MODE as last configured: the fusion outputs are only computed in
+ *	the fusion modes (IMU and above).
+ */
+static uint8_t						operationModeBNO055 = kWarpSensorConfigConstBNO055registerConfigMode;
+
 void
 initBNO055(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts)
 {
@@ -78,20 +84,28 @@ writeSensorRegisterBNO055(uint8_t deviceRegister, uint8_t payload)
 WarpStatus
 configureSensorRegisterBNO055(uint8_t payloadOP_Mode, uint8_t payloadPWR_Mode)
 {
-	WarpStatus status1, status2;
+	WarpStatus status1, status2, status3 = kWarpStatusOK;
 
+	/*
+	 *	PWR_MODE can only be changed in CONFIG mode, so go there first and
+	 *	then to the requested operation mode.
+	 */
 	warpScaleSupplyVoltage(deviceBNO055State.operatingVoltageMillivolts);
-	status1 = writeSensorRegisterBNO055(kWarpSensorConfigurationRegisterBNO055_OPR_MODE /* register address PMU_RANGE */,
-											 payloadOP_Mode /* payload */
-	);
-	status2 = writeSensorRegisterBNO055(kWarpSensorConfigurationRegisterBNO055_PWR_MODE /* register address PMU_RANGE */,
-											 payloadPWR_Mode /* payload */
-	);
+	status1 = writeSensorRegisterBNO055(kWarpSensorConfigurationRegisterBNO055_OPR_MODE,
+										kWarpSensorConfigConstBNO055registerConfigMode);
+	OSA_TimeDelay(kWarpBNO055ToConfigModeMilliseconds);
 
-    OSA_TimeDelay(7);
+	status2 = writeSensorRegisterBNO055(kWarpSensorConfigurationRegisterBNO055_PWR_MODE, payloadPWR_Mode);
 
-	
-	return (status1 | status2);
+	if (payloadOP_Mode != kWarpSensorConfigConstBNO055registerConfigMode)
+	{
+		status3 = writeSensorRegisterBNO055(kWarpSensorConfigurationRegisterBNO055_OPR_MODE, payloadOP_Mode);
+		OSA_TimeDelay(kWarpBNO055FromConfigModeMilliseconds);
+	}
+
+	operationModeBNO055 = (status1 | status2 | status3) == kWarpStatusOK ? payloadOP_Mode : kWarpSensorConfigConstBNO055registerConfigMode;
+
+	return (status1 | status2 | status3);
 }
 
 WarpStatus
@@ -100,6 +114,11 @@ readSensorRegisterBNO055(uint8_t deviceRegister, int numberOfBytes)
 	uint8_t			cmdBuf[1] = {0xFF};
 	i2c_status_t	status;
 
+	if (numberOfBytes > kWarpSizesI2cBufferBytes)
+	{
+		return kWarpStatusBadDeviceCommand;
+	}
+
 	i2c_device_t slave =
 		{
 		.address 		= deviceBNO055State.i2cAddress,
@@ -125,81 +144,90 @@ readSensorRegisterBNO055(uint8_t deviceRegister, int numberOfBytes)
 	return kWarpStatusOK;
 }
 
-void
-printSensorDataBNO055(bool hexModeFlag) {
-	int16_t		readSensorRegisterValueLSB;
-	int16_t		readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
-	WarpStatus	i2cReadStatus;
-	int16_t accX, accY, accZ, magX, magY, magZ, gyrX, gyrY, gyrZ;
+static WarpStatus
+burstReadBNO055(uint8_t deviceRegister, uint8_t *  data, size_t nbyte)
+{
+	uint8_t			cmdBuf[1] = {deviceRegister};
+	i2c_status_t	status;
 
-    i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Accel_Data_X_LSB, 6);
-    
-    accX = (int16_t)((deviceBNO055State.i2cBuffer[1] << 8) | deviceBNO055State.i2cBuffer[0]);
-    accY = (int16_t)((deviceBNO055State.i2cBuffer[3] << 8) | deviceBNO055State.i2cBuffer[2]);
-    accZ = (int16_t)((deviceBNO055State.i2cBuffer[5] << 8) | deviceBNO055State.i2cBuffer[4]);
+	i2c_device_t slave =
+		{
+		.address 		= deviceBNO055State.i2cAddress,
+		.baudRate_kbps 	= gWarpI2cBaudRateKbps
+	};
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
+	warpScaleSupplyVoltage(deviceBNO055State.operatingVoltageMillivolts);
+	warpEnableI2Cpins();
+	status = I2C_DRV_MasterReceiveDataBlocking(
+							0 /* I2C peripheral instance */,
+							&slave,
+							cmdBuf,
+							1,
+							data,
+							nbyte,
+							gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d, %d, %d,", accX, accY, accZ);
-		}
+		return kWarpStatusDeviceCommunicationFailed;
 	}
 
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Mag_Data_X_LSB, 6);
+	return kWarpStatusOK;
+}
+
+/*
+ *	Read accel, mag and gyro (0x08--0x19) in one burst and, in a fusion
+ *	mode, the quaternion (0x20--0x27) in a second, into data[] as sent by
+ *	the sensor (little-endian). The quaternion bytes are zero outside the
+ *	fusion modes.
+ */
+static WarpStatus
+readOutputsBNO055(uint8_t *  data)
+{
+	WarpStatus	status;
 
-	magX = (int16_t)((deviceBNO055State.i2cBuffer[1] << 8) | deviceBNO055State.i2cBuffer[0]);
-	magY = (int16_t)((deviceBNO055State.i2cBuffer[3] << 8) | deviceBNO055State.i2cBuffer[2]);
-	magZ = (int16_t)((deviceBNO055State.i2cBuffer[5] << 8) | deviceBNO055State.i2cBuffer[4]);
+	status = burstReadBNO055(kWarpSensourOutputRegisterBNO055Accel_Data_X_LSB, data, kWarpSizesBNO055DataBurstBytes);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
 
-	if (i2cReadStatus != kWarpStatusOK)
+	if (operationModeBNO055 >= kWarpSensorConfigConstBNO055registerIMUMode)
 	{
-		warpPrint(" ----,");
+		return burstReadBNO055(kWarpSensourOutputRegisterBNO055QUA_Data_W_LSB,
+							   &data[kWarpSizesBNO055DataBurstBytes], kWarpSizesBNO055QuaternionBytes);
 	}
-	else
+
+	for (uint8_t i = 0; i < kWarpSizesBNO055QuaternionBytes; i++)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,%d, %d,", magX, magY, magZ);
-		}
+		data[kWarpSizesBNO055DataBurstBytes + i] = 0;
 	}
 
-	warpScaleSupplyVoltage(deviceBNO055State.operatingVoltageMillivolts);
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Gyro_Data_X_LSB, 6);
+	return kWarpStatusOK;
+}
+
+void
+printSensorDataBNO055(bool hexModeFlag)
+{
+	uint8_t		data[kWarpSizesBNO055DataBurstBytes + kWarpSizesBNO055QuaternionBytes];
+	WarpStatus	i2cReadStatus;
 
-	gyrX = (int16_t)((deviceBNO055State.i2cBuffer[1] << 8) | deviceBNO055State.i2cBuffer[0]);
-	gyrY = (int16_t)((deviceBNO055State.i2cBuffer[3] << 8) | deviceBNO055State.i2cBuffer[2]);
-	gyrZ = (int16_t)((deviceBNO055State.i2cBuffer[5] << 8) | deviceBNO055State.i2cBuffer[4]);
+	i2cReadStatus = readOutputsBNO055(data);
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
+	for (uint8_t i = 0; i < sizeof(data); i += 2)
 	{
-		if (hexModeFlag)
+		if (i2cReadStatus != kWarpStatusOK)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
+			warpPrint(" ----,");
+		}
+		else if (hexModeFlag)
+		{
+			warpPrint(" 0x%02x 0x%02x,", data[i + 1], data[i]);
 		}
 		else
 		{
-			warpPrint(" %d,%d,%d,", gyrX, gyrY, gyrZ);
+			warpPrint(" %d,", (int16_t)((data[i + 1] << 8) | data[i]));
 		}
 	}
-
 }
 
 WarpStatus
@@ -214,232 +242,36 @@ StateBNO055()
 }
 
 uint8_t
-appendSensorDataBNO055(uint8_t* buf)
+appendSensorDataBNO055(void)
 {
-	uint8_t index = 0;
-
-	int16_t		readSensorRegisterValueLSB;
-	int16_t		readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
+	uint8_t		index = 0;
+	uint8_t		data[kWarpSizesBNO055DataBurstBytes + kWarpSizesBNO055QuaternionBytes];
 	WarpStatus	i2cReadStatus;
 
-	warpScaleSupplyVoltage(deviceBNO055State.operatingVoltageMillivolts);
+	i2cReadStatus = readOutputsBNO055(data);
 
 	/*
-	 *	First, trigger a measurement
+	 *	Every reading is written, as zero on failure, so the record
+	 *	keeps its width.
 	 */
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Accel_Data_X_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-	
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Accel_Data_Y_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
+	for (uint8_t i = 0; i < sizeof(data); i += 2)
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Accel_Data_Z_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Mag_Data_X_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Mag_Data_Y_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Mag_Data_Z_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Gyro_Data_X_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Gyro_Data_Y_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
-
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
-	}
-
-	i2cReadStatus = readSensorRegisterBNO055(kWarpSensourOutputRegisterBNO055Gyro_Data_Z_LSB, 2);
-	readSensorRegisterValueLSB = deviceBNO055State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceBNO055State.i2cBuffer[1];
-	readSensorRegisterValueCombined = (readSensorRegisterValueMSB << 8) | readSensorRegisterValueLSB;
+		if (i2cReadStatus != kWarpStatusOK)
+		{
+			data[i]		= 0;
+			data[i + 1]	= 0;
+		}
 
-	if ((i2cReadStatus != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 24);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 16);
-		index += 1;
-
+		warpFlashStreamByte(data[i + 1]);
+		warpFlashStreamByte(data[i]);
+		index += 2;
 	}
 
 	/*
 	 * total number of bytes written
 	 */
 	return index;
-}
\ No newline at end of file
+}
@@ -4,6 +4,15 @@ WarpStatus	writeSensorRegisterBNO055(uint8_t deviceRegister, uint8_t payload);
 WarpStatus	configureSensorRegisterBNO055(uint8_t payloadOP_Mode, uint8_t payloadPWR_Mode);
 void		printSensorDataBNO055(bool hexModeFlag);
 WarpStatus	StateBNO055();
-uint8_t		appendSensorDataBNO055(uint8_t* buf);
+uint8_t		appendSensorDataBNO055(void);
+
+/*
+ *	Accelerometer, magnetometer and gyroscope x, y, z, then the fusion
+ *	quaternion w, x, y, z (zero outside the fusion modes), in the BNO055's
+ *	default units: 0.01 m/s^2, 1/16 uT, 1/16 dps and 2^-14.
+ */
+const uint8_t	bytesPerMeasurementBNO055				= 26;
+const uint8_t	bytesPerReadingBNO055					= 2;
+const uint8_t	numberOfReadingsPerMeasurementBNO055	= 13;
 
 
@@ -61,6 +61,18 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+/*
+ *	The CCS811 only produces a result every 250ms or more (MEAS_MODE), so
+ *	the last one is kept here and logged again until STATUS.DATA_READY
+ *	says there is a new one: eCO2, TVOC, raw ADC value, V_REF and V_NTC.
+ */
+static int16_t						readingsCCS811[5];
+static bool							readingsValidCCS811 = false;
+
+/*
+ *	ENV_DATA as last written, to skip writes that would change nothing.
+ */
+static uint16_t						environmentDataCCS811[2] = {0xFFFF, 0xFFFF};
 
 
 /*
@@ -96,7 +108,7 @@ writeSensorRegisterCCS811(uint8_t deviceRegister, uint8_t* payload)
 			break;
 		}
 
-		case 0x05:
+		case kWarpSensorConfigurationRegisterCCS811ENV_DATA:
 		case 0xF1:
 		case 0xFF:
 		{
@@ -170,43 +182,6 @@ writeSensorRegisterCCS811(uint8_t deviceRegister, uint8_t* payload)
 	return kWarpStatusOK;
 }
 
-WarpStatus
-configureSensorCCS811(uint8_t* payloadMEAS_MODE)
-{
-	WarpStatus	status1, status2;
-
-	/*
-	 *	See https://narcisaam.github.io/Init_Device/ for more information
-	 *	on how to initialize and configure CCS811
-	 */
-
-	/*
-	 *	Delay needed before start of i2c.
-	 */
-	OSA_TimeDelay(20);
-
-	warpScaleSupplyVoltage(deviceCCS811State.operatingVoltageMillivolts);
-	status1 = writeSensorRegisterCCS811(kWarpSensorConfigurationRegisterCCS811APP_START /* register address APP_START */,
-										payloadMEAS_MODE /* Dummy value */
-	);
-
-	/*
-	 *	Wait for the sensor to change to application mode
-	 */
-	OSA_TimeDelay(500);
-
-	status2 = writeSensorRegisterCCS811(kWarpSensorConfigurationRegisterCCS811MEAS_MODE /* register address MEAS_MODE */,
-										payloadMEAS_MODE /* payload: 3F initial reset */
-	);
-
-	/*
-	 *	After writing to MEAS_MODE to configure the sensor in mode 1-4,
-	 *	run CCS811 for 20 minutes, before accurate readings are generated.
-	 */
-
-	return (status1 | status2);
-}
-
 WarpStatus
 readSensorRegisterCCS811(uint8_t deviceRegister, int numberOfBytes)
 {
@@ -246,245 +221,257 @@ readSensorRegisterCCS811(uint8_t deviceRegister, int numberOfBytes)
 	return kWarpStatusOK;
 }
 
-void
-printSensorDataCCS811(bool hexModeFlag)
+static WarpStatus
+burstReadCCS811(uint8_t deviceRegister, uint8_t *  data, size_t nbyte)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
-	int16_t		equivalentCO2, TVOC;
-	WarpStatus	i2cReadStatus;
+	uint8_t		cmdBuf[1] = {deviceRegister};
+	i2c_status_t	status;
 
+	i2c_device_t slave =
+		{
+		.address = deviceCCS811State.i2cAddress,
+		.baudRate_kbps = gWarpI2cBaudRateKbps
+	};
 
 	warpScaleSupplyVoltage(deviceCCS811State.operatingVoltageMillivolts);
-	i2cReadStatus	= readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811ALG_DATA, 4 /* numberOfBytes */);
-	equivalentCO2	= (deviceCCS811State.i2cBuffer[0] << 8) | deviceCCS811State.i2cBuffer[1];
-	TVOC		= (deviceCCS811State.i2cBuffer[2] << 8) | deviceCCS811State.i2cBuffer[3];
-	if (i2cReadStatus != kWarpStatusOK)
+	warpEnableI2Cpins();
+	status = I2C_DRV_MasterReceiveDataBlocking(
+		0 /* I2C peripheral instance */,
+		&slave,
+		cmdBuf,
+		1,
+		data,
+		nbyte,
+		gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
 	{
-		warpPrint(" ----, ----,");
+		return kWarpStatusDeviceCommunicationFailed;
 	}
-	else
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Read STATUS until all the bits in mask are set, for at least
+ *	maximumMilliseconds. The CCS811 NACKs until it has booted, so failed
+ *	reads are retried too. Leaves the last STATUS in i2cBuffer[0].
+ *
+ *	The wait is bounded by a count of polls, each a 1ms sleep and a read,
+ *	rather than by warpTimeGetMilliseconds(), which only counts the sleep
+ *	when the LPTMR timed it. The wait can run longer than asked, not shorter.
+ */
+static WarpStatus
+waitForStatusCCS811(uint8_t mask, uint32_t maximumMilliseconds)
+{
+	WarpStatus	status;
+
+	for (uint32_t i = 0; ; i++)
 	{
-		if (hexModeFlag)
+		status = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811STATUS, 1 /* numberOfBytes */);
+		if ((status == kWarpStatusOK) && ((deviceCCS811State.i2cBuffer[0] & mask) == mask))
 		{
-			warpPrint(" 0x%02x 0x%02x, 0x%02x 0x%02x,",
-					  deviceCCS811State.i2cBuffer[3],
-					  deviceCCS811State.i2cBuffer[2],
-					  deviceCCS811State.i2cBuffer[1],
-					  deviceCCS811State.i2cBuffer[0]);
+			return kWarpStatusOK;
 		}
-		else
+
+		if (i >= maximumMilliseconds)
 		{
-			warpPrint(" %d, %d,", equivalentCO2, TVOC);
+			return kWarpStatusDeviceCommunicationFailed;
 		}
+
+		warpSleepMilliseconds(1);
 	}
+}
 
-	i2cReadStatus = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811RAW_DATA, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceCCS811State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceCCS811State.i2cBuffer[1];
+WarpStatus
+configureSensorCCS811(uint8_t* payloadMEAS_MODE)
+{
+	WarpStatus	status1, status2;
 
 	/*
-	 *	RAW ADC value. See CCS811 manual, Figure 15:
+	 *	See https://narcisaam.github.io/Init_Device/ for more information
+	 *	on how to initialize and configure CCS811
 	 */
-	readSensorRegisterValueCombined =
-		((readSensorRegisterValueLSB & 0x03) << 8) |
-		(readSensorRegisterValueMSB & 0xFF);
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
-	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
-	}
+
 	/*
-	 *	Get Voltage across V_REF
+	 *	Rather than fixed delays for the start of I2C and the change to
+	 *	application mode, poll STATUS (0.5ms or so per read) until the
+	 *	firmware is valid and then until it reports application mode. If it
+	 *	already is in application mode, e.g., when reconfigured between
+	 *	runs, APP_START is skipped altogether.
 	 */
-	i2cReadStatus = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811RAW_REF_NTC, 4 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceCCS811State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceCCS811State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB) << 8) | (readSensorRegisterValueLSB);
-
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
+	warpScaleSupplyVoltage(deviceCCS811State.operatingVoltageMillivolts);
+	status1 = waitForStatusCCS811(0x10 /* APP_VALID */, kWarpCCS811StartupMilliseconds);
+	if ((status1 == kWarpStatusOK) && !(deviceCCS811State.i2cBuffer[0] & 0x80 /* FW_MODE */))
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
+		status1 = writeSensorRegisterCCS811(kWarpSensorConfigurationRegisterCCS811APP_START /* register address APP_START */,
+											payloadMEAS_MODE /* Dummy value */
+		);
+
+		if (status1 == kWarpStatusOK)
 		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			status1 = waitForStatusCCS811(0x80 /* FW_MODE */, kWarpCCS811AppStartMilliseconds);
 		}
 	}
+
+	status2 = writeSensorRegisterCCS811(kWarpSensorConfigurationRegisterCCS811MEAS_MODE /* register address MEAS_MODE */,
+										payloadMEAS_MODE /* payload: 3F initial reset */
+	);
+
 	/*
-	 *	Get Voltage across R_NTC
+	 *	After writing to MEAS_MODE to configure the sensor in mode 1-4,
+	 *	run CCS811 for 20 minutes, before accurate readings are generated.
 	 */
-	readSensorRegisterValueLSB = deviceCCS811State.i2cBuffer[2];
-	readSensorRegisterValueMSB = deviceCCS811State.i2cBuffer[3];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB) << 8) | (readSensorRegisterValueLSB);
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
-	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
-	}
+	return (status1 | status2);
 }
 
-uint8_t
-appendSensorDataCCS811(uint8_t* buf)
+/*
+ *	Write the ambient humidity and temperature to ENV_DATA so the CCS811
+ *	can compensate for them. Both are sent in units of 1/512, temperature
+ *	offset by 25 degrees C (Figure 27 of the CCS811 manual). Writes that
+ *	would change neither value by at least 0.5 are skipped.
+ */
+WarpStatus
+setEnvironmentDataCCS811(int16_t temperatureCentidegrees, uint16_t humidityCentipercent)
 {
-	uint8_t index = 0;
-
-	uint16_t readSensorRegisterValueLSB;
-	uint16_t readSensorRegisterValueMSB;
-	int16_t readSensorRegisterValueCombined;
-	int16_t equivalentCO2, TVOC;
-	WarpStatus i2cReadStatus;
+	uint8_t		payload[4];
+	uint16_t	humidity;
+	uint16_t	temperature;
+	WarpStatus	status;
 
-	warpScaleSupplyVoltage(deviceCCS811State.operatingVoltageMillivolts);
-	i2cReadStatus = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811ALG_DATA, 4 /* numberOfBytes */);
-	equivalentCO2 = (deviceCCS811State.i2cBuffer[0] << 8) | deviceCCS811State.i2cBuffer[1];
-	TVOC          = (deviceCCS811State.i2cBuffer[2] << 8) | deviceCCS811State.i2cBuffer[3];
-	if (i2cReadStatus != kWarpStatusOK)
+	if (temperatureCentidegrees < -2500)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		temperatureCentidegrees = -2500;
 	}
-	else
-	{
 
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(equivalentCO2 >> 8);
-		index += 1;
+	humidity	= (uint16_t)(((uint32_t)humidityCentipercent * 512) / 100);
+	temperature	= (uint16_t)(((uint32_t)(temperatureCentidegrees + 2500) * 512) / 100);
 
-		buf[index] = (uint8_t)(equivalentCO2);
-		index += 1;
+	if (((humidity >> 8) == (environmentDataCCS811[0] >> 8)) && ((temperature >> 8) == (environmentDataCCS811[1] >> 8)))
+	{
+		return kWarpStatusOK;
+	}
 
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(TVOC >> 8);
-		index += 1;
+	payload[0] = (uint8_t)(humidity >> 8);
+	payload[1] = (uint8_t)(humidity);
+	payload[2] = (uint8_t)(temperature >> 8);
+	payload[3] = (uint8_t)(temperature);
 
-		buf[index] = (uint8_t)(TVOC);
-		index += 1;
+	status = writeSensorRegisterCCS811(kWarpSensorConfigurationRegisterCCS811ENV_DATA, payload);
+	if (status == kWarpStatusOK)
+	{
+		environmentDataCCS811[0] = humidity;
+		environmentDataCCS811[1] = temperature;
 	}
 
-	i2cReadStatus              = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811RAW_DATA, 2 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceCCS811State.i2cBuffer[0];
-	readSensorRegisterValueMSB = deviceCCS811State.i2cBuffer[1];
+	return status;
+}
 
-	/*
-	 *	RAW ADC value. See CCS811 manual, Figure 15:
-	 */
-	readSensorRegisterValueCombined =
-		((readSensorRegisterValueLSB & 0x03) << 8) |
-		(readSensorRegisterValueMSB & 0xFF);
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
+/*
+ *	Read STATUS and, only when DATA_READY is set (or nothing has been read
+ *	yet), ALG_RESULT_DATA in one 8-byte burst, which includes RAW_DATA,
+ *	followed by RAW_REF_NTC. Otherwise the previous readings stand, so
+ *	between results each sample costs a single 1-byte read.
+ *
+ *	The CCS811 nINT line would let us sleep until DATA_READY, but it is not
+ *	routed to a KL03 pin, so STATUS is polled instead.
+ */
+static WarpStatus
+readOutputsCCS811(void)
+{
+	uint8_t		data[kWarpSizesCCS811AlgResultBytes];
+	WarpStatus	status;
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
+	status = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811STATUS, 1 /* numberOfBytes */);
+	if (status != kWarpStatusOK)
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+		return status;
 	}
-	/*
-	 *	Get Voltage across V_REF
-	 */
-	i2cReadStatus                   = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811RAW_REF_NTC, 4 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceCCS811State.i2cBuffer[0];
-	readSensorRegisterValueMSB      = deviceCCS811State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB) << 8) | (readSensorRegisterValueLSB);
 
-	if (i2cReadStatus != kWarpStatusOK)
+	if (readingsValidCCS811 && !(deviceCCS811State.i2cBuffer[0] & 0x08 /* DATA_READY */))
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		return kWarpStatusOK;
 	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+	status = burstReadCCS811(kWarpSensorOutputRegisterCCS811ALG_DATA, data, kWarpSizesCCS811AlgResultBytes);
+	if (status != kWarpStatusOK)
+	{
+		return status;
 	}
+
 	/*
-	 *	Get Voltage across R_NTC
+	 *	eCO2 and TVOC, then STATUS and ERROR_ID, then RAW_DATA. For the
+	 *	RAW ADC value, see CCS811 manual, Figure 15.
 	 */
-	readSensorRegisterValueLSB      = deviceCCS811State.i2cBuffer[2];
-	readSensorRegisterValueMSB      = deviceCCS811State.i2cBuffer[3];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB) << 8) | (readSensorRegisterValueLSB);
+	readingsCCS811[0] = (data[0] << 8) | data[1];
+	readingsCCS811[1] = (data[2] << 8) | data[3];
+	readingsCCS811[2] = ((data[6] & 0x03) << 8) | (data[7] & 0xFF);
 
-	if (i2cReadStatus != kWarpStatusOK)
+	/*
+	 *	Voltages across V_REF and R_NTC, MSB first.
+	 */
+	status = readSensorRegisterCCS811(kWarpSensorOutputRegisterCCS811RAW_REF_NTC, 4 /* numberOfBytes */);
+	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
-		index += 1;
+		return status;
+	}
 
-		buf[index] = 0;
-		index += 1;
+	readingsCCS811[3] = (deviceCCS811State.i2cBuffer[0] << 8) | deviceCCS811State.i2cBuffer[1];
+	readingsCCS811[4] = (deviceCCS811State.i2cBuffer[2] << 8) | deviceCCS811State.i2cBuffer[3];
+	readingsValidCCS811 = true;
+
+	return kWarpStatusOK;
+}
+
+void
+printSensorDataCCS811(bool hexModeFlag)
+{
+	WarpStatus	i2cReadStatus;
+
+	i2cReadStatus = readOutputsCCS811();
+
+	for (uint8_t i = 0; i < sizeof(readingsCCS811)/sizeof(readingsCCS811[0]); i++)
+	{
+		if (i2cReadStatus != kWarpStatusOK)
+		{
+			warpPrint(" ----,");
+		}
+		else
+		{
+			if (hexModeFlag)
+			{
+				warpPrint(" 0x%02x 0x%02x,", (uint8_t)(readingsCCS811[i] >> 8), (uint8_t)readingsCCS811[i]);
+			}
+			else
+			{
+				warpPrint(" %d,", readingsCCS811[i]);
+			}
+		}
 	}
-	else
+}
+
+uint8_t
+appendSensorDataCCS811(void)
+{
+	uint8_t		index = 0;
+	int16_t		reading;
+	WarpStatus	i2cReadStatus;
+
+	i2cReadStatus = readOutputsCCS811();
+
+	for (uint8_t i = 0; i < sizeof(readingsCCS811)/sizeof(readingsCCS811[0]); i++)
 	{
+		reading = (i2cReadStatus == kWarpStatusOK) ? readingsCCS811[i] : 0;
+
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(reading >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(reading));
 		index += 1;
 	}
 
 	return index;
-}
\ No newline at end of file
+}
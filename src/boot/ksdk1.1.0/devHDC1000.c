@@ -61,6 +61,20 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+/*
+ *	Configuration register as last written. The power-on default has
+ *	MODE set (temperature and humidity in sequence) at 14 bits each.
+ */
+static uint16_t						configurationHDC1000 = 0x1000;
+
+/*
+ *	Raw codes from the last successful measurement, for other drivers
+ *	that want the ambient conditions (see environmentDataHDC1000()).
+ */
+static uint16_t						lastTemperatureHDC1000;
+static uint16_t						lastHumidityHDC1000;
+static bool							lastMeasurementValidHDC1000 = false;
+
 
 void
 initHDC1000(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts)
@@ -115,9 +129,161 @@ writeSensorRegisterHDC1000(uint8_t deviceRegister, uint16_t payload)
 		return kWarpStatusDeviceCommunicationFailed;
 	}
 
+	configurationHDC1000 = payload;
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Worst-case conversion time for the configured mode and resolutions, from
+ *	Table 7.5 of the HDC1000 datasheet: temperature takes 3.65ms (11 bit) or
+ *	6.35ms (14 bit), humidity 2.5ms (8 bit), 3.85ms (11 bit) or 6.5ms
+ *	(14 bit). With MODE set, one trigger converts both in sequence.
+ */
+uint8_t
+measurementMillisecondsHDC1000(void)
+{
+	uint16_t	temperatureMicroseconds;
+	uint16_t	humidityMicroseconds;
+
+	temperatureMicroseconds = (configurationHDC1000 & (1 << 10)) ? 3650 : 6350;
+
+	switch ((configurationHDC1000 >> 8) & 0x3)
+	{
+		case 0b01:
+		{
+			humidityMicroseconds = 3850;
+			break;
+		}
+
+		case 0b10:
+		{
+			humidityMicroseconds = 2500;
+			break;
+		}
+
+		default:
+		{
+			humidityMicroseconds = 6500;
+			break;
+		}
+	}
+
+	if (!(configurationHDC1000 & (1 << 12)))
+	{
+		return (uint8_t)((((temperatureMicroseconds > humidityMicroseconds) ? temperatureMicroseconds : humidityMicroseconds) + 999) / 1000);
+	}
+
+	return (uint8_t)((temperatureMicroseconds + humidityMicroseconds + 999) / 1000);
+}
+
+/*
+ *	Split-phase acquisition: startMeasurementHDC1000() triggers a conversion
+ *	and returns straight away. After measurementMillisecondsHDC1000(), which
+ *	the caller can spend asleep or talking to other devices,
+ *	readMeasurementHDC1000() collects temperature and humidity in one 4-byte
+ *	read. This relies on MODE being set in the configuration register.
+ */
+WarpStatus
+startMeasurementHDC1000(void)
+{
+	uint8_t		cmdBuf[1] = {kWarpSensorOutputRegisterHDC1000Temperature};
+	i2c_status_t	status;
+
+	i2c_device_t slave =
+		{
+			.address       = deviceHDC1000State.i2cAddress,
+			.baudRate_kbps = gWarpI2cBaudRateKbps};
+
+	warpScaleSupplyVoltage(deviceHDC1000State.operatingVoltageMillivolts);
+	warpEnableI2Cpins();
+
+	status = I2C_DRV_MasterSendDataBlocking(
+		0 /* I2C peripheral instance */,
+		&slave,
+		cmdBuf,
+		1,
+		NULL,
+		0,
+		gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
+	{
+		return kWarpStatusDeviceCommunicationFailed;
+	}
+
+	return kWarpStatusOK;
+}
+
+WarpStatus
+readMeasurementHDC1000(uint16_t *  temperature, uint16_t *  humidity)
+{
+	i2c_status_t	status;
+
+	i2c_device_t slave =
+		{
+			.address       = deviceHDC1000State.i2cAddress,
+			.baudRate_kbps = gWarpI2cBaudRateKbps};
+
+	warpScaleSupplyVoltage(deviceHDC1000State.operatingVoltageMillivolts);
+	warpEnableI2Cpins();
+
+	/*
+	 *	The HDC1000 NACKs its address until the conversion is done, so
+	 *	reading too early fails rather than returning stale data.
+	 */
+	status = I2C_DRV_MasterReceiveDataBlocking(
+		0 /* I2C peripheral instance */,
+		&slave,
+		NULL,
+		0,
+		(uint8_t*)deviceHDC1000State.i2cBuffer,
+		kWarpSizesHDC1000MeasurementBytes,
+		gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
+	{
+		return kWarpStatusDeviceCommunicationFailed;
+	}
+
+	*temperature	= ((deviceHDC1000State.i2cBuffer[0] & 0xFF) << 8) | (deviceHDC1000State.i2cBuffer[1] & 0xFF);
+	*humidity		= ((deviceHDC1000State.i2cBuffer[2] & 0xFF) << 8) | (deviceHDC1000State.i2cBuffer[3] & 0xFF);
+
+	lastTemperatureHDC1000		= *temperature;
+	lastHumidityHDC1000			= *humidity;
+	lastMeasurementValidHDC1000	= true;
+
+	return kWarpStatusOK;
+}
+
+WarpStatus
+environmentDataHDC1000(int16_t *  temperatureCentidegrees, uint16_t *  humidityCentipercent)
+{
+	if (!lastMeasurementValidHDC1000)
+	{
+		return kWarpStatusDeviceNotInitialized;
+	}
+
+	*temperatureCentidegrees	= (int16_t)((16500UL * lastTemperatureHDC1000) >> 16) - 4000;
+	*humidityCentipercent		= (uint16_t)((10000UL * lastHumidityHDC1000) >> 16);
+
 	return kWarpStatusOK;
 }
 
+static WarpStatus
+measureHDC1000(uint16_t *  temperature, uint16_t *  humidity)
+{
+	WarpStatus	status;
+
+	status = startMeasurementHDC1000();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	warpSleepMilliseconds(measurementMillisecondsHDC1000());
+
+	return readMeasurementHDC1000(temperature, humidity);
+}
+
 WarpStatus
 readSensorRegisterHDC1000(uint8_t deviceRegister, int numberOfBytes)
 {
@@ -187,9 +353,9 @@ readSensorRegisterHDC1000(uint8_t deviceRegister, int numberOfBytes)
 			gWarpI2cTimeoutMilliseconds);
 
 		/*
-		 *	Step 2: Wait for max 6.5ms for conversion completion (see Table 7.5 of HDC1000 datasheet)
+		 *	Step 2: Wait for conversion completion (see Table 7.5 of HDC1000 datasheet)
 		 */
-		OSA_TimeDelay(7);
+		warpSleepMilliseconds(measurementMillisecondsHDC1000());
 
 		/*
 		 *	Step 3: Read temp/humidity
@@ -233,140 +399,59 @@ readSensorRegisterHDC1000(uint8_t deviceRegister, int numberOfBytes)
 void
 printSensorDataHDC1000(bool hexModeFlag)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
+	uint16_t	temperature;
+	uint16_t	humidity;
 	WarpStatus	i2cReadStatus;
 
-
-	warpScaleSupplyVoltage(deviceHDC1000State.operatingVoltageMillivolts);
-	i2cReadStatus = readSensorRegisterHDC1000(kWarpSensorOutputRegisterHDC1000Temperature, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceHDC1000State.i2cBuffer[0];
-	readSensorRegisterValueLSB = deviceHDC1000State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
-
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
-	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			/*
-			 *	See Section 8.6.1 of the HDC1000 manual for the conversion to temperature.
-			 */
-			warpPrint(" %d,", (readSensorRegisterValueCombined * 165 / (1u << 16)) - 40);
-		}
-	}
-
-	i2cReadStatus = readSensorRegisterHDC1000(kWarpSensorOutputRegisterHDC1000Humidity, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceHDC1000State.i2cBuffer[0];
-	readSensorRegisterValueLSB = deviceHDC1000State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+	i2cReadStatus = measureHDC1000(&temperature, &humidity);
 
 	if (i2cReadStatus != kWarpStatusOK)
 	{
-		warpPrint(" ----,");
+		warpPrint(" ----, ----,");
 	}
 	else
 	{
 		if (hexModeFlag)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
+			warpPrint(" 0x%02x 0x%02x,", temperature >> 8, temperature & 0xFF);
+			warpPrint(" 0x%02x 0x%02x,", humidity >> 8, humidity & 0xFF);
 		}
 		else
 		{
 			/*
-			 *	See Section 8.6.2 of the HDC1000 manual for the conversion to temperature.
+			 *	See Sections 8.6.1 and 8.6.2 of the HDC1000 manual for the
+			 *	conversions to temperature and relative humidity.
 			 */
-			warpPrint(" %d,", (readSensorRegisterValueCombined * 100 / (1u << 16)));
+			warpPrint(" %d,", (int16_t)((temperature * 165UL) >> 16) - 40);
+			warpPrint(" %d,", (int16_t)((humidity * 100UL) >> 16));
 		}
 	}
 }
 
 uint8_t
-appendSensorDataHDC1000(uint8_t* buf)
+appendSensorDataHDC1000(void)
 {
-	uint8_t index = 0;
-
-	uint16_t readSensorRegisterValueLSB;
-	uint16_t readSensorRegisterValueMSB;
-	int16_t readSensorRegisterValueCombined;
-	WarpStatus i2cReadStatus;
-
-	warpScaleSupplyVoltage(deviceHDC1000State.operatingVoltageMillivolts);
-	i2cReadStatus                   = readSensorRegisterHDC1000(kWarpSensorOutputRegisterHDC1000Temperature, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceHDC1000State.i2cBuffer[0];
-	readSensorRegisterValueLSB      = deviceHDC1000State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+	uint16_t	temperature;
+	uint16_t	humidity;
+	int16_t		readings[2] = {0, 0};
+	WarpStatus	i2cReadStatus;
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
+	i2cReadStatus = measureHDC1000(&temperature, &humidity);
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
+	if (i2cReadStatus == kWarpStatusOK)
 	{
-		readSensorRegisterValueCombined = (readSensorRegisterValueCombined * 165 / (1u << 16)) - 40;
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+		readings[0] = (int16_t)((temperature * 165UL) >> 16) - 40;
+		readings[1] = (int16_t)((humidity * 100UL) >> 16);
 	}
 
-	i2cReadStatus                   = readSensorRegisterHDC1000(kWarpSensorOutputRegisterHDC1000Humidity, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceHDC1000State.i2cBuffer[0];
-	readSensorRegisterValueLSB      = deviceHDC1000State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
 	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
+	 * MSB first
 	 */
-
-	if (i2cReadStatus != kWarpStatusOK)
+	for (uint8_t i = 0; i < 2; i++)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		readSensorRegisterValueCombined = (readSensorRegisterValueCombined * 100 / (1u << 16));
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+		warpFlashStreamByte((uint8_t)(readings[i] >> 8));
+		warpFlashStreamByte((uint8_t)(readings[i]));
 	}
 
-	return index;
-}
\ No newline at end of file
+	return sizeof(readings);
+}
@@ -40,7 +40,11 @@ void		initHDC1000(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts)
 WarpStatus	writeSensorRegisterHDC1000(uint8_t deviceRegister, uint16_t payload);
 WarpStatus	readSensorRegisterHDC1000(uint8_t deviceRegister, int numberOfBytes);
 void		printSensorDataHDC1000(bool hexModeFlag);
-uint8_t		appendSensorDataHDC1000(uint8_t* buf);
+uint8_t		appendSensorDataHDC1000(void);
+WarpStatus	startMeasurementHDC1000(void);
+WarpStatus	readMeasurementHDC1000(uint16_t *  temperature, uint16_t *  humidity);
+uint8_t		measurementMillisecondsHDC1000(void);
+WarpStatus	environmentDataHDC1000(int16_t *  temperatureCentidegrees, uint16_t *  humidityCentipercent);
 
 const uint8_t bytesPerMeasurementHDC1000            = 4;
 const uint8_t bytesPerReadingHDC1000                = 2;
@@ -35,6 +35,8 @@
 	POSSIBILITY OF SUCH DAMAGE.
 */
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 
 /*
  *	config.h needs to come first
@@ -62,10 +64,63 @@ extern volatile uint32_t 			gWarpSpiTimeoutMicroseconds;
 extern uint8_t 						gWarpSpiCommonSourceBuffer[];
 extern uint8_t 						gWarpSpiCommonSinkBuffer[];
 extern uint16_t 					gWarpBuffAddress;
+extern WarpPersistentState			gWarpPersistentState;
+extern volatile bool				gWarpFlashStreamOpen;
 
 uint8_t 	gFlashWriteLimit 		= 0x20;
 uint8_t		deviceOpsBuffer[kWarpMemoryCommonSpiBufferBytes];
 
+/*
+ *	Sector and position of the next unwritten slot in the persistent-state
+ *	log. A value of kWarpIS25xPPersistentStateSlotCount means the log moves to
+ *	the other sector on the next save. These are rebuilt from flash once after
+ *	each reset.
+ */
+static bool		persistentStateLoaded		= false;
+static uint16_t	persistentStateSector		= kWarpIS25xPPersistentStateFirstSector;
+static uint16_t	persistentStateNextSlot		= kWarpIS25xPPersistentStateSlotCount;
+
+/*
+ *	Records streamed since the persistent state was last saved.
+ */
+static uint8_t	recordsSinceSaveIS25xP		= 0;
+
+/*
+ *	First error seen since beginStreamToIS25xP(); once set, further bytes are dropped.
+ */
+static WarpStatus	streamStatusIS25xP			= kWarpStatusOK;
+
+/*
+ *	Set while a sector erase started by eraseAheadIS25xP() may still be running.
+ */
+static bool		eraseAheadInProgress		= false;
+
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+/*
+ *	A run of bytes programmed into one log page by one Page Program, and the
+ *	CRC-16 of the bytes as they were streamed, so that the run can be read
+ *	back and checked later without keeping a copy of it.
+ */
+typedef struct
+{
+	uint16_t	pageNumber;
+	uint8_t		pageOffset;
+	uint8_t		lastPageOffset;
+	uint16_t	crc;
+} WarpIS25xPVerifyChunk;
+
+/*
+ *	The chunk being streamed, and the programmed chunks waiting for idle time
+ *	to be checked in. remapUnsavedIS25xP is set when a failed check has added
+ *	to the remap table since the persistent state was last saved.
+ */
+static WarpIS25xPVerifyChunk	streamChunkIS25xP;
+static uint16_t					streamChunkBytesIS25xP		= 0;
+static WarpIS25xPVerifyChunk	verifyQueueIS25xP[kWarpIS25xPVerifyQueueLength];
+static uint8_t					verifyQueueLengthIS25xP		= 0;
+static bool						remapUnsavedIS25xP			= false;
+#endif
+
 void 
 initIS25xP(int chipSelectIoPinID, uint16_t operatingVoltageMillivolts)
 {
@@ -219,7 +274,10 @@ programMultipleIS25xPWithoutOffsetUpdate(uint16_t* pageNumber_p, uint8_t* pageOf
 {
 	WarpStatus status;
 
-	if (kWarpSizeIS25xPPageSizeBytes <= (size_t)(*pageOffset_p) + (size_t)(nbyte))
+	/*
+	 *	Whole rest-of-pages first, then what is left in the last page.
+	 */
+	while (kWarpSizeIS25xPPageSizeBytes <= (size_t)(*pageOffset_p) + (size_t)(nbyte))
 	{
 		size_t nByteToWrite = kWarpSizeIS25xPPageSizeBytes - *pageOffset_p;
 		status = programSingleIS25xPWithoutOffsetUpdate(pageNumber_p, pageOffset_p, nByteToWrite, buf);
@@ -231,9 +289,11 @@ programMultipleIS25xPWithoutOffsetUpdate(uint16_t* pageNumber_p, uint8_t* pageOf
 		*pageNumber_p += 1;
 		*pageOffset_p = 0;
 
-		status = programMultipleIS25xPWithoutOffsetUpdate(pageNumber_p, pageOffset_p, nbyte - nByteToWrite, buf + (nByteToWrite));
-	} 
-	else
+		nbyte	-= nByteToWrite;
+		buf		+= nByteToWrite;
+	}
+
+	if (nbyte > 0)
 	{
 		status = programSingleIS25xPWithoutOffsetUpdate(pageNumber_p, pageOffset_p, nbyte, buf);
 		if (status != kWarpStatusOK)
@@ -246,315 +306,1264 @@ programMultipleIS25xPWithoutOffsetUpdate(uint16_t* pageNumber_p, uint8_t* pageOf
 	return kWarpStatusOK;
 }
 
-WarpStatus
-writeToIS25xPFromEnd(size_t nbyte, uint8_t *buf)
+static WarpStatus
+readPersistentStateSlotIS25xP(uint16_t sector, uint16_t slot, WarpPersistentState *  slotState)
 {
-	// assume that nbyte < 32
-	WarpStatus status;
-	uint8_t pageOffsetBuf[3];
-	status = readMemoryIS25xP(kWarpIS25xPPageOffsetStoragePage, kWarpIS25xPPageOffsetStorageOffset, kWarpIS25xPPageOffsetStorageSize, pageOffsetBuf);
-	if (status != kWarpStatusOK)
-	{
-		warpPrint("\r\n\tError: readMemoryIS25xP failed");
-		return status;
-	}
+	return readMemoryIS25xP(sector * kWarpIS25xPPagesPerSector + slot / kWarpIS25xPPersistentStateSlotsPerPage,
+							(slot % kWarpIS25xPPersistentStateSlotsPerPage) * sizeof(WarpPersistentState),
+							sizeof(WarpPersistentState),
+							slotState);
+}
 
-	uint8_t pageOffset = pageOffsetBuf[2];
-	uint16_t pageNumber = pageOffsetBuf[1] | pageOffsetBuf[0] << 8;
+static bool
+isPersistentStateSlotErased(const WarpPersistentState *  slotState)
+{
+	const uint8_t *	bytes = (const uint8_t *)slotState;
 
-	status = programMultipleIS25xPWithoutOffsetUpdate(&pageNumber, &pageOffset, nbyte, buf);
-	if (status != kWarpStatusOK)
+	for (size_t i = 0; i < sizeof(WarpPersistentState); i++)
 	{
-		warpPrint("\r\n\tError: programMultipleIS25xPWithoutOffsetUpdate failed");
-		return status;
+		if (bytes[i] != 0xFF)
+		{
+			return false;
+		}
 	}
 
-	status = programPageNumberAndOffset(pageNumber, pageOffset);
-	if (status != kWarpStatusOK)
+	return true;
+}
+
+static uint16_t
+nextLogSectorIS25xP(uint16_t sector)
+{
+	return (sector + 1 >= kWarpIS25xPLogEndSector) ? kWarpIS25xPFirstLogSector : sector + 1;
+}
+
+/*
+ *	Sector holding the last byte written to the log, i.e., the one before the
+ *	log head. When the head is at the start of a page this is the previous page,
+ *	wrapping from the first log page back to the last page of the chip.
+ */
+static uint16_t
+lastWrittenSectorIS25xP(void)
+{
+	uint16_t page = gWarpPersistentState.logPageNumber;
+
+	if (gWarpPersistentState.logPageOffset == 0)
 	{
-		warpPrint("\r\n\tError: programPageNumberAndOffset failed");
-		return status;
+		page = (page == kWarpInitialPageNumberIS25xP) ? kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector - 1 : page - 1;
 	}
 
-	return kWarpStatusOK;
+	return page / kWarpIS25xPPagesPerSector;
 }
 
-void
-byteOffsetToAddress(uint32_t byteOffset, uint8_t *address)
+/*
+ *	Number of erased sectors between the last written sector and
+ *	eraseAheadSector, going round the ring.
+ */
+static uint16_t
+erasedSectorsAheadIS25xP(void)
 {
-	address[2] = (uint8_t)(byteOffset);
-	address[1] = (uint8_t)(byteOffset >>= 8);
-	address[0] = (uint8_t)(byteOffset >>= 8);
+	uint16_t ringSectors = kWarpIS25xPLogEndSector - kWarpIS25xPFirstLogSector;
+
+	return (gWarpPersistentState.eraseAheadSector + ringSectors - lastWrittenSectorIS25xP() - 1) % ringSectors;
 }
 
-WarpStatus
-programPageNumberAndOffset(uint16_t pageNumber, uint8_t pageOffset)
+static WarpStatus
+startSectorEraseIS25xP(uint16_t sector)
 {
-	WarpStatus status;
-	status = eraseSectorIS25xP(0);
-	if (status != kWarpStatusOK)
+	uint8_t ops[4];
+
+	ops[0] = 0xD7; /* SER (SPI Mode) */
+	ops[1] = (uint8_t)(sector >> 4);
+	ops[2] = (uint8_t)(sector << 4);
+	ops[3] = 0x00;
+
+	enableIS25xPWrite();
+
+	return spiTransactionIS25xP(ops, 4);
+}
+
+/*
+ *	Before erasing a log sector, move the ring-log tail out of it. Erasing
+ *	sector 1 while the tail is unset and the log is not empty means the log is
+ *	starting its second lap, so the tail starts at the first log page. Also
+ *	erases the spares of any remapped pages in the sector.
+ */
+static WarpStatus
+releaseLogSectorIS25xP(uint16_t sector)
+{
+	WarpStatus	status;
+	bool		stateChanged = false;
+
+#if (WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	uint16_t	tailPageNumber;
+	uint8_t		tailPageOffset;
+
+	if ((gWarpPersistentState.logTailPageNumber == 0) &&
+		(sector == kWarpIS25xPFirstLogSector) &&
+		((gWarpPersistentState.logPageNumber != kWarpInitialPageNumberIS25xP) ||
+		 (gWarpPersistentState.logPageOffset != kWarpInitialPageOffsetIS25xP)))
 	{
-		warpPrint("\r\n\tError:raseSectorIS25xP failed");
-		return status;
+		gWarpPersistentState.logTailPageNumber = kWarpInitialPageNumberIS25xP;
+		gWarpPersistentState.logTailPageOffset = kWarpInitialPageOffsetIS25xP;
 	}
 
-	uint8_t address[3];
-	address[1] = (uint8_t)(pageNumber);
-	address[0] = (uint8_t)(pageNumber >> 8);
-	address[2] = pageOffset;
-
+	tailPageNumber = gWarpPersistentState.logTailPageNumber;
+	tailPageOffset = gWarpPersistentState.logTailPageOffset;
 
-	status = programPageIS25xP(0, 0, 3, address);
+	status = warpFlashAdvanceLogTail(sector * kWarpIS25xPPagesPerSector, kWarpIS25xPPagesPerSector);
 	if (status != kWarpStatusOK)
 	{
-		warpPrint("\r\n\tError: programPageIS25xP failed");
 		return status;
 	}
-	return kWarpStatusOK;
-}
 
-WarpStatus
-resetIS25xP()
-{
-	WarpStatus status;
-	status = chipEraseIS25xP();
-	if (status != kWarpStatusOK)
+	stateChanged = (tailPageNumber != gWarpPersistentState.logTailPageNumber) ||
+				   (tailPageOffset != gWarpPersistentState.logTailPageOffset);
+#endif
+
+	/*
+	 *	The log has now left any remapped page in the sector. Its spare is
+	 *	erased along with the sector so it can take the page's next lap, and a
+	 *	pending remap takes effect from here on.
+	 */
+	for (uint8_t i = 0; i < kWarpFlashRemapTableEntries; i++)
 	{
-		warpPrint("\r\n\tError: chipEraseIS25xP failed");
-		return status;
+		if ((gWarpPersistentState.remapPageNumbers[i] != 0) &&
+			(gWarpPersistentState.remapPageNumbers[i] / kWarpIS25xPPagesPerSector == sector))
+		{
+			status = startSectorEraseIS25xP(kWarpIS25xPSpareFirstSector + i);
+			if (status != kWarpStatusOK)
+			{
+				return status;
+			}
+
+			status = waitForWriteCompletion(kWarpIS25xPSectorEraseTypicalMilliseconds, kWarpIS25xPSectorEraseMaxMilliseconds);
+			if (status != kWarpStatusOK)
+			{
+				return status;
+			}
+
+			gWarpPersistentState.remapPendingMask &= ~(1 << i);
+			stateChanged = true;
+		}
 	}
 
-	status = programPageNumberAndOffset(kWarpInitialPageNumberIS25xP, kWarpInitialPageOffsetIS25xP);
-	if (status != kWarpStatusOK)
+	/*
+	 *	Save the new tail and remap table before the erase, so that neither
+	 *	points into erased flash.
+	 */
+	if (stateChanged)
 	{
-		warpPrint("\r\n\tError: programPageNumberAndOffset failed");
-		return status;
+		return savePersistentStateIS25xP();
 	}
 
 	return kWarpStatusOK;
 }
 
-WarpStatus
-readMemoryIS25xP(uint16_t startPageNumber, uint8_t startPageOffset, size_t nbyte, void *buf)
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+/*
+ *	Read a programmed chunk back and check it against the CRC of the bytes
+ *	that were streamed into it. The rest of the lap has been written after a
+ *	page that fails, so its data stays where it is: it gets a pending remap
+ *	table entry, and moves to a spare from the next erase of its sector.
+ */
+static WarpStatus
+verifyChunkIS25xP(const WarpIS25xPVerifyChunk *  chunk)
 {
-	WarpStatus status;
+	WarpStatus	status;
+	uint8_t		readBack[16];
+	uint16_t	crc			= 0xFFFF;
+	uint16_t	pageOffset	= chunk->pageOffset;
+	size_t		nbyte;
 
-	if (nbyte > kWarpSizeAT45DBPageSizeBytes)
+	status = waitForWriteCompletion(0, kWarpIS25xPPageProgramMaxMilliseconds);
+	if (status != kWarpStatusOK)
 	{
-		return kWarpStatusBadDeviceCommand;
+		return status;
 	}
 
-	size_t 		nBytesBeingRead;
-	uint16_t 	nextPageNumber;
-	uint8_t 	nextPageOffset;
-
-	size_t nBytesRemainingInPage 	= kWarpSizeAT45DBPageSizeBytes - startPageOffset;
-	size_t nBytesSpiLimit 			= kWarpMemoryCommonSpiBufferBytes - 4;
-
-	if (nBytesRemainingInPage < nbyte)
+	while (pageOffset <= chunk->lastPageOffset)
 	{
-		if (nBytesRemainingInPage > nBytesSpiLimit)
-		{
-			nBytesBeingRead = nBytesSpiLimit;
-			nextPageNumber 	= startPageNumber;
-			nextPageOffset 	= startPageOffset + nBytesSpiLimit;
-		} 
-		else
+		nbyte = MIN(sizeof(readBack), chunk->lastPageOffset + 1 - pageOffset);
+
+		status = readMemoryIS25xP(chunk->pageNumber, pageOffset, nbyte, readBack);
+		if (status != kWarpStatusOK)
 		{
-			nBytesBeingRead = nBytesRemainingInPage;
-			nextPageNumber 	= startPageNumber + 1;
-			nextPageOffset 	= 0;
+			return status;
 		}
-	} 
-	else
+
+		crc = warpCrc16Update(crc, readBack, nbyte);
+		pageOffset += nbyte;
+	}
+
+	if (crc == chunk->crc)
 	{
-		if (nbyte > nBytesSpiLimit)
-		{
-			nBytesBeingRead = nBytesSpiLimit;
-			nextPageNumber 	= startPageNumber;
-			nextPageOffset 	= startPageOffset + nBytesSpiLimit;
-		} 
-		else
-		{
-			nBytesBeingRead = nbyte;
-			nextPageNumber 	= startPageNumber;
-			nextPageOffset 	= startPageOffset + nbyte;
-		}
+		return kWarpStatusOK;
 	}
 
-	size_t nBytesRemaining	= nbyte - nBytesBeingRead;
+	gWarpPersistentState.errorCount = MIN(gWarpPersistentState.errorCount + 1, 0xFF);
 
-	deviceOpsBuffer[0] = 0x03; /* NORD */
-	deviceOpsBuffer[2] = (uint8_t)(startPageNumber);
-	deviceOpsBuffer[1] = (uint8_t)(startPageNumber >> 8);
-	deviceOpsBuffer[3] = startPageOffset;
+	for (uint8_t i = 0; i < kWarpFlashRemapTableEntries; i++)
+	{
+		if ((gWarpPersistentState.remapPageNumbers[i] == chunk->pageNumber) &&
+			(gWarpPersistentState.remapPendingMask & (1 << i)))
+		{
+			return kWarpStatusOK;
+		}
+	}
 
-	status = spiTransactionIS25xP(deviceOpsBuffer, nBytesBeingRead + 4);
-	if (status != kWarpStatusOK)
+	if (warpFlashAddRemap(chunk->pageNumber, true) == 0)
 	{
-		warpPrint("\r\n\tError: communication failed");
-		return status;
+		return kWarpStatusFlashVerifyFailed;
 	}
+	remapUnsavedIS25xP = true;
+
+	return kWarpStatusOK;
+}
 
-	for (size_t i = 0; i < nBytesBeingRead; i++)
+/*
+ *	Queue the chunk streamed since the last Page Program was opened, if any.
+ *	eraseAheadIS25xP() empties the queue after every record, and a record
+ *	shorter than a page makes at most two chunks, so the queue only fills
+ *	for a record longer than that. Then the oldest chunk is checked now, on
+ *	the sample path, to make room.
+ */
+static void
+queueStreamChunkIS25xP(void)
+{
+	if (streamChunkBytesIS25xP == 0)
 	{
-		((uint8_t *)buf)[i] = deviceIS25xPState.spiSinkBuffer[i + 4];
+		return;
 	}
 
-	if (nBytesRemaining == 0)
+	if (verifyQueueLengthIS25xP == kWarpIS25xPVerifyQueueLength)
 	{
-		return kWarpStatusOK;
+		if (verifyChunkIS25xP(&verifyQueueIS25xP[0]) != kWarpStatusOK)
+		{
+			gWarpPersistentState.errorCount = MIN(gWarpPersistentState.errorCount + 1, 0xFF);
+		}
 
+		memmove(&verifyQueueIS25xP[0], &verifyQueueIS25xP[1], (kWarpIS25xPVerifyQueueLength - 1) * sizeof(WarpIS25xPVerifyChunk));
+		verifyQueueLengthIS25xP--;
 	}
-	return readMemoryIS25xP(nextPageNumber, nextPageOffset, nBytesRemaining, (uint8_t *)buf + nBytesBeingRead);
+
+	streamChunkIS25xP.lastPageOffset				= streamChunkIS25xP.pageOffset + streamChunkBytesIS25xP - 1;
+	verifyQueueIS25xP[verifyQueueLengthIS25xP++]	= streamChunkIS25xP;
+	streamChunkBytesIS25xP							= 0;
 }
+#endif
 
-WarpStatus
-programPageIS25xP(uint16_t startPageAddress, uint8_t startPageOffset, size_t nbyte, uint8_t *buf)
+/*
+ *	Check the queued chunks. Needs the flash to be free of erases, and saves
+ *	the remap table if a check failed.
+ */
+static WarpStatus
+verifyQueuedWritesIS25xP(void)
 {
-	if (nbyte > kWarpMemoryCommonSpiBufferBytes - 4)
-	{
-		return kWarpStatusBadDeviceCommand;
-	}
-
-	uint8_t ops[kWarpMemoryCommonSpiBufferBytes] = {0};
-	ops[0] = 0x02; /* PP */
-	ops[2] = (uint8_t)(startPageAddress);
-	ops[1] = (uint8_t)(startPageAddress >>= 8);
-	ops[3] = startPageOffset;
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	WarpStatus	status;
 
-	for (size_t i = 0; i < nbyte; i++)
+	if (gWarpFlashStreamOpen)
 	{
-		ops[i + 4] = buf[i];
+		return kWarpStatusOK;
 	}
 
-	WarpStatus status;
+	queueStreamChunkIS25xP();
 
-	enableIS25xPWrite();
-	status = spiTransactionIS25xP(ops, nbyte + 4);
-	if (status != kWarpStatusOK)
+	for (uint8_t i = 0; i < verifyQueueLengthIS25xP; i++)
 	{
-		warpPrint("\r\n\tError: communication failed");
-		return status;
+		status = verifyChunkIS25xP(&verifyQueueIS25xP[i]);
+		if (status != kWarpStatusOK)
+		{
+			verifyQueueLengthIS25xP = 0;
+
+			return status;
+		}
 	}
+	verifyQueueLengthIS25xP = 0;
 
-	status = waitForWriteCompletion();
-	if (status != kWarpStatusOK)
+	if (remapUnsavedIS25xP)
 	{
-		warpPrint("\r\n\tError: waitForWriteCompletion failed");
-		return status;
-	}
+		remapUnsavedIS25xP = false;
 
-	disableIS25xPWrite();
+		return savePersistentStateIS25xP();
+	}
+#endif
 
-	return status;
+	return kWarpStatusOK;
 }
 
-
-WarpStatus
-eraseSectorIS25xP(uint32_t address)
+/*
+ *	Find the newest slot with a good CRC in one persistent-state sector, and
+ *	the first slot after the programmed ones. *newestSlot is -1 if there is
+ *	no good slot. The second sector was a log sector in older firmware, so
+ *	with requireSectorPair a slot must also carry SectorPair and no unknown
+ *	flags, to make it unlikely that old log data passes for a slot.
+ */
+static WarpStatus
+findPersistentStateIS25xP(uint16_t sector, bool requireSectorPair, int32_t *  newestSlot, uint16_t *  nextSlot, uint32_t *  sequenceNumber)
 {
-	WarpStatus status;
+	WarpStatus			status;
+	WarpPersistentState	slotState;
+	uint16_t			low		= 0;
+	uint16_t			high	= kWarpIS25xPPersistentStateSlotCount;
 
-	uint8_t ops[4] = {0};
-	ops[0] = 0xD7; /* SER (SPI Mode) */
-	ops[2] = (uint8_t)(address <<= 1);
-	ops[1] = (uint8_t)(address >>= 8);
+	/*
+	 *	Slots are only ever appended and the sector is only ever erased as a
+	 *	whole, so the programmed slots form a prefix of the sector. Binary
+	 *	search for the first erased one instead of reading all of them.
+	 */
+	while (low < high)
+	{
+		uint16_t	mid = (low + high) / 2;
 
-	ops[3] = 0x00;
+		status = readPersistentStateSlotIS25xP(sector, mid, &slotState);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
 
-	enableIS25xPWrite();
-	status = spiTransactionIS25xP(ops, 4);
-	if (status != kWarpStatusOK)
-	{
-		warpPrint("\r\n\tError: communication failed");
-		return status;
+		if (isPersistentStateSlotErased(&slotState))
+		{
+			high = mid;
+		}
+		else
+		{
+			low = mid + 1;
+		}
 	}
 
-	status = waitForWriteCompletion();
-	if (status != kWarpStatusOK)
+	*nextSlot	= low;
+	*newestSlot	= -1;
+
+	/*
+	 *	Walk back past any slot left torn by a reset part-way through
+	 *	programming it.
+	 */
+	for (int32_t slot = (int32_t)low - 1; slot >= 0; slot--)
 	{
-		warpPrint("\r\n\tError: waitForWriteCompletion failed");
-		return status;
+		status = readPersistentStateSlotIS25xP(sector, slot, &slotState);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		if (requireSectorPair &&
+			((slotState.flags & ~(kWarpPersistentStateFlagDevicesConfigured | kWarpPersistentStateFlagSectorPair)) ||
+			 !(slotState.flags & kWarpPersistentStateFlagSectorPair)))
+		{
+			continue;
+		}
+
+		if (slotState.crc == warpCrc16((const uint8_t *)&slotState, offsetof(WarpPersistentState, crc)))
+		{
+			*newestSlot		= slot;
+			*sequenceNumber	= slotState.sequenceNumber;
+
+			return kWarpStatusOK;
+		}
 	}
+
 	return kWarpStatusOK;
 }
 
 WarpStatus
-chipEraseIS25xP()
+loadPersistentStateIS25xP(void)
 {
-	warpPrint("\n%s\n", "Erasing chip. This takes about 4s.");
-	enableIS25xPWrite();
-	uint8_t ops[1] = {0};
+	WarpStatus	status;
+	int32_t		firstNewestSlot;
+	int32_t		secondNewestSlot;
+	uint16_t	firstNextSlot;
+	uint16_t	secondNextSlot;
+	int32_t		newestSlot;
+	uint32_t	firstSequenceNumber		= 0;
+	uint32_t	secondSequenceNumber	= 0;
+
+	if (persistentStateLoaded)
+	{
+		return kWarpStatusOK;
+	}
 
-	ops[0] = 0xC7; /* CER (SPI Mode) */
+	/*
+	 *	No remapping while the slots are searched.
+	 */
+	memset(&gWarpPersistentState, 0, sizeof(gWarpPersistentState));
 
-	WarpStatus status;
-	status = spiTransactionIS25xP(ops, 1);
+	status = findPersistentStateIS25xP(kWarpIS25xPPersistentStateFirstSector, false, &firstNewestSlot, &firstNextSlot, &firstSequenceNumber);
 	if (status != kWarpStatusOK)
 	{
-		warpPrint("\r\n\tError: communication failed");
 		return status;
 	}
-	status = waitForWriteCompletion();
-	warpPrint("%s\n", "Chip erased");
-
-	return status;
-}
 
-WarpStatus
-flashStatusIS25xP()
-{
-	uint8_t ops4[2] = 
+	status = findPersistentStateIS25xP(kWarpIS25xPPersistentStateSecondSector, true, &secondNewestSlot, &secondNextSlot, &secondSequenceNumber);
+	if (status != kWarpStatusOK)
 	{
-			/* Read Status Register */
-			0x05, /* Byte0 */
-			0x00, /* Dummy Byte1 */
-	};
-	WarpStatus status = spiTransactionIS25xP(ops4, 2 /* opCount */);
+		return status;
+	}
+
+	/*
+	 *	Both sectors only hold good slots just after the log has moved from a
+	 *	full sector, or after a reset during the erase that starts the move.
+	 *	Either way the newer state is the one with more records behind it, or,
+	 *	for the same number, the one in the sector that is not full.
+	 */
+	if ((secondNewestSlot >= 0) &&
+		((firstNewestSlot < 0) ||
+		 (secondSequenceNumber > firstSequenceNumber) ||
+		 ((secondSequenceNumber == firstSequenceNumber) && (firstNextSlot == kWarpIS25xPPersistentStateSlotCount))))
+	{
+		persistentStateSector	= kWarpIS25xPPersistentStateSecondSector;
+		persistentStateNextSlot	= secondNextSlot;
+		newestSlot				= secondNewestSlot;
+	}
+	else
+	{
+		persistentStateSector	= kWarpIS25xPPersistentStateFirstSector;
+		persistentStateNextSlot	= firstNextSlot;
+		newestSlot				= firstNewestSlot;
+	}
+
+	if (newestSlot >= 0)
+	{
+		status = readPersistentStateSlotIS25xP(persistentStateSector, newestSlot, &gWarpPersistentState);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		persistentStateLoaded = true;
+
+		/*
+		 *	Sector 4071 was the last log sector before it held the persistent
+		 *	state, so a head or tail saved there by older firmware moves round
+		 *	to the start of the log.
+		 */
+		if (gWarpPersistentState.logPageNumber >= kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector)
+		{
+			gWarpPersistentState.logPageNumber	= kWarpInitialPageNumberIS25xP;
+			gWarpPersistentState.logPageOffset	= kWarpInitialPageOffsetIS25xP;
+		}
+		if (gWarpPersistentState.logTailPageNumber >= kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector)
+		{
+			gWarpPersistentState.logTailPageNumber	= kWarpInitialPageNumberIS25xP;
+			gWarpPersistentState.logTailPageOffset	= kWarpInitialPageOffsetIS25xP;
+		}
+
+		/*
+		 *	Slots saved before the erase-ahead manager existed carry no
+		 *	erase position, so treat nothing ahead of the head as erased.
+		 */
+		if ((gWarpPersistentState.eraseAheadSector < kWarpIS25xPFirstLogSector) ||
+			(gWarpPersistentState.eraseAheadSector >= kWarpIS25xPLogEndSector))
+		{
+			gWarpPersistentState.eraseAheadSector = nextLogSectorIS25xP(lastWrittenSectorIS25xP());
+		}
+
+		/*
+		 *	Records streamed since the last save are still in the flash, past
+		 *	the saved head.
+		 */
+		return warpFlashRecoverLogHead(kWarpIS25xPPersistentStateSaveRecords);
+	}
+
+	/*
+	 *	No valid slot. Sector 0 is either freshly erased or still holds the
+	 *	3-byte page pointer written by older firmware, so take the log head
+	 *	from there. The slots after the pointer are still erased, so the log
+	 *	carries on in sector 0 past it.
+	 */
+	uint8_t pageOffsetBuf[3];
+	status = readMemoryIS25xP(kWarpIS25xPPageOffsetStoragePage, kWarpIS25xPPageOffsetStorageOffset, kWarpIS25xPPageOffsetStorageSize, pageOffsetBuf);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	gWarpPersistentState.logPageNumber	= pageOffsetBuf[1] | pageOffsetBuf[0] << 8;
+	gWarpPersistentState.logPageOffset	= pageOffsetBuf[2];
+
+	if ((gWarpPersistentState.logPageNumber < kWarpInitialPageNumberIS25xP) || (gWarpPersistentState.logPageNumber >= kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector))
+	{
+		gWarpPersistentState.logPageNumber	= kWarpInitialPageNumberIS25xP;
+		gWarpPersistentState.logPageOffset	= kWarpInitialPageOffsetIS25xP;
+	}
+
+	/*
+	 *	Nothing says the sectors beyond the head are erased, and once the
+	 *	ring has wrapped they are not, so erase each before the log reaches it.
+	 */
+	gWarpPersistentState.eraseAheadSector = nextLogSectorIS25xP(lastWrittenSectorIS25xP());
+
+	persistentStateLoaded	= true;
+
+	return kWarpStatusOK;
+}
+
+WarpStatus
+savePersistentStateIS25xP(void)
+{
+	WarpStatus	status;
+	uint16_t	sector;
+
+	status = finishEraseAheadIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	if (persistentStateNextSlot >= kWarpIS25xPPersistentStateSlotCount)
+	{
+		sector = (persistentStateSector == kWarpIS25xPPersistentStateFirstSector) ? kWarpIS25xPPersistentStateSecondSector : kWarpIS25xPPersistentStateFirstSector;
+
+		status = startSectorEraseIS25xP(sector);
+		if (status == kWarpStatusOK)
+		{
+			status = waitForWriteCompletion(kWarpIS25xPSectorEraseTypicalMilliseconds, kWarpIS25xPSectorEraseMaxMilliseconds);
+		}
+		if (status != kWarpStatusOK)
+		{
+			warpPrint("\r\n\tError: persistent-state sector erase failed");
+			return status;
+		}
+
+		persistentStateSector	= sector;
+		persistentStateNextSlot	= 0;
+	}
+
+	gWarpPersistentState.flags	|= kWarpPersistentStateFlagSectorPair;
+	gWarpPersistentState.crc	= warpCrc16((const uint8_t *)&gWarpPersistentState, offsetof(WarpPersistentState, crc));
+
+	status = programPageIS25xP(persistentStateSector * kWarpIS25xPPagesPerSector + persistentStateNextSlot / kWarpIS25xPPersistentStateSlotsPerPage,
+							   (persistentStateNextSlot % kWarpIS25xPPersistentStateSlotsPerPage) * sizeof(WarpPersistentState),
+							   sizeof(WarpPersistentState),
+							   (uint8_t *)&gWarpPersistentState);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: programPageIS25xP failed");
+		return status;
+	}
+
+	persistentStateNextSlot++;
+	recordsSinceSaveIS25xP = 0;
+
+	return kWarpStatusOK;
+}
+
+WarpStatus
+writeToIS25xPFromEnd(size_t nbyte, uint8_t *buf)
+{
+	// assume that nbyte < 32
+	WarpStatus status;
+
+	/*
+	 *	The log head is only read from flash on the first write after a reset;
+	 *	after that it is carried in gWarpPersistentState.
+	 */
+	status = loadPersistentStateIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: loadPersistentStateIS25xP failed");
+		return status;
+	}
+
+	uint16_t pageNumber	= gWarpPersistentState.logPageNumber;
+	uint8_t pageOffset	= gWarpPersistentState.logPageOffset;
+
+	status = programMultipleIS25xPWithoutOffsetUpdate(&pageNumber, &pageOffset, nbyte, buf);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: programMultipleIS25xPWithoutOffsetUpdate failed");
+		return status;
+	}
+
+	gWarpPersistentState.logPageNumber = pageNumber;
+	gWarpPersistentState.logPageOffset = pageOffset;
+
+	status = savePersistentStateIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: savePersistentStateIS25xP failed");
+		return status;
+	}
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Open a Page Program at the log head and leave /CS asserted, so that the bytes
+ *	of a record can be clocked straight into the page buffer as they are read
+ *	from the sensors. The program itself starts when /CS is deasserted.
+ */
+static WarpStatus
+openStreamIS25xP(void)
+{
+	spi_status_t status;
+	WarpStatus	 waitStatus;
+	uint16_t	 physicalPageNumber;
+	uint8_t ops[4];
+
+	/*
+	 *	An erase-ahead left running from idle time has to finish before we can
+	 *	program. If the head has reached a sector that idle time did not get
+	 *	round to erasing, erase it now: this is the stall eraseAheadIS25xP()
+	 *	exists to avoid.
+	 */
+	waitStatus = finishEraseAheadIS25xP();
+	if (waitStatus != kWarpStatusOK)
+	{
+		return waitStatus;
+	}
+
+	if ((gWarpPersistentState.logPageOffset == 0) &&
+		(gWarpPersistentState.logPageNumber % kWarpIS25xPPagesPerSector == 0) &&
+		(gWarpPersistentState.logPageNumber / kWarpIS25xPPagesPerSector == gWarpPersistentState.eraseAheadSector))
+	{
+		waitStatus = releaseLogSectorIS25xP(gWarpPersistentState.eraseAheadSector);
+		if (waitStatus != kWarpStatusOK)
+		{
+			return waitStatus;
+		}
+
+		waitStatus = startSectorEraseIS25xP(gWarpPersistentState.eraseAheadSector);
+		if (waitStatus != kWarpStatusOK)
+		{
+			return waitStatus;
+		}
+
+		eraseAheadInProgress = true;
+		waitStatus = finishEraseAheadIS25xP();
+		if (waitStatus != kWarpStatusOK)
+		{
+			return waitStatus;
+		}
+	}
+
+	/*
+	 *	The previous page may still be programming, e.g., if another SPI
+	 *	transaction ended the stream part-way through a record.
+	 */
+	waitStatus = waitForWriteCompletion(0, kWarpIS25xPPageProgramMaxMilliseconds);
+	if (waitStatus != kWarpStatusOK)
+	{
+		return waitStatus;
+	}
+
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	/*
+	 *	Another SPI transaction, e.g., a sensor read part-way through a
+	 *	record, ends the Page Program without closeStreamIS25xP(). The bytes
+	 *	programmed next follow on in the same page, so carry on with the same
+	 *	chunk rather than queueing one for every sensor.
+	 */
+	if ((streamChunkBytesIS25xP != 0) &&
+		((streamChunkIS25xP.pageNumber != gWarpPersistentState.logPageNumber) ||
+		 (streamChunkIS25xP.pageOffset + streamChunkBytesIS25xP != gWarpPersistentState.logPageOffset)))
+	{
+		queueStreamChunkIS25xP();
+	}
+
+	if (streamChunkBytesIS25xP == 0)
+	{
+		streamChunkIS25xP.pageNumber	= gWarpPersistentState.logPageNumber;
+		streamChunkIS25xP.pageOffset	= gWarpPersistentState.logPageOffset;
+		streamChunkIS25xP.crc			= 0xFFFF;
+	}
+#endif
+
+	physicalPageNumber = warpFlashRemapPage(gWarpPersistentState.logPageNumber);
+
+	enableIS25xPWrite();
+
+	ops[0] = 0x02; /* PP */
+	ops[1] = (uint8_t)(physicalPageNumber >> 8);
+	ops[2] = (uint8_t)(physicalPageNumber);
+	ops[3] = gWarpPersistentState.logPageOffset;
+
+	warpScaleSupplyVoltage(deviceIS25xPState.operatingVoltageMillivolts);
+	warpDeasserAllSPIchipSelects();
+	warpEnableSPIpins();
+	GPIO_DRV_ClearPinOutput(deviceIS25xPState.chipSelectIoPinID);
+
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */, NULL, ops, NULL, 4, gWarpSpiTimeoutMicroseconds);
+	if (status != kStatus_SPI_Success)
+	{
+		GPIO_DRV_SetPinOutput(deviceIS25xPState.chipSelectIoPinID);
+		warpDisableSPIpins();
+
+		return kWarpStatusDeviceCommunicationFailed;
+	}
+
+	gWarpFlashStreamOpen = true;
+
+	return kWarpStatusOK;
+}
+
+static void
+closeStreamIS25xP(void)
+{
+	/*
+	 *	If another SPI transaction has happened since the stream was opened,
+	 *	warpDeasserAllSPIchipSelects() has already ended it.
+	 */
+	if (gWarpFlashStreamOpen)
+	{
+		GPIO_DRV_SetPinOutput(deviceIS25xPState.chipSelectIoPinID);
+		warpDisableSPIpins();
+		gWarpFlashStreamOpen = false;
+	}
+
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	queueStreamChunkIS25xP();
+#endif
+}
+
+WarpStatus
+beginStreamToIS25xP(void)
+{
+	WarpStatus status;
+
+	status = loadPersistentStateIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: loadPersistentStateIS25xP failed");
+		return status;
+	}
+
+#if (!WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	if (gWarpPersistentState.logPageNumber == 0)
+	{
+		return kWarpStatusFlashFull;
+	}
+#endif
+
+	status = warpFlashIndexRecordStart(gWarpPersistentState.logPageNumber, gWarpPersistentState.logPageOffset);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	streamStatusIS25xP = kWarpStatusOK;
+
+	return kWarpStatusOK;
+}
+
+void
+streamByteToIS25xP(uint8_t byte)
+{
+	spi_status_t status;
+
+	if (streamStatusIS25xP != kWarpStatusOK)
+	{
+		return;
+	}
+
+	if (!gWarpFlashStreamOpen)
+	{
+		streamStatusIS25xP = openStreamIS25xP();
+		if (streamStatusIS25xP != kWarpStatusOK)
+		{
+			return;
+		}
+	}
+
+	status = SPI_DRV_MasterTransferBlocking(0 /* master instance */, NULL, &byte, NULL, 1, gWarpSpiTimeoutMicroseconds);
+	if (status != kStatus_SPI_Success)
+	{
+		closeStreamIS25xP();
+		streamStatusIS25xP = kWarpStatusDeviceCommunicationFailed;
+
+		return;
+	}
+
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	streamChunkIS25xP.crc = warpCrc16Update(streamChunkIS25xP.crc, &byte, 1);
+	streamChunkBytesIS25xP++;
+#endif
+
+	/*
+	 *	The page offset is 8 bits wide and pages are 256 bytes, so it wraps to
+	 *	zero exactly at the end of the page. A page program cannot cross into
+	 *	the next page, so end it there and open a new one on the next byte.
+	 */
+	gWarpPersistentState.logPageOffset++;
+	if (gWarpPersistentState.logPageOffset == 0)
+	{
+		gWarpPersistentState.logPageNumber++;
+		if (gWarpPersistentState.logPageNumber == kWarpIS25xPLogEndSector * kWarpIS25xPPagesPerSector)
+		{
+#if (WARP_BUILD_ENABLE_FLASH_RING_LOG)
+			/*
+			 *	Wrapped past the end of the log: continue after the
+			 *	persistent-state sector, into sectors already erased ahead.
+			 */
+			gWarpPersistentState.logPageNumber = kWarpInitialPageNumberIS25xP;
+			if (gWarpPersistentState.logTailPageNumber == 0)
+			{
+				gWarpPersistentState.logTailPageNumber = kWarpInitialPageNumberIS25xP;
+				gWarpPersistentState.logTailPageOffset = kWarpInitialPageOffsetIS25xP;
+			}
+#else
+			/*
+			 *	Full: page 0 is never a log page, so it marks the end.
+			 */
+			gWarpPersistentState.logPageNumber = 0;
+			streamStatusIS25xP = kWarpStatusFlashFull;
+#endif
+		}
+		closeStreamIS25xP();
+	}
+}
+
+/*
+ *	Call between records, when there is idle time. Completes an erase started
+ *	earlier if the flash has finished it, checks the chunks programmed since
+ *	the last call, then starts erasing the next sector if fewer than
+ *	kWarpIS25xPEraseAheadSectors are erased ahead of the log head. Only waits
+ *	for an erase to finish if the verify queue would otherwise fill.
+ */
+WarpStatus
+eraseAheadIS25xP(void)
+{
+	WarpStatus status;
+
+	status = loadPersistentStateIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	if (eraseAheadInProgress)
+	{
+		/*
+		 *	With a zero maximum this polls the status for at most about a millisecond.
+		 */
+		status = warpWaitForFlashReady(&deviceIS25xPState, 0x05 /* RDSR */, 0x01, 0x00, 0, 0);
+		if (status == kWarpStatusFlashReadyTimeout)
+		{
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+			/*
+			 *	Chunks can only be checked with the erase done. If there are
+			 *	enough waiting that the next record could fill the queue, wait
+			 *	for it here rather than check them on the sample path.
+			 */
+			if (verifyQueueLengthIS25xP + 2 <= kWarpIS25xPVerifyQueueLength)
+			{
+				return kWarpStatusOK;
+			}
+
+			status = finishEraseAheadIS25xP();
+			if (status != kWarpStatusOK)
+			{
+				return status;
+			}
+
+			return verifyQueuedWritesIS25xP();
+#else
+			return kWarpStatusOK;
+#endif
+		}
+		else if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		eraseAheadInProgress = false;
+		gWarpPersistentState.eraseAheadSector = nextLogSectorIS25xP(gWarpPersistentState.eraseAheadSector);
+	}
+
+	/*
+	 *	With no erase running the log can be read back, so check what the
+	 *	last records programmed before starting another.
+	 */
+	status = verifyQueuedWritesIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	if (erasedSectorsAheadIS25xP() >= kWarpIS25xPEraseAheadSectors)
+	{
+		return kWarpStatusOK;
+	}
+
+#if (!WARP_BUILD_ENABLE_FLASH_RING_LOG)
+	/*
+	 *	Without the ring log, never erase round to the start of the log.
+	 */
+	if (gWarpPersistentState.eraseAheadSector <= lastWrittenSectorIS25xP())
+	{
+		return kWarpStatusOK;
+	}
+#endif
+
+	status = releaseLogSectorIS25xP(gWarpPersistentState.eraseAheadSector);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	status = startSectorEraseIS25xP(gWarpPersistentState.eraseAheadSector);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	eraseAheadInProgress = true;
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Wait (sleeping, see warpWaitForFlashReady()) for an erase started by
+ *	eraseAheadIS25xP(), e.g., before putting the flash into deep power-down.
+ */
+WarpStatus
+finishEraseAheadIS25xP(void)
+{
+	WarpStatus status;
+
+	if (!eraseAheadInProgress)
+	{
+		return kWarpStatusOK;
+	}
+
+	status = waitForWriteCompletion(kWarpIS25xPSectorEraseTypicalMilliseconds, kWarpIS25xPSectorEraseMaxMilliseconds);
 	if (status != kWarpStatusOK)
 	{
-		warpPrint("SPI transaction to read Flash ID failed...\n");
+		return status;
 	}
-	else
+
+	eraseAheadInProgress = false;
+	gWarpPersistentState.eraseAheadSector = nextLogSectorIS25xP(gWarpPersistentState.eraseAheadSector);
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Program a time-index entry. Entries go round the index sectors in order,
+ *	so the first entry in a sector erases it, and the oldest entries with it.
+ */
+WarpStatus
+writeIndexEntryIS25xP(uint16_t entryIndex, size_t nbyte, uint8_t *  entry)
+{
+	WarpStatus	status;
+	uint16_t	sector			= kWarpIS25xPIndexFirstSector + entryIndex / kWarpIS25xPIndexEntriesPerSector;
+	uint16_t	entryInSector	= entryIndex % kWarpIS25xPIndexEntriesPerSector;
+
+	status = finishEraseAheadIS25xP();
+	if (status != kWarpStatusOK)
 	{
-		warpPrint("Flash Status = [" BYTE_TO_BINARY_PATTERN "]\n",
-							BYTE_TO_BINARY(deviceIS25xPState.spiSinkBuffer[1]));
-		return kWarpStatusOK;
+		return status;
+	}
+
+	if (entryInSector == 0)
+	{
+		status = startSectorEraseIS25xP(sector);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		status = waitForWriteCompletion(kWarpIS25xPSectorEraseTypicalMilliseconds, kWarpIS25xPSectorEraseMaxMilliseconds);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
 	}
+
+	return programPageIS25xP(sector * kWarpIS25xPPagesPerSector + (entryInSector * nbyte) / kWarpSizeIS25xPPageSizeBytes,
+							 (entryInSector * nbyte) % kWarpSizeIS25xPPageSizeBytes,
+							 nbyte,
+							 entry);
 }
 
 WarpStatus
-waitForWriteCompletion()
+endStreamToIS25xP(void)
 {
-	uint8_t ops4[] = 
+	WarpStatus status;
+
+	closeStreamIS25xP();
+	if (streamStatusIS25xP != kWarpStatusOK)
 	{
-			/* Read Status Register */
-			0x05, /* Byte0 */
-			0x00, /* Dummy Byte1 */
-	};
+		return streamStatusIS25xP;
+	}
+
+	status = waitForWriteCompletion(kWarpIS25xPPageProgramTypicalMilliseconds, kWarpIS25xPPageProgramMaxMilliseconds);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	/*
+	 *	Between saves, a reset loses nothing: loadPersistentStateIS25xP()
+	 *	finds these records again.
+	 */
+	recordsSinceSaveIS25xP++;
+	if (recordsSinceSaveIS25xP >= kWarpIS25xPPersistentStateSaveRecords)
+	{
+		return savePersistentStateIS25xP();
+	}
+
+	return kWarpStatusOK;
+}
 
+void
+byteOffsetToAddress(uint32_t byteOffset, uint8_t *address)
+{
+	address[2] = (uint8_t)(byteOffset);
+	address[1] = (uint8_t)(byteOffset >>= 8);
+	address[0] = (uint8_t)(byteOffset >>= 8);
+}
+
+WarpStatus
+programPageNumberAndOffset(uint16_t pageNumber, uint8_t pageOffset)
+{
 	WarpStatus status;
-	status = spiTransactionIS25xP(ops4, sizeof(ops4) / sizeof(uint8_t) /* opCount */);
+	status = eraseSectorIS25xP(0);
 	if (status != kWarpStatusOK)
 	{
-		warpPrint("\r\n\tError: communication failed");
+		warpPrint("\r\n\tError:raseSectorIS25xP failed");
+		return status;
+	}
+
+	uint8_t address[3];
+	address[1] = (uint8_t)(pageNumber);
+	address[0] = (uint8_t)(pageNumber >> 8);
+	address[2] = pageOffset;
+
+
+	status = programPageIS25xP(0, 0, 3, address);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: programPageIS25xP failed");
+		return status;
+	}
+	return kWarpStatusOK;
+}
+
+WarpStatus
+resetIS25xP()
+{
+	WarpStatus status;
+
+	status = finishEraseAheadIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	status = chipEraseIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: chipEraseIS25xP failed");
+		return status;
+	}
+
+	memset(&gWarpPersistentState, 0, sizeof(gWarpPersistentState));
+	gWarpPersistentState.logPageNumber	= kWarpInitialPageNumberIS25xP;
+	gWarpPersistentState.logPageOffset	= kWarpInitialPageOffsetIS25xP;
+	gWarpPersistentState.eraseAheadSector	= lastWrittenSectorIS25xP();
+#if (WARP_BUILD_ENABLE_FLASH_VERIFY)
+	streamChunkBytesIS25xP	= 0;
+	verifyQueueLengthIS25xP	= 0;
+	remapUnsavedIS25xP		= false;
+#endif
+	persistentStateSector				= kWarpIS25xPPersistentStateFirstSector;
+	persistentStateNextSlot				= 0;
+	persistentStateLoaded				= true;
+
+	status = savePersistentStateIS25xP();
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: savePersistentStateIS25xP failed");
 		return status;
 	}
 
-	while ((deviceIS25xPState.spiSinkBuffer[1] & 0x1))
+	return kWarpStatusOK;
+}
+
+/*
+ *	Reads as many pieces as needed, each within one page and within the SPI
+ *	buffer, in a loop rather than by recursion so the stack used does not
+ *	grow with nbyte.
+ */
+WarpStatus
+readMemoryIS25xP(uint16_t startPageNumber, uint8_t startPageOffset, size_t nbyte, void *buf)
+{
+	WarpStatus	status;
+	uint16_t	pageNumber		= startPageNumber;
+	size_t		pageOffset		= startPageOffset;
+	uint8_t *	readPointer		= (uint8_t *)buf;
+	size_t		nBytesSpiLimit	= kWarpMemoryCommonSpiBufferBytes - 4;
+	size_t		nBytesBeingRead;
+	uint16_t	physicalPageNumber;
+
+	if (nbyte > kWarpSizeIS25xPPageSizeBytes)
+	{
+		return kWarpStatusBadDeviceCommand;
+	}
+
+	while (nbyte > 0)
 	{
-		OSA_TimeDelay(1);
+		nBytesBeingRead = MIN(nbyte, MIN(nBytesSpiLimit, kWarpSizeIS25xPPageSizeBytes - pageOffset));
+
+		physicalPageNumber = warpFlashRemapPage(pageNumber);
 
-		status = spiTransactionIS25xP(ops4, sizeof(ops4) / sizeof(uint8_t) /* opCount */);
+		deviceOpsBuffer[0] = 0x03; /* NORD */
+		deviceOpsBuffer[2] = (uint8_t)(physicalPageNumber);
+		deviceOpsBuffer[1] = (uint8_t)(physicalPageNumber >> 8);
+		deviceOpsBuffer[3] = (uint8_t)pageOffset;
+
+		status = spiTransactionIS25xP(deviceOpsBuffer, nBytesBeingRead + 4);
 		if (status != kWarpStatusOK)
 		{
 			warpPrint("\r\n\tError: communication failed");
 			return status;
 		}
+
+		for (size_t i = 0; i < nBytesBeingRead; i++)
+		{
+			readPointer[i] = deviceIS25xPState.spiSinkBuffer[i + 4];
+		}
+
+		readPointer	+= nBytesBeingRead;
+		nbyte		-= nBytesBeingRead;
+		pageOffset	+= nBytesBeingRead;
+
+		if (pageOffset == kWarpSizeIS25xPPageSizeBytes)
+		{
+			pageNumber++;
+			pageOffset = 0;
+		}
+	}
+
+	return kWarpStatusOK;
+}
+
+WarpStatus
+programPageIS25xP(uint16_t startPageAddress, uint8_t startPageOffset, size_t nbyte, uint8_t *buf)
+{
+	if (nbyte > kWarpMemoryCommonSpiBufferBytes - 4)
+	{
+		return kWarpStatusBadDeviceCommand;
+	}
+
+	startPageAddress = warpFlashRemapPage(startPageAddress);
+
+	uint8_t ops[kWarpMemoryCommonSpiBufferBytes] = {0};
+	ops[0] = 0x02; /* PP */
+	ops[2] = (uint8_t)(startPageAddress);
+	ops[1] = (uint8_t)(startPageAddress >>= 8);
+	ops[3] = startPageOffset;
+
+	for (size_t i = 0; i < nbyte; i++)
+	{
+		ops[i + 4] = buf[i];
+	}
+
+	WarpStatus status;
+
+	enableIS25xPWrite();
+	status = spiTransactionIS25xP(ops, nbyte + 4);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: communication failed");
+		return status;
+	}
+
+	status = waitForWriteCompletion(kWarpIS25xPPageProgramTypicalMilliseconds, kWarpIS25xPPageProgramMaxMilliseconds);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: waitForWriteCompletion failed");
+		return status;
+	}
+
+	disableIS25xPWrite();
+
+	return status;
+}
+
+
+WarpStatus
+eraseSectorIS25xP(uint32_t address)
+{
+	WarpStatus status;
+
+	uint8_t ops[4] = {0};
+	ops[0] = 0xD7; /* SER (SPI Mode) */
+	ops[2] = (uint8_t)(address <<= 1);
+	ops[1] = (uint8_t)(address >>= 8);
+
+	ops[3] = 0x00;
+
+	enableIS25xPWrite();
+	status = spiTransactionIS25xP(ops, 4);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: communication failed");
+		return status;
+	}
+
+	status = waitForWriteCompletion(kWarpIS25xPSectorEraseTypicalMilliseconds, kWarpIS25xPSectorEraseMaxMilliseconds);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: waitForWriteCompletion failed");
+		return status;
 	}
 	return kWarpStatusOK;
 }
+
+WarpStatus
+chipEraseIS25xP()
+{
+	warpPrint("\n%s\n", "Erasing chip. This takes about 4s.");
+	enableIS25xPWrite();
+	uint8_t ops[1] = {0};
+
+	ops[0] = 0xC7; /* CER (SPI Mode) */
+
+	WarpStatus status;
+	status = spiTransactionIS25xP(ops, 1);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("\r\n\tError: communication failed");
+		return status;
+	}
+	status = waitForWriteCompletion(kWarpIS25xPChipEraseTypicalMilliseconds, kWarpIS25xPChipEraseMaxMilliseconds);
+	warpPrint("%s\n", "Chip erased");
+
+	return status;
+}
+
+WarpStatus
+flashStatusIS25xP()
+{
+	uint8_t ops4[2] = 
+	{
+			/* Read Status Register */
+			0x05, /* Byte0 */
+			0x00, /* Dummy Byte1 */
+	};
+	WarpStatus status = spiTransactionIS25xP(ops4, 2 /* opCount */);
+	if (status != kWarpStatusOK)
+	{
+		warpPrint("SPI transaction to read Flash ID failed...\n");
+	}
+	else
+	{
+		warpPrint("Flash Status = [" BYTE_TO_BINARY_PATTERN "]\n",
+							BYTE_TO_BINARY(deviceIS25xPState.spiSinkBuffer[1]));
+		return kWarpStatusOK;
+	}
+}
+
+WarpStatus
+waitForWriteCompletion(uint32_t typicalMilliseconds, uint32_t maximumMilliseconds)
+{
+	/*
+	 *	Read Status Register (0x05); bit 0 is WIP, clear when ready.
+	 */
+	return warpWaitForFlashReady(&deviceIS25xPState, 0x05, 0x01, 0x00, typicalMilliseconds, maximumMilliseconds);
+}
 WarpStatus
 deepPowerModeIS25xP()
 {
@@ -570,7 +1579,7 @@ deepPowerModeIS25xP()
 		warpPrint("\r\n\tError: communication failed");
 		return status;
 	}
-	waitForWriteCompletion();
+	waitForWriteCompletion(0, kWarpIS25xPPowerDownMaxMilliseconds);
 	
 
 	return status;
@@ -590,7 +1599,7 @@ releaseDeepPowerModeIS25xP()
 		warpPrint("\r\n\tError: communication failed");
 		return status;
 	}
-	waitForWriteCompletion();
+	waitForWriteCompletion(0, kWarpIS25xPPowerDownMaxMilliseconds);
 
 	return status;
 }
\ No newline at end of file
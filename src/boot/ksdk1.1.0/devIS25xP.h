@@ -38,10 +38,70 @@
 #define kWarpInitialPageNumberIS25xP		0x10
 #define kWarpInitialPageOffsetIS25xP		0x00
 
+/*
+ *	Typical and maximum busy times in milliseconds, from the AC characteristics
+ *	in the IS25WP datasheet. A typical time of 0 means the operation is too short
+ *	to be worth sleeping through.
+ */
+#define kWarpIS25xPPageProgramTypicalMilliseconds	0	/* tPP: 0.2ms typical, 0.8ms max	*/
+#define kWarpIS25xPPageProgramMaxMilliseconds		1
+#define kWarpIS25xPSectorEraseTypicalMilliseconds	70	/* tSE	*/
+#define kWarpIS25xPSectorEraseMaxMilliseconds		300
+#define kWarpIS25xPChipEraseTypicalMilliseconds		4000	/* tCE	*/
+#define kWarpIS25xPChipEraseMaxMilliseconds			180000	/* Worst case for the 128Mbit IS25WP128	*/
+#define kWarpIS25xPPowerDownMaxMilliseconds			1	/* tDP, tRES1: a few microseconds	*/
+
 const uint16_t 	kWarpIS25xPPageOffsetStoragePage 	= 0;
 const uint8_t 	kWarpIS25xPPageOffsetStorageOffset 	= 0;
 const size_t 	kWarpIS25xPPageOffsetStorageSize	= 3;
 
+/*
+ *	The persistent state is an append-only log of 32-byte WarpPersistentState
+ *	slots in sector 0. When the sector fills, the log moves to sector 4071
+ *	and back again, erasing the sector it moves into, so the last good slot
+ *	is never in the sector being erased. It is saved every
+ *	kWarpIS25xPPersistentStateSaveRecords records and whenever sampling
+ *	stops; the records written since the last save are found again after a
+ *	reset (see warpFlashRecoverLogHead()).
+ */
+#define kWarpIS25xPPersistentStateFirstSector	0
+#define kWarpIS25xPPersistentStateSecondSector	4071
+#define kWarpIS25xPPersistentStateSlotsPerPage	8
+#define kWarpIS25xPPersistentStateSlotCount		128
+#define kWarpIS25xPPersistentStateSaveRecords	16
+
+/*
+ *	The log runs through sectors 1 to 4070 of the IS25WP128 as a ring. The
+ *	erase-ahead manager tries to keep this many sectors beyond the log head
+ *	erased, so that the sample path never has to wait for an erase.
+ */
+#define kWarpIS25xPPagesPerSector				16
+#define kWarpIS25xPFirstLogSector				1
+#define kWarpIS25xPLogEndSector					4071
+#define kWarpIS25xPEraseAheadSectors			2
+
+/*
+ *	Sectors 4072 to 4078 are spares for log pages that fail write
+ *	verification, one sector per remap table entry since a sector is the
+ *	smallest unit the chip can erase. Only the first page of each is used.
+ */
+#define kWarpIS25xPSpareFirstSector				4072
+
+/*
+ *	Chunks of the log programmed but not yet read back and checked against
+ *	the CRC of the bytes streamed into them.
+ */
+#define kWarpIS25xPVerifyQueueLength			4
+
+/*
+ *	The last 17 sectors hold the time index, a ring of 16-byte entries (see
+ *	warpFlashIndexRecordStart()). Its oldest sector is erased as it wraps, so
+ *	it is one sector larger than the 4070 entries a full log needs.
+ */
+#define kWarpIS25xPIndexFirstSector				4079
+#define kWarpIS25xPIndexEntriesPerSector		256
+#define kWarpIS25xPIndexEntries					(17 * kWarpIS25xPIndexEntriesPerSector)
+
 void		initIS25xP(int chipSelectIoPinID, uint16_t operatingVoltageMillivolts);
 
 /**
@@ -74,9 +134,17 @@ WarpStatus 	chipEraseIS25xP();
 WarpStatus 	programPageNumberAndOffset(uint16_t pageNumber, uint8_t pageOffset);
 WarpStatus 	resetIS25xP();
 WarpStatus 	writeToIS25xPFromEnd(size_t nbyte, uint8_t* buf);
+WarpStatus 	loadPersistentStateIS25xP(void);
+WarpStatus 	savePersistentStateIS25xP(void);
+WarpStatus 	beginStreamToIS25xP(void);
+void 		streamByteToIS25xP(uint8_t byte);
+WarpStatus 	endStreamToIS25xP(void);
+WarpStatus 	eraseAheadIS25xP(void);
+WarpStatus 	writeIndexEntryIS25xP(uint16_t entryIndex, size_t nbyte, uint8_t *  entry);
+WarpStatus 	finishEraseAheadIS25xP(void);
 void 		enableIS25xPWrite();
 void 		disableIS25xPWrite();
 WarpStatus 	flashStatusIS25xP();
-WarpStatus 	waitForWriteCompletion();
+WarpStatus 	waitForWriteCompletion(uint32_t typicalMilliseconds, uint32_t maximumMilliseconds);
 WarpStatus 	deepPowerModeIS25xP();
 WarpStatus 	releaseDeepPowerModeIS25xP();
\ No newline at end of file
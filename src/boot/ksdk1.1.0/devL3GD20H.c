@@ -62,6 +62,14 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+/*
+ *	Set once configureFifoL3GD20H() has enabled the FIFO, so that
+ *	appendSensorDataL3GD20H() drains it.
+ */
+static bool							fifoL3GD20H = false;
+
+WarpStatus	readFifoL3GD20H(int16_t *  samples, uint8_t maxSamples, uint8_t *  samplesRead);
+
 
 
 void
@@ -143,6 +151,11 @@ configureSensorL3GD20H(uint8_t payloadCTRL1, uint8_t payloadCTRL2, uint8_t paylo
 										 payloadCTRL5 /* payload */
 	);
 
+	/*
+	 *	CTRL5 has FIFO_EN; configureFifoL3GD20H() turns the FIFO on again.
+	 */
+	fifoL3GD20H = false;
+
 	return (status1 | status2 | status3);
 }
 
@@ -204,81 +217,90 @@ readSensorRegisterL3GD20H(uint8_t deviceRegister, int numberOfBytes)
 }
 
 
-void
-printSensorDataL3GD20H(bool hexModeFlag)
+/*
+ *	Read numberOfBytes consecutive registers in one transaction, by setting
+ *	the MSB of the sub-address so that it auto-increments (Section 5.1.1 of
+ *	the L3GD20H manual). With the FIFO enabled, reads past OUT_Z_H wrap back
+ *	to OUT_X_L and pop the next sample.
+ */
+static WarpStatus
+burstReadL3GD20H(uint8_t deviceRegister, uint8_t *  buffer, size_t numberOfBytes)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
-	int8_t		readSensorRegisterSignedByte;
-	WarpStatus	i2cReadStatusLow, i2cReadStatusHigh;
+	uint8_t		cmdBuf[1] = {0xFF};
+	i2c_status_t	status;
 
+	i2c_device_t slave =
+		{
+		.address = deviceL3GD20HState.i2cAddress,
+		.baudRate_kbps = gWarpI2cBaudRateKbps
+	};
 
 	warpScaleSupplyVoltage(deviceL3GD20HState.operatingVoltageMillivolts);
+	cmdBuf[0] = deviceRegister | 0x80;
+	warpEnableI2Cpins();
 
-	i2cReadStatusLow = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_X_L, 1 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceL3GD20HState.i2cBuffer[0];
-	i2cReadStatusHigh = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_X_H, 1 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceL3GD20HState.i2cBuffer[0];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+	status = I2C_DRV_MasterReceiveDataBlocking(
+		0 /* I2C peripheral instance */,
+		&slave,
+		cmdBuf,
+		1,
+		buffer,
+		numberOfBytes,
+		gWarpI2cTimeoutMilliseconds);
 
-	if ((i2cReadStatusLow != kWarpStatusOK) || (i2cReadStatusHigh != kWarpStatusOK))
-	{
-		warpPrint(" ----,");
-	}
-	else
+	if (status != kStatus_I2C_Success)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
-		}
+		return kWarpStatusDeviceCommunicationFailed;
 	}
 
-	i2cReadStatusLow = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Y_L, 1 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceL3GD20HState.i2cBuffer[0];
-	i2cReadStatusHigh = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Y_H, 1 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceL3GD20HState.i2cBuffer[0];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+	return kWarpStatusOK;
+}
 
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+/*
+ *	OUT_TEMP (0x26) through OUT_Z_H (0x2D) in one burst: temperature,
+ *	STATUS, then X, Y and Z LSB first.
+ */
+static WarpStatus
+readOutputsL3GD20H(uint8_t *  data)
+{
+	return burstReadL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_TEMP, data, kWarpSizesL3GD20HBurstBytes);
+}
 
-	if ((i2cReadStatusLow != kWarpStatusOK) || (i2cReadStatusHigh != kWarpStatusOK))
-	{
-		warpPrint(" ----,");
-	}
-	else
+void
+printSensorDataL3GD20H(bool hexModeFlag)
+{
+	uint8_t		data[kWarpSizesL3GD20HBurstBytes];
+	int16_t		readSensorRegisterValueCombined;
+	WarpStatus	i2cReadStatus;
+
+	i2cReadStatus = readOutputsL3GD20H(data);
+
+	for (uint8_t i = 2; i < kWarpSizesL3GD20HBurstBytes; i += 2)
 	{
-		if (hexModeFlag)
+		readSensorRegisterValueCombined = ((data[i + 1] & 0xFF) << 8) | (data[i] & 0xFF);
+
+		/*
+		 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
+		 */
+
+		if (i2cReadStatus != kWarpStatusOK)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
+			warpPrint(" ----,");
 		}
 		else
 		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			if (hexModeFlag)
+			{
+				warpPrint(" 0x%02x 0x%02x,", data[i + 1], data[i]);
+			}
+			else
+			{
+				warpPrint(" %d,", readSensorRegisterValueCombined);
+			}
 		}
 	}
 
-	i2cReadStatusLow = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Z_L, 1 /* numberOfBytes */);
-	readSensorRegisterValueLSB = deviceL3GD20HState.i2cBuffer[0];
-	i2cReadStatusHigh = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Z_H, 1 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceL3GD20HState.i2cBuffer[0];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
-
-	if ((i2cReadStatusLow != kWarpStatusOK) || (i2cReadStatusHigh != kWarpStatusOK))
+	if (i2cReadStatus != kWarpStatusOK)
 	{
 		warpPrint(" ----,");
 	}
@@ -286,167 +308,160 @@ printSensorDataL3GD20H(bool hexModeFlag)
 	{
 		if (hexModeFlag)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
+			warpPrint(" 0x%02x,", data[0]);
 		}
 		else
 		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			warpPrint(" %d,", (int8_t)data[0]);
 		}
 	}
+}
 
-	i2cReadStatusLow = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_TEMP, 1 /* numberOfBytes */);
-	readSensorRegisterSignedByte = deviceL3GD20HState.i2cBuffer[0];
+static uint8_t
+streamReadingL3GD20H(WarpStatus i2cReadStatus, int16_t reading)
+{
+	if (i2cReadStatus != kWarpStatusOK)
+	{
+		reading = 0;
+	}
 
 	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int8_t
+	 * MSB first
 	 */
+	warpFlashStreamByte((uint8_t)(reading >> 8));
+	warpFlashStreamByte((uint8_t)(reading));
 
-	if (i2cReadStatusLow != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
-	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x,", deviceL3GD20HState.i2cBuffer[0]);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterSignedByte);
-		}
-	}
+	return 2;
 }
 
+/*
+ *	With the FIFO enabled, reading the outputs pops the oldest sample, and X,
+ *	Y and Z are the mean of that and the rest of the FIFO, so that records
+ *	further apart than the sample period still use every sample.
+ */
 uint8_t
-appendSensorDataL3GD20H(uint8_t* buf)
+appendSensorDataL3GD20H(void)
 {
-	uint8_t index = 0;
+	uint8_t		index = 0;
+	uint8_t		data[kWarpSizesL3GD20HBurstBytes];
+	int16_t		samples[3 * kWarpSizesL3GD20HFifoBurstSamples];
+	int32_t		sum[3];
+	uint16_t	count = 1;
+	uint8_t		samplesRead;
+	WarpStatus	i2cReadStatus;
 
-	uint16_t readSensorRegisterValueLSB;
-	uint16_t readSensorRegisterValueMSB;
-	int16_t readSensorRegisterValueCombined;
-	int16_t readSensorRegisterSignedByte;
-	WarpStatus i2cReadStatusLow, i2cReadStatusHigh;
+	i2cReadStatus = readOutputsL3GD20H(data);
 
-	warpScaleSupplyVoltage(deviceL3GD20HState.operatingVoltageMillivolts);
-
-	i2cReadStatusLow                = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_X_L, 1 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceL3GD20HState.i2cBuffer[0];
-	i2cReadStatusHigh               = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_X_H, 1 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceL3GD20HState.i2cBuffer[0];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+	for (uint8_t j = 0; j < 3; j++)
+	{
+		sum[j] = (int16_t)(((data[2 * j + 3] & 0xFF) << 8) | (data[2 * j + 2] & 0xFF));
+	}
 
 	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
+	 *	At most one FIFO's worth, so that a FIFO filling as fast as it is
+	 *	read cannot keep us here.
 	 */
-
-	if ((i2cReadStatusLow != kWarpStatusOK) || (i2cReadStatusHigh != kWarpStatusOK))
+	while (fifoL3GD20H && (i2cReadStatus == kWarpStatusOK) && (count <= kWarpSizesL3GD20HFifoSamples))
 	{
-		buf[index] = 0;
-		index += 1;
+		if (readFifoL3GD20H(samples, kWarpSizesL3GD20HFifoBurstSamples, &samplesRead) != kWarpStatusOK)
+		{
+			break;
+		}
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+		for (uint8_t i = 0; i < samplesRead; i++)
+		{
+			for (uint8_t j = 0; j < 3; j++)
+			{
+				sum[j] += samples[3 * i + j];
+			}
+		}
+		count += samplesRead;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+		if (samplesRead < kWarpSizesL3GD20HFifoBurstSamples)
+		{
+			break;
+		}
 	}
 
-	i2cReadStatusLow                = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Y_L, 1 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceL3GD20HState.i2cBuffer[0];
-	i2cReadStatusHigh               = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Y_H, 1 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceL3GD20HState.i2cBuffer[0];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+	for (uint8_t j = 0; j < 3; j++)
+	{
+		index += streamReadingL3GD20H(i2cReadStatus, sum[j] / count);
+	}
 
 	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
+	 *	Temperature, sign extended to 16 bits
 	 */
+	index += streamReadingL3GD20H(i2cReadStatus, (int8_t)data[0]);
 
-	if ((i2cReadStatusLow != kWarpStatusOK) || (i2cReadStatusHigh != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
+	return index;
+}
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+/*
+ *	Enable the 32-sample FIFO in stream mode, with the watermark flag (and
+ *	the INT2/DRDY pin) raised once watermarkSamples samples are waiting.
+ *	Replaces the CTRL5 written by configureSensorL3GD20H(), keeping the high
+ *	pass filter off.
+ */
+WarpStatus
+configureFifoL3GD20H(uint8_t watermarkSamples)
+{
+	WarpStatus status1, status2, status3;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
+	status1 = writeSensorRegisterL3GD20H(kWarpSensorConfigurationRegisterL3GD20HFIFO_CTRL,
+										 0b01000000 | (watermarkSamples & 0x1F) /* payload: stream mode, threshold */
+	);
 
-	i2cReadStatusLow                = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Z_L, 1 /* numberOfBytes */);
-	readSensorRegisterValueLSB      = deviceL3GD20HState.i2cBuffer[0];
-	i2cReadStatusHigh               = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_Z_H, 1 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceL3GD20HState.i2cBuffer[0];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
+	status2 = writeSensorRegisterL3GD20H(kWarpSensorConfigurationRegisterL3GD20HCTRL3,
+										 0b00000100 /* payload: INT2_FTH */
+	);
 
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
+	status3 = writeSensorRegisterL3GD20H(kWarpSensorConfigurationRegisterL3GD20HCTRL5,
+										 0b01000000 /* payload: FIFO_EN */
+	);
 
-	if ((i2cReadStatusLow != kWarpStatusOK) || (i2cReadStatusHigh != kWarpStatusOK))
-	{
-		buf[index] = 0;
-		index += 1;
+	fifoL3GD20H = ((status1 | status2 | status3) == kWarpStatusOK);
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
+	return (status1 | status2 | status3);
+}
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
+/*
+ *	Drain up to maxSamples X/Y/Z samples from the FIFO in one burst, into
+ *	samples (3 * maxSamples readings). The output registers are LSB first
+ *	(CTRL4 BLE clear), the byte order of an int16_t on the KL03, so the
+ *	samples need no conversion.
+ */
+WarpStatus
+readFifoL3GD20H(int16_t *  samples, uint8_t maxSamples, uint8_t *  samplesRead)
+{
+	WarpStatus	status;
+	uint8_t		fifoSource;
+	uint8_t		stored;
 
-	i2cReadStatusLow             = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_TEMP, 1 /* numberOfBytes */);
-	readSensorRegisterSignedByte = (int16_t)(deviceL3GD20HState.i2cBuffer[0]);
+	*samplesRead = 0;
+
+	status = readSensorRegisterL3GD20H(kWarpSensorOutputRegisterL3GD20HFIFO_SRC, 1 /* numberOfBytes */);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
 
 	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int8_t
+	 *	FSS counts 0 to 31 stored samples; OVRN means all 32 are full.
 	 */
-
-	if (i2cReadStatusLow != kWarpStatusOK)
+	fifoSource	= deviceL3GD20HState.i2cBuffer[0];
+	stored		= (fifoSource & 0x40) ? 32 : (fifoSource & 0x1F);
+	stored		= MIN(stored, maxSamples);
+	if (stored == 0)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
+		return kWarpStatusOK;
 	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterSignedByte >> 8);
-		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterSignedByte);
-		index += 1;
+	status = burstReadL3GD20H(kWarpSensorOutputRegisterL3GD20HOUT_X_L, (uint8_t *)samples, stored * kWarpSizesL3GD20HFifoSampleBytes);
+	if (status != kWarpStatusOK)
+	{
+		return status;
 	}
+	*samplesRead = stored;
 
-	return index;
-}
\ No newline at end of file
+	return kWarpStatusOK;
+}
@@ -41,7 +41,9 @@ WarpStatus	readSensorRegisterL3GD20H(uint8_t deviceRegister, int numberOfBytes);
 WarpStatus	writeSensorRegisterL3GD20H(uint8_t deviceRegister, uint8_t payload);
 WarpStatus	configureSensorL3GD20H(uint8_t payloadCTRL1, uint8_t payloadCTRL2, uint8_t payloadCTRL5);
 void		printSensorDataL3GD20H(bool hexModeFlag);
-uint8_t 	appendSensorDataL3GD20H(uint8_t* buf);
+uint8_t 	appendSensorDataL3GD20H(void);
+WarpStatus	configureFifoL3GD20H(uint8_t watermarkSamples);
+WarpStatus	readFifoL3GD20H(int16_t *  samples, uint8_t maxSamples, uint8_t *  samplesRead);
 
 const uint8_t bytesPerMeasurementL3GD20H            = 8;
 const uint8_t bytesPerReadingL3GD20H               	= 2;
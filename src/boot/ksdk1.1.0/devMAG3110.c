@@ -62,6 +62,28 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+/*
+ *	CTRL_REG1 as last configured, without the AC and TM bits, and whether
+ *	measurements are triggered one at a time rather than continuous.
+ */
+static uint8_t						ctrlReg1MAG3110			= 0x00;
+static bool							triggeredMAG3110		= false;
+
+/*
+ *	The die temperature changes slowly, so it is read once every
+ *	kWarpMAG3110TemperatureReadInterval samples and cached in between.
+ */
+static int8_t						dieTemperatureMAG3110	= 0;
+static uint8_t						samplesSinceTemperatureMAG3110 = kWarpMAG3110TemperatureReadInterval;
+
+/*
+ *	Output data period at OS 00 for each DR, in tenths of a millisecond
+ *	(Table 31 of the MAG3110 datasheet: 80, 40, 20, 10, 10, 5, 2.5 and
+ *	1.25 Hz). The ADC rate halves with every step of DR, but from DR 100 the
+ *	minimum over-sampling ratio drops from 16 to 8, so DR 011 and DR 100
+ *	both give 10 Hz, DR 100 at half the ADC rate and current.
+ */
+static const uint16_t				dataPeriodTenthsMillisecondsMAG3110[8] = {125, 250, 500, 1000, 1000, 2000, 4000, 8000};
 
 void
 initMAG3110(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts)
@@ -136,13 +158,74 @@ configureSensorMAG3110(uint8_t payloadCTRL_REG1, uint8_t payloadCTRL_REG2, uint1
 												 payloadCTRL_REG2 /* payload */,
 												 menuI2cPullupValue);
 
+	/*
+	 *	Keep the DR, OS and FR bits of payloadCTRL_REG1 when going ACTIVE.
+	 */
 	i2cWriteStatus3 = writeSensorRegisterMAG3110(kWarpSensorConfigurationRegisterMAG3110CTRL_REG1 /* register address CTRL_REG1 */,
-												 0x01 /* payload: ACTIVE mode */,
+												 (payloadCTRL_REG1 & 0xFC) | 0x01 /* payload: ACTIVE mode */,
 												 menuI2cPullupValue);
 
+	ctrlReg1MAG3110		= payloadCTRL_REG1 & 0xFC;
+	triggeredMAG3110	= false;
+
 	return (i2cWriteStatus1 | i2cWriteStatus2 | i2cWriteStatus3);
 }
 
+/*
+ *	Change the DR, OS and FR bits of CTRL_REG1 (which the MAG3110 only
+ *	accepts in STANDBY), then either go ACTIVE for continuous measurements
+ *	or, if triggered, stay in STANDBY and start a single measurement with
+ *	TM. In triggered mode appendSensorDataMAG3110() and
+ *	printSensorDataMAG3110() read the measurement triggered by the previous
+ *	call and trigger the next one, so they never wait for a conversion.
+ */
+WarpStatus
+setAcquisitionModeMAG3110(uint8_t payloadCTRL_REG1, bool triggered)
+{
+	WarpStatus	i2cWriteStatus1, i2cWriteStatus2;
+
+	ctrlReg1MAG3110		= payloadCTRL_REG1 & 0xFC;
+	triggeredMAG3110	= triggered;
+
+	i2cWriteStatus1 = writeSensorRegisterMAG3110(kWarpSensorConfigurationRegisterMAG3110CTRL_REG1 /* register address CTRL_REG1 */,
+												 0x00 /* payload: STANDBY mode */,
+												 0);
+
+	i2cWriteStatus2 = writeSensorRegisterMAG3110(kWarpSensorConfigurationRegisterMAG3110CTRL_REG1 /* register address CTRL_REG1 */,
+												 ctrlReg1MAG3110 | (triggered ? 0x02 /* TM */ : 0x01 /* AC */),
+												 0);
+
+	return (i2cWriteStatus1 | i2cWriteStatus2);
+}
+
+/*
+ *	Pick the acquisition mode for one sample every samplePeriodMilliseconds.
+ *	Below kWarpMAG3110TriggeredModeMinPeriodMilliseconds, measure
+ *	continuously at the slowest data rate (OS 00) that still produces a new
+ *	measurement per sample, taking the highest DR of any that tie, since it
+ *	draws the least current; at longer periods, trigger one measurement per
+ *	sample and leave the sensor in STANDBY in between. fastRead trades the
+ *	LSBs for 3-byte reads.
+ */
+WarpStatus
+selectAcquisitionModeMAG3110(uint32_t samplePeriodMilliseconds, bool fastRead)
+{
+	uint8_t		dataRate = 7;
+	uint8_t		payloadFastRead = fastRead ? 0x04 /* FR */ : 0x00;
+
+	if (samplePeriodMilliseconds >= kWarpMAG3110TriggeredModeMinPeriodMilliseconds)
+	{
+		return setAcquisitionModeMAG3110(payloadFastRead, true);
+	}
+
+	while ((dataRate > 0) && (dataPeriodTenthsMillisecondsMAG3110[dataRate] > samplePeriodMilliseconds * 10))
+	{
+		dataRate--;
+	}
+
+	return setAcquisitionModeMAG3110((dataRate << 5) | payloadFastRead, false);
+}
+
 WarpStatus
 readSensorRegisterMAG3110(uint8_t deviceRegister, int numberOfBytes)
 {
@@ -195,100 +278,108 @@ readSensorRegisterMAG3110(uint8_t deviceRegister, int numberOfBytes)
 	return kWarpStatusOK;
 }
 
-void
-printSensorDataMAG3110(bool hexModeFlag)
+/*
+ *	Read X, Y and Z in one burst from OUT_X_MSB: 6 bytes, or with FR set
+ *	only the three MSBs, since auto-increment then skips the LSB registers.
+ *	Either way data[] ends up as MSB/LSB pairs, with zero LSBs under FR, so
+ *	logged values have the same scale in both modes. Also refreshes the
+ *	cached die temperature when it is due, and in triggered mode starts the
+ *	next measurement.
+ */
+static WarpStatus
+readOutputsMAG3110(uint8_t *  data)
 {
-	uint16_t	readSensorRegisterValueLSB;
-	uint16_t	readSensorRegisterValueMSB;
-	int16_t		readSensorRegisterValueCombined;
-	int8_t		readSensorRegisterSignedByte;
+	uint8_t		cmdBuf[1] = {kWarpSensorOutputRegisterMAG3110OUT_X_MSB};
+	bool		fastRead = (ctrlReg1MAG3110 & 0x04) != 0;
+	i2c_status_t	status;
 	WarpStatus	i2cReadStatus;
 
+	i2c_device_t slave =
+		{
+		.address = deviceMAG3110State.i2cAddress,
+		.baudRate_kbps = gWarpI2cBaudRateKbps
+	};
 
 	warpScaleSupplyVoltage(deviceMAG3110State.operatingVoltageMillivolts);
+	warpEnableI2Cpins();
 
-	i2cReadStatus = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110OUT_X_MSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceMAG3110State.i2cBuffer[0];
-	readSensorRegisterValueLSB = deviceMAG3110State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
-
-	if (i2cReadStatus != kWarpStatusOK)
+	status = I2C_DRV_MasterReceiveDataBlocking(
+		0 /* I2C peripheral instance */,
+		&slave,
+		cmdBuf,
+		1,
+		data,
+		fastRead ? kWarpSizesMAG3110BurstBytes / 2 : kWarpSizesMAG3110BurstBytes,
+		gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
 	{
-		warpPrint(" ----,");
+		return kWarpStatusDeviceCommunicationFailed;
 	}
-	else
+
+	if (fastRead)
 	{
-		if (hexModeFlag)
+		for (int8_t i = 2; i >= 0; i--)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
-		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			data[2 * i]		= data[i];
+			data[2 * i + 1]	= 0;
 		}
 	}
 
-	i2cReadStatus = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110OUT_Y_MSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceMAG3110State.i2cBuffer[0];
-	readSensorRegisterValueLSB = deviceMAG3110State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
-
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		warpPrint(" ----,");
-	}
-	else
+	if (samplesSinceTemperatureMAG3110 >= kWarpMAG3110TemperatureReadInterval)
 	{
-		if (hexModeFlag)
-		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
-		}
-		else
+		i2cReadStatus = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110DIE_TEMP, 1 /* numberOfBytes */);
+		if (i2cReadStatus == kWarpStatusOK)
 		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			dieTemperatureMAG3110			= (int8_t)deviceMAG3110State.i2cBuffer[0];
+			samplesSinceTemperatureMAG3110	= 0;
 		}
 	}
+	samplesSinceTemperatureMAG3110++;
 
-	i2cReadStatus = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110OUT_Z_MSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB = deviceMAG3110State.i2cBuffer[0];
-	readSensorRegisterValueLSB = deviceMAG3110State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
-
-	if (i2cReadStatus != kWarpStatusOK)
+	if (triggeredMAG3110)
 	{
-		warpPrint(" ----,");
+		return writeSensorRegisterMAG3110(kWarpSensorConfigurationRegisterMAG3110CTRL_REG1 /* register address CTRL_REG1 */,
+										  ctrlReg1MAG3110 | 0x02 /* payload: TM */,
+										  0);
 	}
-	else
+
+	return kWarpStatusOK;
+}
+
+void
+printSensorDataMAG3110(bool hexModeFlag)
+{
+	uint8_t		data[kWarpSizesMAG3110BurstBytes];
+	int16_t		readSensorRegisterValueCombined;
+	WarpStatus	i2cReadStatus;
+
+	i2cReadStatus = readOutputsMAG3110(data);
+
+	for (uint8_t i = 0; i < kWarpSizesMAG3110BurstBytes; i += 2)
 	{
-		if (hexModeFlag)
+		readSensorRegisterValueCombined = ((data[i] & 0xFF) << 8) | (data[i + 1] & 0xFF);
+
+		/*
+		 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
+		 */
+
+		if (i2cReadStatus != kWarpStatusOK)
 		{
-			warpPrint(" 0x%02x 0x%02x,", readSensorRegisterValueMSB, readSensorRegisterValueLSB);
+			warpPrint(" ----,");
 		}
 		else
 		{
-			warpPrint(" %d,", readSensorRegisterValueCombined);
+			if (hexModeFlag)
+			{
+				warpPrint(" 0x%02x 0x%02x,", data[i], data[i + 1]);
+			}
+			else
+			{
+				warpPrint(" %d,", readSensorRegisterValueCombined);
+			}
 		}
 	}
 
-	i2cReadStatus = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110DIE_TEMP, 1 /* numberOfBytes */);
-	readSensorRegisterSignedByte = deviceMAG3110State.i2cBuffer[0];
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int8_t
-	 */
-
 	if (i2cReadStatus != kWarpStatusOK)
 	{
 		warpPrint(" ----,");
@@ -297,141 +388,46 @@ printSensorDataMAG3110(bool hexModeFlag)
 	{
 		if (hexModeFlag)
 		{
-			warpPrint(" 0x%02x,", deviceMAG3110State.i2cBuffer[0]);
+			warpPrint(" 0x%02x,", (uint8_t)dieTemperatureMAG3110);
 		}
 		else
 		{
-			warpPrint(" %d,", readSensorRegisterSignedByte);
+			warpPrint(" %d,", dieTemperatureMAG3110);
 		}
 	}
 }
 
-uint8_t
-appendSensorDataMAG3110(uint8_t* buf)
+static uint8_t
+streamReadingMAG3110(WarpStatus i2cReadStatus, int16_t reading)
 {
-	uint8_t index = 0;
-
-	uint16_t readSensorRegisterValueLSB;
-	uint16_t readSensorRegisterValueMSB;
-	int16_t readSensorRegisterValueCombined;
-	int16_t readSensorRegisterSignedByte;
-	WarpStatus i2cReadStatus;
-
-	warpScaleSupplyVoltage(deviceMAG3110State.operatingVoltageMillivolts);
-
-	i2cReadStatus                   = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110OUT_X_MSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceMAG3110State.i2cBuffer[0];
-	readSensorRegisterValueLSB      = deviceMAG3110State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
-
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
-
-	i2cReadStatus                   = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110OUT_Y_MSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceMAG3110State.i2cBuffer[0];
-	readSensorRegisterValueLSB      = deviceMAG3110State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
-	 */
-
 	if (i2cReadStatus != kWarpStatusOK)
 	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
+		reading = 0;
 	}
 
-	i2cReadStatus                   = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110OUT_Z_MSB, 2 /* numberOfBytes */);
-	readSensorRegisterValueMSB      = deviceMAG3110State.i2cBuffer[0];
-	readSensorRegisterValueLSB      = deviceMAG3110State.i2cBuffer[1];
-	readSensorRegisterValueCombined = ((readSensorRegisterValueMSB & 0xFF) << 8) | (readSensorRegisterValueLSB & 0xFF);
-
 	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int16_t
+	 * MSB first
 	 */
+	warpFlashStreamByte((uint8_t)(reading >> 8));
+	warpFlashStreamByte((uint8_t)(reading));
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
-
-		buf[index] = 0;
-		index += 1;
-	}
-	else
-	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
-		index += 1;
-	}
-
-	i2cReadStatus                = readSensorRegisterMAG3110(kWarpSensorOutputRegisterMAG3110DIE_TEMP, 1 /* numberOfBytes */);
-	readSensorRegisterSignedByte = (int16_t)(deviceMAG3110State.i2cBuffer[0]);
+	return 2;
+}
 
-	/*
-	 *	NOTE: Here, we don't need to manually sign extend since we are packing directly into an int8_t
-	 */
+uint8_t
+appendSensorDataMAG3110(void)
+{
+	uint8_t		index = 0;
+	uint8_t		data[kWarpSizesMAG3110BurstBytes];
+	WarpStatus	i2cReadStatus;
 
-	if (i2cReadStatus != kWarpStatusOK)
-	{
-		buf[index] = 0;
-		index += 1;
+	i2cReadStatus = readOutputsMAG3110(data);
 
-		buf[index] = 0;
-		index += 1;
-	}
-	else
+	for (uint8_t i = 0; i < kWarpSizesMAG3110BurstBytes; i += 2)
 	{
-		/*
-		 * MSB first
-		 */
-		buf[index] = (uint8_t)(readSensorRegisterSignedByte >> 8);
-		index += 1;
-
-		buf[index] = (uint8_t)(readSensorRegisterSignedByte);
-		index += 1;
+		index += streamReadingMAG3110(i2cReadStatus, ((data[i] & 0xFF) << 8) | (data[i + 1] & 0xFF));
 	}
+	index += streamReadingMAG3110(i2cReadStatus, dieTemperatureMAG3110);
 
 	return index;
-}
\ No newline at end of file
+}
@@ -41,7 +41,9 @@ WarpStatus	writeSensorRegisterMAG3110(uint8_t deviceRegister, uint8_t payload, u
 WarpStatus	configureSensorMAG3110(uint8_t payloadCTRL_REG1, uint8_t payloadCTRL_REG2, uint16_t menuI2cPullupValue);
 WarpStatus	readSensorRegisterMAG3110(uint8_t deviceRegister, int numberOfBytes);
 void 		printSensorDataMAG3110(bool hexModeFlag);
-uint8_t 	appendSensorDataMAG3110(uint8_t* buf);
+uint8_t 	appendSensorDataMAG3110(void);
+WarpStatus	setAcquisitionModeMAG3110(uint8_t payloadCTRL_REG1, bool triggered);
+WarpStatus	selectAcquisitionModeMAG3110(uint32_t samplePeriodMilliseconds, bool fastRead);
 
 const uint8_t bytesPerMeasurementMAG3110            = 8;
 const uint8_t bytesPerReadingMAG3110                = 2;
@@ -62,6 +62,18 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+#if (WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM)
+static uint8_t	ctrlReg1MMA8451Q;
+static int16_t	windowMMA8451Q[1 << kWarpSpectrumLog2Points];
+
+/*
+ *	Output data period in microseconds for each CTRL_REG1 DR setting.
+ */
+static const uint32_t	samplePeriodMicrosecondsMMA8451Q[8] =
+{
+	1250, 2500, 5000, 10000, 20000, 80000, 160000, 640000,
+};
+#endif
 
 
 void
@@ -130,20 +142,31 @@ writeSensorRegisterMMA8451Q(uint8_t deviceRegister, uint8_t payload)
 WarpStatus
 configureSensorMMA8451Q(uint8_t payloadF_SETUP, uint8_t payloadCTRL_REG1)
 {
-	WarpStatus	i2cWriteStatus1, i2cWriteStatus2;
+	WarpStatus	i2cWriteStatus1, i2cWriteStatus2, i2cWriteStatus3;
 
 
 	warpScaleSupplyVoltage(deviceMMA8451QState.operatingVoltageMillivolts);
 
-	i2cWriteStatus1 = writeSensorRegisterMMA8451Q(kWarpSensorConfigurationRegisterMMA8451QF_SETUP /* register address F_SETUP */,
+	/*
+	 *	F_SETUP can only be changed in standby.
+	 */
+	i2cWriteStatus1 = writeSensorRegisterMMA8451Q(kWarpSensorConfigurationRegisterMMA8451QCTRL_REG1 /* register address CTRL_REG1 */,
+												  payloadCTRL_REG1 & ~0x01 /* payload: standby */
+	);
+
+	i2cWriteStatus2 = writeSensorRegisterMMA8451Q(kWarpSensorConfigurationRegisterMMA8451QF_SETUP /* register address F_SETUP */,
 												  payloadF_SETUP /* payload: Disable FIFO */
 	);
 
-	i2cWriteStatus2 = writeSensorRegisterMMA8451Q(kWarpSensorConfigurationRegisterMMA8451QCTRL_REG1 /* register address CTRL_REG1 */,
+	i2cWriteStatus3 = writeSensorRegisterMMA8451Q(kWarpSensorConfigurationRegisterMMA8451QCTRL_REG1 /* register address CTRL_REG1 */,
 												  payloadCTRL_REG1 /* payload */
 	);
 
-	return (i2cWriteStatus1 | i2cWriteStatus2);
+#if (WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM)
+	ctrlReg1MMA8451Q = payloadCTRL_REG1;
+#endif
+
+	return (i2cWriteStatus1 | i2cWriteStatus2 | i2cWriteStatus3);
 }
 
 WarpStatus
@@ -307,8 +330,179 @@ printSensorDataMMA8451Q(bool hexModeFlag)
 	}
 }
 
+#if (WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM)
+static WarpStatus
+burstReadMMA8451Q(uint8_t deviceRegister, uint8_t *  data, size_t nbyte)
+{
+	uint8_t			cmdBuf[1] = {deviceRegister};
+	i2c_status_t	status;
+
+	i2c_device_t slave =
+		{
+		.address 		= deviceMMA8451QState.i2cAddress,
+		.baudRate_kbps 	= gWarpI2cBaudRateKbps
+	};
+
+	warpScaleSupplyVoltage(deviceMMA8451QState.operatingVoltageMillivolts);
+	warpEnableI2Cpins();
+	status = I2C_DRV_MasterReceiveDataBlocking(
+							0 /* I2C peripheral instance */,
+							&slave,
+							cmdBuf,
+							1,
+							data,
+							nbyte,
+							gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
+	{
+		return kWarpStatusDeviceCommunicationFailed;
+	}
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Fill windowMMA8451Q[] with consecutive samples of one axis from the
+ *	FIFO, which F_SETUP must have enabled. With the FIFO on, reads past
+ *	OUT_Z_LSB wrap to OUT_X_MSB, so a burst from OUT_X_MSB returns whole
+ *	x, y, z frames. Between bursts, sleep for as long as the FIFO takes to
+ *	collect another burst's worth of frames.
+ */
+static WarpStatus
+readWindowMMA8451Q(void)
+{
+	uint8_t		frames[kWarpSizesMMA8451QFifoBurstFrames * kWarpSizesMMA8451QFifoFrameBytes];
+	uint32_t	burstMilliseconds;
+	uint16_t	count = 0;
+	uint8_t		emptyPolls = 0;
+	WarpStatus	status;
+
+	burstMilliseconds = (samplePeriodMicrosecondsMMA8451Q[(ctrlReg1MMA8451Q >> 3) & 0x07] * kWarpSizesMMA8451QFifoBurstFrames) / 1000;
+
+	while (count < (1 << kWarpSpectrumLog2Points))
+	{
+		uint8_t		available;
+
+		status = readSensorRegisterMMA8451Q(kWarpSensorOutputRegisterMMA8451QF_STATUS, 1 /* numberOfBytes */);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		available = deviceMMA8451QState.i2cBuffer[0] & 0x3F;
+		if (available == 0)
+		{
+			if (++emptyPolls > kWarpMMA8451QSpectrumMaxEmptyPolls)
+			{
+				return kWarpStatusDeviceCommunicationFailed;
+			}
+
+			warpSleepMilliseconds(burstMilliseconds);
+			continue;
+		}
+		emptyPolls = 0;
+
+		available = MIN(available, kWarpSizesMMA8451QFifoBurstFrames);
+		available = MIN(available, (1 << kWarpSpectrumLog2Points) - count);
+
+		status = burstReadMMA8451Q(kWarpSensorOutputRegisterMMA8451QOUT_X_MSB, frames, available * kWarpSizesMMA8451QFifoFrameBytes);
+		if (status != kWarpStatusOK)
+		{
+			return status;
+		}
+
+		for (uint8_t i = 0; i < available; i++)
+		{
+			uint8_t *	sample = &frames[i * kWarpSizesMMA8451QFifoFrameBytes + 2 * kWarpMMA8451QSpectrumAxis];
+			int16_t		combined = ((sample[0] & 0xFF) << 6) | (sample[1] >> 2);
+
+			/*
+			 *	Sign extend the 14-bit value based on knowledge that upper 2 bit are 0:
+			 */
+			windowMMA8451Q[count++] = (combined ^ (1 << 13)) - (1 << 13);
+		}
+	}
+
+	return kWarpStatusOK;
+}
+
+/*
+ *	Log the spectrum of one window of samples instead of a single sample:
+ *	kWarpSpectrumBands band levels or, with WARP_BUILD_SPECTRUM_LOG_PEAKS,
+ *	kWarpSpectrumPeaks (bin, level) pairs. Levels are log2 of the energy
+ *	in Q8 (see warpSpectrumBands()). All zeros if the window could not be
+ *	read.
+ */
+uint8_t
+appendSensorDataMMA8451Q(void)
+{
+#if (WARP_BUILD_SPECTRUM_LOG_PEAKS)
+	uint8_t		bins[kWarpSpectrumPeaks];
+	int16_t		levels[kWarpSpectrumPeaks];
+	uint8_t		numberOfLevels = kWarpSpectrumPeaks;
+#else
+	int16_t		levels[kWarpSpectrumBands];
+	uint8_t		numberOfLevels = kWarpSpectrumBands;
+#endif
+	uint8_t		index = 0;
+	int8_t		shift;
+	WarpStatus	i2cReadStatus;
+
+	warpScaleSupplyVoltage(deviceMMA8451QState.operatingVoltageMillivolts);
+
+	i2cReadStatus = readWindowMMA8451Q();
+	if (i2cReadStatus != kWarpStatusOK)
+	{
+		for (uint8_t i = 0; i < numberOfLevels; i++)
+		{
+			warpFlashStreamByte(0);
+			index += 1;
+
+			warpFlashStreamByte(0);
+			index += 1;
+#if (WARP_BUILD_SPECTRUM_LOG_PEAKS)
+			warpFlashStreamByte(0);
+			index += 1;
+
+			warpFlashStreamByte(0);
+			index += 1;
+#endif
+		}
+
+		return index;
+	}
+
+	shift = warpSpectrumReal(windowMMA8451Q, kWarpSpectrumLog2Points);
+#if (WARP_BUILD_SPECTRUM_LOG_PEAKS)
+	warpSpectrumPeaks(windowMMA8451Q, kWarpSpectrumLog2Points, shift, bins, levels, kWarpSpectrumPeaks);
+#else
+	warpSpectrumBands(windowMMA8451Q, kWarpSpectrumLog2Points, shift, levels, kWarpSpectrumBands);
+#endif
+
+	for (uint8_t i = 0; i < numberOfLevels; i++)
+	{
+#if (WARP_BUILD_SPECTRUM_LOG_PEAKS)
+		warpFlashStreamByte(0);
+		index += 1;
+
+		warpFlashStreamByte(bins[i]);
+		index += 1;
+#endif
+		/*
+		 * MSB first
+		 */
+		warpFlashStreamByte((uint8_t)(levels[i] >> 8));
+		index += 1;
+
+		warpFlashStreamByte((uint8_t)(levels[i]));
+		index += 1;
+	}
+
+	return index;
+}
+#else
 uint8_t
-appendSensorDataMMA8451Q(uint8_t* buf)
+appendSensorDataMMA8451Q(void)
 {
 	uint8_t index = 0;
 	uint16_t readSensorRegisterValueLSB;
@@ -342,10 +536,10 @@ appendSensorDataMMA8451Q(uint8_t* buf)
 
 	if (i2cReadStatus != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -353,10 +547,10 @@ appendSensorDataMMA8451Q(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 
@@ -372,10 +566,10 @@ appendSensorDataMMA8451Q(uint8_t* buf)
 
 	if (i2cReadStatus != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -383,10 +577,10 @@ appendSensorDataMMA8451Q(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 
@@ -402,10 +596,10 @@ appendSensorDataMMA8451Q(uint8_t* buf)
 
 	if (i2cReadStatus != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
@@ -413,11 +607,12 @@ appendSensorDataMMA8451Q(uint8_t* buf)
 		/*
 		 * MSB first
 		 */
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined >> 8);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined >> 8));
 		index += 1;
 
-		buf[index] = (uint8_t)(readSensorRegisterValueCombined);
+		warpFlashStreamByte((uint8_t)(readSensorRegisterValueCombined));
 		index += 1;
 	}
 	return index;
-}
\ No newline at end of file
+}
+#endif
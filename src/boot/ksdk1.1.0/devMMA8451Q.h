@@ -41,8 +41,18 @@ WarpStatus	readSensorRegisterMMA8451Q(uint8_t deviceRegister, int numberOfBytes)
 WarpStatus	writeSensorRegisterMMA8451Q(uint8_t deviceRegister, uint8_t payloadBtye);
 WarpStatus 	configureSensorMMA8451Q(uint8_t payloadF_SETUP, uint8_t payloadCTRL_REG1);
 void		printSensorDataMMA8451Q(bool hexModeFlag);
-uint8_t		appendSensorDataMMA8451Q(uint8_t* buf);
+uint8_t		appendSensorDataMMA8451Q(void);
 
+#if (WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM) && (WARP_BUILD_SPECTRUM_LOG_PEAKS)
+const uint8_t bytesPerMeasurementMMA8451Q            = 4 * kWarpSpectrumPeaks;
+const uint8_t bytesPerReadingMMA8451Q                = 2;
+const uint8_t numberOfReadingsPerMeasurementMMA8451Q = 2 * kWarpSpectrumPeaks;
+#elif (WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM)
+const uint8_t bytesPerMeasurementMMA8451Q            = 2 * kWarpSpectrumBands;
+const uint8_t bytesPerReadingMMA8451Q                = 2;
+const uint8_t numberOfReadingsPerMeasurementMMA8451Q = kWarpSpectrumBands;
+#else
 const uint8_t bytesPerMeasurementMMA8451Q            = 6;
 const uint8_t bytesPerReadingMMA8451Q                = 2;
-const uint8_t numberOfReadingsPerMeasurementMMA8451Q = 3;
\ No newline at end of file
+const uint8_t numberOfReadingsPerMeasurementMMA8451Q = 3;
+#endif
\ No newline at end of file
@@ -433,7 +433,7 @@ setRTCCountdownRV8803C7(uint16_t countdown, WarpRV8803ExtTD clk_freq, bool inter
 
 
 uint8_t
-appendSensorDataRV8803C7(uint8_t* buf)
+appendSensorDataRV8803C7(void)
 {
 	uint8_t	tmpRV8803RegisterByte;
 	WarpStatus status;
@@ -443,12 +443,12 @@ appendSensorDataRV8803C7(uint8_t* buf)
 
 	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
 	{
-		buf[index] = tmpRV8803RegisterByte;
+		warpFlashStreamByte(tmpRV8803RegisterByte);
 		index += 1;
 	}
 
@@ -456,12 +456,12 @@ appendSensorDataRV8803C7(uint8_t* buf)
 
 	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
 	{
-		buf[index] = tmpRV8803RegisterByte;
+		warpFlashStreamByte(tmpRV8803RegisterByte);
 		index += 1;
 	}
 
@@ -469,12 +469,12 @@ appendSensorDataRV8803C7(uint8_t* buf)
 
 	if (status != kWarpStatusOK)
 	{
-		buf[index] = 0;
+		warpFlashStreamByte(0);
 		index += 1;
 	}
 	else
 	{
-		buf[index] = tmpRV8803RegisterByte;
+		warpFlashStreamByte(tmpRV8803RegisterByte);
 		index += 1;
 	}
 
@@ -113,7 +113,7 @@ WarpStatus	writeRTCRegisterRV8803C7(uint8_t deviceStartRegister, uint8_t payload
 WarpStatus	writeRTCRegistersRV8803C7(uint8_t deviceStartRegister, uint8_t nRegs, uint8_t payload[]);
 WarpStatus	setRTCTimeRV8803C7(rtc_datetime_t *  tm);
 WarpStatus	setRTCCountdownRV8803C7(uint16_t countdown, WarpRV8803ExtTD clk_freq, bool interupt_enable);
-uint8_t appendSensorDataRV8803C7(uint8_t* buf);
+uint8_t appendSensorDataRV8803C7(void);
 
 const uint8_t bytesPerMeasurementRV8803C7				= 3;
 const uint8_t bytesPerReadingRV8803C7					= 1;
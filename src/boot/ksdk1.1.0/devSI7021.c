@@ -61,6 +61,19 @@ extern volatile uint32_t			gWarpI2cBaudRateKbps;
 extern volatile uint32_t			gWarpI2cTimeoutMilliseconds;
 extern volatile uint32_t			gWarpSupplySettlingDelayMilliseconds;
 
+/*
+ *	RES1 (bit 7) and RES0 (bit 0) of user register 1 as last written. The
+ *	power-on default, 0b00, is 12 bit RH and 14 bit temperature.
+ */
+static uint8_t						resolutionSI7021 = 0x00;
+
+/*
+ *	Last successful measurement, for other drivers that want the ambient
+ *	conditions (see environmentDataSI7021()).
+ */
+static int16_t						lastTemperatureSI7021;
+static int16_t						lastHumiditySI7021;
+static bool							lastMeasurementValidSI7021 = false;
 
 
 void
@@ -72,23 +85,37 @@ initSI7021(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts)
 	return;
 }
 
-WarpStatus
-readSensorRegisterSI7021(uint8_t deviceRegister, int numberOfBytes)
+/*
+ *	CRC-8 with polynomial x^8 + x^5 + x^4 + 1 and initial value 0x00, as
+ *	sent after each measurement (Section 5.1 of the SI7021 manual).
+ */
+static uint8_t
+crc8SI7021(const uint8_t *  data, uint8_t nbyte)
 {
-	uint8_t 	cmdBuf[2] = {0xFF, 0xFF};
-	i2c_status_t	status1, status2, status3, status4;
+	uint8_t		crc = 0x00;
 
+	for (uint8_t i = 0; i < nbyte; i++)
+	{
+		crc ^= data[i];
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+		}
+	}
 
-	USED(numberOfBytes);
+	return crc;
+}
+
+/*
+ *	The SI7021 has no register pointer: every access starts with a command
+ *	code (Table 11 of the SI7021 manual), optionally followed by a payload.
+ */
+static WarpStatus
+sendCommandSI7021(uint8_t command, uint8_t *  payload, size_t payloadBytes)
+{
+	uint8_t		cmdBuf[1] = {command};
+	i2c_status_t	status;
 
-	/*
-	 *	TODO: See SI7021 manual.
-	 *	1.	We should be passing in a 'command code' such as those in table 11
-	 *	2.	We first write command code, then read results
-	 *
-	 *	for now, just fix command code as 'read firmware version'
-	 */
-	
 	i2c_device_t slave =
 		{
 		.address = deviceSI7021State.i2cAddress,
@@ -96,67 +123,346 @@ readSensorRegisterSI7021(uint8_t deviceRegister, int numberOfBytes)
 	};
 
 	warpScaleSupplyVoltage(deviceSI7021State.operatingVoltageMillivolts);
-
-	/*
-	 *	TODO: for now, we fix command code as read first byte of serial number
-	 */
-	cmdBuf[0] = 0xFA;
-	cmdBuf[1] = 0x0F;
 	warpEnableI2Cpins();
 
-	status1 = I2C_DRV_MasterSendDataBlocking(
+	status = I2C_DRV_MasterSendDataBlocking(
 							0 /* I2C peripheral instance */,
 							&slave,
-							NULL,
-							0,
 							cmdBuf,
-							2,//TODO: for now, we fix command code as two byte 'read firmware version' command
+							1,
+							payload,
+							payloadBytes,
 							gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
+	{
+		return kWarpStatusDeviceCommunicationFailed;
+	}
+
+	return kWarpStatusOK;
+}
 
+static WarpStatus
+receiveSI7021(uint8_t *  data, size_t nbyte)
+{
+	i2c_status_t	status;
+
+	i2c_device_t slave =
+		{
+		.address = deviceSI7021State.i2cAddress,
+		.baudRate_kbps = gWarpI2cBaudRateKbps
+	};
 
 	/*
-	 *	See SI7021 manual, page 20: two reads will be nacked before third succeeds.
 	 *	See similar thing in HDC1000 driver where we also send a NULL cmdBuf in
 	 *	I2C_DRV_MasterReceiveDataBlocking.
 	 */
-	status2 = I2C_DRV_MasterReceiveDataBlocking(
+	status = I2C_DRV_MasterReceiveDataBlocking(
 							0 /* I2C peripheral instance */,
 							&slave,
 							NULL,
 							0,
-							(uint8_t *)deviceSI7021State.i2cBuffer,
-							numberOfBytes,
+							data,
+							nbyte,
 							gWarpI2cTimeoutMilliseconds);
+	if (status != kStatus_I2C_Success)
+	{
+		return kWarpStatusDeviceCommunicationFailed;
+	}
 
-	status3 = I2C_DRV_MasterReceiveDataBlocking(
-							0 /* I2C peripheral instance */,
-							&slave,
-							NULL,
-							0,
-							(uint8_t *)deviceSI7021State.i2cBuffer,
-							numberOfBytes,
-							gWarpI2cTimeoutMilliseconds);
+	return kWarpStatusOK;
+}
+
+/*
+ *	Worst-case conversion time for the configured resolution, from Table 2
+ *	of the SI7021 manual. A relative humidity measurement always includes
+ *	a temperature conversion, so its time is the sum of both.
+ */
+uint8_t
+measurementMillisecondsSI7021(void)
+{
+	switch (resolutionSI7021)
+	{
+		case 0x01:
+		{
+			/*
+			 *	RH 8 bit (3.1ms), T 12 bit (3.8ms)
+			 */
+			return 7;
+		}
+
+		case 0x80:
+		{
+			/*
+			 *	RH 10 bit (4.5ms), T 13 bit (6.2ms)
+			 */
+			return 11;
+		}
+
+		case 0x81:
+		{
+			/*
+			 *	RH 11 bit (7ms), T 11 bit (2.4ms)
+			 */
+			return 10;
+		}
+
+		default:
+		{
+			/*
+			 *	RH 12 bit (12ms), T 14 bit (10.8ms)
+			 */
+			return 23;
+		}
+	}
+}
+
+/*
+ *	deviceRegister is an SI7021 command code, and only the commands that
+ *	read something are accepted: the menu sweeps a range of codes that also
+ *	holds writes (e.g., 0xE6, write user register 1). For the no-hold-master
+ *	measurement commands we wait out the conversion before reading, rather
+ *	than retrying reads until the SI7021 stops NACKing them.
+ */
+WarpStatus
+readSensorRegisterSI7021(uint8_t deviceRegister, int numberOfBytes)
+{
+	WarpStatus	status;
+
+	switch (deviceRegister)
+	{
+		case kWarpSensorOutputRegisterSI7021MeasureRHNoHold:
+		case kWarpSensorOutputRegisterSI7021MeasureTNoHold:
+		case kWarpSensorOutputRegisterSI7021TFromPreviousRH:
+		case kWarpSensorConfigurationRegisterSI7021ReadUserRegister1:
+		{
+			/* OK */
+			break;
+		}
+
+		default:
+		{
+			return kWarpStatusBadDeviceCommand;
+		}
+	}
+
+	if (numberOfBytes > kWarpSizesI2cBufferBytes)
+	{
+		return kWarpStatusBadDeviceCommand;
+	}
+
+	status = sendCommandSI7021(deviceRegister, NULL, 0);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	if ((deviceRegister == kWarpSensorOutputRegisterSI7021MeasureRHNoHold) ||
+		(deviceRegister == kWarpSensorOutputRegisterSI7021MeasureTNoHold))
+	{
+		warpSleepMilliseconds(measurementMillisecondsSI7021());
+	}
+
+	return receiveSI7021((uint8_t *)deviceSI7021State.i2cBuffer, numberOfBytes);
+}
+
+WarpStatus
+writeSensorRegisterSI7021(uint8_t deviceRegister, uint8_t payload)
+{
+	uint8_t		payloadByte[1];
+	WarpStatus	status;
+
+	switch (deviceRegister)
+	{
+		case kWarpSensorConfigurationRegisterSI7021WriteUserRegister1:
+		{
+			/* OK */
+			break;
+		}
+
+		default:
+		{
+			return kWarpStatusBadDeviceCommand;
+		}
+	}
+
+	payloadByte[0] = payload;
+	status = sendCommandSI7021(deviceRegister, payloadByte, 1);
+	if (status == kWarpStatusOK)
+	{
+		resolutionSI7021 = payload & 0x81;
+	}
+
+	return status;
+}
+
+/*
+ *	Set the measurement resolution, given as the RES1 (bit 7) and RES0
+ *	(bit 0) bits of user register 1. The other bits of the register are
+ *	read back and preserved, as the SI7021 manual asks.
+ */
+WarpStatus
+configureSensorSI7021(uint8_t payloadResolution)
+{
+	WarpStatus	status;
+
+	status = readSensorRegisterSI7021(kWarpSensorConfigurationRegisterSI7021ReadUserRegister1, 1 /* numberOfBytes */);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	return writeSensorRegisterSI7021(kWarpSensorConfigurationRegisterSI7021WriteUserRegister1,
+									 (deviceSI7021State.i2cBuffer[0] & 0x7E) | (payloadResolution & 0x81));
+}
+
+/*
+ *	Split-phase acquisition: startMeasurementSI7021() issues "Measure RH, no
+ *	hold master" and returns straight away. After
+ *	measurementMillisecondsSI7021(), readMeasurementSI7021() collects the
+ *	humidity and then the temperature that the SI7021 measured as part of
+ *	the same conversion (command 0xE0), so one conversion yields both.
+ */
+WarpStatus
+startMeasurementSI7021(void)
+{
+	return sendCommandSI7021(kWarpSensorOutputRegisterSI7021MeasureRHNoHold, NULL, 0);
+}
+
+WarpStatus
+readMeasurementSI7021(uint16_t *  humidity, uint16_t *  temperature)
+{
+	WarpStatus	status;
+	uint8_t *	data = (uint8_t *)deviceSI7021State.i2cBuffer;
 
 	/*
-	 *	Now, this two-byte read should succed according to page 20 of SI7021 manual:
+	 *	Humidity MSB, LSB and checksum.
 	 */
-	status4 = I2C_DRV_MasterReceiveDataBlocking(
-							0 /* I2C peripheral instance */,
-							&slave,
-							NULL,
-							0,
-							(uint8_t *)deviceSI7021State.i2cBuffer,
-							numberOfBytes,
-							gWarpI2cTimeoutMilliseconds);
+	status = receiveSI7021(data, 3);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
 
-	if ((status1 != kStatus_I2C_Success) ||
-		(status2 != kStatus_I2C_Success) ||
-		(status3 != kStatus_I2C_Success) ||
-		(status4 != kStatus_I2C_Success)
-		)
+	if (crc8SI7021(data, 2) != data[2])
 	{
 		return kWarpStatusDeviceCommunicationFailed;
 	}
 
+	*humidity = ((data[0] & 0xFF) << 8) | (data[1] & 0xFC);
+
+	status = readSensorRegisterSI7021(kWarpSensorOutputRegisterSI7021TFromPreviousRH, 2 /* numberOfBytes */);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	*temperature = ((data[0] & 0xFF) << 8) | (data[1] & 0xFC);
+
+	return kWarpStatusOK;
+}
+
+static WarpStatus
+measureSI7021(int16_t *  temperatureCentidegrees, int16_t *  humidityCentipercent)
+{
+	uint16_t	humidity;
+	uint16_t	temperature;
+	WarpStatus	status;
+
+	status = startMeasurementSI7021();
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	warpSleepMilliseconds(measurementMillisecondsSI7021());
+
+	status = readMeasurementSI7021(&humidity, &temperature);
+	if (status != kWarpStatusOK)
+	{
+		return status;
+	}
+
+	/*
+	 *	See Sections 5.1.1 and 5.1.2 of the SI7021 manual:
+	 *	RH = 125 * code / 65536 - 6 and T = 175.72 * code / 65536 - 46.85.
+	 */
+	*temperatureCentidegrees	= (int16_t)((17572UL * temperature) >> 16) - 4685;
+	*humidityCentipercent		= (int16_t)((12500UL * humidity) >> 16) - 600;
+
+	lastTemperatureSI7021		= *temperatureCentidegrees;
+	lastHumiditySI7021			= *humidityCentipercent;
+	lastMeasurementValidSI7021	= true;
+
 	return kWarpStatusOK;
 }
+
+WarpStatus
+environmentDataSI7021(int16_t *  temperatureCentidegrees, uint16_t *  humidityCentipercent)
+{
+	if (!lastMeasurementValidSI7021)
+	{
+		return kWarpStatusDeviceNotInitialized;
+	}
+
+	/*
+	 *	The conversion can go slightly outside 0--100 %RH.
+	 */
+	*temperatureCentidegrees	= lastTemperatureSI7021;
+	*humidityCentipercent		= (lastHumiditySI7021 < 0) ? 0 : ((lastHumiditySI7021 > 10000) ? 10000 : lastHumiditySI7021);
+
+	return kWarpStatusOK;
+}
+
+void
+printSensorDataSI7021(bool hexModeFlag)
+{
+	int16_t		temperatureCentidegrees;
+	int16_t		humidityCentipercent;
+	WarpStatus	i2cReadStatus;
+
+	i2cReadStatus = measureSI7021(&temperatureCentidegrees, &humidityCentipercent);
+
+	if (i2cReadStatus != kWarpStatusOK)
+	{
+		warpPrint(" ----, ----,");
+	}
+	else
+	{
+		if (hexModeFlag)
+		{
+			warpPrint(" 0x%04x, 0x%04x,", (uint16_t)temperatureCentidegrees, (uint16_t)humidityCentipercent);
+		}
+		else
+		{
+			warpPrint(" %d, %d,", temperatureCentidegrees / 100, humidityCentipercent / 100);
+		}
+	}
+}
+
+uint8_t
+appendSensorDataSI7021(void)
+{
+	int16_t		temperatureCentidegrees;
+	int16_t		humidityCentipercent;
+	int16_t		readings[2] = {0, 0};
+	WarpStatus	i2cReadStatus;
+
+	i2cReadStatus = measureSI7021(&temperatureCentidegrees, &humidityCentipercent);
+
+	if (i2cReadStatus == kWarpStatusOK)
+	{
+		readings[0] = temperatureCentidegrees / 100;
+		readings[1] = humidityCentipercent / 100;
+	}
+
+	/*
+	 * MSB first
+	 */
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		warpFlashStreamByte((uint8_t)(readings[i] >> 8));
+		warpFlashStreamByte((uint8_t)(readings[i]));
+	}
+
+	return sizeof(readings);
+}
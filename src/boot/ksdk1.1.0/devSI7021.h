@@ -36,4 +36,20 @@
 */
 
 void		initSI7021(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts);
+WarpStatus	writeSensorRegisterSI7021(uint8_t deviceRegister, uint8_t payload);
+WarpStatus	configureSensorSI7021(uint8_t payloadResolution);
 WarpStatus	readSensorRegisterSI7021(uint8_t deviceRegister, int numberOfBytes);
+WarpStatus	startMeasurementSI7021(void);
+WarpStatus	readMeasurementSI7021(uint16_t *  humidity, uint16_t *  temperature);
+uint8_t		measurementMillisecondsSI7021(void);
+WarpStatus	environmentDataSI7021(int16_t *  temperatureCentidegrees, uint16_t *  humidityCentipercent);
+void		printSensorDataSI7021(bool hexModeFlag);
+uint8_t		appendSensorDataSI7021(void);
+
+/*
+ *	Same layout as the HDC1000 (temperature in degrees C, then relative
+ *	humidity in percent), so the two can share a slot in the flash log.
+ */
+const uint8_t bytesPerMeasurementSI7021            = 4;
+const uint8_t bytesPerReadingSI7021                = 2;
+const uint8_t numberOfReadingsPerMeasurementSI7021 = 2;
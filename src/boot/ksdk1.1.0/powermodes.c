@@ -7,6 +7,7 @@
 #include "fsl_power_manager.h"
 #include "fsl_gpio_driver.h"
 #include "fsl_llwu_hal.h"
+#include "fsl_lptmr_hal.h"
 #include "fsl_smc_hal.h"
 #include "fsl_clock_manager.h"
 #include "fsl_sim_hal.h"
@@ -189,11 +190,338 @@ update_clock_mode(uint8_t cmConfigMode)
 
 
 
-WarpStatus
-warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
+/*
+ *	Approximate typical supply current in each power mode, in nanoamps,
+ *	from the KL03 data sheet (IDD at 3V, 25C). Indexed by WarpPowerMode.
+ *	These only need to be good enough to rank the sleep modes against
+ *	each other in warpChooseLowPowerMode().
+ */
+static const uint32_t	powerModeSupplyCurrentNanoamps[] =
+{
+	[kWarpPowerModeWAIT]	= 2500000,
+	[kWarpPowerModeSTOP]	= 300000,
+	[kWarpPowerModeVLPR]	= 250000,
+	[kWarpPowerModeVLPW]	= 150000,
+	[kWarpPowerModeVLPS]	= 2000,
+	[kWarpPowerModeVLLS0]	= 300,
+	[kWarpPowerModeVLLS1]	= 700,
+	[kWarpPowerModeVLLS3]	= 1500,
+	[kWarpPowerModeRUN]	= 5000000,
+};
+
+static const char *	powerModeNames[] =
+{
+	[kWarpPowerModeWAIT]	= "WAIT",
+	[kWarpPowerModeSTOP]	= "STOP",
+	[kWarpPowerModeVLPR]	= "VLPR",
+	[kWarpPowerModeVLPW]	= "VLPW",
+	[kWarpPowerModeVLPS]	= "VLPS",
+	[kWarpPowerModeVLLS0]	= "VLLS0",
+	[kWarpPowerModeVLLS1]	= "VLLS1",
+	[kWarpPowerModeVLLS3]	= "VLLS3",
+	[kWarpPowerModeRUN]	= "RUN",
+};
+
+/*
+ *	Time spent in a transition over and above the requested sleep time,
+ *	i.e., the cost of programming the wakeup source, the power manager
+ *	callbacks and any clock manager reconfiguration on the way back. All
+ *	the low-power modes return to either RUN or VLPR, so those are the only
+ *	origins we need to keep track of.
+ *
+ *	These are estimates. Only the time is ever measured, and only for
+ *	sleeps timed by the LPTMR (see warpSetLowPowerModeMilliseconds()): a
+ *	whole-second sleep woken by an RTC or RV8803C7 alarm can overrun by up
+ *	to a second of alarm granularity, which would swamp the overhead. The
+ *	charge drawn during the overhead is taken to be the VLPR current above,
+ *	not measured. The VLLSx entries can never be measured here since those
+ *	modes wake through a reset, so they stay at a rough guess at the boot
+ *	path unless someone calls warpRecordPowerModeTransitionCost() after it.
+ */
+static WarpPowerModeTransitionCost	powerModeTransitionCosts[kWarpPowerModeOriginMax][kWarpPowerModeRUN + 1] =
+{
+	[kWarpPowerModeOriginVLPR] =
+	{
+		[kWarpPowerModeVLPW]	= {.meanMilliseconds = 10},
+		[kWarpPowerModeVLPS]	= {.meanMilliseconds = 10},
+		[kWarpPowerModeVLLS0]	= {.meanMilliseconds = 500},
+		[kWarpPowerModeVLLS1]	= {.meanMilliseconds = 500},
+		[kWarpPowerModeVLLS3]	= {.meanMilliseconds = 500},
+	},
+};
+
+/*
+ *	Set by armLptmrWakeup() so that warpSetLowPowerModeMilliseconds() can
+ *	disarm the compare interrupt again after the sleep.
+ */
+static volatile bool		lptmrWakeupArmed;
+
+/*
+ *	Added to the LPTMR count by warpTimeGetMilliseconds(); see
+ *	armLptmrWakeup().
+ */
+static volatile uint16_t	lptmrTimeOffsetMilliseconds;
+
+static void
+updateClockManagerConfiguration(uint8_t cmConfigIndex)
+{
+	/*
+	 *	CLOCK_SYS_UpdateConfiguration() reprograms the MCG-Lite and runs
+	 *	all the clock manager callbacks even if cmConfigIndex is already
+	 *	the current configuration. When cycling between VLPR and VLPS we
+	 *	come back from VLPS with the VLPR configuration still in place,
+	 *	so skip the redundant reconfiguration.
+	 */
+	if (CLOCK_SYS_GetCurrentConfiguration() != cmConfigIndex)
+	{
+		CLOCK_SYS_UpdateConfiguration(cmConfigIndex, kClockManagerPolicyForcible);
+	}
+}
+
+void
+warpRecordPowerModeTransitionCost(WarpPowerModeOrigin origin, WarpPowerMode powerMode, uint16_t overheadMilliseconds)
+{
+	WarpPowerModeTransitionCost *	cost;
+
+	if ((origin >= kWarpPowerModeOriginMax) || (powerMode > kWarpPowerModeRUN))
+	{
+		return;
+	}
+
+	cost = &powerModeTransitionCosts[origin][powerMode];
+
+	/*
+	 *	The first measurement replaces the initial estimate, subsequent
+	 *	ones go into a running average with weight 1/4.
+	 */
+	if (cost->transitionCount == 0)
+	{
+		cost->meanMilliseconds = overheadMilliseconds;
+	}
+	else
+	{
+		cost->meanMilliseconds = (uint16_t)((int32_t)cost->meanMilliseconds +
+							(((int32_t)overheadMilliseconds - (int32_t)cost->meanMilliseconds) / 4));
+	}
+
+	if (cost->transitionCount < 0xFFFF)
+	{
+		cost->transitionCount++;
+	}
+}
+
+WarpPowerMode
+warpChooseLowPowerMode(uint32_t intervalMilliseconds, bool allowResetWakeup)
+{
+	/*
+	 *	Pick the mode which uses the least charge over the interval, charging
+	 *	the estimated transition overhead at the VLPR current. If no sleep
+	 *	mode pays for itself within the interval, stay in VLPR.
+	 */
+	static const WarpPowerMode	candidates[] =
+					{
+						kWarpPowerModeVLPS,
+						kWarpPowerModeVLLS3,
+						kWarpPowerModeVLLS1,
+						kWarpPowerModeVLLS0,
+					};
+	WarpPowerMode			bestMode = kWarpPowerModeVLPR;
+	uint64_t			bestChargePicocoulombs;
+
+	bestChargePicocoulombs = (uint64_t)intervalMilliseconds * powerModeSupplyCurrentNanoamps[kWarpPowerModeVLPR];
+
+	for (size_t i = 0; i < sizeof(candidates)/sizeof(candidates[0]); i++)
+	{
+		WarpPowerMode	mode = candidates[i];
+		uint32_t	overheadMilliseconds = powerModeTransitionCosts[kWarpPowerModeOriginVLPR][mode].meanMilliseconds;
+		uint64_t	chargePicocoulombs;
+
+		if ((mode != kWarpPowerModeVLPS) && !allowResetWakeup)
+		{
+			continue;
+		}
+
+		if (overheadMilliseconds >= intervalMilliseconds)
+		{
+			continue;
+		}
+
+		chargePicocoulombs = (uint64_t)overheadMilliseconds * powerModeSupplyCurrentNanoamps[kWarpPowerModeVLPR] +
+					(uint64_t)(intervalMilliseconds - overheadMilliseconds) * powerModeSupplyCurrentNanoamps[mode];
+
+		if (chargePicocoulombs < bestChargePicocoulombs)
+		{
+			bestChargePicocoulombs = chargePicocoulombs;
+			bestMode = mode;
+		}
+	}
+
+	return bestMode;
+}
+
+void
+warpPrintPowerModeTransitionCosts(void)
+{
+	warpPrint("\r\n\tTransition overheads (from RUN | from VLPR):\n");
+	for (int mode = kWarpPowerModeWAIT; mode <= kWarpPowerModeRUN; mode++)
+	{
+		warpPrint("\r\t%s:\t%d ms (%d) | %d ms (%d), %d nA\n",
+			powerModeNames[mode],
+			powerModeTransitionCosts[kWarpPowerModeOriginRUN][mode].meanMilliseconds,
+			powerModeTransitionCosts[kWarpPowerModeOriginRUN][mode].transitionCount,
+			powerModeTransitionCosts[kWarpPowerModeOriginVLPR][mode].meanMilliseconds,
+			powerModeTransitionCosts[kWarpPowerModeOriginVLPR][mode].transitionCount,
+			powerModeSupplyCurrentNanoamps[mode]);
+	}
+}
+
+
+
+/*
+ *	Milliseconds from the LPTMR, like OSA_TimeGetMsec(), but without going
+ *	back when armLptmrWakeup() restarts the LPTMR. Wraps at 16 bits. Use
+ *	this rather than OSA_TimeGetMsec() to time anything that can span a
+ *	sleep.
+ */
+uint16_t
+warpTimeGetMilliseconds(void)
+{
+	return (uint16_t)(OSA_TimeGetMsec() + lptmrTimeOffsetMilliseconds);
+}
+
+static void
+armLptmrWakeup(uint16_t sleepMilliseconds)
+{
+	/*
+	 *	The LPTMR is already running from the 1kHz LPO in free-running mode
+	 *	as the OSA time base. The compare register can only be changed while
+	 *	the LPTMR is disabled, which also clears the counter, so carry the
+	 *	count reached so far over into lptmrTimeOffsetMilliseconds:
+	 *	warpTimeGetMilliseconds() then keeps counting up across the restart.
+	 *	Since the LPTMR is free-running, the counter keeps going after the
+	 *	compare match.
+	 *
+	 *	The LPTMR is LLWU internal module 0 on the KL03, so it can also wake
+	 *	us from VLLS1 and VLLS3 (but not VLLS0, where the LPO is off).
+	 */
+	lptmrWakeupArmed = true;
+
+	lptmrTimeOffsetMilliseconds = warpTimeGetMilliseconds();
+	LPTMR_HAL_Disable(LPTMR0_BASE);
+	LPTMR_HAL_SetCompareValue(LPTMR0_BASE, sleepMilliseconds);
+	LPTMR_HAL_ClearIntFlag(LPTMR0_BASE);
+	LPTMR_HAL_SetIntCmd(LPTMR0_BASE, true);
+	LLWU->ME |= LLWU_ME_WUME0_MASK;		/*	KSDK's feature header omits the LLWU internal modules for the KL03	*/
+	INT_SYS_EnableIRQ(LPTMR0_IRQn);
+	INT_SYS_EnableIRQ(LLWU_IRQn);
+	LPTMR_HAL_Enable(LPTMR0_BASE);
+}
+
+/*
+ *	After a sleep armed with armLptmrWakeup(): if something else woke us
+ *	before the compare match, the match would otherwise still interrupt us
+ *	later.
+ */
+static void
+disarmLptmrWakeup(void)
+{
+	LPTMR_HAL_SetIntCmd(LPTMR0_BASE, false);
+	LPTMR_HAL_ClearIntFlag(LPTMR0_BASE);
+	LLWU->ME &= ~LLWU_ME_WUME0_MASK;
+	lptmrWakeupArmed = false;
+}
+
+static WarpStatus
+armWakeupSource(WarpPowerMode powerMode, uint32_t sleepMilliseconds)
+{
+	/*
+	 *	Whole-second sleeps use the RV8803C7 countdown at 1Hz (or the KL03
+	 *	RTC alarm on builds without the RV8803C7), as before.
+	 *
+	 *	Sub-second sleeps use the LPTMR, which needs no I2C traffic to arm.
+	 *	In VLLS0 the LPO is off, so there we fall back to the RV8803C7
+	 *	countdown at 4096Hz (up to ~1s) or 64Hz (up to ~64s).
+	 */
+	if ((sleepMilliseconds % 1000) == 0)
+	{
+		#if (WARP_BUILD_ENABLE_DEVRV8803C7)
+			/*
+			 *	Program RV8803 external interrupt
+			 */
+			warpEnableI2Cpins();
+			setRTCCountdownRV8803C7(sleepMilliseconds/1000, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
+			warpDisableI2Cpins();
+
+			gpioEnableWakeUp();
+		#else
+			/*
+			 *	In Glaux, because we have the external clock going to RTC_CLKIN,
+			 *	we can actually have the RTC active in stop modes too.
+			 *
+			 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
+			 *
+			 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
+			 *	we are able to wake from VLLS0.
+			 */
+			gpioDisableWakeUp();
+			setSleepRtcAlarm(sleepMilliseconds/1000);
+		#endif
+
+		return kWarpStatusOK;
+	}
+
+	if ((powerMode != kWarpPowerModeVLLS0) && (sleepMilliseconds <= 0xFFFF))
+	{
+		armLptmrWakeup(sleepMilliseconds);
+
+		return kWarpStatusOK;
+	}
+
+	#if (WARP_BUILD_ENABLE_DEVRV8803C7)
+	{
+		WarpRV8803ExtTD	clockFrequency;
+		uint32_t	countdown;
+
+		if (sleepMilliseconds >= 64000)
+		{
+			return kWarpStatusPowerTransitionErrorBadSleepTime;
+		}
+
+		if (sleepMilliseconds < 1000)
+		{
+			clockFrequency = kWarpRV8803ExtTD_4kHZ;
+			countdown = (sleepMilliseconds * 4096) / 1000;
+		}
+		else
+		{
+			clockFrequency = kWarpRV8803ExtTD_64HZ;
+			countdown = (sleepMilliseconds * 64) / 1000;
+		}
+
+		if ((countdown == 0) || (countdown > 4095))
+		{
+			return kWarpStatusPowerTransitionErrorBadSleepTime;
+		}
+
+		warpEnableI2Cpins();
+		setRTCCountdownRV8803C7(countdown, clockFrequency, true /* interupt_enable */);
+		warpDisableI2Cpins();
+
+		gpioEnableWakeUp();
+
+		return kWarpStatusOK;
+	}
+	#else
+		return kWarpStatusPowerTransitionErrorBadSleepTime;
+	#endif
+}
+
+static WarpStatus
+transitionToPowerMode(WarpPowerMode powerMode, uint32_t sleepMilliseconds)
 {
 	uint8_t				cmConfigMode = CLOCK_CONFIG_INDEX_FOR_RUN;
 	power_manager_error_code_t	status;
+	WarpStatus			wakeupStatus;
 
 
 	switch (powerMode)
@@ -205,28 +533,11 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 				return kWarpStatusPowerTransitionErrorVlpr2Wait;
 			}
 
-			#if (WARP_BUILD_ENABLE_DEVRV8803C7)
-				/*
-				*	Program RV8803 external interrupt
-				*/
-				warpEnableI2Cpins();
-				setRTCCountdownRV8803C7(sleepSeconds, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
-				warpDisableI2Cpins();
-
-				gpioEnableWakeUp();
-			#else
-				/*
-				 *	In Glaux, because we have the external clock going to RTC_CLKIN,
-				 *	we can actually have the RTC active in stop modes too.
-				 *
-				 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
-				 *
-				 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
-				 *	we are able to wake from VLLS0.
-				 */
-				gpioDisableWakeUp();
-				setSleepRtcAlarm(sleepSeconds);
-			#endif
+			wakeupStatus = armWakeupSource(powerMode, sleepMilliseconds);
+			if (wakeupStatus != kWarpStatusOK)
+			{
+				return wakeupStatus;
+			}
 
 			status = POWER_SYS_SetMode(powerMode, kPowerManagerPolicyAgreement);
 
@@ -239,7 +550,7 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 			/*
 			 *	For now, always go to VLPR upon completion of prior mode
 			 */
-			CLOCK_SYS_UpdateConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR, kClockManagerPolicyForcible);
+			updateClockManagerConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR);
 			
 
 			if (status != kPowerManagerSuccess)
@@ -257,35 +568,18 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 				return kWarpStatusPowerTransitionErrorVlpr2Stop;
 			}
 
-			#if (WARP_BUILD_ENABLE_DEVRV8803C7)
-				/*
-				 *	Program RV8803 external interrupt
-				 */
-				warpEnableI2Cpins();
-				setRTCCountdownRV8803C7(sleepSeconds, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
-				warpDisableI2Cpins();
-
-				gpioEnableWakeUp();
-			#else
-				/*
-				 *	In Glaux, because we have the external clock going to RTC_CLKIN,
-				 *	we can actually have the RTC active in stop modes too.
-				 *
-				 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
-				 *
-				 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
-				 *	we are able to wake from VLLS0.
-				 */
-				gpioDisableWakeUp();
-				setSleepRtcAlarm(sleepSeconds);
-			#endif
+			wakeupStatus = armWakeupSource(powerMode, sleepMilliseconds);
+			if (wakeupStatus != kWarpStatusOK)
+			{
+				return wakeupStatus;
+			}
 
 			status = POWER_SYS_SetMode(powerMode, kPowerManagerPolicyAgreement);
 
 			/*
 			 *	For now, always go to VLPR upon completion of prior mode
 			 */
-			CLOCK_SYS_UpdateConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR, kClockManagerPolicyForcible);
+			updateClockManagerConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR);
 
 			if (status != kPowerManagerSuccess)
 			{
@@ -327,28 +621,11 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 				return kWarpStatusPowerTransitionErrorRun2Vlpw;
 			}
 
-			#if (WARP_BUILD_ENABLE_DEVRV8803C7)
-				/*
-				*	Program RV8803 external interrupt
-				*/
-				warpEnableI2Cpins();
-				setRTCCountdownRV8803C7(sleepSeconds, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
-				warpDisableI2Cpins();
-
-				gpioEnableWakeUp();
-			#else
-				/*
-				 *	In Glaux, because we have the external clock going to RTC_CLKIN,
-				 *	we can actually have the RTC active in stop modes too.
-				 *
-				 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
-				 *
-				 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
-				 *	we are able to wake from VLLS0.
-				 */
-				gpioDisableWakeUp();
-				setSleepRtcAlarm(sleepSeconds);
-			#endif
+			wakeupStatus = armWakeupSource(powerMode, sleepMilliseconds);
+			if (wakeupStatus != kWarpStatusOK)
+			{
+				return wakeupStatus;
+			}
 
 			status = POWER_SYS_SetMode(powerMode, kPowerManagerPolicyAgreement);
 
@@ -357,7 +634,7 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 				/*
 				 *	For now, always go to VLPR upon completion of prior mode
 				 */
-				CLOCK_SYS_UpdateConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR, kClockManagerPolicyForcible);
+				updateClockManagerConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR);
 			}
 
 			if (status != kPowerManagerSuccess)
@@ -370,28 +647,11 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 
 		case kWarpPowerModeVLPS:
 		{
-			#if (WARP_BUILD_ENABLE_DEVRV8803C7)
-				/*
-				 *	Program RV8803 external interrupt
-				 */
-				warpEnableI2Cpins();
-				setRTCCountdownRV8803C7(sleepSeconds, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
-				warpDisableI2Cpins();
-
-				gpioEnableWakeUp();
-			#else
-				/*
-				 *	In Glaux, because we have the external clock going to RTC_CLKIN,
-				 *	we can actually have the RTC active in stop modes too.
-				 *
-				 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
-				 *
-				 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
-				 *	we are able to wake from VLLS0.
-				 */
-				gpioDisableWakeUp();
-				setSleepRtcAlarm(sleepSeconds);
-			#endif
+			wakeupStatus = armWakeupSource(powerMode, sleepMilliseconds);
+			if (wakeupStatus != kWarpStatusOK)
+			{
+				return wakeupStatus;
+			}
 
 			status = POWER_SYS_SetMode(powerMode, kPowerManagerPolicyAgreement);
 
@@ -404,7 +664,7 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 				/*
 				 *	For now, always go to VLPR upon completion of prior mode
 				 */
-				CLOCK_SYS_UpdateConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR, kClockManagerPolicyForcible);
+				updateClockManagerConfiguration(CLOCK_CONFIG_INDEX_FOR_VLPR);
 				
 			}
 
@@ -430,7 +690,7 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 			}
 			else
 			{
-				CLOCK_SYS_UpdateConfiguration(CLOCK_CONFIG_INDEX_FOR_RUN, kClockManagerPolicyForcible);
+				updateClockManagerConfiguration(CLOCK_CONFIG_INDEX_FOR_RUN);
 			}
 
 			break;
@@ -438,31 +698,11 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 
 		case kWarpPowerModeVLLS0:
 		{
-			#if (WARP_BUILD_ENABLE_DEVRV8803C7)
-				/*
-				 *	Program RV8803 external interrupt
-				 */
-				warpEnableI2Cpins();
-				setRTCCountdownRV8803C7(sleepSeconds, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
-				warpDisableI2Cpins();
-
-				/*
-				 *	Since we wakeup via reset and we also turn these back on at reset:
-				 */
-				gpioEnableWakeUp();
-			#else
-				/*
-				 *	In Glaux, because we have the external clock going to RTC_CLKIN,
-				 *	we can actually have the RTC active in stop modes too.
-				 *
-				 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
-				 *
-				 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
-				 *	we are able to wake from VLLS0.
-				 */
-				gpioDisableWakeUp();
-				setSleepRtcAlarm(sleepSeconds);
-			#endif
+			wakeupStatus = armWakeupSource(powerMode, sleepMilliseconds);
+			if (wakeupStatus != kWarpStatusOK)
+			{
+				return wakeupStatus;
+			}
 
 			status = POWER_SYS_SetMode(powerMode, kPowerManagerPolicyAgreement);
 
@@ -478,31 +718,11 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 
 		case kWarpPowerModeVLLS1:
 		{
-			/*
-			 *	TODO: this can be replaced using the internal RTC
-			 */
-			#if (WARP_BUILD_ENABLE_DEVRV8803C7)
-				/*
-				 *	Program RV8803 external interrupt
-				 */
-				warpEnableI2Cpins();
-				setRTCCountdownRV8803C7(sleepSeconds, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
-				warpDisableI2Cpins();
-
-				gpioEnableWakeUp();
-			#else
-				/*
-				 *	In Glaux, because we have the external clock going to RTC_CLKIN,
-				 *	we can actually have the RTC active in stop modes too.
-				 *
-				 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
-				 *
-				 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
-				 *	we are able to wake from VLLS0.
-				 */
-				gpioDisableWakeUp();
-				setSleepRtcAlarm(sleepSeconds);
-			#endif
+			wakeupStatus = armWakeupSource(powerMode, sleepMilliseconds);
+			if (wakeupStatus != kWarpStatusOK)
+			{
+				return wakeupStatus;
+			}
 
 			status = POWER_SYS_SetMode(powerMode, kPowerManagerPolicyAgreement);
 
@@ -517,31 +737,11 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 
 		case kWarpPowerModeVLLS3:
 		{
-			/*
-			 *	TODO: this can be replaced using the internal RTC
-			 */
-			#if (WARP_BUILD_ENABLE_DEVRV8803C7)
-				/*
-				 *	Program RV8803 external interrupt
-				 */
-				warpEnableI2Cpins();
-				setRTCCountdownRV8803C7(sleepSeconds, kWarpRV8803ExtTD_1HZ, true /* interupt_enable */);
-				warpDisableI2Cpins();
-
-				gpioEnableWakeUp();
-			#else
-				/*
-				 *	In Glaux, because we have the external clock going to RTC_CLKIN,
-				 *	we can actually have the RTC active in stop modes too.
-				 *
-				 *	See footnote 5 of Table 7-2. "Module operation in low-power modes".
-				 *
-				 *	TODO: Need to test Warp variant of firmware on Glaux HW and see if
-				 *	we are able to wake from VLLS0.
-				 */
-				gpioDisableWakeUp();
-				setSleepRtcAlarm(sleepSeconds);
-			#endif
+			wakeupStatus = armWakeupSource(powerMode, sleepMilliseconds);
+			if (wakeupStatus != kWarpStatusOK)
+			{
+				return wakeupStatus;
+			}
 
 			status = POWER_SYS_SetMode(powerMode, kPowerManagerPolicyAgreement);
 
@@ -562,3 +762,86 @@ warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
 
 	return kWarpStatusOK;
 }
+
+
+
+WarpStatus
+warpSetLowPowerModeMilliseconds(WarpPowerMode powerMode, uint32_t sleepMilliseconds)
+{
+	WarpStatus		status;
+	WarpPowerModeOrigin	origin;
+	uint16_t		startMilliseconds;
+	uint16_t		elapsedMilliseconds;
+	bool			timedByLptmr;
+
+	origin = (POWER_SYS_GetCurrentMode() == kPowerManagerVlpr) ? kWarpPowerModeOriginVLPR : kWarpPowerModeOriginRUN;
+
+	/*
+	 *	warpTimeGetMilliseconds() is the free-running LPTMR counter, clocked
+	 *	from the 1kHz LPO, which keeps running in VLPS, and it keeps counting
+	 *	up across the LPTMR restart in armLptmrWakeup(). It is only 16 bits
+	 *	wide, but the LPTMR only times sleeps shorter than ~65s. Only sleeps
+	 *	the LPTMR timed are recorded as a transition cost, as any other
+	 *	wakeup source can be late by up to its own tick.
+	 */
+	lptmrWakeupArmed = false;
+	startMilliseconds = warpTimeGetMilliseconds();
+	status = transitionToPowerMode(powerMode, sleepMilliseconds);
+	timedByLptmr = lptmrWakeupArmed;
+	if (timedByLptmr)
+	{
+		disarmLptmrWakeup();
+	}
+	elapsedMilliseconds = warpTimeGetMilliseconds() - startMilliseconds;
+
+	if ((status == kWarpStatusOK) && timedByLptmr)
+	{
+		warpRecordPowerModeTransitionCost(origin, powerMode,
+				(elapsedMilliseconds > sleepMilliseconds) ? (elapsedMilliseconds - sleepMilliseconds) : 0);
+	}
+
+	return status;
+}
+
+WarpStatus
+warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds)
+{
+	return warpSetLowPowerModeMilliseconds(powerMode, sleepSeconds*1000);
+}
+
+void
+warpSleepMilliseconds(uint32_t sleepMilliseconds)
+{
+	/*
+	 *	For short waits on a peripheral (e.g., a sensor conversion). From
+	 *	VLPR, sleep in VLPS if that repays its transition cost, otherwise in
+	 *	VLPW. From RUN, or if the sleep fails, fall back to a busy wait. Bus
+	 *	sessions held across a VLPS sleep are shut down first and set up
+	 *	again on their next transaction.
+	 */
+	if (sleepMilliseconds == 0)
+	{
+		return;
+	}
+
+	if (POWER_SYS_GetCurrentMode() == kPowerManagerVlpr)
+	{
+		WarpPowerMode	sleepMode = warpChooseLowPowerMode(sleepMilliseconds, false /* allowResetWakeup */);
+
+		if (sleepMode != kWarpPowerModeVLPS)
+		{
+			sleepMode = kWarpPowerModeVLPW;
+		}
+		else
+		{
+			warpSuspendBusSessions();
+		}
+
+		if (warpSetLowPowerModeMilliseconds(sleepMode, sleepMilliseconds) == kWarpStatusOK)
+		{
+			return;
+		}
+	}
+
+	OSA_TimeDelay(sleepMilliseconds);
+}
@@ -0,0 +1,349 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "fsl_misc_utilities.h"
+
+#include "config.h"
+#include "warp.h"
+
+
+
+/*
+ *	Vibration spectra of accelerometer windows on the KL03: an in-place
+ *	radix-2 real FFT on int16_t samples and reductions of the spectrum to
+ *	a few band energies or peaks, so that only those need to be logged.
+ *	The Cortex-M0+ has no FPU and no divider, so everything is Q15 integer
+ *	arithmetic with block floating point: the data are shifted before any
+ *	stage that could overflow and the shifts are returned to the caller.
+ */
+
+/*
+ *	sin(2 * pi * k / 256) in Q15 for the first quarter turn, k = 0..64.
+ */
+static const int16_t	sineTableSpectrum[65] =
+{
+	0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+	6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+	18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+	27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+	32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767,
+};
+
+/*
+ *	sin(2 * pi * k / 256) for any k.
+ */
+static int16_t
+sineSpectrum(uint8_t k)
+{
+	int16_t	value = (k & 0x40) ? sineTableSpectrum[64 - (k & 0x3F)] : sineTableSpectrum[k & 0x3F];
+
+	return (k & 0x80) ? -value : value;
+}
+
+static int16_t
+cosineSpectrum(uint8_t k)
+{
+	return sineSpectrum(k + 64);
+}
+
+/*
+ *	Largest magnitude the butterflies can take without overflowing: a + W*b
+ *	grows by up to 1 + sqrt(2).
+ */
+#define kSpectrumHeadroomLimit	13572
+
+/*
+ *	Halve all n values until none is above kSpectrumHeadroomLimit, or, with
+ *	grow, double them while that leaves them below it, so that small
+ *	signals keep their precision. Returns the change in scale as a power
+ *	of two.
+ */
+static int8_t
+rescaleSpectrum(int16_t *  x, uint16_t n, bool grow)
+{
+	int16_t	maximum = 0;
+	int8_t	shift = 0;
+
+	for (uint16_t i = 0; i < n; i++)
+	{
+		maximum = MAX(maximum, abs(x[i]));
+	}
+
+	while (maximum > kSpectrumHeadroomLimit)
+	{
+		maximum >>= 1;
+		shift++;
+	}
+	while (grow && (maximum != 0) && (maximum <= kSpectrumHeadroomLimit / 2))
+	{
+		maximum <<= 1;
+		shift--;
+	}
+
+	for (uint16_t i = 0; (shift != 0) && (i < n); i++)
+	{
+		x[i] = (shift > 0) ? (int16_t)((x[i] + (1 << (shift - 1))) >> shift) : (int16_t)(x[i] << -shift);
+	}
+
+	return shift;
+}
+
+/*
+ *	Spectrum of 2^log2Points (at most 256) real samples, of at most 15
+ *	bits, in place. The mean is removed and a Hann window applied first.
+ *	On return x[0] is the DC term, x[1] the Nyquist term and x[2k], x[2k+1]
+ *	the real and imaginary parts of bin k for 0 < k < 2^(log2Points-1).
+ *	Returns the power of two the values have to be multiplied by.
+ */
+int8_t
+warpSpectrumReal(int16_t *  x, uint8_t log2Points)
+{
+	uint16_t	points = 1 << log2Points;
+	uint16_t	halfPoints = points >> 1;
+	uint8_t		tableStep = 256 >> log2Points;
+	int32_t		sum = 0;
+	int16_t		mean;
+	int8_t		shift;
+
+	for (uint16_t i = 0; i < points; i++)
+	{
+		sum += x[i];
+	}
+	mean = (int16_t)((sum + (points >> 1)) >> log2Points);
+
+	for (uint16_t i = 0; i < points; i++)
+	{
+		x[i] -= mean;
+	}
+
+	/*
+	 *	Scale up before the Hann window, (1 - cos(2 * pi * n / N)) / 2, so
+	 *	that weak signals are not lost to rounding.
+	 */
+	shift = rescaleSpectrum(x, points, true);
+
+	for (uint16_t i = 0; i < points; i++)
+	{
+		int32_t	window = (32768 - cosineSpectrum((uint8_t)(i * tableStep))) >> 1;
+
+		x[i] = (int16_t)(((int32_t)x[i] * window + (1 << 14)) >> 15);
+	}
+
+	/*
+	 *	The even and odd samples are the real and imaginary parts of a
+	 *	complex sequence of half the length. Put it in bit-reversed order.
+	 */
+	for (uint16_t i = 0, j = 0; i < halfPoints; i++)
+	{
+		if (i < j)
+		{
+			int16_t	re = x[2 * i], im = x[2 * i + 1];
+
+			x[2 * i]		= x[2 * j];
+			x[2 * i + 1]	= x[2 * j + 1];
+			x[2 * j]		= re;
+			x[2 * j + 1]	= im;
+		}
+
+		uint16_t	bit = halfPoints >> 1;
+
+		while (j & bit)
+		{
+			j ^= bit;
+			bit >>= 1;
+		}
+		j |= bit;
+	}
+
+	/*
+	 *	Decimation-in-time radix-2 butterflies.
+	 */
+	for (uint8_t stage = 0; (1 << stage) < halfPoints; stage++)
+	{
+		uint16_t	span = 1 << stage;
+		uint8_t		step = 128 >> stage;
+
+		shift += rescaleSpectrum(x, points, false);
+
+		for (uint16_t m = 0; m < span; m++)
+		{
+			int32_t	c = cosineSpectrum((uint8_t)(m * step));
+			int32_t	s = sineSpectrum((uint8_t)(m * step));
+
+			for (uint16_t i = m; i < halfPoints; i += 2 * span)
+			{
+				int16_t *	a = &x[2 * i];
+				int16_t *	b = &x[2 * (i + span)];
+				int32_t		tr = (c * b[0] + s * b[1] + (1 << 14)) >> 15;
+				int32_t		ti = (c * b[1] - s * b[0] + (1 << 14)) >> 15;
+
+				b[0] = (int16_t)(a[0] - tr);
+				b[1] = (int16_t)(a[1] - ti);
+				a[0] = (int16_t)(a[0] + tr);
+				a[1] = (int16_t)(a[1] + ti);
+			}
+		}
+	}
+
+	/*
+	 *	Separate the spectra of the even and odd samples and combine them:
+	 *	X[k] = E + W^k O and X[N/2 - k] = conj(E - W^k O), with
+	 *	E = (Z[k] + conj(Z[N/2 - k])) / 2, O = (Z[k] - conj(Z[N/2 - k])) / 2j.
+	 */
+	shift += rescaleSpectrum(x, points, false);
+	{
+		int16_t	re = x[0], im = x[1];
+
+		x[0] = re + im;
+		x[1] = re - im;
+	}
+
+	for (uint16_t k = 1; k <= halfPoints / 2; k++)
+	{
+		int16_t *	a = &x[2 * k];
+		int16_t *	b = &x[2 * (halfPoints - k)];
+		int32_t		c = cosineSpectrum((uint8_t)(k * tableStep));
+		int32_t		s = sineSpectrum((uint8_t)(k * tableStep));
+		int32_t		evenRe = (a[0] + b[0]) >> 1;
+		int32_t		evenIm = (a[1] - b[1]) >> 1;
+		int32_t		oddRe = (a[1] + b[1]) >> 1;
+		int32_t		oddIm = (b[0] - a[0]) >> 1;
+		int32_t		tr = (c * oddRe + s * oddIm + (1 << 14)) >> 15;
+		int32_t		ti = (c * oddIm - s * oddRe + (1 << 14)) >> 15;
+
+		a[0] = (int16_t)(evenRe + tr);
+		a[1] = (int16_t)(evenIm + ti);
+		b[0] = (int16_t)(evenRe - tr);
+		b[1] = (int16_t)(ti - evenIm);
+	}
+
+	return shift;
+}
+
+/*
+ *	|X[k]|^2 of a spectrum from warpSpectrumReal(), unscaled.
+ */
+static uint32_t
+powerSpectrum(const int16_t *  x, uint16_t k, uint16_t halfPoints)
+{
+	if (k == 0)
+	{
+		return (uint32_t)((int32_t)x[0] * x[0]);
+	}
+	if (k == halfPoints)
+	{
+		return (uint32_t)((int32_t)x[1] * x[1]);
+	}
+
+	return (uint32_t)((int32_t)x[2 * k] * x[2 * k]) + (uint32_t)((int32_t)x[2 * k + 1] * x[2 * k + 1]);
+}
+
+/*
+ *	log2(power * 4^shift) in Q8, to within about 0.01, or 0 for no power.
+ *	This keeps the dynamic range of the energies in 16 bits.
+ */
+static int16_t
+levelSpectrum(uint64_t power, int8_t shift)
+{
+	int16_t		msb = 63;
+	uint16_t	fraction;
+
+	if (power == 0)
+	{
+		return 0;
+	}
+
+	while (!(power & (1ULL << msb)))
+	{
+		msb--;
+	}
+
+	fraction = (uint16_t)(((msb >= 8) ? (power >> (msb - 8)) : (power << (8 - msb))) & 0xFF);
+
+	/*
+	 *	log2(1 + f) is f plus a bump of about 0.34 f (1 - f).
+	 */
+	return (int16_t)((msb + 2 * shift) * 256 + fraction + ((fraction * (256 - fraction) * 87) >> 16));
+}
+
+/*
+ *	Energy in numberOfBands equal bands between DC and Nyquist (DC
+ *	excluded), as levels from levelSpectrum(). numberOfBands must be a
+ *	power of two no larger than 2^(log2Points-1).
+ */
+void
+warpSpectrumBands(const int16_t *  x, uint8_t log2Points, int8_t shift, int16_t *  levels, uint8_t numberOfBands)
+{
+	uint16_t	halfPoints = 1 << (log2Points - 1);
+	uint16_t	binsPerBand = halfPoints / numberOfBands;
+	uint16_t	k = 1;
+
+	for (uint8_t band = 0; band < numberOfBands; band++)
+	{
+		uint64_t	energy = 0;
+
+		for (; k <= binsPerBand * (band + 1); k++)
+		{
+			energy += powerSpectrum(x, k, halfPoints);
+		}
+		levels[band] = levelSpectrum(energy, shift);
+	}
+}
+
+/*
+ *	The numberOfPeaks strongest local maxima, strongest first, as bin
+ *	numbers and levels from levelSpectrum(). Unused entries are zero.
+ */
+void
+warpSpectrumPeaks(const int16_t *  x, uint8_t log2Points, int8_t shift, uint8_t *  bins, int16_t *  levels, uint8_t numberOfPeaks)
+{
+	uint16_t	halfPoints = 1 << (log2Points - 1);
+	uint32_t	power[kWarpSpectrumMaxPeaks];
+	uint32_t	previous = powerSpectrum(x, 0, halfPoints);
+	uint32_t	current = powerSpectrum(x, 1, halfPoints);
+
+	numberOfPeaks = MIN(numberOfPeaks, kWarpSpectrumMaxPeaks);
+	if (numberOfPeaks == 0)
+	{
+		return;
+	}
+
+	for (uint8_t i = 0; i < numberOfPeaks; i++)
+	{
+		power[i]	= 0;
+		bins[i]		= 0;
+	}
+
+	for (uint16_t k = 1; k < halfPoints; k++)
+	{
+		uint32_t	next = powerSpectrum(x, k + 1, halfPoints);
+
+		if ((current > previous) && (current >= next))
+		{
+			int8_t	i = numberOfPeaks - 1;
+
+			if (current > power[i])
+			{
+				for (; (i > 0) && (current > power[i - 1]); i--)
+				{
+					power[i]	= power[i - 1];
+					bins[i]		= bins[i - 1];
+				}
+				power[i]	= current;
+				bins[i]		= (uint8_t)k;
+			}
+		}
+
+		previous	= current;
+		current		= next;
+	}
+
+	for (uint8_t i = 0; i < numberOfPeaks; i++)
+	{
+		levels[i] = levelSpectrum(power[i], shift);
+	}
+}
@@ -50,11 +50,14 @@ typedef enum
 	kWarpStatusPowerTransitionErrorVlpr2Vlpr,
 	kWarpStatusErrorPowerSysSetmode,
 	kWarpStatusBadPowerModeSpecified,
+	kWarpStatusPowerTransitionErrorBadSleepTime,
 
 	/*
 	 *	Errors with flash
 	*/
 	kWarpStatusFlashFull,
+	kWarpStatusFlashReadyTimeout,
+	kWarpStatusFlashVerifyFailed,
 	/*
 	 *	Always keep this as the last item.
 	 */
@@ -79,6 +82,13 @@ typedef enum
 	kWarpPowerModeRUN,
 } WarpPowerMode;
 
+typedef enum
+{
+	kWarpPowerModeOriginRUN,
+	kWarpPowerModeOriginVLPR,
+	kWarpPowerModeOriginMax,
+} WarpPowerModeOrigin;
+
 typedef enum
 {
 	kWarpSensorADXL362,
@@ -144,11 +154,15 @@ typedef enum
 
 	kWarpSensorConfigurationRegisterHDC1000Configuration	= 0x02,
 
+	kWarpSensorConfigurationRegisterSI7021WriteUserRegister1	= 0xE6,
+	kWarpSensorConfigurationRegisterSI7021ReadUserRegister1	= 0xE7,
+
 	kWarpSensorConfigurationRegisterAMG8834PCTL				= 0x00,
 	kWarpSensorConfigurationRegisterAMG8834RST				= 0x01,
 	kWarpSensorConfigurationRegisterAMG8834FPSC				= 0x02,
 
 	kWarpSensorConfigurationRegisterCCS811MEAS_MODE			= 0x01,
+	kWarpSensorConfigurationRegisterCCS811ENV_DATA			= 0x05,
 	kWarpSensorConfigurationRegisterCCS811APP_START			= 0xF4,
 
 	kWarpSensorConfigurationRegisterBMX055accelPMU_RANGE		= 0x0F,
@@ -156,16 +170,27 @@ typedef enum
 	kWarpSensorConfigurationRegisterBMX055accelPMU_LPW			= 0x11,
 	kWarpSensorConfigurationRegisterBMX055accelPMU_LOW_POWER	= 0x12,
 	kWarpSensorConfigurationRegisterBMX055accelACCD_HBW			= 0x13,
+	kWarpSensorConfigurationRegisterBMX055accelINT_EN_1			= 0x17,
+	kWarpSensorConfigurationRegisterBMX055accelINT_MAP_1		= 0x1A,
+	kWarpSensorConfigurationRegisterBMX055accelFIFO_CONFIG_0	= 0x30,
+	kWarpSensorConfigurationRegisterBMX055accelFIFO_CONFIG_1	= 0x3E,
 	kWarpSensorConfigurationRegisterBMX055magPowerCtrl			= 0x4B,
 	kWarpSensorConfigurationRegisterBMX055magOpMode				= 0x4C,
 	kWarpSensorConfigurationRegisterBMX055gyroRANGE				= 0x0F,
 	kWarpSensorConfigurationRegisterBMX055gyroBW				= 0x10,
 	kWarpSensorConfigurationRegisterBMX055gyroLPM1				= 0x11,
 	kWarpSensorConfigurationRegisterBMX055gyroRATE_HBW			= 0x13,
+	kWarpSensorConfigurationRegisterBMX055gyroINT_EN_0			= 0x15,
+	kWarpSensorConfigurationRegisterBMX055gyroINT_MAP_1			= 0x18,
+	kWarpSensorConfigurationRegisterBMX055gyroFIFO_WM_EN		= 0x1E,
+	kWarpSensorConfigurationRegisterBMX055gyroFIFO_CONFIG_0		= 0x3D,
+	kWarpSensorConfigurationRegisterBMX055gyroFIFO_CONFIG_1		= 0x3E,
 
 	kWarpSensorConfigurationRegisterL3GD20HCTRL1				= 0x20,
 	kWarpSensorConfigurationRegisterL3GD20HCTRL2				= 0x21,
+	kWarpSensorConfigurationRegisterL3GD20HCTRL3				= 0x22,
 	kWarpSensorConfigurationRegisterL3GD20HCTRL5				= 0x24,
+	kWarpSensorConfigurationRegisterL3GD20HFIFO_CTRL			= 0x2E,
 
 	kWarpSensorConfigurationRegisterBME680Reset					= 0xE0,
 	kWarpSensorConfigurationRegisterBME680Config				= 0x75,
@@ -173,6 +198,8 @@ typedef enum
 	kWarpSensorConfigurationRegisterBME680Ctrl_Hum				= 0x72,
 	kWarpSensorConfigurationRegisterBME680Ctrl_Gas_1			= 0x71,
 	kWarpSensorConfigurationRegisterBME680Ctrl_Gas_0			= 0x70,
+	kWarpSensorConfigurationRegisterBME680Gas_Wait_0			= 0x64,
+	kWarpSensorConfigurationRegisterBME680Res_Heat_0			= 0x5A,
 
 	kWarpSensorConfigurationRegisterBME680CalibrationRegion1Start	= 0x89,
 	kWarpSensorConfigurationRegisterBME680CalibrationRegion1End		= 0xA2,
@@ -196,6 +223,7 @@ typedef enum
 
 typedef enum
 {
+	kWarpSensorOutputRegisterMMA8451QF_STATUS			= 0x00,
 	kWarpSensorOutputRegisterMMA8451QOUT_X_MSB			= 0x01,
 	kWarpSensorOutputRegisterMMA8451QOUT_X_LSB			= 0x02,
 	kWarpSensorOutputRegisterMMA8451QOUT_Y_MSB			= 0x03,
@@ -203,6 +231,7 @@ typedef enum
 	kWarpSensorOutputRegisterMMA8451QOUT_Z_MSB			= 0x05,
 	kWarpSensorOutputRegisterMMA8451QOUT_Z_LSB			= 0x06,
 
+	kWarpSensorOutputRegisterMAG3110DR_STATUS			= 0x00,
 	kWarpSensorOutputRegisterMAG3110OUT_X_MSB			= 0x01,
 	kWarpSensorOutputRegisterMAG3110OUT_X_LSB			= 0x02,
 	kWarpSensorOutputRegisterMAG3110OUT_Y_MSB			= 0x03,
@@ -214,6 +243,10 @@ typedef enum
 	kWarpSensorOutputRegisterHDC1000Temperature			= 0x00,
 	kWarpSensorOutputRegisterHDC1000Humidity			= 0x01,
 
+	kWarpSensorOutputRegisterSI7021MeasureRHNoHold		= 0xF5,
+	kWarpSensorOutputRegisterSI7021MeasureTNoHold		= 0xF3,
+	kWarpSensorOutputRegisterSI7021TFromPreviousRH		= 0xE0,
+
 	kWarpSensourOutputRegisterBNO055EUL_HEADING_LSB		= 0x1A,
 	kWarpSensourOutputRegisterBNO055EUL_HEADING_MSB		= 0x1B,
 	kWarpSensourOutputRegisterBNO055EUL_ROLL_LSB		= 0x1C,
@@ -238,12 +271,14 @@ typedef enum
 	kWarpSensourOutputRegisterBNO055Gyro_Data_Y_MSB		= 0x17,
 	kWarpSensourOutputRegisterBNO055Gyro_Data_Z_LSB		= 0x18,
 	kWarpSensourOutputRegisterBNO055Gyro_Data_Z_MSB		= 0x19,
+	kWarpSensourOutputRegisterBNO055QUA_Data_W_LSB		= 0x20,
 
 	kWarpSensorOutputRegisterAMG8834TTHL				= 0x0E,
 	kWarpSensorOutputRegisterAMG8834TTHH				= 0x0F,
 	kWarpSensorOutputRegisterAMG8834T01L				= 0x80,
 	kWarpSensorOutputRegisterAMG8834T64H				= 0xFF,
 
+	kWarpSensorOutputRegisterCCS811STATUS				= 0x00,
 	kWarpSensorOutputRegisterCCS811ALG_DATA				= 0x02,
 	kWarpSensorOutputRegisterCCS811RAW_DATA				= 0x03,
 	kWarpSensorOutputRegisterCCS811RAW_REF_NTC			= 0x06,
@@ -255,12 +290,16 @@ typedef enum
 	kWarpSensorOutputRegisterBMX055accelACCD_Z_LSB		= 0x06,
 	kWarpSensorOutputRegisterBMX055accelACCD_Z_MSB		= 0x07,
 	kWarpSensorOutputRegisterBMX055accelACCD_TEMP		= 0x08,
+	kWarpSensorOutputRegisterBMX055accelFIFO_STATUS		= 0x0E,
+	kWarpSensorOutputRegisterBMX055accelFIFO_DATA		= 0x3F,
 	kWarpSensorOutputRegisterBMX055gyroRATE_X_LSB		= 0x02,
 	kWarpSensorOutputRegisterBMX055gyroRATE_X_MSB		= 0x03,
 	kWarpSensorOutputRegisterBMX055gyroRATE_Y_LSB		= 0x04,
 	kWarpSensorOutputRegisterBMX055gyroRATE_Y_MSB		= 0x05,
 	kWarpSensorOutputRegisterBMX055gyroRATE_Z_LSB		= 0x06,
 	kWarpSensorOutputRegisterBMX055gyroRATE_Z_MSB		= 0x07,
+	kWarpSensorOutputRegisterBMX055gyroFIFO_STATUS		= 0x0E,
+	kWarpSensorOutputRegisterBMX055gyroFIFO_DATA		= 0x3F,
 	kWarpSensorOutputRegisterBMX055magX_LSB				= 0x42,
 	kWarpSensorOutputRegisterBMX055magX_MSB				= 0x43,
 	kWarpSensorOutputRegisterBMX055magY_LSB				= 0x44,
@@ -277,7 +316,9 @@ typedef enum
 	kWarpSensorOutputRegisterL3GD20HOUT_Y_H				= 0x2B,
 	kWarpSensorOutputRegisterL3GD20HOUT_Z_L				= 0x2C,
 	kWarpSensorOutputRegisterL3GD20HOUT_Z_H				= 0x2D,
+	kWarpSensorOutputRegisterL3GD20HFIFO_SRC			= 0x2F,
 
+	kWarpSensorOutputRegisterBME680meas_status_0		= 0x1D,
 	kWarpSensorOutputRegisterBME680press_msb			= 0x1F,
 	kWarpSensorOutputRegisterBME680press_lsb			= 0x20,
 	kWarpSensorOutputRegisterBME680press_xlsb			= 0x21,
@@ -286,6 +327,11 @@ typedef enum
 	kWarpSensorOutputRegisterBME680temp_xlsb			= 0x24,
 	kWarpSensorOutputRegisterBME680hum_msb				= 0x25,
 	kWarpSensorOutputRegisterBME680hum_lsb				= 0x26,
+	kWarpSensorOutputRegisterBME680gas_r_msb			= 0x2A,
+	kWarpSensorOutputRegisterBME680gas_r_lsb			= 0x2B,
+	kWarpSensorOutputRegisterBME680res_heat_val			= 0x00,
+	kWarpSensorOutputRegisterBME680res_heat_range		= 0x02,
+	kWarpSensorOutputRegisterBME680range_sw_err			= 0x04,
 
 	kWarpSensorOutputRegisterADXL362XDATA_L				= 0x0E,
 	kWarpSensorOutputRegisterADXL362XDATA_H				= 0x0F,
@@ -298,6 +344,9 @@ typedef enum
 	kWarpSensorOutputRegisterADXL362STATUS				= 0x0B,
 	kWarpSensorOutputRegisterADXL362FIFO_ENTRIES_L		= 0x0C,
 	kWarpSensorOutputRegisterADXL362FIFO_ENTRIES_H		= 0x0D,
+	kWarpSensorOutputRegisterADXL362THRESH_ACT_L		= 0x20,
+	kWarpSensorOutputRegisterADXL362THRESH_ACT_H		= 0x21,
+	kWarpSensorOutputRegisterADXL362TIME_ACT			= 0x22,
 	kWarpSensorOutputRegisterADXL362ACT_INACT_CTL		= 0x27,
 	kWarpSensorOutputRegisterADXL362FIFO_CONTROL		= 0x28,
 	kWarpSensorOutputRegisterADXL362FIFO_SAMPLES		= 0x29,
@@ -321,8 +370,12 @@ typedef enum
 	kWarpSensorConfigConstADXL362registerReadRegister		= 0x0B,
 	kWarpSensorConfigConstADXL362registerFIFORead			= 0x0D,
 	kWarpSensorConfigConstADXL362resetCode					= 0x52,
+	kWarpSensorConfigConstBNO055registerConfigMode			= 0x00,
 	kWarpSensorConfigConstBNO055registerAMGMode				= 0x01,
+	kWarpSensorConfigConstBNO055registerIMUMode				= 0x08,
 	kWarpSensorConfigConstBNO055registerNDOFMode			= 0x0C,
+	kWarpSensorConfigConstBNO055registerNormalPowerMode		= 0x00,
+	kWarpSensorConfigConstBNO055registerSuspendPowerMode	= 0x02,
 } WarpSensorConfigConst;
 
 typedef enum
@@ -330,6 +383,12 @@ typedef enum
 	kWarpMiscMarkerForAbsentByte					= 0xFF,
 } WarpMisc;
 
+typedef enum
+{
+	kWarpPersistentStateFlagDevicesConfigured		= (1 << 0),
+	kWarpPersistentStateFlagSectorPair				= (1 << 1),
+} WarpPersistentStateFlag;
+
 typedef struct
 {
 	bool			isInitialized;
@@ -368,14 +427,183 @@ typedef struct
 	uint8_t			errorCount;
 } WarpPowerManagerCallbackStructure;
 
+typedef struct
+{
+	uint16_t		meanMilliseconds;
+	uint16_t		transitionCount;
+} WarpPowerModeTransitionCost;
+
+/*
+ *	Sampler state that has to survive a VLLS0 wakeup (which resets RAM).
+ *	Kept at 32 bytes so that eight slots fit in one flash page; the CRC
+ *	covers every field before it. eraseAheadSector is the first flash sector
+ *	after the log head not known to be erased. logTailPageNumber and
+ *	logTailPageOffset locate the oldest record once the ring log has wrapped;
+ *	a logTailPageNumber of 0 means it has not, and the log starts at the
+ *	first log page. codecState is reserved for the record encoder's running
+ *	state and is zero until an encoder uses it.
+ *
+ *	remapPageNumbers lists log pages that failed write verification; entry i
+ *	sends reads and writes of that page to spare page i (see
+ *	warpFlashRemapPage()), and 0 marks an unused entry. While bit i of
+ *	remapPendingMask is set, the failed page still holds log data written on
+ *	this lap, so the remap only takes effect once the page is next erased.
+ *
+ *	flags holds WarpPersistentStateFlag bits. DevicesConfigured is set after
+ *	a sampling round configured every sensor without error, so that a warm
+ *	boot from VLLS0 can skip the register setup that survived the sleep.
+ *	SectorPair marks slots saved by the IS25xP driver's two-sector state log.
+ */
+typedef struct
+{
+	uint32_t		sequenceNumber;
+	uint16_t		logPageNumber;
+	uint8_t			logPageOffset;
+	uint8_t			errorCount;
+	uint16_t		eraseAheadSector;
+	uint16_t		logTailPageNumber;
+	uint8_t			logTailPageOffset;
+	uint8_t			codecState[1];
+	uint16_t		remapPageNumbers[kWarpFlashRemapTableEntries];
+	uint8_t			remapPendingMask;
+	uint8_t			flags;
+	uint16_t		crc;
+} WarpPersistentState;
+
+/*
+ *	Time-index entry for the flash log: where the first record to start in a
+ *	group of kWarpFlashIndexPagesPerEntry log pages begins, and the RTC time
+ *	and sequence number it was written at. entryNumber counts up from one
+ *	entry to the next, so the newest entry can be found after a reset.
+ *	bootEpoch counts cold boots (modulo 256), since each one restarts the RTC.
+ */
+typedef struct
+{
+	uint32_t		timestamp;
+	uint32_t		sequenceNumber;
+	uint16_t		entryNumber;
+	uint16_t		pageNumber;
+	uint8_t			pageOffset;
+	uint8_t			bootEpoch;
+	uint16_t		crc;
+} WarpFlashIndexEntry;
+
+/*
+ *	Running aggregate of one reading (channel) of a logged sensor.
+ */
+typedef struct
+{
+	int32_t			min;
+	int32_t			max;
+	int64_t			sum;
+	uint32_t		count;
+} WarpFlashChannelAggregate;
+
+/*
+ *	An aggregate query over the flash log: readings firstReading onwards of
+ *	the sensor with the given bit in the record bit field.
+ */
+typedef struct
+{
+	uint16_t					sensorBitField;
+	uint8_t						firstReading;
+	WarpFlashChannelAggregate	channels[kWarpFlashAggregateMaxChannels];
+} WarpFlashAggregateQuery;
+
+/*
+ *	Tests that can start a capture in writeAllSensorsToFlash(), on reading
+ *	readingIndex of the sensor with the given bit in the record bit field.
+ */
+typedef enum
+{
+	kWarpTriggerAbove,				/*	reading > threshold						*/
+	kWarpTriggerStep,				/*	|reading - reading in last record| > threshold			*/
+	kWarpTriggerMagnitude,			/*	sum of squares of 16-bit readingIndex..readingIndex+2 > threshold	*/
+	kWarpTriggerADXL362Activity,	/*	ADXL362 activity since the last record; no reading		*/
+} WarpTriggerPredicate;
+
+typedef struct
+{
+	WarpTriggerPredicate	predicate;
+	uint16_t				sensorBitField;
+	uint8_t					readingIndex;
+	uint32_t				threshold;
+
+	/*
+	 *	Filled in when the capture starts
+	 */
+	bool					enabled;
+	uint16_t				recordOffset;
+	uint8_t					sizePerReading;
+	bool					havePrevious;
+	int32_t					previous;
+} WarpTriggerCondition;
+
+/*
+ *	Where the record decoder is in the byte stream of the log: in the record
+ *	bit field and format byte while measurementIndex < 3, then in reading
+ *	readingIndex of the sensorIndex-th sensor present, bytesIndex bytes into
+ *	it.
+ */
+typedef struct
+{
+	uint16_t		sensorBitField;
+	uint8_t			recordFormat;
+	uint8_t			numberOfSensors;
+	uint8_t			measurementIndex;
+	uint8_t			sensorIndex;
+	uint8_t			readingIndex;
+	uint8_t			bytesIndex;
+	uint8_t			sizePerReading;
+	uint8_t			numberOfReadings;
+	int32_t			reading;
+} WarpFlashRecordDecoder;
+
+/*
+ *	A read of the log from one position to another. Holds everything needed
+ *	to carry on from where a read was stopped.
+ */
+typedef struct
+{
+	uint16_t				pageNumber;
+	uint8_t					pageOffset;
+	uint16_t				endPageNumber;
+	uint8_t					endPageOffset;
+	WarpFlashRecordDecoder	decoder;
+} WarpFlashLogReader;
+
 void		warpScaleSupplyVoltage(uint16_t voltageMillivolts);
 void		warpDisableSupplyVoltage(void);
 WarpStatus	warpSetLowPowerMode(WarpPowerMode powerMode, uint32_t sleepSeconds);
+WarpStatus	warpSetLowPowerModeMilliseconds(WarpPowerMode powerMode, uint32_t sleepMilliseconds);
+void		warpRecordPowerModeTransitionCost(WarpPowerModeOrigin origin, WarpPowerMode powerMode, uint16_t overheadMilliseconds);
+WarpPowerMode	warpChooseLowPowerMode(uint32_t intervalMilliseconds, bool allowResetWakeup);
+void		warpSleepMilliseconds(uint32_t sleepMilliseconds);
+uint16_t	warpTimeGetMilliseconds(void);
+void		warpPrintPowerModeTransitionCosts(void);
+int8_t		warpSpectrumReal(int16_t *  x, uint8_t log2Points);
+void		warpSpectrumBands(const int16_t *  x, uint8_t log2Points, int8_t shift, int16_t *  levels, uint8_t numberOfBands);
+void		warpSpectrumPeaks(const int16_t *  x, uint8_t log2Points, int8_t shift, uint8_t *  bins, int16_t *  levels, uint8_t numberOfPeaks);
+uint16_t	warpCrc16(const uint8_t *  data, size_t nbyte);
+uint16_t	warpCrc16Update(uint16_t crc, const uint8_t *  data, size_t nbyte);
 void		warpEnableI2Cpins(void);
 void		warpDisableI2Cpins(void);
 void		warpEnableSPIpins(void);
 void		warpDisableSPIpins(void);
 void		warpDeasserAllSPIchipSelects(void);
+void		warpAcquireI2cBus(uint32_t baudRateKbps);
+void		warpReleaseI2cBus(void);
+void		warpAcquireSpiBus(uint32_t baudRateKbps);
+void		warpReleaseSpiBus(void);
+void		warpSuspendBusSessions(void);
+void		warpPrintBusTransactionCounts(void);
+void		warpFlashStreamByte(uint8_t byte);
+WarpStatus	warpFlashAdvanceLogTail(uint16_t firstPageNumber, uint16_t pageCount);
+WarpStatus	warpFlashRecoverLogHead(uint16_t maxRecords);
+WarpStatus	warpFlashIndexRecordStart(uint16_t pageNumber, uint8_t pageOffset);
+uint16_t	warpFlashRemapPage(uint16_t pageNumber);
+uint16_t	warpFlashAddRemap(uint16_t pageNumber, bool pending);
+WarpStatus	warpWaitForFlashReady(WarpSPIDeviceState volatile *  deviceStatePointer, uint8_t statusOpcode, uint8_t readyMask, uint8_t readyValue, uint32_t typicalMilliseconds, uint32_t maximumMilliseconds);
 void		warpPrint(const char *fmt, ...);
 int			warpWaitKey(void);
 
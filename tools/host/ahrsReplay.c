@@ -0,0 +1,547 @@
+/*
+ *	Host check of the fixed-point Mahony AHRS in devBMX055.c
+ *	(WARP_BUILD_ENABLE_BMX055_AHRS) against the same filter in double
+ *	precision.
+ *
+ *	A simulated BMX055 turns through a smooth random-looking motion with
+ *	the Earth's gravity and field, and its readings, rounded and with
+ *	noise, go to both filters. The logged Q14 quaternion is compared with
+ *	the reference over the second half of each run, once the filters have
+ *	settled.
+ *
+ *	Two paths are replayed. updateAhrsBMX055() is called directly at 25 to
+ *	400 Hz, with and without the magnetometer, and timed on the host. Then
+ *	appendSensorDataBMX055() reads the simulated device on the I2C bus
+ *	(hostWarp.c) with the gyroscope FIFO configured: each record must step
+ *	the filter once for every frame the FIFO collected, at the sample
+ *	period of the configured BW.
+ *
+ *	Usage: ahrsReplay [seconds [seed]]
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "fsl_i2c_master_driver.h"
+
+#include "config.h"
+#include "warp.h"
+#include "devBMX055.h"
+#include "hostWarp.h"
+
+
+
+typedef enum
+{
+	kHostAccelAddress			= 0x18,
+	kHostGyroAddress			= 0x68,
+	kHostMagAddress				= 0x10,
+	kHostRtcBase				= 0x4003D000,
+	kHostRtcTicksPerSecond		= 32768,
+
+	/*
+	 *	RANGE 4 is 125 dps full scale; the accelerometer's 2 g range is
+	 *	1024 counts per g.
+	 */
+	kHostGyroRange				= 4,
+	kHostAccelCountsPerG		= 1024,
+	kHostMagCounts				= 300,
+} HostConstant;
+
+volatile WarpI2CDeviceState	deviceBMX055accelState;
+volatile WarpI2CDeviceState	deviceBMX055gyroState;
+volatile WarpI2CDeviceState	deviceBMX055magState;
+
+static volatile uint32_t *	rtc;
+static double				truth[4];
+static double				referenceQuaternion[4];
+static double				referenceIntegral[3];
+
+/*
+ *	The gyroscope FIFO: frames waiting, oldest first, and the number the
+ *	driver has read.
+ */
+static int16_t				fifo[kWarpSizesBMX055gyroFifoFrames][3];
+static uint8_t				fifoFrames;
+static uint32_t				fifoFramesRead;
+
+
+static bool
+mapRtc(void)
+{
+	void *	page = mmap((void *)(uintptr_t)kHostRtcBase, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	if (page != (void *)(uintptr_t)kHostRtcBase)
+	{
+		return false;
+	}
+	rtc = (volatile uint32_t *)page;
+
+	return true;
+}
+
+/*
+ *	RTC->TSR and RTC->TPR for a time in prescaler ticks.
+ */
+static void
+setRtc(uint64_t ticks)
+{
+	rtc[0] = (uint32_t)(ticks / kHostRtcTicksPerSecond);
+	rtc[1] = (uint32_t)(ticks % kHostRtcTicksPerSecond);
+}
+
+static double
+gaussian(void)
+{
+	double	u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double	v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static double
+gyroRadiansPerCount(void)
+{
+	return (2000 >> kHostGyroRange) / 32768.0 * M_PI / 180.0;
+}
+
+/*
+ *	The motion: angular rate in rad/s at time t.
+ */
+static void
+angularRate(double t, double *  w)
+{
+	w[0] = 0.8 * sin(0.7 * t);
+	w[1] = 0.6 * sin(1.1 * t + 1.0);
+	w[2] = 1.0 * sin(0.3 * t + 2.0);
+}
+
+/*
+ *	Rotate q by w over dt, as q' = q + q * (0, w dt / 2), normalised.
+ */
+static void
+rotate(double *  q, const double *  w, double dt)
+{
+	double	h[3] = {w[0] * dt / 2.0, w[1] * dt / 2.0, w[2] * dt / 2.0};
+	double	a = q[0], b = q[1], c = q[2], d = q[3];
+	double	n;
+
+	q[0] = a - b * h[0] - c * h[1] - d * h[2];
+	q[1] = b + a * h[0] + c * h[2] - d * h[1];
+	q[2] = c + a * h[1] - b * h[2] + d * h[0];
+	q[3] = d + a * h[2] + b * h[1] - c * h[0];
+
+	n = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		q[i] /= n;
+	}
+}
+
+/*
+ *	An Earth-frame vector in the sensor frame of orientation q.
+ */
+static void
+toSensorFrame(const double *  q, const double *  v, double *  out)
+{
+	double	w = q[0], x = q[1], y = q[2], z = q[3];
+	double	r[3][3] =
+	{
+		{1 - 2 * (y * y + z * z),	2 * (x * y - w * z),		2 * (x * z + w * y)},
+		{2 * (x * y + w * z),		1 - 2 * (x * x + z * z),	2 * (y * z - w * x)},
+		{2 * (x * z - w * y),		2 * (y * z + w * x),		1 - 2 * (x * x + y * y)},
+	};
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		out[i] = r[0][i] * v[0] + r[1][i] * v[1] + r[2][i] * v[2];
+	}
+}
+
+/*
+ *	Accelerometer and magnetometer counts for the orientation in truth.
+ */
+static void
+readAccelMag(int16_t *  accel, int16_t *  mag)
+{
+	const double	gravity[3] = {0.0, 0.0, 1.0};
+	const double	field[3] = {0.45, 0.0, -0.89};
+	double			a[3], m[3];
+
+	toSensorFrame(truth, gravity, a);
+	toSensorFrame(truth, field, m);
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		accel[i]	= (int16_t)lrint(a[i] * kHostAccelCountsPerG + gaussian() * 3.0);
+		mag[i]		= (int16_t)lrint(m[i] * kHostMagCounts + gaussian() * 2.0);
+	}
+}
+
+static void
+readGyro(double t, int16_t *  gyro)
+{
+	double	w[3];
+
+	angularRate(t, w);
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		gyro[i] = (int16_t)lrint(w[i] / gyroRadiansPerCount() + gaussian() * 2.0);
+	}
+}
+
+static void
+resetFilters(void)
+{
+	const double	start[4] = {cos(0.3), 0.6 * sin(0.3), 0.0, 0.8 * sin(0.3)};
+
+	memcpy(truth, start, sizeof(truth));
+	memset(referenceQuaternion, 0, sizeof(referenceQuaternion));
+	memset(referenceIntegral, 0, sizeof(referenceIntegral));
+	referenceQuaternion[0] = 1.0;
+
+	setRtc(0);
+	initAhrsBMX055();
+}
+
+/*
+ *	Mahony's MahonyAHRSupdate() in double, with the gains of config.h.
+ */
+static void
+referenceUpdate(const int16_t *  accel, const int16_t *  gyro, const int16_t *  mag, double dt)
+{
+	double *	q = referenceQuaternion;
+	double		twoKp = kWarpBMX055AhrsTwoKpQ8 / 256.0;
+	double		twoKi = kWarpBMX055AhrsTwoKiQ8 / 256.0;
+	double		a[3] = {accel[0], accel[1], accel[2]};
+	double		g[3];
+	double		e[3];
+	double		n, t[4];
+
+	n = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		a[i] /= n;
+	}
+
+	double	halfvx = q[1] * q[3] - q[0] * q[2];
+	double	halfvy = q[0] * q[1] + q[2] * q[3];
+	double	halfvz = q[0] * q[0] - 0.5 + q[3] * q[3];
+
+	e[0] = a[1] * halfvz - a[2] * halfvy;
+	e[1] = a[2] * halfvx - a[0] * halfvz;
+	e[2] = a[0] * halfvy - a[1] * halfvx;
+
+	if (mag != NULL)
+	{
+		double	m[3] = {mag[0], mag[1], mag[2]};
+
+		n = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+		for (uint8_t i = 0; i < 3; i++)
+		{
+			m[i] /= n;
+		}
+
+		double	hx = 2.0 * (m[0] * (0.5 - q[2] * q[2] - q[3] * q[3]) + m[1] * (q[1] * q[2] - q[0] * q[3]) + m[2] * (q[1] * q[3] + q[0] * q[2]));
+		double	hy = 2.0 * (m[0] * (q[1] * q[2] + q[0] * q[3]) + m[1] * (0.5 - q[1] * q[1] - q[3] * q[3]) + m[2] * (q[2] * q[3] - q[0] * q[1]));
+		double	bx = sqrt(hx * hx + hy * hy);
+		double	bz = 2.0 * (m[0] * (q[1] * q[3] - q[0] * q[2]) + m[1] * (q[2] * q[3] + q[0] * q[1]) + m[2] * (0.5 - q[1] * q[1] - q[2] * q[2]));
+		double	halfwx = bx * (0.5 - q[2] * q[2] - q[3] * q[3]) + bz * (q[1] * q[3] - q[0] * q[2]);
+		double	halfwy = bx * (q[1] * q[2] - q[0] * q[3]) + bz * (q[0] * q[1] + q[2] * q[3]);
+		double	halfwz = bx * (q[0] * q[2] + q[1] * q[3]) + bz * (0.5 - q[1] * q[1] - q[2] * q[2]);
+
+		e[0] += m[1] * halfwz - m[2] * halfwy;
+		e[1] += m[2] * halfwx - m[0] * halfwz;
+		e[2] += m[0] * halfwy - m[1] * halfwx;
+	}
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		referenceIntegral[i] += twoKi * e[i] * dt;
+		g[i] = (gyro[i] * gyroRadiansPerCount() + twoKp * e[i] + referenceIntegral[i]) * 0.5 * dt;
+	}
+
+	t[0] = q[0] - q[1] * g[0] - q[2] * g[1] - q[3] * g[2];
+	t[1] = q[1] + q[0] * g[0] + q[2] * g[2] - q[3] * g[1];
+	t[2] = q[2] + q[0] * g[1] - q[1] * g[2] + q[3] * g[0];
+	t[3] = q[3] + q[0] * g[2] + q[1] * g[1] - q[2] * g[0];
+
+	n = sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2] + t[3] * t[3]);
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		q[i] = t[i] / n;
+	}
+}
+
+/*
+ *	Angle in degrees between the logged quaternion and the reference.
+ */
+static double
+loggedError(void)
+{
+	int16_t	logged[4];
+	double	n = 0.0, dot = 0.0;
+
+	getQuaternionAhrsBMX055(logged);
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		n	+= (double)logged[i] * logged[i];
+		dot	+= logged[i] * referenceQuaternion[i];
+	}
+	dot = fmin(fabs(dot) / sqrt(n), 1.0);
+
+	return 2.0 * acos(dot) * 180.0 / M_PI;
+}
+
+/*
+ *	updateAhrsBMX055() at rateHz for the given time, with the RTC step the
+ *	firmware would see. readings[i] are accelerometer, gyroscope and
+ *	magnetometer X, Y, Z. Returns the nanoseconds per update of a second,
+ *	timed pass over the same readings.
+ */
+static double
+replayDirect(uint32_t rateHz, double seconds, bool useMag, double *  meanError, double *  worstError)
+{
+	uint32_t			updates = (uint32_t)(seconds * rateHz);
+	int16_t				(*readings)[3][3] = malloc(updates * sizeof(*readings));
+	uint32_t *			steps = malloc(updates * sizeof(*steps));
+	uint64_t			ticks, lastTicks = 0;
+	double				w[3];
+	double				sum = 0.0;
+	uint32_t			compared = 0;
+	struct timespec		start, end;
+
+	*worstError = 0.0;
+	resetFilters();
+
+	for (uint32_t i = 0; i < updates; i++)
+	{
+		double	t = (double)i / rateHz;
+
+		angularRate(t, w);
+		rotate(truth, w, 1.0 / rateHz);
+		readAccelMag(readings[i][0], readings[i][2]);
+		readGyro(t, readings[i][1]);
+
+		ticks		= ((uint64_t)(i + 1) * kHostRtcTicksPerSecond) / rateHz;
+		steps[i]	= (uint32_t)(ticks - lastTicks);
+		lastTicks	= ticks;
+
+		updateAhrsBMX055(readings[i][0], readings[i][1], useMag ? readings[i][2] : NULL, steps[i]);
+		referenceUpdate(readings[i][0], readings[i][1], useMag ? readings[i][2] : NULL, (double)steps[i] / kHostRtcTicksPerSecond);
+
+		if (i >= updates / 2)
+		{
+			double	error = loggedError();
+
+			sum += error;
+			compared++;
+			*worstError = fmax(*worstError, error);
+		}
+	}
+	*meanError = sum / compared;
+
+	initAhrsBMX055();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t i = 0; i < updates; i++)
+	{
+		updateAhrsBMX055(readings[i][0], readings[i][1], useMag ? readings[i][2] : NULL, steps[i]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	free(readings);
+	free(steps);
+
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / updates;
+}
+
+/*
+ *	The simulated gyroscope's FIFO_STATUS and FIFO_DATA; every other read
+ *	goes to the register file.
+ */
+static bool
+readFifoHook(uint8_t address, uint8_t deviceRegister, uint8_t *  data, uint32_t nbyte)
+{
+	if (address != kHostGyroAddress)
+	{
+		return false;
+	}
+
+	if (deviceRegister == kWarpSensorOutputRegisterBMX055gyroFIFO_STATUS)
+	{
+		data[0] = fifoFrames;
+
+		return true;
+	}
+
+	if (deviceRegister == kWarpSensorOutputRegisterBMX055gyroFIFO_DATA)
+	{
+		uint32_t	frames = nbyte / kWarpSizesBMX055FifoFrameBytes;
+
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			for (uint8_t j = 0; j < 3; j++)
+			{
+				data[6 * i + 2 * j]		= (uint8_t)fifo[i][j];
+				data[6 * i + 2 * j + 1]	= (uint8_t)(fifo[i][j] >> 8);
+			}
+		}
+		memmove(fifo, fifo[frames], (fifoFrames - frames) * sizeof(fifo[0]));
+		fifoFrames		-= frames;
+		fifoFramesRead	+= frames;
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ *	Data registers holding a reading in their top significantBits bits.
+ */
+static void
+setDataRegisters(uint8_t address, uint8_t firstRegister, const int16_t *  readings, const uint8_t *  significantBits)
+{
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		uint16_t	value = (uint16_t)(readings[i] << (16 - significantBits[i]));
+
+		gHostI2cRegisters[address][firstRegister + 2 * i]		= (uint8_t)value;
+		gHostI2cRegisters[address][firstRegister + 2 * i + 1]	= (uint8_t)(value >> 8);
+	}
+}
+
+/*
+ *	appendSensorDataBMX055() every recordMilliseconds with the gyroscope
+ *	at the output data rate of bandwidth (a BW register value). The
+ *	reference steps once per frame by the exact sample period, with the
+ *	record's accelerometer and magnetometer readings, as the driver does.
+ *	Returns false if the driver did not read every frame.
+ */
+static bool
+replayFifo(uint8_t bandwidth, uint32_t rateHz, uint32_t recordMilliseconds, double seconds, double *  meanError, double *  worstError)
+{
+	const uint8_t	accelBits[3] = {12, 12, 12};
+	const uint8_t	magBits[3] = {13, 13, 15};
+	int16_t			accel[3], gyro[3], mag[3];
+	uint32_t		framesPerRecord = rateHz * recordMilliseconds / 1000;
+	uint32_t		records = (uint32_t)(seconds * 1000 / recordMilliseconds);
+	uint32_t		framesWritten = 0;
+	double			w[3];
+	double			sum = 0.0;
+	uint32_t		compared = 0;
+
+	*worstError = 0.0;
+	resetFilters();
+
+	configureSensorBMX055gyro(kHostGyroRange, bandwidth, 0x00, 0x00);
+	configureFifoBMX055gyro(kWarpBMX055FifoWatermarkFrames);
+	fifoFrames		= 0;
+	fifoFramesRead	= 0;
+	gHostI2cReadHook = readFifoHook;
+
+	for (uint32_t r = 0; r < records; r++)
+	{
+		for (uint32_t i = 0; i < framesPerRecord; i++)
+		{
+			double	t = (double)framesWritten / rateHz;
+
+			angularRate(t, w);
+			rotate(truth, w, 1.0 / rateHz);
+			readGyro(t, fifo[fifoFrames++]);
+			framesWritten++;
+		}
+
+		readAccelMag(accel, mag);
+		setDataRegisters(kHostAccelAddress, kWarpSensorOutputRegisterBMX055accelACCD_X_LSB, accel, accelBits);
+		setDataRegisters(kHostMagAddress, kWarpSensorOutputRegisterBMX055magX_LSB, mag, magBits);
+		setDataRegisters(kHostGyroAddress, kWarpSensorOutputRegisterBMX055gyroRATE_X_LSB, fifo[fifoFrames - 1], (const uint8_t[3]){16, 16, 16});
+		setRtc((uint64_t)(r + 1) * recordMilliseconds * kHostRtcTicksPerSecond / 1000);
+
+		for (uint32_t i = 0; i < fifoFrames; i++)
+		{
+			memcpy(gyro, fifo[i], sizeof(gyro));
+			referenceUpdate(accel, gyro, mag, 1.0 / rateHz);
+		}
+
+		appendSensorDataBMX055();
+
+		if (r >= records / 2)
+		{
+			double	error = loggedError();
+
+			sum += error;
+			compared++;
+			*worstError = fmax(*worstError, error);
+		}
+	}
+	*meanError = sum / compared;
+	gHostI2cReadHook = NULL;
+
+	return (fifoFrames == 0) && (fifoFramesRead == framesWritten);
+}
+
+int
+main(int argc, char **  argv)
+{
+	double		seconds = (argc > 1) ? strtod(argv[1], NULL) : 120.0;
+	const struct
+	{
+		uint8_t		bandwidth;
+		uint32_t	rateHz;
+		uint32_t	recordMilliseconds;
+	} fifoCases[] =
+	{
+		{0x07, 100, 1000},
+		{0x06, 200, 250},
+		{0x03, 400, 100},
+	};
+	double		mean[2], worst[2], nanoseconds;
+	double		overallWorst = 0.0;
+	bool		ok = true;
+
+	srand((argc > 2) ? strtoul(argv[2], NULL, 0) : 1);
+
+	if (!mapRtc())
+	{
+		printf("could not map the RTC at 0x%x\n", kHostRtcBase);
+		return 1;
+	}
+
+	initBMX055accel(kHostAccelAddress, 1800);
+	initBMX055gyro(kHostGyroAddress, 1800);
+	initBMX055mag(kHostMagAddress, 1800);
+	configureSensorBMX055gyro(kHostGyroRange, 0x07, 0x00, 0x00);
+
+	printf("updateAhrsBMX055(), logged Q14 quaternion vs double reference, mean / worst over the last %.0f s:\n", seconds / 2);
+	for (uint32_t rateHz = 25; rateHz <= 400; rateHz *= 2)
+	{
+		nanoseconds = replayDirect(rateHz, seconds, true, &mean[0], &worst[0]);
+		replayDirect(rateHz, seconds, false, &mean[1], &worst[1]);
+		overallWorst = fmax(overallWorst, fmax(worst[0], worst[1]));
+		printf("\t%3u Hz: %.3f / %.3f deg with the magnetometer, %.3f / %.3f deg without; host %.0f ns/update\n",
+			   rateHz, mean[0], worst[0], mean[1], worst[1], nanoseconds);
+	}
+
+	printf("appendSensorDataBMX055() with the gyroscope FIFO:\n");
+	for (uint8_t i = 0; i < sizeof(fifoCases) / sizeof(fifoCases[0]); i++)
+	{
+		if (!replayFifo(fifoCases[i].bandwidth, fifoCases[i].rateHz, fifoCases[i].recordMilliseconds, seconds, &mean[0], &worst[0]))
+		{
+			printf("\t%3u Hz, a record every %u ms: FAILED, frames left in the FIFO\n", fifoCases[i].rateHz, fifoCases[i].recordMilliseconds);
+			ok = false;
+			continue;
+		}
+		overallWorst = fmax(overallWorst, worst[0]);
+		printf("\t%3u Hz, a record every %u ms: every frame stepped; %.3f / %.3f deg\n",
+			   fifoCases[i].rateHz, fifoCases[i].recordMilliseconds, mean[0], worst[0]);
+	}
+
+	printf("worst %.3f deg\n", overallWorst);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+/*
+ *	Host check of the BME680 fixed-point compensation in devBME680.c
+ *	against the floating-point formulas of the BME680 datasheet (Section 3).
+ *
+ *	The driver is built as it is for the KL03. configureSensorBME680() reads
+ *	the calibration from a BME680 simulated on the I2C bus, so the parsing
+ *	is checked too. The calibration is a typical part's and copies of it
+ *	with every parameter scaled by up to 20 %. Temperature, pressure and
+ *	humidity are compared over a grid of raw values, keeping to readings
+ *	in the part's operating range (-40 to 85 C, 30 to 110 kPa); gas
+ *	resistance over every ADC value, range and range switching error.
+ *
+ *	Usage: bme680Reference [calibrations [seed]]
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fsl_i2c_master_driver.h"
+
+#include "config.h"
+#include "warp.h"
+#include "hostWarp.h"
+
+
+
+typedef enum
+{
+	kHostBME680Address	= 0x77,
+} HostConstant;
+
+volatile WarpI2CDeviceState	deviceBME680State;
+volatile uint8_t			deviceBME680CalibrationValues[kWarpSizesBME680CalibrationValuesCount];
+
+/*
+ *	From devBME680.h, which defines data and so cannot be included
+ *	alongside devBME680.c.
+ */
+void						initBME680(const uint8_t i2cAddress, uint16_t operatingVoltageMillivolts);
+WarpStatus					configureSensorBME680(uint8_t payloadCtrl_Hum, uint8_t payloadCtrl_Meas, uint8_t payloadGas_0);
+int16_t						compensateTemperatureBME680(uint32_t temperatureAdc);
+uint32_t					compensatePressureBME680(uint32_t pressureAdc);
+uint32_t					compensateHumidityBME680(uint16_t humidityAdc);
+uint32_t					compensateGasResistanceBME680(uint16_t gasAdc, uint8_t gasRange);
+
+/*
+ *	Calibration parameters as the datasheet names them.
+ */
+typedef struct
+{
+	double	t1, t2, t3;
+	double	p1, p2, p3, p4, p5, p6, p7, p8, p9, p10;
+	double	h1, h2, h3, h4, h5, h6, h7;
+	double	rangeSwitchingError;
+} Calibration;
+
+typedef struct
+{
+	double	temperature;
+	double	pressure;
+	double	humidity;
+	double	gasRelative;
+	double	gasOhms;
+	double	gasOhmsResistance;
+} WorstError;
+
+
+static double
+scaleParameter(double value, double minimum, double maximum, bool perturb)
+{
+	if (perturb)
+	{
+		value = round(value * (0.8 + 0.4 * rand() / (double)RAND_MAX));
+	}
+
+	return fmin(fmax(value, minimum), maximum);
+}
+
+/*
+ *	Lay the calibration out in the simulated part's registers, as the
+ *	datasheet's memory map has it.
+ */
+static void
+setCalibration(const Calibration *  k)
+{
+	uint8_t *	r = gHostI2cRegisters[kHostBME680Address];
+	uint8_t		c[kWarpSizesBME680CalibrationValuesCount] = {0};
+	uint16_t	h1 = (uint16_t)k->h1, h2 = (uint16_t)k->h2;
+
+	c[33] = (uint16_t)k->t1;		c[34] = (uint16_t)k->t1 >> 8;
+	c[1] = (int16_t)k->t2;			c[2] = (uint16_t)(int16_t)k->t2 >> 8;
+	c[3] = (int8_t)k->t3;
+	c[5] = (uint16_t)k->p1;			c[6] = (uint16_t)k->p1 >> 8;
+	c[7] = (int16_t)k->p2;			c[8] = (uint16_t)(int16_t)k->p2 >> 8;
+	c[9] = (int8_t)k->p3;
+	c[11] = (int16_t)k->p4;			c[12] = (uint16_t)(int16_t)k->p4 >> 8;
+	c[13] = (int16_t)k->p5;			c[14] = (uint16_t)(int16_t)k->p5 >> 8;
+	c[16] = (int8_t)k->p6;
+	c[15] = (int8_t)k->p7;
+	c[19] = (int16_t)k->p8;			c[20] = (uint16_t)(int16_t)k->p8 >> 8;
+	c[21] = (int16_t)k->p9;			c[22] = (uint16_t)(int16_t)k->p9 >> 8;
+	c[23] = (uint8_t)k->p10;
+	c[27] = h1 >> 4;				c[26] = (h1 & 0x0F) | ((h2 & 0x0F) << 4);		c[25] = h2 >> 4;
+	c[28] = (int8_t)k->h3;
+	c[29] = (int8_t)k->h4;
+	c[30] = (int8_t)k->h5;
+	c[31] = (uint8_t)k->h6;
+	c[32] = (int8_t)k->h7;
+
+	for (uint8_t i = 0; i < kWarpSizesBME680CalibrationRegion1Bytes; i++)
+	{
+		r[kWarpSensorConfigurationRegisterBME680CalibrationRegion1Start + i] = c[i];
+	}
+	for (uint8_t i = kWarpSizesBME680CalibrationRegion1Bytes; i < kWarpSizesBME680CalibrationValuesCount; i++)
+	{
+		r[kWarpSensorConfigurationRegisterBME680CalibrationRegion2Start + i - kWarpSizesBME680CalibrationRegion1Bytes] = c[i];
+	}
+	r[0x04] = (uint8_t)((int8_t)k->rangeSwitchingError << 4);
+}
+
+/*
+ *	The datasheet's floating-point compensation. referenceTemperature()
+ *	returns t_fine for the other two.
+ */
+static double
+referenceTemperature(const Calibration *  k, uint32_t adc, double *  temperatureFine)
+{
+	double	var1 = (adc / 16384.0 - k->t1 / 1024.0) * k->t2;
+	double	var2 = (adc / 131072.0 - k->t1 / 8192.0);
+
+	var2 = var2 * var2 * (k->t3 * 16.0);
+	*temperatureFine = var1 + var2;
+
+	return *temperatureFine / 5120.0;
+}
+
+static double
+referencePressure(const Calibration *  k, uint32_t adc, double temperatureFine)
+{
+	double	var1 = temperatureFine / 2.0 - 64000.0;
+	double	var2 = var1 * var1 * (k->p6 / 131072.0);
+	double	var3;
+	double	pressure;
+
+	var2 = var2 + var1 * k->p5 * 2.0;
+	var2 = var2 / 4.0 + k->p4 * 65536.0;
+	var1 = ((k->p3 * var1 * var1) / 16384.0 + k->p2 * var1) / 524288.0;
+	var1 = (1.0 + var1 / 32768.0) * k->p1;
+	pressure = 1048576.0 - adc;
+	pressure = ((pressure - var2 / 4096.0) * 6250.0) / var1;
+	var1 = k->p9 * pressure * pressure / 2147483648.0;
+	var2 = pressure * (k->p8 / 32768.0);
+	var3 = (pressure / 256.0) * (pressure / 256.0) * (pressure / 256.0) * (k->p10 / 131072.0);
+
+	return pressure + (var1 + var2 + var3 + k->p7 * 128.0) / 16.0;
+}
+
+static double
+referenceHumidity(const Calibration *  k, uint32_t adc, double temperature)
+{
+	double	var1 = adc - (k->h1 * 16.0 + (k->h3 / 2.0) * temperature);
+	double	var2 = var1 * ((k->h2 / 262144.0) * (1.0 + (k->h4 / 16384.0) * temperature + (k->h5 / 1048576.0) * temperature * temperature));
+	double	var3 = k->h6 / 16384.0;
+	double	var4 = k->h7 / 2097152.0;
+
+	return fmin(fmax(var2 + (var3 + var4 * temperature) * var2 * var2, 0.0), 100.0);
+}
+
+static double
+referenceGasResistance(const Calibration *  k, uint16_t adc, uint8_t range)
+{
+	static const double	constArray1[16] = {1, 1, 1, 1, 1, 0.99, 1, 0.992, 1, 1, 0.998, 0.995, 1, 0.99, 1, 1};
+	static const double	constArray2[16] = {8000000, 4000000, 2000000, 1000000, 499500.4995, 248262.1648, 125000, 63004.03226,
+										   31281.28128, 15625, 7812.5, 3906.25, 1953.125, 976.5625, 488.28125, 244.140625};
+	double				var1 = (1340.0 + 5.0 * k->rangeSwitchingError) * constArray1[range];
+
+	return var1 * constArray2[range] / (adc - 512.0 + var1);
+}
+
+static void
+compare(const Calibration *  k, WorstError *  worst)
+{
+	for (uint32_t temperatureAdc = 200000; temperatureAdc < 700000; temperatureAdc += 997)
+	{
+		double	temperatureFine;
+		double	temperature = referenceTemperature(k, temperatureAdc, &temperatureFine);
+
+		if ((temperature < -40.0) || (temperature > 85.0))
+		{
+			continue;
+		}
+
+		worst->temperature = fmax(worst->temperature, fabs(compensateTemperatureBME680(temperatureAdc) - temperature * 100.0));
+
+		for (uint32_t pressureAdc = 100000; pressureAdc < 700000; pressureAdc += 1999)
+		{
+			double	pressure = referencePressure(k, pressureAdc, temperatureFine);
+
+			if ((pressure < 30000.0) || (pressure > 110000.0))
+			{
+				continue;
+			}
+
+			compensateTemperatureBME680(temperatureAdc);
+			worst->pressure = fmax(worst->pressure, fabs(compensatePressureBME680(pressureAdc) - pressure));
+		}
+
+		for (uint32_t humidityAdc = 0; humidityAdc < 65536; humidityAdc += 97)
+		{
+			compensateTemperatureBME680(temperatureAdc);
+			worst->humidity = fmax(worst->humidity, fabs(compensateHumidityBME680(humidityAdc) / 1000.0 - referenceHumidity(k, humidityAdc, temperature)));
+		}
+	}
+}
+
+static void
+compareGas(Calibration *  k, WorstError *  worst)
+{
+	for (int8_t rangeSwitchingError = -8; rangeSwitchingError < 8; rangeSwitchingError++)
+	{
+		k->rangeSwitchingError = rangeSwitchingError;
+		setCalibration(k);
+		configureSensorBME680(0, 0, 0);
+
+		for (uint8_t range = 0; range < 16; range++)
+		{
+			for (uint16_t adc = 0; adc < 1024; adc++)
+			{
+				double	resistance	= referenceGasResistance(k, adc, range);
+				double	error		= fabs(compensateGasResistanceBME680(adc, range) - resistance);
+
+				worst->gasRelative = fmax(worst->gasRelative, error / resistance);
+				if (error > worst->gasOhms)
+				{
+					worst->gasOhms				= error;
+					worst->gasOhmsResistance	= resistance;
+				}
+			}
+		}
+	}
+}
+
+int
+main(int argc, char **  argv)
+{
+	static const Calibration	typical =
+	{
+		.t1 = 26140, .t2 = 26406, .t3 = 3,
+		.p1 = 36162, .p2 = -10397, .p3 = 88, .p4 = 6965, .p5 = -96, .p6 = 30, .p7 = 71, .p8 = -3355, .p9 = -2472, .p10 = 30,
+		.h1 = 752, .h2 = 1037, .h3 = 0, .h4 = 45, .h5 = 20, .h6 = 120, .h7 = -100,
+		.rangeSwitchingError = -2,
+	};
+	uint32_t					calibrations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 8;
+	WorstError					worst = {0};
+
+	srand((argc > 2) ? strtoul(argv[2], NULL, 0) : 1);
+
+	initBME680(kHostBME680Address, kWarpDefaultSupplyVoltageMillivoltsBME680);
+
+	for (uint32_t i = 0; i < calibrations; i++)
+	{
+		bool		perturb = (i != 0);
+		Calibration	k;
+
+		k.t1	= scaleParameter(typical.t1, 0, 65535, perturb);
+		k.t2	= scaleParameter(typical.t2, -32768, 32767, perturb);
+		k.t3	= scaleParameter(typical.t3, -128, 127, perturb);
+		k.p1	= scaleParameter(typical.p1, 0, 65535, perturb);
+		k.p2	= scaleParameter(typical.p2, -32768, 32767, perturb);
+		k.p3	= scaleParameter(typical.p3, -128, 127, perturb);
+		k.p4	= scaleParameter(typical.p4, -32768, 32767, perturb);
+		k.p5	= scaleParameter(typical.p5, -32768, 32767, perturb);
+		k.p6	= scaleParameter(typical.p6, -128, 127, perturb);
+		k.p7	= scaleParameter(typical.p7, -128, 127, perturb);
+		k.p8	= scaleParameter(typical.p8, -32768, 32767, perturb);
+		k.p9	= scaleParameter(typical.p9, -32768, 32767, perturb);
+		k.p10	= scaleParameter(typical.p10, 0, 255, perturb);
+		k.h1	= scaleParameter(typical.h1, 0, 4095, perturb);
+		k.h2	= scaleParameter(typical.h2, 0, 4095, perturb);
+		k.h3	= scaleParameter(typical.h3, -128, 127, perturb);
+		k.h4	= scaleParameter(typical.h4, -128, 127, perturb);
+		k.h5	= scaleParameter(typical.h5, -128, 127, perturb);
+		k.h6	= scaleParameter(typical.h6, 0, 255, perturb);
+		k.h7	= scaleParameter(typical.h7, -128, 127, perturb);
+		k.rangeSwitchingError = typical.rangeSwitchingError;
+
+		setCalibration(&k);
+		if (configureSensorBME680(0, 0, 0) != kWarpStatusOK)
+		{
+			printf("configureSensorBME680() failed\n");
+			return 1;
+		}
+
+		compare(&k, &worst);
+		if (i == 0)
+		{
+			compareGas(&k, &worst);
+		}
+	}
+
+	printf("%u calibrations; worst difference from the datasheet's floating-point formulas:\n", calibrations);
+	printf("\ttemperature %.2f of a 0.01 C step\n", worst.temperature);
+	printf("\tpressure %.1f Pa\n", worst.pressure);
+	printf("\thumidity %.3f %%RH\n", worst.humidity);
+	printf("\tgas resistance %.4f %% (%.1f ohm of %.0f ohm)\n", 100.0 * worst.gasRelative, worst.gasOhms, worst.gasOhmsResistance);
+
+	return 0;
+}
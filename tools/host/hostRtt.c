@@ -0,0 +1,89 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hostRtt.h"
+
+
+
+/*
+ *	Stand-ins for the SEGGER RTT and OSA calls that boot.c makes on the paths
+ *	the host harnesses run. warpPrint() output is kept in gHostRttOutput, so
+ *	that a harness can read back what the firmware printed, and also goes to
+ *	stdout if gHostRttEcho is set. There are never any keys waiting.
+ */
+char		gHostRttOutput[kHostRttOutputBytes];
+size_t		gHostRttOutputLength;
+int			gHostRttEcho;
+
+
+static void
+hostRttAppend(const char *  s, size_t length)
+{
+	if (gHostRttEcho)
+	{
+		fwrite(s, 1, length, stdout);
+	}
+
+	if (length > sizeof(gHostRttOutput) - 1 - gHostRttOutputLength)
+	{
+		length = sizeof(gHostRttOutput) - 1 - gHostRttOutputLength;
+	}
+	memcpy(&gHostRttOutput[gHostRttOutputLength], s, length);
+	gHostRttOutputLength += length;
+	gHostRttOutput[gHostRttOutputLength] = '\0';
+}
+
+void
+hostRttClear(void)
+{
+	gHostRttOutputLength	= 0;
+	gHostRttOutput[0]		= '\0';
+}
+
+/*
+ *	Like the firmware's version, which writes to RTT as it formats, the
+ *	whole output is kept, however little of it fits in warpPrintBuffer.
+ */
+int
+SEGGER_RTT_vprintf(unsigned BufferIndex, const char *  sFormat, va_list *  pParamList, char warpPrintBuffer[], int warpPrintBufferLength)
+{
+	char	output[kHostRttOutputBytes];
+	int		length;
+
+	(void)BufferIndex;
+
+	length = vsnprintf(output, sizeof(output), sFormat, *pParamList);
+	if (length < 0)
+	{
+		return length;
+	}
+
+	hostRttAppend(output, strlen(output));
+	snprintf(warpPrintBuffer, warpPrintBufferLength, "%s", output);
+
+	return length;
+}
+
+unsigned
+SEGGER_RTT_WriteString(unsigned BufferIndex, const char *  s)
+{
+	(void)BufferIndex;
+
+	hostRttAppend(s, strlen(s));
+
+	return strlen(s);
+}
+
+int
+SEGGER_RTT_GetKey(void)
+{
+	return -1;
+}
+
+void
+OSA_TimeDelay(uint32_t delay)
+{
+	(void)delay;
+}
@@ -0,0 +1,10 @@
+typedef enum
+{
+	kHostRttOutputBytes	= 4096,
+} HostRttConstant;
+
+extern char		gHostRttOutput[];
+extern size_t	gHostRttOutputLength;
+extern int		gHostRttEcho;
+
+void	hostRttClear(void);
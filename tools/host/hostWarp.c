@@ -0,0 +1,114 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fsl_i2c_master_driver.h"
+
+#include "config.h"
+#include "warp.h"
+#include "hostWarp.h"
+
+
+
+/*
+ *	Stand-ins for what the device drivers use from boot.c and powermodes.c,
+ *	for harnesses that build a driver without boot.c. I2C transfers go to
+ *	a bus of register-file devices: a write sets registers from the command
+ *	byte on, a read returns them.
+ */
+volatile uint32_t	gWarpI2cBaudRateKbps					= kWarpDefaultI2cBaudRateKbps;
+volatile uint32_t	gWarpI2cTimeoutMilliseconds				= kWarpDefaultI2cTimeoutMilliseconds;
+volatile uint32_t	gWarpSupplySettlingDelayMilliseconds	= kWarpDefaultSupplySettlingDelayMilliseconds;
+
+uint8_t				gHostI2cRegisters[128][256];
+bool				(*gHostI2cReadHook)(uint8_t address, uint8_t deviceRegister, uint8_t *  data, uint32_t nbyte);
+
+
+i2c_status_t
+I2C_DRV_MasterSendDataBlocking(uint32_t instance, const i2c_device_t *  device, const uint8_t *  cmdBuff, uint32_t cmdSize, const uint8_t *  txBuff, uint32_t txSize, uint32_t timeout_ms)
+{
+	(void)instance;
+	(void)timeout_ms;
+
+	if (cmdSize != 1)
+	{
+		return kStatus_I2C_Fail;
+	}
+
+	for (uint32_t i = 0; i < txSize; i++)
+	{
+		gHostI2cRegisters[device->address & 0x7F][(uint8_t)(cmdBuff[0] + i)] = txBuff[i];
+	}
+
+	return kStatus_I2C_Success;
+}
+
+i2c_status_t
+I2C_DRV_MasterReceiveDataBlocking(uint32_t instance, const i2c_device_t *  device, const uint8_t *  cmdBuff, uint32_t cmdSize, uint8_t *  rxBuff, uint32_t rxSize, uint32_t timeout_ms)
+{
+	(void)instance;
+	(void)timeout_ms;
+
+	if (cmdSize != 1)
+	{
+		return kStatus_I2C_Fail;
+	}
+
+	if ((gHostI2cReadHook != NULL) && gHostI2cReadHook(device->address & 0x7F, cmdBuff[0], rxBuff, rxSize))
+	{
+		return kStatus_I2C_Success;
+	}
+
+	for (uint32_t i = 0; i < rxSize; i++)
+	{
+		rxBuff[i] = gHostI2cRegisters[device->address & 0x7F][(uint8_t)(cmdBuff[0] + i)];
+	}
+
+	return kStatus_I2C_Success;
+}
+
+void
+warpScaleSupplyVoltage(uint16_t voltageMillivolts)
+{
+	(void)voltageMillivolts;
+}
+
+void
+warpSleepMilliseconds(uint32_t sleepMilliseconds)
+{
+	(void)sleepMilliseconds;
+}
+
+void
+warpEnableI2Cpins(void)
+{
+}
+
+void
+warpAcquireI2cBus(uint32_t baudRateKbps)
+{
+	(void)baudRateKbps;
+}
+
+void
+warpReleaseI2cBus(void)
+{
+}
+
+void
+warpFlashStreamByte(uint8_t byte)
+{
+	(void)byte;
+}
+
+void
+warpPrint(const char *fmt, ...)
+{
+	va_list	arg;
+
+	va_start(arg, fmt);
+	vprintf(fmt, arg);
+	va_end(arg);
+}
@@ -0,0 +1,7 @@
+/*
+ *	Registers of the I2C devices on the simulated bus, by 7-bit address.
+ *	If gHostI2cReadHook is set and returns true for a read, it has filled
+ *	the read in itself (e.g., from a FIFO) instead of the register file.
+ */
+extern uint8_t	gHostI2cRegisters[128][256];
+extern bool		(*gHostI2cReadHook)(uint8_t address, uint8_t deviceRegister, uint8_t *  data, uint32_t nbyte);
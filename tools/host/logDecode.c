@@ -0,0 +1,381 @@
+/*
+ *	Host check of the flash log aggregate queries (the 'A' menu entry,
+ *	flashAggregateBetweenTimes() in boot.c) against a reference decode of
+ *	the same log.
+ *
+ *	boot.c is built for Glaux (BME680 and IS25xP) and linked against a
+ *	simulated IS25xP held in memory. The harness writes records of random
+ *	layouts, calling warpFlashIndexRecordStart() before each one as the
+ *	IS25xP driver does, so the time index is the firmware's own. Some
+ *	records carry a different format byte and must be left out. Each query
+ *	runs through the firmware and through the reference below, a plain
+ *	decode of the same bytes, and the count, minimum, maximum and mean of
+ *	every channel printed by the firmware must equal the reference's.
+ *
+ *	Usage: logDecode [records [queries [seed]]]
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "fsl_spi_master_driver.h"
+
+#include "config.h"
+#include "warp.h"
+#include "hostRtt.h"
+
+
+
+/*
+ *	IS25xP geometry (devIS25xP.h, which defines data and so cannot be
+ *	included alongside boot.c) and the sensor bit field (boot.c).
+ */
+typedef enum
+{
+	kHostPageSizeBytes			= kWarpSizeIS25xPPageSizeBytes,
+	kHostPagesPerSector			= 16,
+	kHostInitialPageNumber		= 0x10,
+	kHostIndexFirstSector		= 4079,
+	kHostIndexEntriesPerSector	= 256,
+	kHostFlashPages				= (kHostIndexFirstSector + 17) * kHostPagesPerSector,
+	kHostRtcBase				= 0x4003D000,
+
+	kHostReadingCountBitField	= 0b1,
+	kHostRTCTSRBitField			= 0b10,
+	kHostRTCTPRBitField			= 0b100,
+	kHostBME680BitField			= 0b100000000,
+	kHostBME680Readings			= 4,
+} HostConstant;
+
+extern WarpPersistentState	gWarpPersistentState;
+uint16_t					warpCrc16(const uint8_t *  data, size_t nbyte);
+uint8_t						flashGetRecordFormat(void);
+WarpStatus					flashAggregateBetweenTimes(uint8_t bootEpoch, uint32_t startSeconds, uint32_t endSeconds, uint8_t sensorBitNumber, uint8_t firstReading);
+
+static uint8_t				flash[(size_t)kHostFlashPages * kHostPageSizeBytes];
+static volatile uint32_t *	rtcTsr;
+
+
+/*
+ *	The parts of the IS25xP driver boot.c calls on the query path.
+ */
+WarpStatus
+readMemoryIS25xP(uint16_t startPageNumber, uint8_t startPageOffset, size_t nbyte, void *  buf)
+{
+	memcpy(buf, &flash[(size_t)startPageNumber * kHostPageSizeBytes + startPageOffset], nbyte);
+
+	return kWarpStatusOK;
+}
+
+WarpStatus
+writeIndexEntryIS25xP(uint16_t entryIndex, size_t nbyte, uint8_t *  entry)
+{
+	uint16_t	sector			= kHostIndexFirstSector + entryIndex / kHostIndexEntriesPerSector;
+	uint16_t	entryInSector	= entryIndex % kHostIndexEntriesPerSector;
+
+	if (entryInSector == 0)
+	{
+		memset(&flash[(size_t)sector * kHostPagesPerSector * kHostPageSizeBytes], 0xFF, kHostPagesPerSector * kHostPageSizeBytes);
+	}
+	memcpy(&flash[(size_t)sector * kHostPagesPerSector * kHostPageSizeBytes + entryInSector * nbyte], entry, nbyte);
+
+	return kWarpStatusOK;
+}
+
+WarpStatus
+loadPersistentStateIS25xP(void)
+{
+	return kWarpStatusOK;
+}
+
+/*
+ *	boot.c reads RTC->TSR for index entries, so give the RTC registers a
+ *	page of memory at their address on the KL03.
+ */
+static bool
+mapRtc(void)
+{
+	void *	page = mmap((void *)(uintptr_t)kHostRtcBase, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	if (page != (void *)(uintptr_t)kHostRtcBase)
+	{
+		return false;
+	}
+	rtcTsr = (volatile uint32_t *)page;
+
+	return true;
+}
+
+static uint32_t
+randomBits(void)
+{
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void
+writeByte(uint8_t byte)
+{
+	flash[(size_t)gWarpPersistentState.logPageNumber * kHostPageSizeBytes + gWarpPersistentState.logPageOffset] = byte;
+	gWarpPersistentState.logPageOffset++;
+	if (gWarpPersistentState.logPageOffset == 0)
+	{
+		gWarpPersistentState.logPageNumber++;
+	}
+}
+
+static void
+writeReading(int32_t reading)
+{
+	writeByte((uint8_t)(reading >> 24));
+	writeByte((uint8_t)(reading >> 16));
+	writeByte((uint8_t)(reading >> 8));
+	writeByte((uint8_t)reading);
+}
+
+/*
+ *	Log records one after another, as writeAllSensorsToFlash() lays them
+ *	out, a few to each RTC second. The readings cover the full int32_t
+ *	range so that sign extension and the 64-bit sums are exercised.
+ */
+static void
+writeLog(uint32_t records)
+{
+	static const uint16_t	sensors[] = {kHostReadingCountBitField, kHostRTCTSRBitField, kHostRTCTPRBitField, kHostBME680BitField};
+	uint32_t				seconds = 1000;
+
+	memset(flash, 0xFF, sizeof(flash));
+	memset(&gWarpPersistentState, 0, sizeof(gWarpPersistentState));
+	gWarpPersistentState.logPageNumber = kHostInitialPageNumber;
+
+	for (uint32_t i = 0; i < records; i++)
+	{
+		uint16_t	sensorBitField = 0;
+
+		while (sensorBitField == 0)
+		{
+			for (uint8_t j = 0; j < sizeof(sensors) / sizeof(sensors[0]); j++)
+			{
+				sensorBitField |= (rand() % 3 != 0) ? sensors[j] : 0;
+			}
+		}
+
+		seconds += rand() % 3;
+		*rtcTsr = seconds;
+		warpFlashIndexRecordStart(gWarpPersistentState.logPageNumber, gWarpPersistentState.logPageOffset);
+
+		writeByte((uint8_t)(sensorBitField >> 8));
+		writeByte((uint8_t)sensorBitField);
+		writeByte((rand() % 20 == 0) ? 0x00 : flashGetRecordFormat());
+		if (sensorBitField & kHostReadingCountBitField)
+		{
+			writeReading(i);
+		}
+		if (sensorBitField & kHostRTCTSRBitField)
+		{
+			writeReading(seconds);
+		}
+		if (sensorBitField & kHostRTCTPRBitField)
+		{
+			writeReading(rand() % 32768);
+		}
+		if (sensorBitField & kHostBME680BitField)
+		{
+			for (uint8_t j = 0; j < kHostBME680Readings; j++)
+			{
+				writeReading((rand() % 2) ? (int32_t)randomBits() : (int32_t)(rand() % 2001) - 1000);
+			}
+		}
+
+		gWarpPersistentState.sequenceNumber++;
+	}
+}
+
+static uint32_t
+logPosition(uint16_t pageNumber, uint8_t pageOffset)
+{
+	return (uint32_t)pageNumber * kHostPageSizeBytes + pageOffset;
+}
+
+/*
+ *	The reference: pick the range from the index entries by a linear scan,
+ *	then decode every record in it.
+ */
+static void
+referenceAggregate(uint32_t startSeconds, uint32_t endSeconds, uint16_t sensorBit, uint8_t firstReading, WarpFlashChannelAggregate *  channels, uint32_t *  records)
+{
+	uint32_t				start	= logPosition(kHostInitialPageNumber, 0);
+	uint32_t				end		= logPosition(gWarpPersistentState.logPageNumber, gWarpPersistentState.logPageOffset);
+	WarpFlashIndexEntry		entry;
+
+	for (uint32_t i = 0; ; i++)
+	{
+		memcpy(&entry, &flash[(size_t)kHostIndexFirstSector * kHostPagesPerSector * kHostPageSizeBytes + i * sizeof(entry)], sizeof(entry));
+		if (entry.crc != warpCrc16((const uint8_t *)&entry, offsetof(WarpFlashIndexEntry, crc)))
+		{
+			break;
+		}
+
+		if (entry.timestamp <= startSeconds)
+		{
+			start = logPosition(entry.pageNumber, entry.pageOffset);
+		}
+		if (entry.timestamp > endSeconds)
+		{
+			end = logPosition(entry.pageNumber, entry.pageOffset);
+			break;
+		}
+	}
+
+	memset(channels, 0, kWarpFlashAggregateMaxChannels * sizeof(channels[0]));
+	*records = 0;
+
+	for (uint32_t position = start; position < end; )
+	{
+		const uint8_t *	record = &flash[position];
+		uint16_t		sensorBitField = (record[0] << 8) | record[1];
+		bool			sameFormat = (record[2] == flashGetRecordFormat());
+		uint32_t		offset = 3;
+
+		for (uint16_t bit = 1; bit != 0; bit <<= 1)
+		{
+			uint8_t		readings = (bit == kHostBME680BitField) ? kHostBME680Readings : 1;
+
+			if (!(sensorBitField & bit))
+			{
+				continue;
+			}
+
+			for (uint8_t j = 0; j < readings; j++, offset += 4)
+			{
+				int32_t						reading = (int32_t)(((uint32_t)record[offset] << 24) | ((uint32_t)record[offset + 1] << 16) | ((uint32_t)record[offset + 2] << 8) | record[offset + 3]);
+				WarpFlashChannelAggregate *	channel;
+
+				if (!sameFormat || (bit != sensorBit) || (j < firstReading) || (j >= firstReading + kWarpFlashAggregateMaxChannels))
+				{
+					continue;
+				}
+				channel = &channels[j - firstReading];
+
+				if ((channel->count == 0) || (reading < channel->min))
+				{
+					channel->min = reading;
+				}
+				if ((channel->count == 0) || (reading > channel->max))
+				{
+					channel->max = reading;
+				}
+				channel->sum += reading;
+				channel->count++;
+			}
+		}
+
+		position += offset;
+		(*records)++;
+	}
+}
+
+/*
+ *	What flashAggregateBetweenTimes() printed for each channel should be
+ *	what it prints for the reference's.
+ */
+static bool
+compareAggregate(uint8_t firstReading, const WarpFlashChannelAggregate *  channels)
+{
+	char		expected[kHostRttOutputBytes];
+	size_t		length = 0;
+	const char *	firmware;
+
+	for (int i = 0; i < kWarpFlashAggregateMaxChannels; i++)
+	{
+		if (channels[i].count == 0)
+		{
+			continue;
+		}
+
+		length += snprintf(&expected[length], sizeof(expected) - length, "\r\n\treading %d: count %u, min %d, max %d, mean %d",
+							firstReading + i,
+							channels[i].count,
+							channels[i].min,
+							channels[i].max,
+							(int32_t)(channels[i].sum / (int64_t)channels[i].count));
+	}
+	snprintf(&expected[length], sizeof(expected) - length, "\n");
+
+	firmware = strstr(gHostRttOutput, "Press 'q' to stop.\n");
+	if ((firmware == NULL) || (strcmp(firmware + strlen("Press 'q' to stop.\n"), expected) != 0))
+	{
+		printf("firmware printed:\n%s\nreference:%s\n", gHostRttOutput, expected);
+		return false;
+	}
+
+	return true;
+}
+
+int
+main(int argc, char **  argv)
+{
+	static const uint8_t	sensorBitNumbers[] = {0, 1, 2, 8};
+	uint32_t				records	= (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+	uint32_t				queries	= (argc > 2) ? strtoul(argv[2], NULL, 0) : 500;
+	uint32_t				lastSeconds;
+	uint32_t				decodedRecords = 0;
+	uint32_t				matchingChannels = 0;
+	WarpFlashChannelAggregate	channels[kWarpFlashAggregateMaxChannels];
+
+	srand((argc > 3) ? strtoul(argv[3], NULL, 0) : 1);
+
+	if (!mapRtc())
+	{
+		printf("cannot map the RTC registers at 0x%x\n", kHostRtcBase);
+		return 1;
+	}
+
+	writeLog(records);
+	lastSeconds = *rtcTsr;
+
+	for (uint32_t i = 0; i < queries; i++)
+	{
+		uint32_t	startSeconds	= 1000 + randomBits() % (lastSeconds - 1000 + 10);
+		uint32_t	endSeconds		= startSeconds + randomBits() % ((i % 10 == 0) ? lastSeconds : 200);
+		uint8_t		sensorBitNumber	= sensorBitNumbers[rand() % sizeof(sensorBitNumbers)];
+		uint8_t		firstReading	= (sensorBitNumber == 8) ? rand() % kHostBME680Readings : 0;
+		uint32_t	rangeRecords;
+		WarpStatus	status;
+
+		if (i == 0)
+		{
+			startSeconds	= 0;
+			endSeconds		= 0xFFFFFFFF;
+		}
+
+		hostRttClear();
+		status = flashAggregateBetweenTimes(0, startSeconds, endSeconds, sensorBitNumber, firstReading);
+		if (status != kWarpStatusOK)
+		{
+			printf("query %u: flashAggregateBetweenTimes() returned %d\n", i, status);
+			return 1;
+		}
+
+		referenceAggregate(startSeconds, endSeconds, 1 << sensorBitNumber, firstReading, channels, &rangeRecords);
+		if (!compareAggregate(firstReading, channels))
+		{
+			printf("query %u: times %u to %u, sensor bit %u, first reading %u\n", i, startSeconds, endSeconds, sensorBitNumber, firstReading);
+			return 1;
+		}
+
+		decodedRecords += rangeRecords;
+		for (int j = 0; j < kWarpFlashAggregateMaxChannels; j++)
+		{
+			matchingChannels += (channels[j].count != 0);
+		}
+	}
+
+	printf("%u records (%u pages); %u queries over %u records, %u channel aggregates: all match the reference decode\n",
+			records, gWarpPersistentState.logPageNumber - kHostInitialPageNumber + 1, queries, decodedRecords, matchingChannels);
+
+	return 0;
+}
@@ -0,0 +1,357 @@
+/*
+ *	Host model of the ring log (WARP_BUILD_ENABLE_FLASH_RING_LOG) over many
+ *	laps of a small simulated flash.
+ *
+ *	The writer streams records of varying size at the log head. Before a
+ *	page is programmed (AT45DB), or a sector is erased kWarpIS25xPEraseAhead
+ *	sectors ahead of the head (IS25xP), it calls modelAdvanceLogTail(), a
+ *	copy of warpFlashAdvanceLogTail() in boot.c over the simulated flash.
+ *	After every record the model walks the log from the tail to the head,
+ *	as flashReadAllMemory() does. The walk must find the newest records, in
+ *	order, each intact, and end exactly at the head.
+ *
+ *	Usage: ringLogModel [laps [seed]]
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+
+typedef enum
+{
+	kWarpModelPageSizeBytes		= kWarpSizeIS25xPPageSizeBytes,
+	kWarpModelFirstLogPage		= 16,
+	kWarpModelPagesPerSector	= 16,
+	kWarpModelLogSectors		= 6,
+	kWarpModelLogEndPage		= kWarpModelFirstLogPage + kWarpModelLogSectors * kWarpModelPagesPerSector,
+	kWarpModelEraseAheadSectors	= 2,	/* kWarpIS25xPEraseAheadSectors	*/
+	kWarpModelMaxRecordBytes	= 3 + 4 * 4 + 4 * 16,
+} WarpModelConstant;
+
+/*
+ *	A record is the 16-bit sensor bit field, the format byte, and four bytes
+ *	for each bit set in the low 4 bits of the bit field and for each of 16
+ *	readings for bit 4. The sequence number is written as the first of these
+ *	and the rest are derived from it, so that a record can be checked.
+ */
+static uint8_t		flash[kWarpModelLogEndPage * kWarpModelPageSizeBytes];
+static uint16_t		headPageNumber;
+static uint8_t		headPageOffset;
+static uint16_t		tailPageNumber;
+static uint8_t		tailPageOffset;
+static uint32_t		oldestSequenceNumber;
+static uint32_t		nextSequenceNumber;
+static uint32_t		overwrittenPages;
+
+
+static uint16_t
+modelRecordSize(uint16_t sensorBitField)
+{
+	uint16_t	recordSize = 3;
+
+	if ((sensorBitField == 0) || (sensorBitField == 0xFFFF) || (sensorBitField & 0xFFE0))
+	{
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		if (sensorBitField & (1 << i))
+		{
+			recordSize += 4;
+		}
+	}
+	if (sensorBitField & (1 << 4))
+	{
+		recordSize += 4 * 16;
+	}
+
+	return recordSize;
+}
+
+static uint16_t
+modelNextLogPage(uint16_t pageNumber)
+{
+	return (pageNumber + 1 >= kWarpModelLogEndPage) ? kWarpModelFirstLogPage : pageNumber + 1;
+}
+
+static uint8_t
+modelReadByte(uint16_t pageNumber, uint8_t pageOffset)
+{
+	return flash[pageNumber * kWarpModelPageSizeBytes + pageOffset];
+}
+
+/*
+ *	warpFlashAdvanceLogTail(), with flashReadMemory() reading the model.
+ */
+static void
+modelAdvanceLogTail(uint16_t firstPageNumber, uint16_t pageCount)
+{
+	uint16_t	nextPageNumber;
+	uint8_t		nextPageOffset;
+	uint8_t		bitFieldBytes[2];
+	uint16_t	recordSize;
+	uint16_t	recordEnd;
+	uint16_t	endPageNumber;
+
+	if (tailPageNumber == 0)
+	{
+		return;
+	}
+
+	endPageNumber = modelNextLogPage(firstPageNumber + pageCount - 1);
+
+	while (((uint16_t)(tailPageNumber - firstPageNumber) < pageCount) || ((tailPageNumber == endPageNumber) && (tailPageOffset == 0)))
+	{
+		nextPageNumber	= tailPageNumber;
+		nextPageOffset	= tailPageOffset + 1;
+		if (tailPageOffset == kWarpModelPageSizeBytes - 1)
+		{
+			nextPageNumber	= modelNextLogPage(tailPageNumber);
+			nextPageOffset	= 0;
+		}
+
+		bitFieldBytes[0] = modelReadByte(tailPageNumber, tailPageOffset);
+		bitFieldBytes[1] = modelReadByte(nextPageNumber, nextPageOffset);
+
+		recordSize = modelRecordSize((bitFieldBytes[0] << 8) | bitFieldBytes[1]);
+		if (recordSize == 0)
+		{
+			tailPageNumber = endPageNumber;
+			tailPageOffset = 0;
+
+			break;
+		}
+		else
+		{
+			recordEnd = tailPageOffset + recordSize;
+			while (recordEnd >= kWarpModelPageSizeBytes)
+			{
+				recordEnd -= kWarpModelPageSizeBytes;
+				tailPageNumber = modelNextLogPage(tailPageNumber);
+			}
+			tailPageOffset = recordEnd;
+
+			oldestSequenceNumber++;
+		}
+	}
+}
+
+/*
+ *	Called as the head enters a page. With sectorErase, as the IS25xP does
+ *	when the head reaches a sector and the erase-ahead manager erases the
+ *	one kWarpModelEraseAheadSectors on; otherwise as the AT45DB does before
+ *	any byte of the page is overwritten.
+ */
+static void
+modelEnterPage(uint16_t pageNumber, bool sectorErase)
+{
+	uint16_t	firstPageNumber = pageNumber;
+	uint16_t	pageCount = 1;
+
+	if (sectorErase)
+	{
+		uint16_t	sector = (pageNumber - kWarpModelFirstLogPage) / kWarpModelPagesPerSector;
+
+		if ((pageNumber - kWarpModelFirstLogPage) % kWarpModelPagesPerSector != 0)
+		{
+			return;
+		}
+
+		sector			= (sector + kWarpModelEraseAheadSectors) % kWarpModelLogSectors;
+		firstPageNumber	= kWarpModelFirstLogPage + sector * kWarpModelPagesPerSector;
+		pageCount		= kWarpModelPagesPerSector;
+	}
+
+	/*
+	 *	The first time round there is nothing to step over. As in
+	 *	eraseSectorIS25xP() and bufferToMainMemoryWriteAT45DB(), the tail is
+	 *	set when the start of the log is about to be overwritten again.
+	 */
+	if ((tailPageNumber == 0) && (firstPageNumber == kWarpModelFirstLogPage) && (nextSequenceNumber != 0))
+	{
+		tailPageNumber	= kWarpModelFirstLogPage;
+		tailPageOffset	= 0;
+	}
+
+	modelAdvanceLogTail(firstPageNumber, pageCount);
+	memset(&flash[firstPageNumber * kWarpModelPageSizeBytes], 0xFF, pageCount * kWarpModelPageSizeBytes);
+	overwrittenPages += pageCount;
+}
+
+static void
+modelStreamByte(uint8_t byte, bool sectorErase)
+{
+	if (headPageOffset == 0)
+	{
+		modelEnterPage(headPageNumber, sectorErase);
+	}
+
+	flash[headPageNumber * kWarpModelPageSizeBytes + headPageOffset] = byte;
+	headPageOffset++;
+	if (headPageOffset == 0)
+	{
+		headPageNumber = modelNextLogPage(headPageNumber);
+	}
+}
+
+static uint8_t
+modelRecordByte(uint32_t sequenceNumber, uint16_t index)
+{
+	return (uint8_t)((sequenceNumber * 2654435761u) >> (8 * (index & 3))) ^ (uint8_t)index;
+}
+
+static void
+modelWriteRecord(uint16_t sensorBitField, bool sectorErase)
+{
+	uint16_t	recordSize = modelRecordSize(sensorBitField);
+
+	modelStreamByte((uint8_t)(sensorBitField >> 8), sectorErase);
+	modelStreamByte((uint8_t)sensorBitField, sectorErase);
+	modelStreamByte(0x40 /* kWarpFlashRecordFormatVersion */, sectorErase);
+	for (uint16_t i = 3; i < recordSize; i++)
+	{
+		modelStreamByte((i < 7) ? (uint8_t)(nextSequenceNumber >> (8 * (6 - i))) : modelRecordByte(nextSequenceNumber, i), sectorErase);
+	}
+
+	nextSequenceNumber++;
+}
+
+/*
+ *	Walk the log from the tail to the head. Returns false, with a message,
+ *	at the first record that is not the next one expected.
+ */
+static bool
+modelCheckLog(void)
+{
+	uint16_t	pageNumber = (tailPageNumber == 0) ? kWarpModelFirstLogPage : tailPageNumber;
+	uint8_t		pageOffset = (tailPageNumber == 0) ? 0 : tailPageOffset;
+	uint32_t	expected = oldestSequenceNumber;
+	uint8_t		record[kWarpModelMaxRecordBytes];
+	uint16_t	recordSize;
+	uint32_t	sequenceNumber;
+
+	while ((pageNumber != headPageNumber) || (pageOffset != headPageOffset))
+	{
+		uint16_t	p = pageNumber;
+		uint8_t		o = pageOffset;
+
+		for (uint16_t i = 0; i < 2; i++)
+		{
+			record[i] = modelReadByte(p, o);
+			o++;
+			if (o == 0)
+			{
+				p = modelNextLogPage(p);
+			}
+		}
+
+		recordSize = modelRecordSize((record[0] << 8) | record[1]);
+		if (recordSize == 0)
+		{
+			printf("record %u: bad bit field 0x%02x%02x at page %u offset %u\n", expected, record[0], record[1], pageNumber, pageOffset);
+			return false;
+		}
+
+		for (uint16_t i = 2; i < recordSize; i++)
+		{
+			record[i] = modelReadByte(p, o);
+			o++;
+			if (o == 0)
+			{
+				p = modelNextLogPage(p);
+			}
+		}
+
+		sequenceNumber = ((uint32_t)record[3] << 24) | ((uint32_t)record[4] << 16) | ((uint32_t)record[5] << 8) | record[6];
+		if (sequenceNumber != expected)
+		{
+			printf("expected record %u, found %u at page %u offset %u\n", expected, sequenceNumber, pageNumber, pageOffset);
+			return false;
+		}
+		for (uint16_t i = 7; i < recordSize; i++)
+		{
+			if (record[i] != modelRecordByte(sequenceNumber, i))
+			{
+				printf("record %u: byte %u corrupt\n", sequenceNumber, i);
+				return false;
+			}
+		}
+
+		pageNumber	= p;
+		pageOffset	= o;
+		expected++;
+	}
+
+	if (expected != nextSequenceNumber)
+	{
+		printf("walk ended at record %u, head is at record %u\n", expected, nextSequenceNumber);
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+modelRun(bool sectorErase, uint32_t laps, uint32_t *  records, uint32_t *  minimumRetained)
+{
+	memset(flash, 0xFF, sizeof(flash));
+	headPageNumber			= kWarpModelFirstLogPage;
+	headPageOffset			= 0;
+	tailPageNumber			= 0;
+	tailPageOffset			= 0;
+	oldestSequenceNumber	= 0;
+	nextSequenceNumber		= 0;
+	overwrittenPages		= 0;
+	*minimumRetained		= UINT32_MAX;
+
+	while (overwrittenPages < (laps + 1) * (kWarpModelLogEndPage - kWarpModelFirstLogPage))
+	{
+		modelWriteRecord(1 + (rand() % 0x1F), sectorErase);
+		if (!modelCheckLog())
+		{
+			return false;
+		}
+
+		if (tailPageNumber != 0)
+		{
+			uint32_t	retained = nextSequenceNumber - oldestSequenceNumber;
+
+			*minimumRetained = (retained < *minimumRetained) ? retained : *minimumRetained;
+		}
+	}
+	*records = nextSequenceNumber;
+
+	return true;
+}
+
+int
+main(int argc, char **  argv)
+{
+	uint32_t	laps = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200;
+	uint32_t	records;
+	uint32_t	minimumRetained;
+	bool		ok = true;
+
+	srand((argc > 2) ? strtoul(argv[2], NULL, 0) : 1);
+
+	for (uint8_t sectorErase = 0; sectorErase < 2; sectorErase++)
+	{
+		if (modelRun(sectorErase, laps, &records, &minimumRetained))
+		{
+			printf("%s: %u laps, %u records of 7--83 bytes, every walk tail->head intact; at least %u records kept after wrapping\n",
+				   sectorErase ? "IS25xP (sector erase)" : "AT45DB (page program)", laps, records, minimumRetained);
+		}
+		else
+		{
+			printf("%s: FAILED\n", sectorErase ? "IS25xP (sector erase)" : "AT45DB (page program)");
+			ok = false;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+/*
+ *	Host check and timing of the fixed-point spectra in spectrum.c
+ *	(WARP_BUILD_ENABLE_MMA8451Q_SPECTRUM) against a double-precision DFT.
+ *
+ *	Each trial is a window of 14-bit accelerometer samples: a 1 g offset,
+ *	two tones of random frequency with the first at a large, medium or
+ *	small amplitude, and noise. The reference is the DFT of the same
+ *	samples with the mean removed and the Hann window applied, as
+ *	warpSpectrumReal() does. For each window size the harness reports
+ *	the worst SNR of the fixed-point spectrum, the worst band level error
+ *	of warpSpectrumBands() for bands above 40 dB, how often the strongest
+ *	peak from warpSpectrumPeaks() is not the reference's strongest bin,
+ *	and the host time per warpSpectrumReal().
+ *
+ *	Usage: spectrumBench [trials [seed]]
+ */
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "warp.h"
+
+
+
+typedef enum
+{
+	kHostMaxLog2Points	= 8,
+	kHostMaxPoints		= 1 << kHostMaxLog2Points,
+	kHostBands			= 8,
+	kHostTimingPasses	= 20,
+} HostConstant;
+
+
+static double
+gaussian(void)
+{
+	double	u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double	v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+/*
+ *	The samples of one trial, clipped to 14 bits.
+ */
+static void
+makeWindow(int16_t *  x, uint16_t points, uint32_t trial)
+{
+	double	amplitude = (trial % 3 == 0) ? 4000.0 : ((trial % 3 == 1) ? 300.0 : 30.0);
+	double	f1 = 3 + (rand() % (points / 2 - 8)) + (rand() % 100) / 100.0;
+	double	f2 = 2 + rand() % (points / 2 - 4);
+
+	for (uint16_t n = 0; n < points; n++)
+	{
+		double	v = 4096.0
+					+ amplitude * sin(2.0 * M_PI * f1 * n / points)
+					+ 0.3 * amplitude * sin(2.0 * M_PI * f2 * n / points + 1.0)
+					+ gaussian() * 2.0;
+
+		x[n] = (int16_t)lrint(fmin(fmax(v, -8192.0), 8191.0));
+	}
+}
+
+/*
+ *	X[0..points/2] of the windowed, mean-removed samples.
+ */
+static void
+referenceSpectrum(const int16_t *  x, uint16_t points, double complex *  spectrum)
+{
+	double	windowed[kHostMaxPoints];
+	double	mean = 0.0;
+
+	for (uint16_t n = 0; n < points; n++)
+	{
+		mean += x[n];
+	}
+	mean /= points;
+
+	for (uint16_t n = 0; n < points; n++)
+	{
+		windowed[n] = (x[n] - mean) * 0.5 * (1.0 - cos(2.0 * M_PI * n / points));
+	}
+
+	for (uint16_t k = 0; k <= points / 2; k++)
+	{
+		spectrum[k] = 0;
+		for (uint16_t n = 0; n < points; n++)
+		{
+			spectrum[k] += windowed[n] * cexp(-2.0 * M_PI * I * k * n / points);
+		}
+	}
+}
+
+static void
+runSize(uint8_t log2Points, uint32_t trials)
+{
+	uint16_t			points = 1 << log2Points;
+	uint16_t			halfPoints = points / 2;
+	uint16_t			binsPerBand = halfPoints / kHostBands;
+	int16_t				(*windows)[kHostMaxPoints] = malloc(trials * sizeof(*windows));
+	int16_t				x[kHostMaxPoints];
+	double complex		reference[kHostMaxPoints / 2 + 1];
+	double				worstSnr = INFINITY, worstBandError = 0.0;
+	uint32_t			peakMismatches = 0;
+	struct timespec		start, end;
+
+	for (uint32_t t = 0; t < trials; t++)
+	{
+		int16_t		levels[kHostBands];
+		uint8_t		bins[1];
+		int16_t		peakLevels[1];
+		int8_t		shift;
+		double		signal = 0.0, error = 0.0;
+		uint16_t	strongest = 1;
+		uint16_t	k = 1;
+
+		makeWindow(windows[t], points, t);
+		memcpy(x, windows[t], points * sizeof(x[0]));
+		referenceSpectrum(x, points, reference);
+
+		shift = warpSpectrumReal(x, log2Points);
+
+		for (k = 1; k < halfPoints; k++)
+		{
+			double complex	fixed = (x[2 * k] + I * x[2 * k + 1]) * ldexp(1.0, shift);
+
+			error	+= pow(cabs(fixed - reference[k]), 2);
+			signal	+= pow(cabs(reference[k]), 2);
+			if (cabs(reference[k]) > cabs(reference[strongest]))
+			{
+				strongest = k;
+			}
+		}
+		worstSnr = fmin(worstSnr, 10.0 * log10(signal / error));
+
+		/*
+		 *	Band levels are log2 of the energy in Q8; 3.0103 dB a step.
+		 */
+		warpSpectrumBands(x, log2Points, shift, levels, kHostBands);
+		k = 1;
+		for (uint8_t band = 0; band < kHostBands; band++)
+		{
+			double	energy = 0.0;
+
+			for (; k <= binsPerBand * (band + 1); k++)
+			{
+				energy += (k == halfPoints) ? pow(creal(reference[k]), 2) : pow(cabs(reference[k]), 2);
+			}
+			if (energy > 1e4)
+			{
+				worstBandError = fmax(worstBandError, fabs(levels[band] / 256.0 - log2(energy)) * 3.0103);
+			}
+		}
+
+		warpSpectrumPeaks(x, log2Points, shift, bins, peakLevels, 1);
+		if (bins[0] != strongest)
+		{
+			peakMismatches++;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t pass = 0; pass < kHostTimingPasses; pass++)
+	{
+		for (uint32_t t = 0; t < trials; t++)
+		{
+			memcpy(x, windows[t], points * sizeof(x[0]));
+			warpSpectrumReal(x, log2Points);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("N=%u: worst SNR vs double %.1f dB; worst band level error (bands above 40 dB) %.2f dB; top peak mismatches %u/%u; host %.2f us/FFT\n",
+		   points, worstSnr, worstBandError, peakMismatches, trials,
+		   ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3) / (kHostTimingPasses * trials));
+
+	free(windows);
+}
+
+int
+main(int argc, char **  argv)
+{
+	uint32_t	trials = (argc > 1) ? strtoul(argv[1], NULL, 0) : 300;
+
+	srand((argc > 2) ? strtoul(argv[2], NULL, 0) : 1);
+
+	for (uint8_t log2Points = 6; log2Points <= kHostMaxLog2Points; log2Points++)
+	{
+		runSize(log2Points, trials);
+	}
+
+	return 0;
+}